@@ -16,6 +16,7 @@
 #include <sstream>
 #include <fstream>
 #include <cstdio>
+#include <cstdlib>
 #include <chrono>
 
 #ifdef _WIN32
@@ -93,8 +94,8 @@ public:
 private:
     
 public:
-    QuantaConsole() {
-        engine_ = std::make_unique<Engine>();
+    explicit QuantaConsole(const Engine::Config& config = Engine::Config()) {
+        engine_ = std::make_unique<Engine>(config);
         bool init_result = engine_->initialize();
         
         if (!init_result) {
@@ -182,11 +183,57 @@ public:
         }
     }
     
+    // --heap-snapshot: the heap as the script left it, for DevTools' Memory
+    // panel, with the largest retainers listed here for a quick look.
+    bool write_heap_snapshot(const std::string& path) {
+        HeapSnapshot::Summary summary;
+        if (!engine_->write_heap_snapshot(path, &summary)) {
+            std::cerr << "Error: Cannot write heap snapshot " << path << std::endl;
+            return false;
+        }
+        std::cerr << "Heap snapshot written to " << path << ": " << summary.node_count << " nodes, "
+                  << summary.edge_count << " edges, " << summary.total_bytes << " bytes\n";
+        for (const HeapSnapshot::Node& node : summary.top_retainers) {
+            std::cerr << "  " << node.retained_size << " retained, " << node.self_size << " self  "
+                      << node.name << "\n";
+        }
+        return true;
+    }
+
+    // --alloc-profile / --alloc-profile-live: the allocation sampler's
+    // records as folded stacks, with its totals here.
+    bool write_allocation_profile(const std::string& path, AllocationSampler::Metric metric) {
+        if (!engine_->write_allocation_profile(path, metric)) {
+            std::cerr << "Error: Cannot write allocation profile " << path << std::endl;
+            return false;
+        }
+        const AllocationSampler::Totals totals = AllocationSampler::totals();
+        if (metric == AllocationSampler::Metric::LiveBytes) {
+            std::cerr << "Live allocation profile written to " << path << ": ~" << totals.live_bytes
+                      << " bytes from " << totals.live_samples << " live samples\n";
+        } else {
+            std::cerr << "Allocation profile written to " << path << ": ~" << totals.allocated_bytes
+                      << " bytes from " << totals.samples << " samples\n";
+        }
+        return true;
+    }
+
+    bool write_profiles(const std::string& heap_snapshot_path, const std::string& alloc_profile_path,
+                        const std::string& live_profile_path) {
+        if (!alloc_profile_path.empty() &&
+            !write_allocation_profile(alloc_profile_path, AllocationSampler::Metric::AllocatedBytes)) return false;
+        if (!live_profile_path.empty() &&
+            !write_allocation_profile(live_profile_path, AllocationSampler::Metric::LiveBytes)) return false;
+        if (!heap_snapshot_path.empty() && !write_heap_snapshot(heap_snapshot_path)) return false;
+        return true;
+    }
+
     bool evaluate_expression(const std::string& input, bool show_prompt = true, bool show_result = true, const std::string& filename = "<console>") {
         try {
             auto start = std::chrono::high_resolution_clock::now();
 
-            auto result = engine_->execute(input, filename);
+            auto result = filename == "<console>" ? engine_->execute(input, filename)
+                                                  : engine_->execute_file_source(input, filename);
 
             auto end = std::chrono::high_resolution_clock::now();
             auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
@@ -308,6 +355,11 @@ int main(int argc, char* argv[]) {
         bool force_module = false;
         std::string code_to_execute;
         std::string filename;
+        std::string heap_snapshot_path;
+        std::string alloc_profile_path;
+        std::string live_profile_path;
+        size_t alloc_sample_interval = AllocationSampler::kDefaultInterval;
+        Engine::Config config;
 
         for (int i = 1; i < argc; i++) {
             std::string arg = argv[i];
@@ -317,6 +369,21 @@ int main(int argc, char* argv[]) {
                 code_to_execute = argv[i + 1];
                 i++;
                 continue;
+            } else if (arg == "--heap-snapshot" && i + 1 < argc) {
+                heap_snapshot_path = argv[++i];
+                continue;
+            } else if (arg == "--alloc-profile" && i + 1 < argc) {
+                alloc_profile_path = argv[++i];
+                continue;
+            } else if (arg == "--alloc-profile-live" && i + 1 < argc) {
+                live_profile_path = argv[++i];
+                continue;
+            } else if (arg == "--alloc-sample-interval" && i + 1 < argc) {
+                alloc_sample_interval = std::strtoull(argv[++i], nullptr, 10);
+                continue;
+            } else if (arg == "--max-heap-size" && i + 1 < argc) {
+                config.max_heap_size = std::strtoull(argv[++i], nullptr, 10) * 1024 * 1024;
+                continue;
             } else if (arg == "--module") {
                 force_module = true;
                 continue;
@@ -332,6 +399,16 @@ int main(int argc, char* argv[]) {
                           << "Options:\n"
                           << "  -c <code>      Execute the given code and exit\n"
                           << "  --module       Force-load the file as an ES module\n"
+                          << "  --heap-snapshot <path>\n"
+                          << "                 Write a DevTools .heapsnapshot once the script ends\n"
+                          << "  --alloc-profile <path>\n"
+                          << "                 Sample allocations and write their stacks, folded\n"
+                          << "  --alloc-profile-live <path>\n"
+                          << "                 Same, counting only what is still alive at the end\n"
+                          << "  --alloc-sample-interval <bytes>\n"
+                          << "                 Mean bytes between samples (default 524288)\n"
+                          << "  --max-heap-size <megabytes>\n"
+                          << "                 Heap limit; past it the script gets a RangeError (default 512)\n"
                           << "  -v, --version  Print the engine version and exit\n"
                           << "  -h, --help     Show this help message and exit\n\n"
                           << "With no file and no -c, starts the interactive REPL.\n";
@@ -343,10 +420,14 @@ int main(int argc, char* argv[]) {
             }
         }
 
-        QuantaConsole console;
+        QuantaConsole console(config);
+        if (!alloc_profile_path.empty() || !live_profile_path.empty()) {
+            AllocationSampler::start(alloc_sample_interval);
+        }
 
         if (execute_code) {
             bool success = console.evaluate_expression(code_to_execute, false, true);
+            if (!console.write_profiles(heap_snapshot_path, alloc_profile_path, live_profile_path)) return 1;
             return success ? 0 : 1;
         }
 
@@ -369,6 +450,7 @@ int main(int argc, char* argv[]) {
             } else {
                 success = console.evaluate_expression(content, false, false, filename);
             }
+            if (!console.write_profiles(heap_snapshot_path, alloc_profile_path, live_profile_path)) return 1;
 
             return success ? 0 : 1;
         }
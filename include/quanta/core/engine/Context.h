@@ -146,9 +146,10 @@ private:
     // a root/module Context, see set_current_filename()'s own call sites),
     // so every child previously paid a full std::string copy (often a heap
     // allocation) at construction just to inherit an unchanging value.
-    // Interned via Shape::intern() (same pool, same write-only-on-set
-    // discipline -- see that method's own doc comment) so inheriting it is
-    // now a plain pointer copy.
+    // Interned via Shape::intern_pinned() (same pool, same write-only-on-set
+    // discipline -- see Shape::intern's own doc comment) so inheriting it is
+    // now a plain pointer copy. Pinned: the collector does not read it, and
+    // CallStack frames keep copies of the pointer.
     const std::string* current_filename_;
 
     static constinit thread_local uint32_t next_context_id_;
@@ -261,7 +262,7 @@ public:
     void set_import_meta(const Value& v) { import_meta_ = v; }
     
     const std::string& get_current_filename() const { return *current_filename_; }
-    void set_current_filename(const std::string& filename) { current_filename_ = Shape::intern(filename); }
+    void set_current_filename(const std::string& filename) { current_filename_ = Shape::intern_pinned(filename); }
     
     bool is_strict_mode() const { return strict_mode_; }
     void set_strict_mode(bool strict) { strict_mode_ = strict; }
@@ -627,8 +628,12 @@ public:
             return const_cast<SlotMap*>(this)->find_interned(key);
         }
 
+        // A key interned earlier may be one an open collection has not seen
+        // held anywhere yet, and this environment may be traced already; so
+        // storing it marks it, as intern() would have.
         BindingSlot& get_or_create_interned(const std::string* key) {
             if (BindingSlot* existing = find_interned(key)) return *existing;
+            Shape::note_key_reached(key);
             if (InlineEntry* e = free_entry()) {
                 e->key = key;
                 e->slot = BindingSlot{};
@@ -783,6 +788,12 @@ public:
     static void operator delete(void* ptr);
 
     Type get_type() const { return type_; }
+    // fn(name, value) for every binding. gc_trace reports the same values
+    // without their names; the heap snapshot wants them.
+    template <typename Fn>
+    void for_each_binding(Fn&& fn) const {
+        slots_.for_each([&fn](const std::string& name, const BindingSlot& slot) { fn(name, slot.value); });
+    }
     Environment* get_outer() const { return outer_environment_; }
     Object* get_binding_object() const { return binding_object_; }
     bool is_with_environment() const { return is_with_environment_; }
@@ -13,6 +13,9 @@
 #include "quanta/core/engine/Context.h"
 #include "quanta/core/modules/ModuleLoader.h"
 #include "quanta/core/gc/Heap.h"
+#include "quanta/core/gc/AllocationSampler.h"
+#include "quanta/core/gc/Collector.h"
+#include "quanta/core/gc/HeapSnapshot.h"
 #include "quanta/parser/AST.h"
 #include <string>
 #include <memory>
@@ -30,7 +33,9 @@ public:
     struct Config {
         bool strict_mode = false;
         bool enable_optimizations = true;
+        // A hard limit on the heap's footprint; see set_near_heap_limit_callback.
         size_t max_heap_size = 512 * 1024 * 1024;
+        // Chunk space mapped when the engine is made (Heap::reserve).
         size_t initial_heap_size = 32 * 1024 * 1024;
         size_t max_stack_size = 8 * 1024 * 1024;
         bool enable_debugger = false;
@@ -100,6 +105,9 @@ public:
     Result execute(const std::string& source);
     Result execute(const std::string& source, const std::string& filename);
     Result execute_file(const std::string& filename);
+    // execute_file for a caller that has already read the file: the source is
+    // run as the contents of filename, code cache included.
+    Result execute_file_source(const std::string& source, const std::string& filename);
     
     Result evaluate(const std::string& expression, bool strict_mode = false);
     
@@ -145,6 +153,35 @@ public:
     size_t get_heap_size() const;
     void force_gc();
     Heap* get_heap() const { return heap_; }
+    // Collects, then writes the heap as a Chrome DevTools .heapsnapshot to
+    // `path` (see HeapSnapshot). False when the file could not be written.
+    bool write_heap_snapshot(const std::string& path, HeapSnapshot::Summary* summary = nullptr);
+    // Writes what AllocationSampler has recorded on this thread to `path` as
+    // folded stacks. For LiveBytes it collects first, so the figures are the
+    // live set now rather than as of the last collection. False when the
+    // file could not be written.
+    bool write_allocation_profile(const std::string& path, AllocationSampler::Metric metric);
+    // Pause and throughput figures for the collections run on this thread:
+    // the recent cycles phase by phase, and pause percentiles over them
+    // (see Collector::telemetry). Reading them is the only cost.
+    Collector::Telemetry gc_stats() const { return Collector::telemetry(); }
+    // For a host with nothing to run until `deadline` -- between requests,
+    // say: spends the time on collection work that would otherwise land in a
+    // pause inside the next one (see Collector::idle_work). Returns whether
+    // work remains, so the host knows whether to call again at its next idle
+    // moment. Call it from the engine's thread, outside any script.
+    bool idle_notification(std::chrono::steady_clock::time_point deadline) {
+        return Collector::idle_work(deadline);
+    }
+    // Config::max_heap_size is a hard limit on this engine's heap footprint
+    // (see Heap's heap limits): crossing it runs an emergency major at the
+    // next safepoint, and if the heap is still over, this callback. It is
+    // given the current limit and the configured one and returns the limit to
+    // use from then on; returning one no larger stops the running script
+    // with a RangeError the script can catch.
+    void set_near_heap_limit_callback(Heap::NearHeapLimitCallback callback) {
+        heap_->set_near_heap_limit_callback(std::move(callback));
+    }
     
     void enable_profiler(bool enable);
     void enable_debugger(bool enable);
@@ -173,7 +210,10 @@ private:
     void setup_error_types();
     void setup_minimal_globals();
     
-    Result execute_internal(const std::string& source, const std::string& filename);
+    // use_code_cache: the source came from a file, so its compiled bodies are
+    // worth keeping for the next run (see CodeCache.h).
+    Result execute_internal(const std::string& source, const std::string& filename,
+                            bool use_code_cache = false);
     
     void handle_exception(const Value& exception);
 };
@@ -0,0 +1,75 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef QUANTA_GC_ALLOCATIONSAMPLER_H
+#define QUANTA_GC_ALLOCATIONSAMPLER_H
+
+#include <cstddef>
+#include <ostream>
+
+namespace Quanta {
+
+// Where the calling thread's allocations come from, and which of them are
+// still alive: a sampling heap profiler. Heap::allocate hands over one
+// allocation per sampling interval on average (see
+// Heap::set_allocation_sampling); each sample records the JS stack that made
+// it, read off CallStack, with the cell's kind as the leaf frame, and stands
+// for interval-many bytes of allocation at that stack. Each collection then
+// drops the samples whose cells it found dead, so the same records answer
+// both "what allocates" and "what is holding the memory".
+//
+// Off costs allocate() one compare against a byte countdown that never runs
+// out. On, the compare is the same, and the work is per sample, not per
+// allocation: at the default interval a program allocating a gigabyte takes
+// about two thousand samples. That is the point of sampling rather than
+// recording everything -- the profile is cheap enough to leave on.
+//
+// Samples hold their cells by address only, never as roots: a sample cannot
+// keep its cell alive, and a cell reaching a sample is what the liveness
+// check after marking is for.
+class AllocationSampler {
+public:
+    static constexpr size_t kDefaultInterval = 512 * 1024;
+
+    // Starts (or restarts, at a new interval) sampling this thread's
+    // allocations. Samples already taken are kept.
+    static void start(size_t mean_interval = kDefaultInterval);
+    // Stops sampling. The records are kept, and so are the live figures, as
+    // they stood at the last collection: once allocation is no longer
+    // watched, a freed cell's slot can be handed to a cell the profile never
+    // saw, so a sample can no longer be told apart from its successor.
+    static void stop();
+    static bool running();
+    // Drops every record.
+    static void clear();
+
+    // Collector: marking is complete and the sweep has not started, so a
+    // sampled cell the mark did not reach is dead.
+    static void drop_dead_samples();
+
+    enum class Metric {
+        AllocatedBytes,   // everything sampled since start
+        LiveBytes,        // what the last collection left alive
+    };
+    // Writes the records in the folded-stack format flamegraph.pl, speedscope
+    // and inferno read: one line per distinct stack, frames outermost first
+    // and separated by ';', then a space and the metric's estimated bytes.
+    // Stacks whose estimate is zero are left out. False when the stream
+    // failed.
+    static bool write_folded(std::ostream& out, Metric metric);
+
+    struct Totals {
+        size_t samples = 0;
+        size_t live_samples = 0;
+        size_t allocated_bytes = 0;
+        size_t live_bytes = 0;
+    };
+    static Totals totals();
+};
+
+}
+
+#endif
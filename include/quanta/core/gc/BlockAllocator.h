@@ -31,17 +31,27 @@ public:
     // A fresh 16KB aligned region (not yet a HeapBlock; caller runs init).
     void* allocate_block_region();
     void release_block_region(void* region);
+    // Maps chunks until the allocator holds at least `bytes` of them. Only
+    // ever grows: space already mapped counts toward it.
+    void reserve(size_t bytes);
 
-    // Scans every chunk for one whose 64 regions are all currently free --
-    // including a chunk that was carved out by grow() but never had all of
-    // its regions drawn, since LIFO consumption can leave an older chunk's
-    // regions untouched underneath newer ones indefinitely -- and hands its
-    // physical pages back to the OS. Call once per major collection, not
-    // per allocation: it is a full scan, not an incremental check.
-    void decommit_idle_chunks() const;
+    // Hands the physical pages of every free region back to the OS, bar the
+    // kCommittedReserve most recently released, which the next few fresh
+    // blocks will want straight away. This used to go chunk by chunk and
+    // only give a chunk back once all 64 of its regions were free, and after
+    // a spike that almost never happens: the survivors are scattered, one
+    // live block is enough to pin a chunk, and the memory around it stayed
+    // resident for good. A region is as good a unit as a chunk -- the
+    // chunk stays mapped either way -- so each free one goes back on its
+    // own, with neighbouring ones merged into one call. Call once per major
+    // collection, not per allocation.
+    void decommit_idle_regions();
 
     size_t chunk_count() const { return chunks_.size(); }
     size_t block_capacity() const { return chunks_.size() * kBlocksPerChunk; }
+    size_t decommitted_count() const { return decommitted_regions_.size(); }
+
+    static constexpr size_t kCommittedReserve = kBlocksPerChunk;
 
     // True when p lies inside any live chunk of any allocator (process-wide).
     static bool owns_address(const void* p);
@@ -51,6 +61,11 @@ private:
 
     std::vector<void*> chunks_;
     std::vector<void*> free_regions_;
+    // Free regions whose pages have gone back to the OS. Drawn on only once
+    // free_regions_ is empty, ahead of mapping a new chunk: the first touch
+    // faults in zero pages, and HeapBlock::init writes every header field
+    // regardless.
+    std::vector<void*> decommitted_regions_;
 };
 
 }
@@ -0,0 +1,74 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef QUANTA_GC_CARDTABLE_H
+#define QUANTA_GC_CARDTABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Quanta {
+
+// Dirty bits over a large array's element store, one per run of kCardSize
+// elements. An old array that would otherwise be remembered whole -- or have
+// every young value stored into it remembered one by one -- records which
+// runs changed instead, and the next minor re-reads only those runs (see
+// Collector::write_barrier_element).
+//
+// Indexed by element, not by address: the element store moves whenever it
+// grows (Object::realloc_butterfly) and may sit inside the cell itself, and
+// a card keyed by index means the same elements wherever they are.
+struct CardTable {
+    static constexpr uint32_t kCardShift = 7;
+    static constexpr uint32_t kCardSize = 1u << kCardShift;
+    // Below this many element slots a whole-cell retrace is cheap enough that
+    // a table is not worth its bookkeeping.
+    static constexpr uint32_t kMinElements = 1024;
+
+    // Grown on demand: the store can grow after the table is made.
+    std::vector<uint8_t> cards;
+    // On the collector's list of tables with dirty cards.
+    bool listed = false;
+
+    void mark(uint32_t index) {
+        const size_t c = index >> kCardShift;
+        if (c >= cards.size()) cards.resize(c + 1);
+        cards[c] = 1;
+    }
+    void mark_range(uint32_t begin, uint32_t count) {
+        if (!count) return;
+        const size_t first = begin >> kCardShift;
+        const size_t last = (static_cast<size_t>(begin) + count - 1) >> kCardShift;
+        if (last >= cards.size()) cards.resize(last + 1);
+        for (size_t c = first; c <= last; c++) cards[c] = 1;
+    }
+    // Calls f(begin, end) once per dirty card, clipped to `length` elements
+    // (adjacent cards are not merged), and clears them. Returns how many
+    // cards were dirty.
+    template <typename F>
+    size_t take_dirty(uint32_t length, F&& f) {
+        size_t dirty = 0;
+        for (size_t c = 0; c < cards.size(); c++) {
+            if (!cards[c]) continue;
+            cards[c] = 0;
+            dirty++;
+            const size_t begin = c << kCardShift;
+            if (begin >= length) continue;
+            const size_t end = begin + kCardSize < length ? begin + kCardSize : length;
+            f(static_cast<uint32_t>(begin), static_cast<uint32_t>(end));
+        }
+        return dirty;
+    }
+    void clear() {
+        for (uint8_t& c : cards) c = 0;
+        listed = false;
+    }
+};
+
+}
+
+#endif
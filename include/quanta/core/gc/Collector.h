@@ -11,20 +11,26 @@
 #include "quanta/core/vm/FixedArray.h"
 #include <chrono>
 #include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <vector>
 
 namespace Quanta {
 
 class Context;
+class Object;
 class Environment;
 class Value;
+class Visitor;
 
 // Per-thread mark(-sweep) collector. Runs only at interpreter safepoints,
 // never inside allocation -- a half-constructed cell (vtable not yet
 // written) is therefore never traced, only kept alive conservatively.
 // A collection spans every heap the calling thread owns: cross-realm edges
 // within one thread are ordinary edges, but two threads never scan each
-// other's heaps, so no cross-thread coordination is needed.
+// other's heaps, so no cross-thread coordination is needed. The one
+// exception is marking's own helpers (QUANTA_GC_MARK_THREADS): they trace
+// this thread's heaps on its behalf, and only while it waits for them.
 class Collector {
 public:
     // Environment knobs, read once:
@@ -33,7 +39,15 @@ public:
     //   QUANTA_GC_VERIFY=1   after marking, check every marked cell's edges
     //   QUANTA_GC_LOG=1      one summary line per collection to stderr
     //   QUANTA_GC_MARK_ONLY=1  skip the sweep (marking soak-test mode)
+    //   QUANTA_GC_NO_BACKGROUND_SWEEP=1  no background sweeper thread
+    //   QUANTA_GC_NO_LAZY_SWEEP=1  no sweeping left for allocation to do;
+    //                        with the knob above, every cell dies in the pause
     //   QUANTA_GC_PROFILE=1  per-phase timing breakdown to stderr
+    //   QUANTA_GC_MARK_THREADS=N  markers sharing a stop-the-world drain,
+    //                        the collecting thread included (default 1, off);
+    //                        QUANTA_GC_PROFILE then adds one line per marker
+    //   QUANTA_GC_CONSERVATIVE_FRAMES=1  scan every register of a VM frame,
+    //                        live or not, and clear none (see RegisterFile)
 
     // The interpreter's per-back-edge hook: collects when requested/stressed.
     //
@@ -46,12 +60,23 @@ public:
     // rather than a derived "armed" flag: a second copy of this state would
     // have to be updated at every site that arms or disarms one of them, and
     // an undercount there means a collection that silently never runs.
-    static void safepoint() {
+    //
+    // True when a heap of this thread is over its limit even after an
+    // emergency major, and its near-limit callback declined to raise it (see
+    // Heap::NearHeapLimitCallback): the script has to stop. Every caller hands
+    // a true answer to raise_heap_limit_error and leaves the way its own
+    // exceptions do; until one has, every safepoint keeps answering true (see
+    // Heap::heap_limit_refused).
+    [[nodiscard]] static bool safepoint() {
         if (Heap::gc_requested() || major_in_progress_ || stress_mode_ != 0) {
-            safepoint_slow();
+            return safepoint_slow();
         }
+        return false;
     }
-    static void safepoint_slow();
+    static bool safepoint_slow();
+    // The RangeError a true safepoint() stands for, thrown on ctx. Clears the
+    // refusal: the script has been told.
+    static void raise_heap_limit_error(Context& ctx);
 
     // True between an incremental major cycle's first slice and its last;
     // read directly by safepoint() above and by the barriers in Collector.cpp.
@@ -71,6 +96,26 @@ public:
     // since the last cycle re-enter the trace via the remembered sets.
     static void collect_minor();
 
+    // Collection work for a thread that has nothing else to do until
+    // `deadline` (Engine::idle_notification). In order, while time is left:
+    // a requested collection, slices of a major -- begun here once one is
+    // close to due, so the safepoint does not have to -- the sweeping lazy
+    // blocks are waiting on, and returning freed memory to the OS. True
+    // while any of that is left; the caller decides whether to come back.
+    static bool idle_work(std::chrono::steady_clock::time_point deadline);
+
+    // QUANTA_GC_MARK_THREADS for this thread, set at run time: the markers
+    // that share its stop-the-world drains from the next one on, itself
+    // included. One turns parallel marking off.
+    static void set_mark_threads(unsigned count);
+
+    // Reports every root a collection marks from through `v`, grouped by
+    // what holds it: `group` is called with each group's name before that
+    // group's edges. For tools that want to say why a cell is alive and not
+    // only that it is (HeapSnapshot.cpp). Stack words that name a cell are
+    // reported as edges to it, which is all the conservative scan knows.
+    static void trace_roots(Visitor& v, const std::function<void(const char*)>& group);
+
     enum class SliceResult { Continuing, CycleComplete };
 
     // One bounded unit of the shared, cycle-lived MarkVisitor's work: drains
@@ -94,6 +139,14 @@ public:
     // its whole length -- and an array being filled hits it on every append.
     // The second is one edge. Callers that have the value in hand use this.
     static void write_barrier_value(const void* cell, const Value& value);
+    // The barrier for a store into an array element. A large old array keeps
+    // a card table (CardTable.h) instead of remembering each edge, and the
+    // next minor re-reads just the runs that were written; anything else
+    // takes write_barrier_value.
+    static void write_barrier_element(Object* obj, uint32_t index, const Value& value);
+    // The same for `count` elements from `begin` written at once (a splice,
+    // a copy), whose values the caller does not have one by one.
+    static void write_barrier_elements(Object* obj, uint32_t begin, uint32_t count);
     // Same for environments (not cells; flag-deduped per cycle).
     static void write_barrier_env(Environment* env);
     // The barrier for a slot store, where the value decides whether there is
@@ -115,6 +168,86 @@ public:
     };
     static const CycleStats& last_cycle();
 
+    // Telemetry: the last kTelemetryCycles collections on this thread, kept
+    // in a ring that every collection writes one record into and nothing
+    // reads until asked. Recording is a handful of stores per collection, so
+    // it is always on; the percentiles are worked out by telemetry(), on the
+    // reader's time, never by the collector.
+    //
+    // A minor is one pause. A major is a cycle of incremental slices, each a
+    // pause of its own, so its record sums them and keeps the longest, and
+    // the slices go into the pause distribution one by one -- the mutator
+    // never waits for a whole major at once, and a p99 over whole cycles
+    // would report a pause nobody sees.
+    static constexpr size_t kTelemetryCycles = 256;
+    static constexpr size_t kTelemetryPauses = 1024;
+
+    struct CycleRecord {
+        bool minor = false;
+        // Microseconds since the process started, at the first pause.
+        uint64_t start_us = 0;
+        // Time the mutator was stopped: the whole pause for a minor, the
+        // sum of its slices for a major.
+        uint64_t pause_us = 0;
+        uint64_t longest_slice_us = 0;
+        uint32_t slices = 0;
+        // Phases, in microseconds. sweep_wait is waiting on the background
+        // and lazy sweeps a previous collection left running; roots covers
+        // the conservative stack scan; mark is the drain, survivor pools
+        // included; sweep is everything the pause still does once the mark
+        // is final.
+        uint64_t sweep_wait_us = 0;
+        uint64_t roots_us = 0;
+        uint64_t mark_us = 0;
+        uint64_t ephemeron_us = 0;
+        uint64_t verify_us = 0;
+        uint64_t sweep_us = 0;
+        // A minor marks only what it newly reached: with sticky marks the
+        // survivors of earlier cycles are marked already. Swept counts what
+        // the sweep found dead, whoever goes on to free it.
+        size_t marked_cells = 0;
+        size_t swept_cells = 0;
+        size_t swept_bytes = 0;
+        size_t live_bytes = 0;
+        size_t stack_words_scanned = 0;
+        size_t survivor_contexts = 0;
+        size_t survivor_environments = 0;
+        // Shapes a major freed from the transition tree, and how many the
+        // thread holds after it (see Shape::prune_unreached). Zero for a
+        // minor: only a major's mark says which shapes are still used.
+        size_t shapes_freed = 0;
+        size_t shapes = 0;
+        // The same for the property-key intern pool (see
+        // Shape::sweep_unreached_keys).
+        size_t keys_freed = 0;
+        size_t interned_keys = 0;
+        // Cards a minor found dirty on old arrays and re-read (see
+        // write_barrier_element). Zero for a major, which reads every array
+        // whole.
+        size_t dirty_cards = 0;
+    };
+
+    struct PauseDistribution {
+        size_t count = 0;
+        uint64_t p50_us = 0;
+        uint64_t p99_us = 0;
+        uint64_t max_us = 0;
+    };
+
+    struct Telemetry {
+        // Oldest first.
+        std::vector<CycleRecord> cycles;
+        // Over the last kTelemetryPauses pauses of each kind.
+        PauseDistribution minor_pauses;
+        PauseDistribution major_slice_pauses;
+        // Since the thread's first collection, not just what the ring holds.
+        size_t minor_count = 0;
+        size_t major_count = 0;
+        uint64_t total_pause_us = 0;
+        uint64_t max_pause_us = 0;
+    };
+    static Telemetry telemetry();
+
     // Live JS call frames. Contexts are not cells and only exist as raw
     // pointers on the C++ stack, which the conservative scanner cannot
     // trace through -- every running frame must register itself.
@@ -139,6 +272,50 @@ public:
     static void push_chunk(const class BytecodeChunk* chunk);
     static void pop_chunk(const class BytecodeChunk* chunk);
     static void pop_value_array(const FixedArray<Value>* arr);
+
+    // A running VM frame's register bank. Registered, the collector reads it
+    // precisely instead of as stack words: it asks the chunk's liveness map
+    // (VM::register_liveness) which registers the instruction at *pc may still
+    // read, visits those as Values, and leaves the bank's words out of the
+    // conservative scan. Only native frames are still scanned word by word.
+    //
+    // A register the map calls dead is skipped, not cleared: whatever it holds
+    // may be freed by this collection, but no instruction reads it again
+    // before writing it, so neither the VM nor a later collection looks at
+    // what is left. That rests entirely on the map being right, which
+    // tests/vm/liveness_test.cpp pins down row by row; a bank is never
+    // written by the collector.
+    //
+    // The map is only right for the instruction the frame is really at, so
+    // *pc must be current at every point a collection can start: every
+    // handler that can call out already sets it (an exception needs it), and
+    // the back-edge safepoints set it to the loop head.
+    struct RegisterFile {
+        Value* regs;
+        const class BytecodeChunk* chunk;
+        const uint32_t* pc;
+    };
+    // Pop by identity: a suspended fiber's frames stay registered while the
+    // host's come and go.
+    static void push_register_file(RegisterFile* file);
+    static void pop_register_file(RegisterFile* file);
+    // A fiber's stack is being freed without unwinding (a generator dropped
+    // while suspended): forgets the register files that lived on it.
+    static void forget_register_files(const void* stack_lo, const void* stack_hi);
+};
+
+// RAII: registers a frame's register bank for as long as the frame runs.
+class RegisterFileRoot {
+public:
+    explicit RegisterFileRoot(Collector::RegisterFile file) : file_(file) {
+        Collector::push_register_file(&file_);
+    }
+    ~RegisterFileRoot() { Collector::pop_register_file(&file_); }
+    RegisterFileRoot(const RegisterFileRoot&) = delete;
+    RegisterFileRoot& operator=(const RegisterFileRoot&) = delete;
+
+private:
+    Collector::RegisterFile file_;
 };
 
 // RAII: keeps a Value vector reachable for the collector while it is built or
@@ -11,6 +11,7 @@
 #include "quanta/core/gc/CellKind.h"
 #include "quanta/core/gc/HeapBlock.h"
 #include <atomic>
+#include <chrono>
 #include <cstddef>
 #include <cstdint>
 #include <functional>
@@ -39,6 +40,14 @@ public:
         size_t large_count = 0;
         size_t large_bytes = 0;
         size_t live_cells_by_kind[kNumCellKinds] = {};
+        // Dead cells the last collection left for allocation to sweep (see
+        // collect_dead_cells), and the blocks holding them. Not part of the
+        // live figures above: those count only what the mark kept.
+        size_t unswept_blocks = 0;
+        size_t unswept_bytes = 0;
+        // Chunk space whose pages have gone back to the OS: mapped, counted
+        // in chunk_count, but not resident.
+        size_t decommitted_bytes = 0;
     };
 
     Heap();
@@ -75,6 +84,9 @@ public:
     static void set_mark(const ProbeResult& p);
     // Exact, known-live cell (from a trace edge, not a guess).
     static ProbeResult exact_cell(const void* p);
+    // Bytes the heap set aside for a live cell: its size class's slot, or
+    // a large cell's requested size.
+    static size_t cell_size(const void* cell);
     // Marks a cell named by a trace edge, where the pointer is a cell base
     // and the kind is known from the edge itself. Returns the cell when this
     // call is the one that marked it, and nothing when it was already marked
@@ -82,6 +94,22 @@ public:
     // an interior pointer or reads the kind back out of the block, neither of
     // which an edge needs.
     static ProbeResult mark_exact(const void* p, CellKind kind);
+    // mark_exact for a parallel mark phase: same contract, but the bit is
+    // claimed atomically, so exactly one of several racing markers gets the
+    // cell back.
+    static ProbeResult mark_exact_atomic(const void* p, CellKind kind);
+
+    // Which heaps count as "this thread's" -- see owned_by_this_thread in
+    // Heap.cpp. A parallel-mark helper traces on behalf of a mutator that is
+    // stopped for the phase, so it has to answer that question the way the
+    // mutator would: the mutator hands out its view, the helper adopts it for
+    // the phase and drops it (a default OwnerView) afterwards.
+    struct OwnerView {
+        Heap* active = nullptr;
+        const std::vector<Heap*>* heaps = nullptr;
+    };
+    static OwnerView owner_view();
+    static void adopt_owner_view(const OwnerView& view);
     // The cell a pointer names, where the pointer is known to be a cell base
     // -- the write barrier's container, not a guessed stack word. Skips the
     // interior-pointer resolution the conservative probe has to do; the kind
@@ -136,7 +164,78 @@ public:
     // every minor pass over the whole heap, which on a large live set is most
     // of what the collection costs. A major clears the marks first, so it has
     // to look everywhere.
-    static void collect_dead_cells(std::vector<DeadCell>& out, bool minor_only);
+    //
+    // With `background` given, a block whose kind is not Object and that
+    // allocation is not pointed at is not listed cell by cell: it goes to
+    // `background` instead, flagged in_background_sweep, for
+    // sweep_in_background. With `lazy` given, every other such block is left
+    // unswept for allocation -- see LazySweep. Returns the dead cells the
+    // blocks handed off either way hold.
+    struct LazySweep;
+    static size_t collect_dead_cells(std::vector<DeadCell>& out, bool minor_only,
+                                     std::vector<HeapBlock*>* background = nullptr,
+                                     const LazySweep* lazy = nullptr);
+    // Bytes the last collect_dead_cells found dead, listed or handed off.
+    static size_t last_dead_bytes();
+
+    // Background sweeping. Running every dead cell's destructor before the
+    // mutator resumes put the whole sweep in the pause, though most dead
+    // cells need nothing of the mutator to die: a String, Symbol or BigInt
+    // releases only its own malloc'd storage. Blocks of those go to a
+    // sweeper thread (one per owning thread, started on first use) that runs
+    // `finalize` and free_cell over their dead cells while JS runs again.
+    //
+    // A block is the sweeper's outright until it is handed back: nothing
+    // allocates from it (it is neither active nor a candidate), and nothing
+    // else on the mutator writes its header -- the write barrier only ever
+    // records Object containers. Allocation takes finished blocks back as
+    // candidates on its slow path; finish_background_sweep waits for the
+    // rest and takes them all, and every collection, stats() and an explicit
+    // free into such a block call it first.
+    using Finalizer = void (*)(void* cell, CellKind kind);
+    static void sweep_in_background(std::vector<HeapBlock*>& blocks, Finalizer finalize);
+    static void finish_background_sweep();
+
+    // Lazy sweeping. What is left in the pause after the background sweeper
+    // takes its share is mostly Object blocks, and a heap that has just
+    // dropped a large structure has millions of dead cells in them, every one
+    // a destructor call before the mutator may resume. Most of those blocks
+    // are not wanted again soon: nothing needs a block swept until allocation
+    // wants its slots. So collect_dead_cells leaves them as they are, flagged
+    // awaiting_lazy_sweep, and allocate() sweeps one only when its (kind,
+    // size class) has run out of swept candidates and would otherwise take a
+    // fresh block. The sweep cost is spread across the allocation that
+    // actually reuses the memory, and the blocks allocation never comes back
+    // for wait for finish_lazy_sweep.
+    //
+    // allocate() is not a safepoint, and some destructors must only run at
+    // one -- a Promise hands its context back to the event loop, an
+    // ArrayBuffer reaches into its views. Before sweeping a block there,
+    // allocation asks `finalizes_anywhere` of every dead cell in it; a block
+    // holding one that cannot be finalized there is set aside for
+    // sweep_refused_blocks instead.
+    //
+    // Until a block is swept its dead cells keep their alloc bits but are not
+    // cells: the mark is the only record of which are live, so every
+    // collection that would clear or extend that record has to come after
+    // the sweep. A minor neither clears marks nor reaches a dead cell from a
+    // live one, and the conservative probe refuses them (see
+    // HeapBlock::cell_containing), so lazy blocks survive minors untouched; a
+    // major clears every mark and calls finish_lazy_sweep first.
+    struct LazySweep {
+        bool (*finalizes_anywhere)(void* cell, CellKind kind);
+        Finalizer finalize;
+    };
+    // Sweeps every lazy block of every heap of this thread. Safepoints only.
+    static void finish_lazy_sweep();
+    // Sweeps only the blocks allocation turned down. Safepoints only.
+    static void sweep_refused_blocks();
+    // finish_lazy_sweep a block at a time, stopping at `deadline`; returns
+    // the blocks swept. For idle time (Collector::idle_work), where the sweep
+    // allocation would otherwise do piecemeal can be done up front.
+    static size_t sweep_lazy_until(std::chrono::steady_clock::time_point deadline);
+    // Whether any heap of this thread still has lazy or refused blocks.
+    static bool lazy_sweep_pending();
     // Empties the dirty list and re-seeds it with the blocks allocation is
     // currently pointed at. Must run before rebuild_allocation_candidates,
     // which is what releases blocks: a released block must not still be on it.
@@ -147,16 +246,25 @@ public:
     // heap's live bytes, counted on the way through: the pacing needs that
     // number right after a sweep, and this already touches every block to
     // find it -- asking stats() for it walked the whole heap a second time.
+    //
+    // Sparse blocks (under a quarter occupied) are queued behind the rest,
+    // so allocation fills them last. Cells here never move -- see the note
+    // in Heap.cpp -- so a sparse block only empties by attrition, and
+    // refilling it first is what kept that from ever happening: after a
+    // spike, the survivors' blocks got topped up again instead of dying off,
+    // and stayed resident. Behind the dense ones they are still used before
+    // any fresh block, so nothing is wasted when the space is wanted.
     static size_t rebuild_allocation_candidates();
 
-    // Full idle-chunk scan (see BlockAllocator::decommit_idle_chunks) --
+    // Free-region decommit (see BlockAllocator::decommit_idle_regions) --
     // major-collection-only housekeeping, not part of the minor pause budget.
     static void decommit_idle_memory();
 
     // Allocation-triggered GC request; the interpreter's safepoint consumes it.
     static bool gc_requested() { return gc_requested_; }
     static void request_gc()   { gc_requested_ = true; }
-    static void clear_gc_request() { gc_requested_ = false; }
+    // A refused heap limit keeps the request standing: see heap_limit_refused.
+    static void clear_gc_request() { gc_requested_ = heap_limit_refused_; }
     // Bytes allocated since the last major finished, and the live set it left
     // behind. A major is due once the heap has grown by a share of what was
     // live: that is the signal that old-generation garbage is piling up, and
@@ -168,6 +276,65 @@ public:
         live_after_major_ = live_bytes;
     }
     static size_t live_after_major() { return live_after_major_; }
+    // Heap limits. A heap's footprint is the blocks it has in use plus its
+    // large cells: what it holds, rather than what its cells are worth (a
+    // block with one live cell counts whole) or what the chunk allocator has
+    // mapped (free regions are anyone's). The limit caps that figure, per heap
+    // and so per engine, for an embedder running many engines in one process
+    // that needs each bounded rather than the whole process OOM-killed.
+    //
+    // Allocation never fails and never collects, so the limit cannot be
+    // enforced there. What allocation does is notice: the slow path that adds
+    // a block or a large cell compares the footprint against the limit, and on
+    // crossing it flags the thread and requests a collection. The safepoint
+    // that takes the request answers it (see Collector::safepoint): an
+    // emergency major first, then, if that did not bring the heap back under,
+    // the near-limit callback. So a heap overshoots its limit by at most what
+    // the mutator allocates between two safepoints.
+    //
+    // The callback gets the current limit and the one the heap started with,
+    // and returns the limit to use from now on. Anything larger raises it;
+    // anything else declines, and the script is stopped with a RangeError.
+    using NearHeapLimitCallback = std::function<size_t(size_t current_limit, size_t initial_limit)>;
+    size_t footprint() const { return block_count_ * HeapBlock::kBlockSize + large_bytes_; }
+    size_t heap_limit() const { return heap_limit_; }
+    // Also becomes the initial limit the callback is told about.
+    void set_heap_limit(size_t bytes);
+    void set_near_heap_limit_callback(NearHeapLimitCallback callback) {
+        near_limit_callback_ = std::move(callback);
+    }
+    // Set by allocation when some heap of this thread crossed its limit;
+    // cleared by the safepoint that deals with it.
+    static bool heap_limit_reached() { return heap_limit_reached_; }
+    static void clear_heap_limit_reached() { heap_limit_reached_ = false; }
+    // Set when the near-limit callback has declined and the script still has
+    // to be stopped; cleared only once some caller has actually raised the
+    // error (Collector::raise_heap_limit_error). Until then every safepoint
+    // answers true without collecting again. A refusal that lived only in one
+    // safepoint's return value was lost to every caller that could not throw
+    // it, and the next block paid for another emergency major and another
+    // callback.
+    static bool heap_limit_refused() { return heap_limit_refused_; }
+    static void refuse_heap_limit() {
+        heap_limit_refused_ = true;
+        request_gc();
+    }
+    static void clear_heap_limit_refused() { heap_limit_refused_ = false; }
+    // A heap of this thread whose footprint is over its limit, or null.
+    static Heap* over_limit_heap();
+    // True when some heap of this thread has used three quarters of its
+    // limit. The collector stops choosing minors then: what fills a heap up
+    // to its limit is old data, and only a major reclaims any of it.
+    static bool near_heap_limit();
+    // Offers an over-limit heap's callback the chance to raise the limit.
+    // True when it did; false when it declined or there is no callback.
+    bool raise_limit_for_footprint();
+    // Maps chunks up front until this heap's allocator has room for `bytes`
+    // of blocks (Engine::Config::initial_heap_size). The pages stay untouched
+    // until a block lands on them; what reserving saves is the map call and
+    // the chunk registry rebuild each chunk costs as the heap first grows.
+    void reserve(size_t bytes) { block_allocator_.reserve(bytes); }
+
     // Charges `bytes` toward gc_requested()'s budget for memory the cell heap
     // doesn't see directly (survivor Contexts). An ordinary charge: a minor
     // reclaims that pool now, so its growth no longer has to buy a major.
@@ -181,6 +348,19 @@ public:
     // one realm and deleted while another realm's heap is active stays safe.
     static void cell_free(void* p);
 
+    // Allocation sampling, for AllocationSampler. `on_sample` sees one
+    // allocation per `mean_interval` bytes on average, the distances between
+    // samples drawn from an exponential distribution -- sampling as a Poisson
+    // process over the bytes, so every byte is equally likely to be picked
+    // whatever the size of the cell it belongs to, and a loop allocating in a
+    // fixed pattern cannot alias with a fixed interval. `on_free` sees every
+    // cell_free while sampling is on, so a sample can be dropped when its
+    // cell is deleted rather than collected. A zero interval turns it off;
+    // per thread, like the heap.
+    using SampleHook = void (*)(void* cell, size_t size, CellKind kind);
+    using FreeHook = void (*)(void* cell);
+    static void set_allocation_sampling(size_t mean_interval, SampleHook on_sample, FreeHook on_free);
+
     // True when p points into (or at) a live cell of THIS heap.
     bool contains(const void* p) const;
     // Cell base address for p (interior pointers OK), nullptr when not a
@@ -208,6 +388,8 @@ private:
     static constexpr uint64_t kLargeMagic = 0x514C41524745ULL;  // "QLARGE"
 
     static size_t size_class_index(size_t size);
+    void* allocate_cell(size_t size, CellKind kind, HeapSegment segment);
+    static void sample_allocation(void* cell, size_t size, CellKind kind);
     HeapBlock* fresh_block(CellKind kind, HeapSegment segment, size_t cls);
     void* allocate_large(size_t size, CellKind kind);
     static void free_large(void* p);
@@ -216,6 +398,15 @@ private:
     static constinit thread_local bool gc_requested_;
     static constinit thread_local size_t bytes_since_major_;
     static constinit thread_local size_t live_after_major_;
+    static constinit thread_local bool heap_limit_reached_;
+    static constinit thread_local bool heap_limit_refused_;
+
+    void check_heap_limit() {
+        if (footprint() > heap_limit_) [[unlikely]] {
+            heap_limit_reached_ = true;
+            request_gc();
+        }
+    }
 
     BlockAllocator block_allocator_;
     // Current allocation target per (kind, class); full blocks rotate into
@@ -230,8 +421,24 @@ private:
         dirty_blocks_.push_back(b);
     }
     std::vector<HeapBlock*> partial_blocks_[kNumCellKinds][kNumSizeClasses];
+    // What the blocks out on the background sweeper will hold once it is
+    // done with them, so the pacing can count them without waiting.
+    size_t background_live_bytes_ = 0;
+    static void adopt_swept_blocks();
+    static void adopt_swept_block(HeapBlock* b);
+    // Blocks awaiting their lazy sweep, per (kind, class) so allocation finds
+    // the ones it can use directly, and the ones allocation found a dead cell
+    // in that only a safepoint may finalize.
+    std::vector<HeapBlock*> lazy_blocks_[kNumCellKinds][kNumSizeClasses];
+    std::vector<HeapBlock*> refused_blocks_;
+    HeapBlock* sweep_for_allocation(size_t kind, size_t cls);
+    static void sweep_lazy_block(HeapBlock* b);
     LargeCell* large_cells_ = nullptr;
+    size_t large_bytes_ = 0;
     size_t block_count_ = 0;
+    size_t heap_limit_ = SIZE_MAX;
+    size_t initial_heap_limit_ = SIZE_MAX;
+    NearHeapLimitCallback near_limit_callback_;
 };
 
 // RAII: makes a heap the thread's active heap for its lifetime.
@@ -34,7 +34,20 @@ public:
     static HeapBlock* init(void* region, Heap* heap, CellKind kind,
                            HeapSegment segment, uint32_t cell_size);
 
-    void* try_allocate();          // nullptr when full
+    // nullptr when full. Allocation bumps a cursor through a run of free
+    // slots -- the young cells of a cycle are laid down next to each other,
+    // in address order, as a nursery's would be -- and only looks at the
+    // bitmaps again when the run is used up; see next_run. Inline: it is
+    // the whole of the allocation fast path, a compare, an increment and a
+    // bit set, and Heap::allocate is in another translation unit.
+    void* try_allocate() {
+        if (h_.run_cursor == h_.run_end && !next_run()) return nullptr;
+        const uint32_t idx = h_.run_cursor++;
+        h_.alloc_bitmap[idx / 64] |= static_cast<uint64_t>(1) << (idx % 64);
+        if (idx < h_.bump_cursor) h_.free_count--;
+        else h_.bump_cursor = idx + 1;
+        return payload_start() + static_cast<size_t>(idx) * h_.cell_size;
+    }
     void  free_cell(void* p);      // explicit delete path (unique_ptr interop)
     // Poison mode: drop the cell from the alloc bitmap WITHOUT recycling the
     // slot, so a use-after-free hits poisoned bytes instead of a fresh cell.
@@ -53,7 +66,7 @@ public:
     uint32_t    capacity() const    { return h_.capacity; }
     uint32_t    live_count() const  { return h_.bump_cursor - h_.free_count; }
     bool        is_empty() const    { return live_count() == 0; }
-    bool        is_full() const     { return !h_.free_list && h_.bump_cursor == h_.capacity; }
+    bool        is_full() const     { return h_.free_count == 0 && h_.bump_cursor == h_.capacity; }
 
     HeapBlock*  next() const           { return h_.next; }
     void        set_next(HeapBlock* n) { h_.next = n; }
@@ -87,6 +100,22 @@ public:
         return true;
     }
 
+    // mark_if_unmarked for parallel marking, where several markers can reach
+    // the same cell, or two cells sharing a bitmap word, at once. The plain
+    // load first keeps the locked instruction off the common already-marked
+    // edge; the fetch-or then decides which marker owns the trace. Relaxed is
+    // enough: the bit guards nothing but the trace, and the cell's contents
+    // were published to every marker before the phase started.
+    bool mark_if_unmarked_atomic(const void* p) {
+        const size_t idx = slot_index(p);
+        if (idx == SIZE_MAX) return false;
+        const size_t word = idx / 64;
+        const uint64_t bit = static_cast<uint64_t>(1) << (idx % 64);
+        if (!(h_.alloc_bitmap[word] & bit)) return false;
+        if (__atomic_load_n(&h_.mark_bitmap[word], __ATOMIC_RELAXED) & bit) return false;
+        return !(__atomic_fetch_or(&h_.mark_bitmap[word], bit, __ATOMIC_RELAXED) & bit);
+    }
+
     bool test_mark(const void* p) const {
         const size_t idx = slot_index(p);
         if (idx == SIZE_MAX) return false;
@@ -133,16 +162,62 @@ public:
         }
     }
 
+    // Who still owes this block its sweep. Swept: nobody, the bitmaps say
+    // which cells are live. Background: the background sweeper is running its
+    // dead cells' destructors right now -- see Heap::sweep_in_background.
+    // Lazy: the last collection left its dead cells for allocation to sweep
+    // -- see Heap::collect_dead_cells -- so until then only a marked cell in
+    // it is live. Read and written on the owning thread only; the sweeper
+    // never looks at it.
+    enum class SweepState : uint8_t { Swept, Background, Lazy };
+    SweepState sweep_state() const { return h_.sweep_state; }
+    void set_sweep_state(SweepState s) { h_.sweep_state = s; }
+    bool in_background_sweep() const { return h_.sweep_state == SweepState::Background; }
+    bool awaiting_lazy_sweep() const { return h_.sweep_state == SweepState::Lazy; }
+
+    // Cells the current mark leaves alive, and dead: alloc & mark and
+    // alloc & ~mark, counted a word at a time.
+    uint32_t marked_count() const {
+        uint32_t n = 0;
+        for (size_t w = 0; w < kBitmapWords; w++)
+            n += static_cast<uint32_t>(__builtin_popcountll(h_.alloc_bitmap[w] & h_.mark_bitmap[w]));
+        return n;
+    }
+    uint32_t dead_count() const {
+        uint32_t n = 0;
+        for (size_t w = 0; w < kBitmapWords; w++)
+            n += static_cast<uint32_t>(__builtin_popcountll(h_.alloc_bitmap[w] & ~h_.mark_bitmap[w]));
+        return n;
+    }
+
+    // finalize(cell, kind), then free_cell, for every dead cell: the whole of
+    // a block's sweep, for a sweeper that owns the block outright.
+    void sweep_dead_cells(void (*finalize)(void* cell, CellKind kind));
+
 private:
-    struct FreeCell { FreeCell* next; };
+    // Moves the run to the next stretch of free slots at or after the end of
+    // the current one, false when there is none. A slot is free when neither
+    // its alloc bit nor its remembered bit is set -- see retire_cell.
+    bool next_run();
 
     struct Header {
         Heap*      heap;
         HeapBlock* next;
-        FreeCell*  free_list;
+        // [run_cursor, run_end): the free slots try_allocate is handing out.
+        // A free list threaded through dead cells used to sit here; it made
+        // every allocation a dependent load from the cell it was about to
+        // hand out and every sweep a store into the cell it had just freed,
+        // and it handed holes out in the reverse of the order the sweep
+        // found them. The bitmaps already say which slots are free, so the
+        // run is read off them instead, a word at a time.
+        uint32_t   run_cursor;
+        uint32_t   run_end;
         uint32_t   cell_size;
         uint32_t   capacity;
+        // One past the highest slot ever handed out; the scans over the
+        // bitmaps stop here.
         uint32_t   bump_cursor;
+        // Free slots below bump_cursor.
         uint32_t   free_count;
         // ceil(2^32 / cell_size), so the slot index of a cell is a multiply
         // and a shift instead of a divide. The size classes are not powers of
@@ -156,6 +231,8 @@ private:
         // dirty_blocks_. Sits in padding the two enums already leave, so the
         // header does not grow.
         bool       in_dirty_list;
+        // See sweep_state(). The last byte of that same padding.
+        SweepState sweep_state;
         uint64_t   alloc_bitmap[kBitmapWords];
         uint64_t   mark_bitmap[kBitmapWords];
         uint64_t   remembered_bitmap[kBitmapWords];
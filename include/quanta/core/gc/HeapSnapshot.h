@@ -0,0 +1,61 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef QUANTA_GC_HEAPSNAPSHOT_H
+#define QUANTA_GC_HEAPSNAPSHOT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace Quanta {
+
+// The calling thread's heap as a graph, written in the .heapsnapshot JSON
+// Chrome DevTools' Memory panel loads. Nodes are every live cell, every
+// Context and Environment reachable from one, and a synthetic node per root
+// group (see Collector::trace_roots) under a single "(GC roots)" node; the
+// edges are what the cells' own trace() implementations report, so the
+// snapshot sees exactly the graph the collector marks.
+//
+// The graph is held as flat arrays -- a few words per node and per edge --
+// but the JSON never is: nodes, edges and strings are each written straight
+// to the stream as they are produced, so a heap of gigabytes costs its graph,
+// not a second copy of itself as text.
+//
+// Collects first, so every cell in the snapshot is live. Cells that only the
+// conservative stack scan holds have no precise root to hang from and appear
+// under "(Conservative stack roots)".
+class HeapSnapshot {
+public:
+    struct Node {
+        std::string name;
+        size_t self_size = 0;
+        // Self size plus everything only this node keeps alive: the bytes a
+        // collection would free if the node went away. DevTools computes its
+        // own from the edges; this is the same dominator-tree answer, for a
+        // caller that has no DevTools to hand.
+        size_t retained_size = 0;
+    };
+
+    struct Summary {
+        size_t node_count = 0;
+        size_t edge_count = 0;
+        size_t total_bytes = 0;
+        // The nodes retaining the most, largest first, synthetic nodes left
+        // out.
+        std::vector<Node> top_retainers;
+    };
+
+    // Writes the snapshot to `out`; false when the stream failed.
+    // `top_retainers` bounds Summary::top_retainers.
+    static bool write(std::ostream& out, Summary* summary = nullptr, size_t top_retainers = 10);
+};
+
+}
+
+#endif
@@ -0,0 +1,318 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef QUANTA_GC_PARALLEL_MARKER_H
+#define QUANTA_GC_PARALLEL_MARKER_H
+
+#include "quanta/core/gc/CellKind.h"
+#include "quanta/core/gc/Heap.h"
+#include "quanta/core/gc/Visitor.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Quanta {
+
+// The machinery behind QUANTA_GC_MARK_THREADS (see Collector.cpp, where the
+// collector's MarkVisitor hands a stop-the-world drain to it and merges back
+// what the markers deferred). Here rather than in Collector.cpp so that
+// tests/gc/collector_test.cpp can drive a pool and a deque directly.
+
+// Chase-Lev work-stealing deque (Chase & Lev 2005, with the memory orders of
+// Le, Pop, Cohen & Zappa Nardelli 2013). The owner pushes and pops at the
+// bottom without contention; thieves take from the top and race only each
+// other, and the owner only for the last entry. Entries are encoded gray
+// cells -- see ParallelMarker::encode.
+class WorkStealingDeque {
+public:
+    WorkStealingDeque() { array_.store(grow_to(kInitialCapacity, nullptr, 0, 0), std::memory_order_relaxed); }
+
+    WorkStealingDeque(const WorkStealingDeque&) = delete;
+    WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+    void push(uintptr_t x) {
+        int64_t b = bottom_.load(std::memory_order_relaxed);
+        int64_t t = top_.load(std::memory_order_acquire);
+        Array* a = array_.load(std::memory_order_relaxed);
+        if (b - t > a->mask) {
+            a = grow_to((a->mask + 1) * 2, a, t, b);
+            array_.store(a, std::memory_order_release);
+        }
+        a->slots[b & a->mask].store(x, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom_.store(b + 1, std::memory_order_relaxed);
+    }
+
+    bool pop(uintptr_t& out) {
+        int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+        Array* a = array_.load(std::memory_order_relaxed);
+        bottom_.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top_.load(std::memory_order_relaxed);
+        if (t > b) {
+            bottom_.store(b + 1, std::memory_order_relaxed);
+            return false;
+        }
+        out = a->slots[b & a->mask].load(std::memory_order_relaxed);
+        if (t == b) {
+            // Last entry: a thief may be taking it too, and top decides.
+            bool won = top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                                    std::memory_order_relaxed);
+            bottom_.store(b + 1, std::memory_order_relaxed);
+            return won;
+        }
+        return true;
+    }
+
+    bool steal(uintptr_t& out) {
+        int64_t t = top_.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom_.load(std::memory_order_acquire);
+        if (t >= b) return false;
+        Array* a = array_.load(std::memory_order_acquire);
+        out = a->slots[t & a->mask].load(std::memory_order_relaxed);
+        return top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                            std::memory_order_relaxed);
+    }
+
+    bool looks_empty() const {
+        return top_.load(std::memory_order_relaxed) >= bottom_.load(std::memory_order_relaxed);
+    }
+
+    // Between phases only, with no thief left: a thief can still be reading
+    // an array the owner has outgrown, so outgrown ones are kept until here.
+    void release_outgrown() {
+        Array* current = array_.load(std::memory_order_relaxed);
+        for (auto& a : arrays_) {
+            if (a.get() != current) a.reset();
+        }
+        arrays_.erase(std::remove(arrays_.begin(), arrays_.end(), nullptr), arrays_.end());
+    }
+
+private:
+    static constexpr int64_t kInitialCapacity = 1024;
+
+    struct Array {
+        int64_t mask;
+        std::unique_ptr<std::atomic<uintptr_t>[]> slots;
+    };
+
+    Array* grow_to(int64_t capacity, const Array* from, int64_t t, int64_t b) {
+        auto a = std::make_unique<Array>();
+        a->mask = capacity - 1;
+        a->slots = std::make_unique<std::atomic<uintptr_t>[]>(static_cast<size_t>(capacity));
+        for (int64_t i = t; i < b; i++) {
+            a->slots[i & a->mask].store(from->slots[i & from->mask].load(std::memory_order_relaxed),
+                                        std::memory_order_relaxed);
+        }
+        arrays_.push_back(std::move(a));
+        return arrays_.back().get();
+    }
+
+    // Apart, so a thief's CAS on top does not bounce the owner's bottom.
+    alignas(64) std::atomic<int64_t> top_{0};
+    alignas(64) std::atomic<int64_t> bottom_{0};
+    std::atomic<Array*> array_{nullptr};
+    std::vector<std::unique_ptr<Array>> arrays_;
+};
+
+// One marker's view of a parallel phase: its own deque, the non-cell work it
+// has met and left for the collecting thread, and what it did.
+class ParallelMarker final : public Visitor {
+public:
+    struct Stats {
+        size_t traced = 0;
+        size_t marked = 0;
+        size_t stolen = 0;
+        std::chrono::microseconds busy{0};
+    };
+
+    WorkStealingDeque deque;
+    Stats stats;
+    std::vector<Context*> contexts;
+    std::vector<Environment*> environments;
+    std::vector<WeakMap*> weak_maps;
+    std::vector<WeakSet*> weak_sets;
+    std::vector<WeakRef*> weak_refs;
+    std::vector<FinalizationRegistry*> fin_registries;
+
+    // Cells and large-cell payloads are 16-byte aligned, which leaves the low
+    // bits of a gray entry free for the two things trace needs besides the
+    // address. Only Objects and Strings are ever gray.
+    static uintptr_t encode(const Heap::ProbeResult& p) {
+        return reinterpret_cast<uintptr_t>(p.cell) | (p.kind == CellKind::String ? 1u : 0u) |
+               (p.is_large ? 2u : 0u);
+    }
+    static Heap::ProbeResult decode(uintptr_t w) {
+        Heap::ProbeResult p;
+        p.cell = reinterpret_cast<void*>(w & ~uintptr_t(15));
+        p.kind = (w & 1) ? CellKind::String : CellKind::Object;
+        p.is_large = (w & 2) != 0;
+        return p;
+    }
+
+    void trace(uintptr_t w);
+
+    void visit_object(Object* o) override { mark_edge(o, CellKind::Object); }
+    void visit_string(String* s) override { mark_edge(s, CellKind::String); }
+    void visit_symbol(Symbol* s) override { mark_edge(s, CellKind::Symbol); }
+    void visit_bigint(BigInt* b) override { mark_edge(b, CellKind::BigInt); }
+    void visit_context(Context* ctx) override { if (ctx) contexts.push_back(ctx); }
+    void visit_environment(Environment* env) override { if (env) environments.push_back(env); }
+    void visit_weak_map(WeakMap* w) override { if (w) weak_maps.push_back(w); }
+    void visit_weak_set(WeakSet* w) override { if (w) weak_sets.push_back(w); }
+    void visit_weak_ref(WeakRef* w) override { if (w) weak_refs.push_back(w); }
+    void visit_finalization_registry(FinalizationRegistry* r) override {
+        if (r) fin_registries.push_back(r);
+    }
+
+private:
+    void mark_edge(const void* p, CellKind kind) {
+        Heap::ProbeResult r = Heap::mark_exact_atomic(p, kind);
+        if (!r.cell) return;
+        stats.marked++;
+        if (r.kind == CellKind::Object || r.kind == CellKind::String) deque.push(encode(r));
+    }
+};
+
+// The helper threads of one collecting thread, started on its first parallel
+// drain and parked on a condition variable between phases.
+class MarkerPool {
+public:
+    explicit MarkerPool(unsigned count) : markers_(count) {
+        for (auto& m : markers_) m = std::make_unique<ParallelMarker>();
+        helpers_.reserve(count - 1);
+        for (unsigned i = 1; i < count; i++) helpers_.emplace_back([this, i] { helper_main(i); });
+    }
+
+    ~MarkerPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        for (auto& t : helpers_) t.join();
+    }
+
+    MarkerPool(const MarkerPool&) = delete;
+    MarkerPool& operator=(const MarkerPool&) = delete;
+
+    unsigned size() const { return static_cast<unsigned>(markers_.size()); }
+    ParallelMarker& marker(unsigned i) { return *markers_[i]; }
+    uint32_t phases() const { return phases_; }
+
+    // Deals `seed` out round-robin and runs one phase to termination, the
+    // caller marking alongside. Returns with every deque empty and each
+    // marker's deferred work waiting to be merged.
+    void run(std::vector<Heap::ProbeResult>& seed) {
+        const unsigned n = size();
+        for (size_t i = 0; i < seed.size(); i++) markers_[i % n]->deque.push(ParallelMarker::encode(seed[i]));
+        seed.clear();
+        view_ = Heap::owner_view();
+        idle_.store(0, std::memory_order_relaxed);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            finished_ = 0;
+            generation_++;
+        }
+        wake_.notify_all();
+        work(0);
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_.wait(lock, [&] { return finished_ == n - 1; });
+        for (auto& m : markers_) m->deque.release_outgrown();
+        phases_++;
+    }
+
+    void reset_stats() {
+        for (auto& m : markers_) m->stats = ParallelMarker::Stats{};
+        phases_ = 0;
+    }
+
+private:
+    void helper_main(unsigned index) {
+        uint64_t seen = 0;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wake_.wait(lock, [&] { return stop_ || generation_ != seen; });
+                if (stop_) return;
+                seen = generation_;
+            }
+            Heap::adopt_owner_view(view_);
+            work(index);
+            Heap::adopt_owner_view(Heap::OwnerView{});
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                finished_++;
+            }
+            done_.notify_one();
+        }
+    }
+
+    // Own deque first, then steal, then wait for work to appear anywhere.
+    // A marker only goes idle with its own deque empty and only idle markers
+    // stop pushing, so once all of them are idle no deque can refill: that
+    // is the termination test.
+    void work(unsigned index) {
+        ParallelMarker& me = *markers_[index];
+        const unsigned n = size();
+        auto t0 = std::chrono::steady_clock::now();
+        uintptr_t w;
+        for (;;) {
+            while (me.deque.pop(w)) me.trace(w);
+            bool stole = false;
+            for (unsigned k = 1; k < n && !stole; k++) {
+                if (markers_[(index + k) % n]->deque.steal(w)) stole = true;
+            }
+            if (stole) {
+                me.stats.stolen++;
+                me.trace(w);
+                continue;
+            }
+            idle_.fetch_add(1, std::memory_order_seq_cst);
+            bool more = false;
+            while (idle_.load(std::memory_order_seq_cst) != n) {
+                for (unsigned k = 1; k < n && !more; k++) {
+                    if (!markers_[(index + k) % n]->deque.looks_empty()) more = true;
+                }
+                if (more) break;
+                std::this_thread::yield();
+            }
+            if (!more) break;
+            idle_.fetch_sub(1, std::memory_order_seq_cst);
+        }
+        me.stats.busy += std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - t0);
+    }
+
+    std::vector<std::unique_ptr<ParallelMarker>> markers_;
+    std::vector<std::thread> helpers_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    uint64_t generation_ = 0;
+    unsigned finished_ = 0;
+    bool stop_ = false;
+    std::atomic<unsigned> idle_{0};
+    Heap::OwnerView view_;
+    uint32_t phases_ = 0;
+};
+
+// The pool of this thread's stop-the-world drains, sized by
+// Collector::set_mark_threads or QUANTA_GC_MARK_THREADS; null when that is
+// one. Per collecting thread, like the MarkVisitor it serves; its helpers are
+// joined when that thread exits.
+MarkerPool* marker_pool();
+
+}
+
+#endif
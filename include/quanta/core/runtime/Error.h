@@ -35,8 +35,8 @@ private:
     std::string stack_trace_;
     int line_number_;
     int column_number_;
-    // Lazy, interned via Shape::intern() (same pool/rationale as Context's
-    // current_filename_): no constructor currently populates this (the
+    // Lazy, interned via Shape::intern_pinned() (same pool/rationale as
+    // Context's current_filename_): no constructor currently populates this (the
     // filename+line+column overload below has no callers anywhere in the
     // codebase today -- the actual uncaught-error "at file:line:col" text
     // comes entirely from CallStack, see generate_stack_trace()), so this
@@ -10,6 +10,7 @@
 #include "quanta/core/runtime/Value.h"
 #include "quanta/core/runtime/Shape.h"
 #include "quanta/core/runtime/SmallMapPool.h"
+#include "quanta/core/gc/CardTable.h"
 #include "quanta/core/vm/Bytecode.h"
 #include "quanta/parser/FunctionExecutable.h"
 #include <unordered_map>
@@ -28,6 +29,7 @@ class PropertyDescriptor;
 class HybridDescriptorMap;
 class ScriptUnit;
 struct RareExtras;
+struct CardTable;
 
 // Fixed-position header for Object::butterfly_ -- always exactly 3
 // Value-widths so it sits at a capacity-independent offset from the
@@ -184,14 +186,20 @@ private:
     // alignas(32), Shape.h) instead of its own header field -- same
     // transparent-proxy trick as TaggedProto above; `shape_->x`, `if
     // (shape_)`, `shape_ = next` all keep compiling unchanged.
+    //
+    // Every shape handed in is marked reached: an object moved to a shape
+    // after marking traced it would otherwise leave that shape looking
+    // unused, and the pruning at the end of the cycle would free it from
+    // under the object (see Shape::begin_reachability).
     class TaggedShapePtr {
     public:
         TaggedShapePtr() = default;
-        TaggedShapePtr(Shape* s) : bits_(reinterpret_cast<uintptr_t>(s)) {}
+        TaggedShapePtr(Shape* s) : bits_(reinterpret_cast<uintptr_t>(s)) { if (s) s->note_reached(); }
         Shape* get() const { return reinterpret_cast<Shape*>(bits_ & ~kMask); }
         operator Shape*() const { return get(); }
         Shape* operator->() const { return get(); }
         TaggedShapePtr& operator=(Shape* s) {
+            if (s) s->note_reached();
             bits_ = (reinterpret_cast<uintptr_t>(s) & ~kMask) | (bits_ & kMask);
             return *this;
         }
@@ -345,6 +353,20 @@ public:
     // discipline).
     void trace(Visitor& v);
 
+    // Card marking for large arrays (CardTable.h). card_table() is the table
+    // if there is one; ensure_card_table() makes one for an array big enough
+    // to want it and returns nullptr for anything else. A new table starts
+    // with every current element dirty: stores made before it existed were
+    // remembered some other way, and the minor is about to stop retracing
+    // the elements whole.
+    CardTable* card_table() const;
+    CardTable* ensure_card_table();
+    // The minor's trace of a carded array: the element runs its table marks
+    // dirty (clearing them) and the RareExtras, plus -- with `whole_cell`, for
+    // an array the collector also remembered whole -- everything else
+    // trace_default reaches. Returns how many cards were dirty.
+    size_t trace_dirty_cards(Visitor& v, bool whole_cell);
+
     // Where this object's traced storage lives, for the collector's mark
     // pipeline to request the cache line ahead of time (Collector.cpp,
     // MarkVisitor::step). Everything trace() walks -- elements, shape slots,
@@ -354,6 +376,14 @@ public:
     // address on purpose: it is a prefetch hint and is never dereferenced
     // through this accessor.
     const void* gc_storage_hint() const { return butterfly_; }
+    // Bytes of butterfly held outside this object's own cell, which is the
+    // rest of what the object costs; zero for an inline butterfly, whose
+    // bytes the cell already counts. For the heap snapshot's self sizes.
+    size_t gc_out_of_line_bytes() const {
+        if (!butterfly_ || (butterfly_header()->shape_capacity & kInlineButterflyBit)) return 0;
+        return (static_cast<size_t>(elements_capacity()) + sizeof(ButterflyHeader) / sizeof(Value) +
+                shape_capacity()) * sizeof(Value);
+    }
 
     friend class Function;
     Object(const Object& other) = delete;
@@ -693,6 +723,8 @@ protected:
     // storage); every override chains to this instead of trace() (which would
     // re-enter the switch and recurse).
     void trace_default(Visitor& v);
+    // trace_default's walk of the RareExtras (overflow, internals, descriptors).
+    void trace_extras(Visitor& v);
 
     void ensure_element_capacity(uint32_t capacity);
     void compact_elements();
@@ -729,9 +761,6 @@ public:
 
 private:
 
-    static thread_local std::unordered_map<std::string, std::string> interned_keys_;
-    static const std::string& intern_key(const std::string& key);
-
     bool is_array_index(const std::string& key, uint32_t* index = nullptr) const;
     PropertyDescriptor create_data_descriptor(const Value& value, PropertyAttributes attrs) const;
 
@@ -1084,6 +1113,9 @@ struct RareExtras {
     // (and outside extra_property_order), so no reflective surface can
     // reach it and no enumeration has to skip it.
     std::unique_ptr<std::unordered_map<std::string, Value>> internals;
+    // Only on large arrays, made by the first element store after the array
+    // is old -- see Object::ensure_card_table.
+    std::unique_ptr<CardTable> cards;
 };
 
 // Defined here rather than in the .cpp because the inline caches ask them on
@@ -1235,11 +1267,19 @@ private:
     // each vector keeps using the pooled allocator (see Interpreter.cpp's
     // lookup_cache_data comment) once allocated, resized exactly once per
     // instance.
+    //
+    // Each one is on a per-thread list for its whole life, so a collection
+    // can reach every lookup cache on the thread (see drop_dead_shapes).
     struct InstanceFeedback {
+        InstanceFeedback();
+        ~InstanceFeedback();
+        InstanceFeedback(const InstanceFeedback&) = delete;
+        InstanceFeedback& operator=(const InstanceFeedback&) = delete;
         std::vector<BytecodeChunk::LookupCacheEntry,
             SmallMapAllocator<BytecodeChunk::LookupCacheEntry>> lookup_cache;
         std::vector<PrivateFeedback, SmallMapAllocator<PrivateFeedback>> private_feedback;
     };
+    static std::unordered_set<InstanceFeedback*>& thread_instance_feedback();
     // Per-instance overrides for get_source_text()/get_name(): the common
     // case (decl-site defaults, identical for every instance sharing one
     // executable) lives on executable_->source_text/name instead -- see
@@ -1386,6 +1426,9 @@ public:
     // re-enter the switch and recurse).
     void trace(Visitor& v);
 
+    // BytecodeChunk::drop_dead_shapes for the per-instance lookup caches.
+    static void drop_dead_shapes();
+
     const std::string& get_name() const {
         static const std::string empty;
         if (name_is_empty_) return empty;
@@ -1613,6 +1656,12 @@ public:
         if (is_native_) return call_native(ctx, args, this_value);
         return call_default_impl(ctx, args, this_value, nullptr);
     }
+    // For a Call site whose feedback has seen this function's executable
+    // before (see CallFeedback): the register-mode frame without the
+    // questions the site already answered. Falls back to call_register_args
+    // once register_call_ready() stops holding.
+    bool register_call_ready() const;
+    Value call_monomorphic(Context& ctx, std::span<const Value> args, Value this_value);
     // Arguments that live in the caller's VM registers, on the same terms
     // call_register_args states: already GC roots, and valid for the whole call.
     Value construct(Context& ctx, std::span<const Value> args);
@@ -1685,6 +1734,7 @@ protected:
     Value call_default_impl(Context& ctx, std::span<const Value> args, Value this_value,
                             const std::vector<Value>* args_vec);
     Value call_tree_walker(Context& ctx, std::span<const Value> args, Value this_value);
+    Value run_register_frame(Context& ctx, std::span<const Value> args, Value this_value);
     Value call_native(Context& ctx, std::span<const Value> args, Value this_value);
     Value call_native_rooted(Context& ctx, const std::vector<Value>& args_vec, Value this_value);
 };
@@ -10,6 +10,7 @@
 #include "quanta/core/runtime/SmallMapPool.h"
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <cstdint>
 #include <memory>
 #include <string>
@@ -24,9 +25,14 @@ namespace Quanta {
 // instance via the transition tree, so the layout itself is never
 // duplicated per object -- only each object's own slot values are.
 //
-// Not a GC cell: shapes are thread-local and effectively immortal for the
-// thread's lifetime (agents never share cells, so there is nothing to gain
-// from sharing shapes either). Two independent caps bound the tree, and a
+// Not a GC cell: shapes are thread-local (agents never share cells, so there
+// is nothing to gain from sharing shapes either) and owned by the tree, each
+// node by its parent's transition table. They are still collected, though
+// not by the heap: a program that builds objects from per-request key sets
+// grows a new branch for every one of them, and a process that runs for weeks
+// cannot keep them all. Each major collection works out which shapes a live
+// object still uses and frees every subtree holding none of them -- see
+// begin_reachability() below. Two independent caps bound the tree, and a
 // refused transition means the caller falls back to dictionary-mode storage
 // for that one object:
 //  - kMaxTransitions bounds each node's child count (tree width), so a
@@ -92,26 +98,99 @@ public:
     struct PropertyInfo { const std::string* key; uint32_t slot_index; bool is_accessor; };
     std::vector<PropertyInfo> properties_in_order() const;
 
-    // Canonicalizes `key` to a stable address. Backed by a thread_local set
-    // that, like Shape itself, is never erased from for the thread's
-    // lifetime, so returned pointers stay valid for as long as the thread
-    // runs. Public (beyond Shape's own use for its slot/transition tables)
-    // because Context/Environment (Context.h) share this exact pool for
-    // their own interned strings instead of standing up a parallel one --
-    // see current_filename_ and Environment::SlotMap::InlineEntry::key.
+    // Canonicalizes `key` to a stable address, which stays valid for as long
+    // as something the collector can see still holds it (see "The intern
+    // pool" below). Public (beyond Shape's own use for its slot/transition
+    // tables) because Context/Environment (Context.h) share this exact pool
+    // for their own interned strings instead of standing up a parallel one --
+    // see Environment::SlotMap::InlineEntry::key.
     //
     // Only call this on a write/insert path, never a read/lookup one --
     // any hot get/set-style path should compare against an already-interned
     // pointee by value instead (see find_slot()/is_accessor_slot() above
     // for the pattern).
     static const std::string* intern(const std::string& key);
+    // The same, for a holder the collector cannot see (a filename on a
+    // Context or an Error, a function-local static): the entry is never
+    // dropped, which is what intern() used to promise for every entry.
+    static const std::string* intern_pinned(const std::string& key);
     // Same pool, lookup only: returns nullptr instead of inserting. A caller
     // holding an arbitrary, possibly-never-interned string uses this to ask
-    // "could this name be a key at all" without growing the pool for good.
+    // "could this name be a key at all" without growing the pool. The answer
+    // is for comparing on the spot; a caller that stores it goes through
+    // intern() instead.
     static const std::string* intern_existing(const std::string& key);
 
+    // The intern pool. User data reaches it too -- every key of every object
+    // JSON.parse builds is interned on its way into a shape -- so it is
+    // collected like the shapes are: a major cycle clears every entry's mark
+    // when it opens (begin_key_reachability), and an entry whose mark is
+    // still clear once the shapes are pruned (sweep_unreached_keys) is
+    // erased. The holders that set marks:
+    //  - shapes: every one left after prune_unreached, by its added key,
+    //    at sweep time;
+    //  - bytecode: every chunk alive on the thread, by its names and its
+    //    environment keys, at sweep time (BytecodeChunk::note_keys_reached);
+    //  - objects and environments: as marking traces them, by their
+    //    descriptor keys and binding keys (note_key_reached).
+    // A holder traced before the cycle closes can still be handed a key
+    // afterwards, so intern() marks what it returns, and an environment
+    // slot given an already-interned key marks it too. Anything else that
+    // keeps a key has to be one of the above or use intern_pinned.
+    static void begin_key_reachability();
+    static size_t sweep_unreached_keys();
+    // Entries in this thread's pool, pinned ones included.
+    static size_t key_count();
+    // One pool entry. The text comes first, so the pointer intern() hands
+    // out is the entry's own address as well (Shape.cpp asserts the layout
+    // that makes the cast below valid); the flags are mutable because a set
+    // only hands out const elements.
+    struct InternedKey {
+        std::string text;
+        mutable bool reached = true;
+        mutable bool pinned = false;
+    };
+    // Marking may run on several threads at once; see note_reached.
+    static void note_key_reached(const std::string* key) {
+        const auto* entry = reinterpret_cast<const InternedKey*>(key);
+        std::atomic_ref<bool>(entry->reached).store(true, std::memory_order_relaxed);
+    }
+
+    // Collection. A shape stays while a live object uses it or one of its
+    // descendants -- an object's shape reaches every property it holds
+    // through parent_, so an ancestor of a kept shape is kept too. The
+    // collector clears every mark when a major cycle opens, and marking sets
+    // one for each object it traces (note_reached, from Object::trace, which
+    // markers on other threads may run at the same moment -- hence the
+    // relaxed atomic store). Objects the mutator moves to a shape while the
+    // cycle is open may already have been traced, so every assignment to an
+    // object's shape sets the mark as well (Object::TaggedShapePtr), and so
+    // does creating one.
+    //
+    // When the mark is final the collector calls settle_reachability, which
+    // spreads each mark to its ancestors, then drops every inline-cache
+    // entry naming a shape still unmarked (BytecodeChunk::drop_dead_shapes,
+    // Function::drop_dead_shapes), and only then prune_unreached. Anything
+    // else holding a Shape* beyond one object's own shape_ has to be one of
+    // those caches or pinned: a freed shape's address is the next new
+    // shape's, so a stale pointer would not fail, it would match.
+    void note_reached() { std::atomic_ref<bool>(reached_).store(true, std::memory_order_relaxed); }
+    bool reached() const { return reached_; }
+    // Keeps `s` (and so its ancestors) for the thread's lifetime, for a
+    // cache outside the ones above that remembers a transition for good.
+    static void pin(Shape* s) { s->pinned_ = true; }
+    static void begin_reachability();
+    static void settle_reachability();
+    // Frees every subtree settle_reachability left unmarked, and returns how
+    // many shapes that was.
+    static size_t prune_unreached();
+    // Shapes this thread holds, the root included.
+    static size_t count();
+
+    ~Shape();
+
 private:
-    Shape() = default;
+    Shape();
     Shape(Shape* parent, const std::string* key, uint32_t slot_index, bool is_accessor = false);
 
     static constexpr uint32_t kMaxTransitions = 128;
@@ -136,6 +215,12 @@ private:
     // has_descriptor_override's guard), so answering from a bit spares those
     // hits a keyed probe of the slot table.
     bool has_any_accessor_ : 1 = false;
+    // See pin().
+    bool pinned_ : 1 = false;
+    // See note_reached(). Its own byte rather than another bit: markers on
+    // other threads store to it concurrently, which a bit-field's
+    // read-modify-write cannot take. Sits in the padding before slots_.
+    bool reached_ = true;
 
     // Slot table (key -> flattened slot index), same inline+overflow idiom
     // as HybridDescriptorMap (Object.h). No migration/erase needed --
@@ -258,7 +343,8 @@ private:
     // cache-hit path only, never the property get/set hot path -- see
     // Shape::intern's own doc comment on why interning stays cheap too).
     // Entries own their child unique_ptr<Shape>, never Shape by value:
-    // Shape* is cached permanently elsewhere (FeedbackSlot, Object::shape_).
+    // Shape* is held elsewhere (FeedbackSlot, Object::shape_), so a shape
+    // must not move for as long as it lives.
     struct TransitionMap {
         struct Entry { const std::string* key; std::unique_ptr<Shape> value; };
         std::vector<Entry> entries;
@@ -296,6 +382,20 @@ private:
     // it can't be passed by reference -- assign the second element back).
     static std::pair<Shape*, bool> transition_insert(void*& table, bool is_single,
                                                        const std::string* key, std::unique_ptr<Shape> child);
+    // Calls f(child) for every child in `table`.
+    template <typename F> static void transition_for_each(void* table, bool is_single, F&& f);
+    static void transition_free(void* table, bool is_single);
+    // Frees every child in `table` settle_reachability() left unmarked, with
+    // its subtree, adding the shapes freed to `freed`, and recurses into the
+    // children that stay. Returns the new is_single, like transition_insert;
+    // a table left empty goes back to null.
+    static bool transition_prune(void*& table, bool is_single, size_t& freed);
+    static void prune_children(Shape* s, size_t& freed);
+    static void clear_reached(Shape* s);
+    static bool settle(Shape* s);
+    static size_t subtree_size(Shape* s);
+    // Marks the added key of `s` and of every shape below it.
+    static void note_keys_below(Shape* s);
 
     // Lazy: null until this shape's first child (most shapes -- the "fully
     // built object" terminal ones -- never get one). transition()/
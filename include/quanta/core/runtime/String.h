@@ -128,6 +128,9 @@ public:
     [[nodiscard]] size_t             length()const noexcept { return str().length(); }
     [[nodiscard]] size_t             size()  const noexcept { return str().size(); }
     [[nodiscard]] bool               empty() const noexcept { return !is_cons_ && data_.empty(); }
+    // Whether the bytes are held here rather than collected from a rope's
+    // links; str() on anything else flattens it first.
+    [[nodiscard]] bool               is_flat() const noexcept { return !is_cons_; }
     // Lazily computed. Hashing is a full pass over the bytes and most strings
     // are never used as a key, so the constructors no longer pay it up front --
     // a regex handing back its subject on every match was hashing the whole
@@ -114,6 +114,13 @@ private:
     // VM-internal only: marks a let/const register still in TDZ. Never
     // returned to JS -- Op::LdarChecked converts it to a ReferenceError.
     static constexpr uint64_t TAG_VM_TDZ    = 0x000C000000000000ULL;
+    // A number that is an int32, carried in the low 32 bits. One of two
+    // forms a number can take -- the same number may equally be a double, so
+    // nothing may compare Values by their bits -- produced where integer
+    // arithmetic is the common case (small literals, counters, bitwise
+    // results) so that it can stay integer until it overflows. Never -0,
+    // which has no int32 form.
+    static constexpr uint64_t TAG_INT32     = 0x000D000000000000ULL;
 
     uint64_t bits_;
 
@@ -176,6 +183,14 @@ public:
         return (bits_ & (QUIET_NAN | TAG_MASK)) == (QUIET_NAN | TAG_VM_TDZ);
     }
 
+    // The int32 form. Value(int32_t) below still makes a double: the tagged
+    // form is asked for by name where a fast path is going to look for it.
+    static Value from_int32(int32_t i) {
+        Value v;
+        v.bits_ = QUIET_NAN | TAG_INT32 | static_cast<uint32_t>(i);
+        return v;
+    }
+
     explicit Value(bool b) : bits_(QUIET_NAN | (b ? TAG_TRUE : TAG_FALSE)) {}
 
     // Prevent const char* from being implicitly converted to bool
@@ -251,6 +266,7 @@ public:
     }
     [[nodiscard]] inline bool is_number() const noexcept {
         return (bits_ & EXPONENT_MASK) != EXPONENT_MASK ||
+               (bits_ & (QUIET_NAN | TAG_MASK)) == (QUIET_NAN | TAG_INT32) ||
                (bits_ & (QUIET_NAN | TAG_MASK)) == (QUIET_NAN | TAG_NAN) ||
                (bits_ & (QUIET_NAN | TAG_MASK)) == (QUIET_NAN | TAG_NEG_INF) ||
                (bits_ & (QUIET_NAN | TAG_MASK)) == (QUIET_NAN | TAG_POS_INF);
@@ -298,7 +314,27 @@ public:
         return bits_to_double(bits_);
     }
 
+    // The int32 form is one comparison of the upper half: its tag leaves no
+    // bit of it to the payload.
+    [[nodiscard]] inline bool is_int32() const noexcept {
+        return (bits_ >> 32) == ((QUIET_NAN | TAG_INT32) >> 32);
+    }
+    [[nodiscard]] inline int32_t as_int32() const noexcept {
+        return static_cast<int32_t>(static_cast<uint32_t>(bits_));
+    }
+
+    // Either fast form: what a fast path that has already tried two int32s
+    // accepts next, an int32 against a finite double included.
+    [[nodiscard]] inline bool is_finite_number() const noexcept {
+        return is_finite_double() || is_int32();
+    }
+    [[nodiscard]] inline double as_finite_number() const noexcept {
+        return is_int32() ? static_cast<double>(as_int32()) : bits_to_double(bits_);
+    }
+
     [[nodiscard]] inline double as_number() const noexcept {
+        if (is_finite_double()) return bits_to_double(bits_);
+        if (is_int32()) return static_cast<double>(as_int32());
         if (is_nan()) return std::numeric_limits<double>::quiet_NaN();
         if (is_positive_infinity()) return std::numeric_limits<double>::infinity();
         if (is_negative_infinity()) return -std::numeric_limits<double>::infinity();
@@ -0,0 +1,78 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef QUANTA_VM_BASELINE_JIT_H
+#define QUANTA_VM_BASELINE_JIT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace Quanta {
+
+struct BytecodeChunk;
+
+namespace VM {
+
+// Baseline tier: a chunk that has run enough gets its bytecode translated,
+// one stencil per instruction, into x86-64 code that keeps the accumulator
+// and the register bank pointer in machine registers and jumps between
+// instructions directly instead of through the handler table.
+//
+// Only the instructions whose whole meaning fits in a few machine
+// instructions are translated -- register moves, constants, jumps, the
+// two-finite-doubles forms of arithmetic and comparison, the monomorphic
+// GetNamed hit. Everything else, and every guard that fails, calls out to
+// the very handler the interpreter would have run, so there is exactly one
+// implementation of each opcode's semantics and the two tiers cannot drift.
+//
+// A called-out handler ends by dispatching to the next instruction like any
+// other. The frame runs off exit_code, a copy of the chunk's code in which
+// every translated instruction's opcode byte reads kBaselineExitByte, whose
+// handler returns to the native code rather than carrying on: a run of
+// untranslated instructions is interpreted as one stretch, and control comes
+// back at the first translated one.
+struct BaselineCode {
+    void* code = nullptr;
+    size_t mapped_size = 0;
+    // Native address of every instruction start, indexed by pc: where a
+    // call-out resumes when it did not come back at the next instruction
+    // (a taken jump, a catch handler), and where OSR enters.
+    std::unique_ptr<const void*[]> entries;
+    std::unique_ptr<uint8_t[]> exit_code;
+    uint32_t native_ops = 0;
+    uint32_t call_out_ops = 0;
+
+    BaselineCode() = default;
+    BaselineCode(const BaselineCode&) = delete;
+    BaselineCode& operator=(const BaselineCode&) = delete;
+    ~BaselineCode();
+};
+
+// Calls plus loop back-edges before a chunk is compiled. Low enough that a
+// hot loop moves over within its first few thousand iterations, high enough
+// that the run-once code every script is mostly made of never pays for a
+// compile.
+constexpr uint16_t kBaselineBudget = 1000;
+
+// Table slot the exit copy uses; never a real opcode (asserted in
+// BaselineJit.cpp against Op::kCount).
+constexpr uint8_t kBaselineExitByte = 0xFF;
+
+// Process-wide switch, read once: on by default where the compiler has a
+// backend (x86-64, not Windows); QUANTA_JIT=0 keeps every chunk in the
+// interpreter.
+bool baseline_enabled();
+
+// Compiles `chunk` into chunk.baseline. Leaves it null when the tier is off,
+// the platform has no backend, or the chunk is outside what it handles.
+void baseline_compile(const BytecodeChunk& chunk);
+
+}
+
+}
+
+#endif
@@ -8,7 +8,11 @@
 #define QUANTA_VM_BYTECODE_H
 
 #include "quanta/core/runtime/Value.h"
+#include "quanta/core/vm/BaselineJit.h"
+#include "quanta/core/vm/BytecodePasses.h"
 #include "quanta/core/vm/FixedArray.h"
+#include "quanta/core/vm/Inliner.h"
+#include "quanta/core/vm/ThreadedCode.h"
 #include <array>
 #include <cstdint>
 #include <memory>
@@ -22,7 +26,10 @@ class Shape;
 class ASTNode;
 class Environment;
 class Object;
+class Function;
+class FunctionExecutable;
 struct ClosureTemplate;
+struct ClassTemplate;
 
 // Register-based, accumulator-centric instruction set (V8 Ignition model).
 // Encoding: u8 opcode + fixed operands -- r: u8 register, k: u16 constant-
@@ -120,8 +127,8 @@ enum class Op : uint8_t {
     CopyRestProperties, // r_src r_keys
     CreateRestArray, // r -- acc = Array of args[r..argc), for a `...rest` parameter
 
-    Call,         // r_callee r_args_start argc n
-    CallResolved, // r_func r_this r_args_start argc n -- func already resolved (spec: before args)
+    Call,         // r_callee r_args_start argc n cf
+    CallResolved, // r_func r_this r_args_start argc n cf -- func already resolved (spec: before args)
     Construct,    // r_callee r_args_start argc n -- new.target = callee, calls Function::construct
     // Spread forms: argument count is only known at runtime, so the operand
     // is a spread SOURCE (the original iterable when the whole list is one
@@ -306,8 +313,9 @@ enum class Op : uint8_t {
     // form's operand. Only a literal large enough to fill the pool reaches it.
     LdaConstWide,              // k32
 
-    // Same operands as Call. A direct eval runs in the caller's scope, and the
-    // eval builtin learns that from a flag on the calling context.
+    // Call's operands less the feedback slot. A direct eval runs in the
+    // caller's scope, and the eval builtin learns that from a flag on the
+    // calling context.
     CallDirectEval,            // r_callee r_args_start argc n
 
     // An assignment's reference is made before its right side runs. Nothing can
@@ -330,6 +338,26 @@ enum class Op : uint8_t {
     // keeps EvalAst meaning "a gap the compiler could not emit".
     DefineClass,               // k
 
+    // r_callee r_this t flags o -- falls through when r_callee is a function
+    // built from InlinedCode::targets[t], and jumps to o (the original call)
+    // when it is not. Emitted only into a chunk call-site inlining built; see
+    // Inliner.h for the flags.
+    InlineGuard,
+
+    // r k -- acc = the constructor of a new class built from
+    // BytecodeChunk::classes[k], with its prototype and `constructor` link,
+    // extending the value in r when the class has a heritage (r is not read
+    // otherwise). The compiler emits it only for a class it can build without
+    // Op::DefineClass; one DefineClassMember per method follows, in source
+    // order, so computed keys still interleave with definitions as written.
+    CreateClass,               // r k
+    // r_class r_key k u8 -- defines classes[k].members[u8] on the class in
+    // r_class, or on its prototype for an instance member. r_key holds the
+    // value of the member's key expression when it is computed, and the op
+    // takes ToPropertyKey of it; a literal key comes from the template and
+    // r_key is not read.
+    DefineClassMember,         // r r k u8
+
     kCount
 };
 
@@ -495,6 +523,39 @@ struct KeyedFeedback {
     bool mega = false;
 };
 
+// Target feedback for one Call/CallResolved site, indexed by its cf operand.
+// Most call sites only ever see one callee, and the generic path asks the
+// same questions of it on every trip: what kind of function it is, whether
+// it is native, whether its gate is resolved, whether it is a class
+// constructor. A site that has learned its target answers those once.
+//
+// Uninit -> one of the learned kinds -> Mega on the first miss, for good,
+// like FeedbackSlot::mega: a site that has seen two targets takes the
+// generic path and stops paying to re-learn.
+//
+//   Bytecode  keyed on the executable rather than the Function, so every
+//             closure built from one decl site hits -- `executable` is an
+//             identity only and never dereferenced; the hit path asks the
+//             callee's own executable whether it is still register-ready.
+//             `function` is the first callee seen, which keeps that
+//             executable alive for the inliner to read the body off.
+//   Native    keyed on the Function itself.
+//   Bound     a bind() result with no bound arguments: the hit calls the
+//             target with the bound receiver directly, instead of through
+//             the native wrapper that copies the arguments into a vector.
+//
+// function/target/bound_this are cells and are traced with the chunk
+// (BytecodeChunk::trace); a site learns only when its frame's caches may hold
+// cells at all (Frame::feedback_rooted).
+struct CallFeedback {
+    enum class Kind : uint8_t { Uninit, Bytecode, Native, Bound, Mega };
+    Kind kind = Kind::Uninit;
+    const FunctionExecutable* executable = nullptr;
+    Function* function = nullptr;
+    Function* target = nullptr;
+    Value bound_this;
+};
+
 // One try region: [start_pc, end_pc) -> handler_pc.
 struct HandlerEntry {
     uint32_t start_pc;
@@ -534,6 +595,7 @@ struct BytecodeChunk {
     FixedArray<const std::string*> names;
     const std::string& name_at(size_t i) const { return *names[i]; }
     FixedArray<FeedbackSlot> feedback; // written as call sites warm up
+    FixedArray<CallFeedback> call_feedback; // same, for Call/CallResolved targets
 
     // GetPrivate/SetPrivate and GetKeyed/SetKeyed sites are rare relative to
     // ordinary named property access -- lazily allocated together since both
@@ -627,6 +689,12 @@ struct BytecodeChunk {
     // substitution that boxes a primitive or reaches for the global object.
     bool uses_this : 1 = false;
 
+    // Calls and loop back-edges left before the baseline compiler takes this
+    // chunk (see BaselineJit.h); zero once it has, whether or not it managed
+    // to. Counts down from a const BytecodeChunk& on the interpreter's own
+    // paths, hence mutable. Sits in the padding after the flags above.
+    mutable uint16_t baseline_budget = VM::kBaselineBudget;
+
     // Closures/tree-walk escapes/destructuring/try-catch are each
     // independently rare (a chunk can have any one without the others), so
     // unlike IcFeedback these stay separate lazy pointers rather than one
@@ -643,6 +711,12 @@ struct BytecodeChunk {
     std::unique_ptr<std::vector<ClosureTemplate>> closures;
     std::vector<ClosureTemplate>& ensure_closures();
 
+    // Class bodies the compiler builds itself (Op::CreateClass), the class
+    // counterpart of closures above. A class it cannot build is still a
+    // treewalk_nodes entry behind Op::DefineClass.
+    std::unique_ptr<std::vector<ClassTemplate>> classes;
+    std::vector<ClassTemplate>& ensure_classes();
+
     // Everything the compiler cannot emit and hands back to the tree-walker
     // (Op::EvalAst): class declarations, regex literals, and subtrees from
     // emit_treewalker_delegate. Unlike closures above every entry is a gap,
@@ -665,8 +739,9 @@ struct BytecodeChunk {
         // The same names, interned once (Shape::intern). Every call through
         // this chunk binds the same list, and interning is a hash and a probe
         // per name per call -- so it is done once for the chunk instead. The
-        // pointers are stable for the thread's lifetime, which is what makes
-        // caching them safe. Filled on the first call; see VM::run.
+        // pool keeps each one for as long as the chunk lives (see
+        // note_keys_reached), which is what makes caching them safe. Filled
+        // on the first call; see VM::run.
         std::vector<const std::string*> env_param_keys;
         std::vector<const std::string*> env_local_keys;
         bool env_keys_ready = false;
@@ -689,13 +764,45 @@ struct BytecodeChunk {
     };
     std::unique_ptr<EnvBundle> env;
     EnvBundle& ensure_env() { if (!env) env = std::make_unique<EnvBundle>(); return *env; }
+
+    // Native code for this chunk once it is hot; null until then, and for
+    // good if the baseline compiler turned it down.
+    std::unique_ptr<VM::BaselineCode> baseline;
+    // The pre-decoded form the interpreter runs this chunk from, built the
+    // first time it executes (see ThreadedCode.h).
+    std::unique_ptr<VM::ThreadedCode> threaded;
+    // Call-site inlining's state for this chunk (see Inliner.h): on a warm
+    // chunk, the copy with its small callees spliced in, or an empty record
+    // once it turned out to have none; on that copy, the callees its
+    // InlineGuard ops test for.
+    std::unique_ptr<VM::InlinedCode> inlined;
+    // Which registers each instruction may still read, for the collector's
+    // precise scan of a frame running this chunk (see BytecodePasses.h).
+    // Built by the first collection that needs it, through a const
+    // BytecodeChunk&, hence mutable.
+    mutable std::unique_ptr<VM::RegisterLiveness> liveness;
     using LoopEnvVar = EnvBundle::LoopEnvVar; // BytecodeCompiler builds these before a chunk_ exists
 
+    // Both keep the thread's list of chunks that drop_dead_shapes walks.
     BytecodeChunk();
     // Out of line for the same reason ensure_closures is.
     ~BytecodeChunk();
 
     void trace(Visitor& v) const;
+
+    // Clears every inline-cache entry, in every chunk of this thread, that
+    // names a shape the closing major cycle left unmarked: the step between
+    // Shape::settle_reachability and Shape::prune_unreached. Entries naming
+    // a kept shape stay, so a site warm on a live layout stays warm.
+    static void drop_dead_shapes();
+    // The same for one name-lookup entry, which Function's per-instance
+    // caches hold too.
+    static void drop_dead_shape(LookupCacheEntry& e);
+    // Marks every interned key a chunk of this thread holds -- its names and
+    // its environment keys -- for Shape::sweep_unreached_keys. Every chunk
+    // that exists counts, reachable or not: a chunk is freed with its owner,
+    // so one still here can still run.
+    static void note_keys_reached();
 };
 
 // Human-readable dump for QUANTA_VM_DISASM=1.
@@ -704,6 +811,23 @@ struct BytecodeChunk {
 // else that needs to find instruction boundaries or an embedded jump offset.
 int op_operand_bytes(Op op);
 char op_operand_kind(Op op);
+// Where an instruction keeps its i16 jump offset, counted from its first
+// operand byte, or -1 for one that holds none. The offset is relative to the
+// byte after it.
+int op_jump_offset(Op op);
+// Which operand bytes name a register: up to three single registers, plus for
+// the call forms one argument run, given as the operand bytes holding its
+// first register and its count. Decoded per kind exactly as
+// validate_chunk_registers reads them; a pass that renames registers has to
+// find every one of them, and an opcode whose handler reaches a register some
+// other way (the parameters, read by BindEnvLocals) is not listed here.
+struct RegisterOperands {
+    uint8_t count = 0;
+    uint8_t at[3] = {};
+    int8_t run_first = -1;
+    int8_t run_count = -1;
+};
+RegisterOperands register_operands(Op op);
 
 std::string disassemble_chunk(const BytecodeChunk& chunk, const std::string& name);
 
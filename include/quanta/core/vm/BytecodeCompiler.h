@@ -140,6 +140,10 @@ private:
     // that emit a Star stay unaware of it and one place has to know that an
     // instruction somebody jumps to cannot be swallowed by the one before it.
     void fuse_store_pairs();
+    // The optimization pipeline (BytecodePasses.h), run just before
+    // fuse_store_pairs: the passes reason about Star as its own instruction,
+    // and fusing what they leave is the last thing done to the body.
+    void run_passes();
     void emit(Op op);
     void emit_u8(uint8_t v);
     void emit_u16(uint16_t v);
@@ -148,6 +152,7 @@ private:
     void emit_u32(uint32_t v);
     uint16_t add_name(const std::string& name);
     uint16_t alloc_feedback_slot();
+    uint16_t alloc_call_feedback();
     uint16_t alloc_private_feedback();
     uint16_t alloc_keyed_feedback();
 
@@ -176,6 +181,7 @@ private:
     bool super_member_emittable(const class MemberExpression* mem) const;
     bool emit_super_load(const class MemberExpression* mem);
     bool emit_treewalker_delegate(const ASTNode* node);
+    int emit_class_definition(const class ClassDeclaration* cd);
     bool deleg_at(int line, const ASTNode* node);
 
     // Builds a fresh Array from `elements`, expanding any SpreadElement
@@ -271,6 +277,8 @@ private:
     std::vector<Value> constants_;
     std::vector<std::string> names_;
     std::vector<FeedbackSlot> feedback_;
+    // Call/CallResolved sites so far; chunk_->call_feedback gets this many.
+    uint32_t call_feedback_count_ = 0;
     std::unordered_map<std::string, int> locals_;
     // Names declared `const` in this chunk. declare_local() only takes a name,
     // so constness was dropped and a keywordless for-of/for-in target compiled
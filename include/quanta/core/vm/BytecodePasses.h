@@ -0,0 +1,102 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef QUANTA_VM_BYTECODE_PASSES_H
+#define QUANTA_VM_BYTECODE_PASSES_H
+
+#include <cstdint>
+#include <vector>
+
+namespace Quanta {
+
+class Value;
+struct BytecodeChunk;
+
+namespace VM {
+
+// The optimization passes BytecodeCompiler runs over a finished body, on its
+// builder vectors, before they are frozen and before fuse_store_pairs pairs
+// up what is left. In order:
+//
+//   fold      constants through the accumulator and registers within a
+//             block: int32 arithmetic and comparisons, a register known to
+//             hold a small constant loaded as that constant, a branch on a
+//             known value made unconditional or dropped
+//   copyprop  a register that is a copy of another read as the original,
+//             and a load of what the accumulator already holds dropped
+//   jumps     jump threading: a jump to a Jump goes straight to where that
+//             one goes, a jump to the next instruction goes, a conditional
+//             jump over a Jump becomes the inverse jump, and code nothing
+//             can reach goes with it
+//   dse       stores to a register nobody reads again and accumulator loads
+//             nobody uses, by liveness over the whole body
+//   renumber  registers no instruction names any more closed up, so the
+//             frame VM::run zeroes and the collector scans is smaller
+//
+// Everything is decided from what each opcode is known to read and write;
+// an opcode the passes do not model is taken to read every register and the
+// accumulator and to leave neither known, so a body full of them is left
+// much as it was. An exception edge runs from every instruction in a try
+// range to its handler, before the instruction writes anything. If the
+// result cannot be encoded -- a jump no longer fits its 16 bits -- the body
+// is left exactly as the compiler emitted it.
+//
+// QUANTA_VM_PASSES=0 turns all of it off; QUANTA_VM_DISASM=1 prints what
+// each pass did ahead of the chunk's listing. Both read once.
+struct PassStats {
+    // Instructions each pass rewrote or removed, registers renumber dropped.
+    uint32_t folded = 0;
+    uint32_t propagated = 0;
+    uint32_t threaded = 0;
+    uint32_t dead_stores = 0;
+    uint32_t registers_dropped = 0;
+    uint32_t bytes_before = 0;
+    uint32_t bytes_after = 0;
+};
+
+bool passes_enabled();
+
+// Runs the pipeline over `code`. May append to `constants` (a folded result
+// too wide for LdaSmi) and rewrites chunk.handlers and chunk.register_count
+// to match the new code.
+PassStats optimize_bytecode(std::vector<uint8_t>& code, std::vector<Value>& constants,
+                            BytecodeChunk& chunk);
+
+// Which registers a running frame may still read, instruction by
+// instruction: the collector's map of a VM register file (see
+// Collector::RegisterFile). The same dataflow dse runs, over the finished
+// code, with two differences that both come from what the answer is for. An
+// opcode the model does not know reads exactly the registers it names, not
+// every register -- register_operands lists every one a handler touches, and
+// treating all of them as reads is what keeps an unknown write from hiding a
+// value the collector still has to see. And a row is the union of the
+// registers live into the instruction, live out of it and named by it, since
+// a collection can land anywhere inside one: before a fused store has
+// written, after a handler has parked a result, or while a callee still reads
+// its arguments out of the caller's bank. Parameters are live everywhere;
+// Op::BindEnvLocals and the arguments object read them without naming them.
+//
+// Built the first time a collection finds the chunk on the stack and kept
+// with it. A body the analysis cannot take -- too large, or not decodable --
+// gets no rows, and every one of its registers is scanned.
+struct RegisterLiveness {
+    // 64-bit words per row: register_count rounded up.
+    uint32_t words = 0;
+    // Where each instruction starts, ascending; rows are in the same order.
+    std::vector<uint32_t> pcs;
+    std::vector<uint64_t> rows;
+
+    // The row for the instruction at `pc`, or null when none starts there.
+    const uint64_t* at(uint32_t pc) const;
+};
+
+const RegisterLiveness& register_liveness(const BytecodeChunk& chunk);
+
+}
+
+}
+
+#endif
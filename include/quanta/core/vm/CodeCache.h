@@ -0,0 +1,95 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef QUANTA_VM_CODE_CACHE_H
+#define QUANTA_VM_CODE_CACHE_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+namespace Quanta {
+
+class ScriptUnit;
+class FunctionExecutable;
+struct BytecodeChunk;
+
+namespace VM {
+
+// On-disk cache of the chunks a script's functions compiled to, so the next
+// run of the same source can attach them instead of rebuilding each body and
+// compiling it again.
+//
+// What is cached is the deferred-body executable (see
+// FunctionExecutable::defer_body): a leaf function whose tree was dropped
+// after its analyses were taken. Its first call would otherwise re-parse the
+// body out of the unit's tokens and hand the tree to BytecodeCompiler; on a
+// hit it gets the chunk straight from the file and, if its gate opens, never
+// has a tree at all. Those are the bulk of a bundle's functions, and the only
+// ones whose chunk stands alone: an outer body's chunk carries closure
+// templates that hold live executables built off its nested literal nodes,
+// and a chunk that delegates to the tree-walker holds the nodes themselves,
+// so neither is written out.
+//
+// An entry is filed under the token its body opens at -- the same key the
+// unit files executables under -- in a file named by a hash of the source.
+// A file is used only when its header agrees with this build and this source
+// (format version, opcode count, source hash and length, script or module)
+// and its checksum matches; an entry only when the body it describes still
+// starts where the executable says it does. Anything else is read as a miss,
+// and the next write replaces it.
+//
+// Off unless QUANTA_CODE_CACHE names a directory; read once.
+enum class CodeCacheKind : uint8_t { Script = 1, Module = 2 };
+
+bool code_cache_enabled();
+
+// One source's cache file, as loaded: the raw entries, indexed by body token
+// and decoded only when an executable asks. Held by the unit it describes.
+class CodeCacheFile {
+public:
+    CodeCacheFile(std::string path, CodeCacheKind kind, uint64_t source_hash,
+                  uint64_t source_size)
+        : path_(std::move(path)), kind_(kind), source_hash_(source_hash),
+          source_size_(source_size) {}
+
+    // Reads the file at path_, keeping it only if every check passes.
+    void load();
+    // The entry's chunk, or null. An entry that fails its checks is dropped
+    // as well, so the chunk compiled in its place is written on the next
+    // flush.
+    std::unique_ptr<BytecodeChunk> take(const FunctionExecutable& exe, uint32_t body_tok);
+    // Writes back what the file had plus every chunk the unit compiled since.
+    // A no-op when nothing new was compiled.
+    void flush(const ScriptUnit& unit);
+
+private:
+    struct Span { uint32_t offset; uint32_t size; };
+
+    std::string path_;
+    CodeCacheKind kind_;
+    uint64_t source_hash_;
+    uint64_t source_size_;
+    std::string bytes_;
+    std::unordered_map<uint32_t, Span> entries_;
+};
+
+// Opens the cache for a freshly parsed unit (Engine::execute_file,
+// ModuleLoader::execute_module_file). The unit is remembered until
+// code_cache_flush_all, so functions first called after the entry point
+// returned still make it into the file.
+void code_cache_open(ScriptUnit& unit, CodeCacheKind kind);
+// The cached chunk for a deferred body, or null.
+std::unique_ptr<BytecodeChunk> code_cache_take(const FunctionExecutable& exe);
+void code_cache_flush(const ScriptUnit& unit);
+void code_cache_flush_all();
+
+}
+
+}
+
+#endif
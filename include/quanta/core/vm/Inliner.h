@@ -0,0 +1,93 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef QUANTA_VM_INLINER_H
+#define QUANTA_VM_INLINER_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace Quanta {
+
+struct BytecodeChunk;
+class Function;
+class FunctionExecutable;
+
+namespace VM {
+
+// Call-site inlining: once a chunk is warm, the Call/CallResolved sites whose
+// feedback has only ever seen one small leaf body get that body spliced into
+// a copy of the chunk, and later calls of the function run the copy.
+//
+// The copy is built rather than the chunk rewritten because frames already
+// running the chunk hold pcs into it -- the loop that warmed it is usually one
+// of them -- and because the chunk is what the code cache writes out, and an
+// inlined body is only valid for the callee identities this process has.
+// Nothing moves a running frame over: the copy is picked up by the next call.
+//
+// A site becomes
+//
+//     InlineGuard r_callee r_this t flags -> slow
+//     <callee registers seeded from the arguments, the rest undefined>
+//     <callee body: registers past the caller's own, Return as a jump to done>
+//     Jump -> done
+//   slow:
+//     <the original call, unchanged, feedback slot and all>
+//   done:
+//
+// so a guard that fails is just the call the site always made. The guard
+// tests the callee's executable, which is what the body was copied from; any
+// closure of that declaration passes, since a leaf reads nothing out of its
+// closure.
+//
+// A leaf is a register-mode body short enough to be worth it whose every
+// instruction only reads and writes its own registers, constants and the
+// properties of values it is handed: no calls, no closures, no names looked up
+// through a scope, no arguments object, no try. What an inlined body does not
+// reproduce is the callee's frame -- it has none, so it is missing from a
+// stack trace taken inside it and it spends no depth against the recursion
+// limit, which a body with no calls in it cannot exhaust anyway.
+//
+// QUANTA_VM_INLINE=0 turns it off; read once.
+struct InlinedCode {
+    // The guard's flags operand.
+    enum GuardFlags : uint8_t {
+        // A sloppy body that reads `this` would see a primitive boxed and
+        // undefined replaced by the global object; the inlined copy reads the
+        // receiver register as it is, so the guard only passes an object.
+        kObjectThis = 1 << 0,
+    };
+    struct Target {
+        // Traced with the chunk (BytecodeChunk::trace): keeps `executable`
+        // alive, so the pointer the guard compares cannot be reused by a
+        // different body.
+        Function* function = nullptr;
+        const FunctionExecutable* executable = nullptr;
+    };
+
+    std::unique_ptr<BytecodeChunk> variant;
+    std::vector<Target> targets;
+    uint32_t sites = 0;
+
+    InlinedCode();
+    // Out of line: BytecodeChunk is only forward-declared here.
+    ~InlinedCode();
+};
+
+bool inlining_enabled();
+
+// Gives a warm chunk its InlinedCode, with a variant when any site qualified.
+// Called once per chunk, from the first register-mode call after the chunk's
+// baseline budget ran out; `owner` is the function making that call, whose
+// trace is what reaches the variant's cells.
+void inline_compile(const BytecodeChunk& chunk, Function* owner);
+
+}
+
+}
+
+#endif
@@ -0,0 +1,103 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef QUANTA_VM_THREADED_CODE_H
+#define QUANTA_VM_THREADED_CODE_H
+
+#include <cstdint>
+#include <memory>
+
+namespace Quanta {
+
+class Value;
+struct BytecodeChunk;
+
+namespace VM {
+
+struct Frame;
+struct ThreadedSlot;
+
+// A slot's handler: the slot carries everything the instruction needs, so
+// there is nothing left to read out of the byte stream.
+using ThreadedHandler = Value (*)(Frame&, const ThreadedSlot*, Value);
+
+// The chunk's code again, decoded once: one fixed-width slot per instruction,
+// laid out in pc order so the next instruction is the next slot.
+//
+// The compact encoding stays what the compiler emits, what the disassembler
+// prints and what validate_chunk_registers checks; this is only a faster way
+// to run it. Every handler in the table re-reads its u8/u16 operands out of
+// the byte stream and re-derives the next pc from the opcode's width. Here
+// that was done at build time: a register index is a byte in the slot, a
+// constant is its pool index, a jump is the address of the slot it lands on.
+//
+// Only the instructions worth decoding get a handler of their own -- the
+// same register moves, constants, jumps and number-on-number forms the
+// baseline tier translates. The rest keep their one implementation in the
+// handler table: their slot bridges to it, and the frame runs off exit_code,
+// a copy of the chunk's code in which every decoded instruction's opcode byte
+// reads kThreadedExitByte, so a bridged handler chain hands control back at
+// the first decoded instruction after it.
+//
+// A binary-op slot is also where that site's type feedback lives, and its
+// handler is rewritten in place as the feedback settles: the first execution
+// records what the operands were and quickens the slot to a form specialized
+// for them (AddNumber, AddString, LtNumber, ...), which tests only for that
+// and deopts the slot to the generic handler when the test fails. Both
+// fields are mutable for that reason; nothing else in a slot changes after
+// the build.
+struct ThreadedSlot {
+    mutable ThreadedHandler fn;
+    uint32_t pc;      // the instruction's own pc in the compact encoding
+    uint8_t op;       // its opcode, for the bridge
+    uint8_t r0;       // first register operand
+    uint8_t r1;       // second register operand; on a jump, whether it is a back-edge
+    mutable uint8_t feedback;  // BinaryFeedback bits, on a binary-op slot
+    // A constant's Value bits, a constant-pool index, or the target slot of
+    // a jump, depending on the handler.
+    uint64_t imm;
+};
+
+// What a binary-op site has seen, accumulated over its executions.
+enum BinaryFeedback : uint8_t {
+    kBinaryNone = 0,
+    kBinaryInt = 1 << 0,     // two numbers, both int32-valued
+    kBinaryDouble = 1 << 1,  // two numbers, at least one not int32-valued
+    kBinaryString = 1 << 2,  // two strings
+    kBinaryOther = 1 << 3,   // anything else: one of each, a BigInt, an object
+};
+constexpr uint8_t kBinaryNumber = kBinaryInt | kBinaryDouble;
+
+struct ThreadedCode {
+    std::unique_ptr<ThreadedSlot[]> slots;
+    // Slot index of every instruction start, indexed by pc: where a bridged
+    // chain that did not come back at the next instruction resumes, and
+    // where a frame re-enters after a caught exception or a generator resume.
+    std::unique_ptr<uint32_t[]> slot_at;
+    std::unique_ptr<uint8_t[]> exit_code;
+    uint32_t slot_count = 0;     // zero: the chunk could not be decoded, run it from the table
+    uint32_t decoded_ops = 0;
+
+    // The feedback recorded at the binary op starting at `pc`; kBinaryNone
+    // when it has not run, or is not a binary op.
+    uint8_t binary_feedback(uint32_t pc) const {
+        return slot_count == 0 ? static_cast<uint8_t>(kBinaryNone) : slots[slot_at[pc]].feedback;
+    }
+};
+
+// Table slot the exit copy uses; like kBaselineExitByte, never a real opcode.
+constexpr uint8_t kThreadedExitByte = 0xFE;
+
+// Process-wide switch, read once: on by default; QUANTA_VM_THREADED=0 runs
+// every chunk straight off the compact encoding, which is what
+// tools/bench_dispatch.js compares against.
+bool threaded_enabled();
+
+}
+
+}
+
+#endif
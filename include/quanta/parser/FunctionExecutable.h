@@ -104,6 +104,8 @@ private:
     // Where the body starts in unit_'s token stream, when it was deferred.
     // Only the opening index is kept: parse_body_at reads to the matching
     // brace itself, so an end index would be a second copy of the same fact.
+    // Kept once the body is rebuilt, because it is also the key the code
+    // cache files this body's chunk under (see CodeCache.h).
     mutable uint32_t body_tok_first_ = 0;
     // Where the body begins in the source. Recorded when the body is attached
     // rather than read back off it, so a stack frame can say where a function
@@ -142,6 +144,10 @@ public:
     ASTNode* ensure_body() const;
     ASTNode* body() const { return body_; }
     const Position& body_start() const { return body_start_; }
+    // The unit and token a deferred body came from; a null unit or a zero
+    // token when it never was one.
+    const ExecutableRef<ScriptUnit>& unit() const { return unit_; }
+    uint32_t body_token() const { return body_tok_first_; }
     bool has_body() const { return body_ != nullptr; }
     bool body_is_deferred() const { return body_deferred_ && body_ == nullptr; }
 
@@ -328,6 +334,43 @@ struct ClosureTemplate {
     uint32_t declared_length = 0;
 };
 
+// The same thing for a class body, held by Op::CreateClass and read member by
+// member by Op::DefineClassMember. Only a class the compiler can emit whole
+// has one: no fields, no static blocks, no private names -- each of those
+// rewrites the constructor or needs a scope of its own, and stays with
+// ClassDeclaration::define_class (Op::DefineClass).
+//
+// What define_class works out again on every evaluation -- which executable a
+// method shares, its spec length, whether its body reads the class name and
+// so needs the name bound on each call -- is worked out here once per class
+// site instead.
+struct ClassTemplate {
+    struct Member {
+        enum class Kind : uint8_t { Method, Getter, Setter };
+
+        ExecutableRef<FunctionExecutable> executable;
+        std::string key;               // empty when computed: the key is an operand
+        std::string source_text;
+        Kind kind = Kind::Method;
+        bool is_static = false;
+        bool is_generator = false;
+        bool is_async = false;
+        bool is_computed = false;
+        bool reads_class_name = false;
+        uint32_t declared_length = 0;
+    };
+
+    ExecutableRef<FunctionExecutable> constructor;
+    std::string class_name;            // the inner immutable binding; empty if anonymous
+    std::string constructor_name;      // class_name, or the binding site's inferred name
+    std::string source_text;
+    bool has_heritage = false;
+    bool explicit_constructor = false;
+    bool constructor_reads_class_name = false;
+    uint32_t declared_length = 0;
+    std::vector<Member> members;
+};
+
 }
 
 #endif
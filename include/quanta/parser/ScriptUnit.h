@@ -12,6 +12,7 @@ namespace Quanta {
 
 class ASTNode;
 class Parser;
+namespace VM { class CodeCacheFile; }
 
 // Owns one parse tree and keeps it alive for exactly as long as anything still
 // points into it.
@@ -121,6 +122,20 @@ public:
     void set_ctor_executable_at(uint32_t body_tok, ExecutableRef<FunctionExecutable> exe) {
         ctor_executables_[body_tok] = std::move(exe);
     }
+    // Every plain function literal's executable, by body token -- what the
+    // code cache walks for chunks worth writing back.
+    const std::unordered_map<uint32_t, ExecutableRef<FunctionExecutable>>& executables() const {
+        return executables_;
+    }
+
+    // A module's bodies have to be rebuilt under the module goal: import.meta
+    // and a reserved `await` parse differently there.
+    void set_module_goal(bool module) { module_goal_ = module; }
+
+    // The chunks an earlier run of this same source compiled, when the code
+    // cache is on (see CodeCache.h); null otherwise.
+    VM::CodeCacheFile* code_cache() const { return code_cache_.get(); }
+    void set_code_cache(std::unique_ptr<VM::CodeCacheFile> cache);
 
 private:
     ScriptUnit() = default;
@@ -134,7 +149,9 @@ private:
     // See executable_at.
     std::unordered_map<uint32_t, ExecutableRef<FunctionExecutable>> executables_;
     std::unordered_map<uint32_t, ExecutableRef<FunctionExecutable>> ctor_executables_;
+    std::unique_ptr<VM::CodeCacheFile> code_cache_;
     mutable uint32_t ref_count_ = 0;
+    bool module_goal_ = false;
 
     static constinit thread_local ScriptUnit* building_;
 };
@@ -72,7 +72,12 @@ ContextSurvivorGuard::~ContextSurvivorGuard() {
 }
 
 void Environment::gc_trace(Visitor& v) const {
-    slots_.for_each([&v](const std::string&, const BindingSlot& slot) { v.visit(slot.value); });
+    // Every key here is the interned string itself, so its address is the
+    // pool entry's (see Shape::note_key_reached).
+    slots_.for_each([&v](const std::string& key, const BindingSlot& slot) {
+        Shape::note_key_reached(&key);
+        v.visit(slot.value);
+    });
     v.visit_object(binding_object_);
     v.visit_environment(outer_environment_);
 }
@@ -184,7 +189,7 @@ Context::Context(Engine* engine, Type type)
       lexical_environment_(nullptr), variable_environment_(nullptr),
       execution_depth_(0), global_object_(nullptr), current_exception_(),
       return_value_(),
-      engine_(engine), current_filename_(Shape::intern("<unknown>")) {
+      engine_(engine), current_filename_(Shape::intern_pinned("<unknown>")) {
 
     if (type == Type::Global) {
         initialize_global_context();
@@ -200,7 +205,7 @@ Context::Context(Engine* engine, Context* parent, Type type)
       this_value_(parent ? parent->this_value_ : Value()),
       execution_depth_(0), global_object_(parent ? parent->global_object_ : nullptr),
       current_exception_(), return_value_(),
-      engine_(engine), current_filename_(parent ? parent->current_filename_ : Shape::intern("<unknown>")) {
+      engine_(engine), current_filename_(parent ? parent->current_filename_ : Shape::intern_pinned("<unknown>")) {
 
 
 
@@ -790,6 +795,18 @@ bool Context::check_execution_depth() const {
 }
 
 void Context::initialize_global_context() {
+    // The factory's intrinsics are per thread, so on any engine but a thread's
+    // first they still name the previous realm's prototypes here. Left in
+    // place, this realm's global object and Object.prototype were created
+    // inheriting from that realm's Object.prototype, so every engine chained
+    // onto all the ones before it: each own-property miss during setup walked
+    // one more realm per engine built, and every realm kept every older one
+    // reachable. Start from nothing, as the first engine does; setup installs
+    // this realm's own as it builds them.
+    ObjectFactory::set_object_prototype(nullptr);
+    ObjectFactory::set_array_prototype(nullptr);
+    ObjectFactory::set_function_prototype(nullptr);
+
     global_object_ = ObjectFactory::create_object().release();
     this_value_ = global_object_ ? Value(global_object_) : Value();
 
@@ -26,6 +26,7 @@
 #include "quanta/parser/ScriptUnit.h"
 #include "quanta/lexer/Lexer.h"
 #include "quanta/core/engine/CallStack.h"
+#include "quanta/core/vm/CodeCache.h"
 #include <fstream>
 #include <sstream>
 #include <chrono>
@@ -62,6 +63,8 @@ Engine::Engine() : initialized_(false), execution_count_(0),
     config_.max_stack_size = 8 * 1024 * 1024;
     config_.enable_debugger = false;
     config_.enable_profiler = false;
+    heap_->set_heap_limit(config_.max_heap_size);
+    heap_->reserve(config_.initial_heap_size);
     start_time_ = std::chrono::high_resolution_clock::now();
 }
 
@@ -72,6 +75,8 @@ Engine::Engine(const Config& config)
     heap_ = new Heap();
     Heap::set_active(heap_);
     engine_registry().push_back(this);
+    heap_->set_heap_limit(config_.max_heap_size);
+    heap_->reserve(config_.initial_heap_size);
 
     start_time_ = std::chrono::high_resolution_clock::now();
 }
@@ -130,7 +135,10 @@ void Engine::shutdown() {
     if (!initialized_) {
         return;
     }
-    
+
+    // Before the context goes: functions first called after their script's
+    // entry point returned are only written now.
+    VM::code_cache_flush_all();
     global_context_.reset();
     
     initialized_ = false;
@@ -156,7 +164,14 @@ Engine::Result Engine::execute_file(const std::string& filename) {
     
     std::ostringstream buffer;
     buffer << file.rdbuf();
-    return execute(buffer.str(), filename);
+    return execute_file_source(buffer.str(), filename);
+}
+
+Engine::Result Engine::execute_file_source(const std::string& source, const std::string& filename) {
+    if (!initialized_) {
+        return Result("Engine not initialized");
+    }
+    return execute_internal(source, filename, /*use_code_cache=*/true);
 }
 
 Engine::Result Engine::evaluate(const std::string& expression, bool strict_mode) {
@@ -359,7 +374,10 @@ void Engine::add_survivor_environment(Environment* env) {
 }
 
 void Engine::run_event_loop_to_completion(Context& ctx) {
-    Collector::safepoint();
+    if (Collector::safepoint()) {
+        Collector::raise_heap_limit_error(ctx);
+        return;
+    }
     if (ctx.has_pending_microtasks()) {
         ctx.drain_microtasks();
     }
@@ -391,7 +409,7 @@ size_t Engine::get_heap_usage() const {
 size_t Engine::get_heap_size() const {
     if (!heap_) return 0;
     Heap::Stats s = heap_->stats();
-    return s.chunk_count * BlockAllocator::kChunkSize + s.large_bytes;
+    return s.chunk_count * BlockAllocator::kChunkSize - s.decommitted_bytes + s.large_bytes;
 }
 
 bool Engine::has_pending_exception() const {
@@ -479,7 +497,8 @@ void Engine::setup_built_in_functions() {
 void Engine::setup_error_types() {
 }
 
-Engine::Result Engine::execute_internal(const std::string& source, const std::string& filename) {
+Engine::Result Engine::execute_internal(const std::string& source, const std::string& filename,
+                                        bool use_code_cache) {
     HeapScope heap_scope(heap_);
     try {
         execution_count_++;
@@ -549,13 +568,16 @@ Engine::Result Engine::execute_internal(const std::string& source, const std::st
         if (!program) {
             return Result("Parse error in " + filename);
         }
-        
+
+        if (use_code_cache) VM::code_cache_open(*program_unit, VM::CodeCacheKind::Script);
+
         if (global_context_) {
             global_context_->set_current_filename(filename);
 
             Value result = program->evaluate(*global_context_);
 
             run_event_loop_to_completion(*global_context_);
+            if (use_code_cache) VM::code_cache_flush(*program_unit);
 
             if (global_context_->has_exception()) {
                 Value exception = global_context_->get_exception();
@@ -619,4 +641,22 @@ void Engine::force_gc() {
     total_gc_runs_++;
 }
 
+bool Engine::write_heap_snapshot(const std::string& path, HeapSnapshot::Summary* summary) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) return false;
+    const bool written = HeapSnapshot::write(out, summary);
+    total_gc_runs_++;
+    out.close();
+    return written && static_cast<bool>(out);
+}
+
+bool Engine::write_allocation_profile(const std::string& path, AllocationSampler::Metric metric) {
+    if (metric == AllocationSampler::Metric::LiveBytes) force_gc();
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) return false;
+    const bool written = AllocationSampler::write_folded(out, metric);
+    out.close();
+    return written && static_cast<bool>(out);
+}
+
 }
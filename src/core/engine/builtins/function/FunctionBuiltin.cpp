@@ -389,6 +389,12 @@ void register_function_builtins(Context& ctx) {
 
             bound_function->set_prototype(target_func->get_prototype());
             bound_function->set_internal_slot("__bound_target__", Value(static_cast<Object*>(target_func)));
+            // With no arguments of its own to prepend, a call through this is
+            // just a call of the target with a fixed receiver, and a call site
+            // that learns that can make it directly (see CallFeedback). The
+            // hidden [[BoundThis]] below is an ordinary property anyone can
+            // overwrite, so the receiver the site trusts is kept here instead.
+            if (bound_args.empty()) bound_function->set_internal_slot("__bound_this__", bound_this);
             // The closure also captures bound_this/bound_args invisibly;
             // mirror them as traced hidden properties.
             bound_function->set_property("[[BoundThis]]", bound_this);
@@ -1533,12 +1533,74 @@ void register_global_builtins(Context& ctx) {
                 stats_obj->set_property("chunks", Value(static_cast<double>(s.chunk_count)));
                 stats_obj->set_property("largeCells", Value(static_cast<double>(s.large_count)));
                 stats_obj->set_property("largeBytes", Value(static_cast<double>(s.large_bytes)));
+                stats_obj->set_property("unsweptBytes", Value(static_cast<double>(s.unswept_bytes)));
+                stats_obj->set_property("decommittedBytes", Value(static_cast<double>(s.decommitted_bytes)));
                 stats_obj->set_property("lastMarked", Value(static_cast<double>(Collector::last_cycle().marked_cells)));
                 stats_obj->set_property("lastSwept", Value(static_cast<double>(Collector::last_cycle().swept_cells)));
             }
             return Value(stats_obj.release());
         }, 0);
 
+    // gc.telemetry(): Collector::telemetry as a frozen snapshot, for
+    // in-process dashboards. A fresh object per call, so a reader cannot
+    // disturb what the next one sees.
+    auto gc_obj_telemetry_fn = ObjectFactory::create_native_function("telemetry",
+        [](Context& ctx, std::span<const Value> args, Value receiver) -> Value {
+            (void)ctx; (void)args;
+            const Collector::Telemetry t = Collector::telemetry();
+            auto num = [](auto n) { return Value(static_cast<double>(n)); };
+            auto pauses = [&num](const Collector::PauseDistribution& d) {
+                auto obj = ObjectFactory::create_object();
+                obj->set_property("count", num(d.count));
+                obj->set_property("p50Us", num(d.p50_us));
+                obj->set_property("p99Us", num(d.p99_us));
+                obj->set_property("maxUs", num(d.max_us));
+                obj->freeze();
+                return Value(obj.release());
+            };
+            auto cycles = ObjectFactory::create_array();
+            for (size_t i = 0; i < t.cycles.size(); i++) {
+                const Collector::CycleRecord& c = t.cycles[i];
+                auto rec = ObjectFactory::create_object();
+                rec->set_property("type", Value(std::string(c.minor ? "minor" : "major")));
+                rec->set_property("startUs", num(c.start_us));
+                rec->set_property("pauseUs", num(c.pause_us));
+                rec->set_property("longestSliceUs", num(c.longest_slice_us));
+                rec->set_property("slices", num(c.slices));
+                rec->set_property("sweepWaitUs", num(c.sweep_wait_us));
+                rec->set_property("rootsUs", num(c.roots_us));
+                rec->set_property("markUs", num(c.mark_us));
+                rec->set_property("ephemeronUs", num(c.ephemeron_us));
+                rec->set_property("verifyUs", num(c.verify_us));
+                rec->set_property("sweepUs", num(c.sweep_us));
+                rec->set_property("markedCells", num(c.marked_cells));
+                rec->set_property("sweptCells", num(c.swept_cells));
+                rec->set_property("sweptBytes", num(c.swept_bytes));
+                rec->set_property("liveBytes", num(c.live_bytes));
+                rec->set_property("stackWordsScanned", num(c.stack_words_scanned));
+                rec->set_property("survivorContexts", num(c.survivor_contexts));
+                rec->set_property("survivorEnvironments", num(c.survivor_environments));
+                rec->set_property("shapesFreed", num(c.shapes_freed));
+                rec->set_property("shapes", num(c.shapes));
+                rec->set_property("keysFreed", num(c.keys_freed));
+                rec->set_property("internedKeys", num(c.interned_keys));
+                rec->set_property("dirtyCards", num(c.dirty_cards));
+                rec->freeze();
+                cycles->set_element(static_cast<uint32_t>(i), Value(rec.release()));
+            }
+            cycles->freeze();
+            auto obj = ObjectFactory::create_object();
+            obj->set_property("minorCount", num(t.minor_count));
+            obj->set_property("majorCount", num(t.major_count));
+            obj->set_property("totalPauseUs", num(t.total_pause_us));
+            obj->set_property("maxPauseUs", num(t.max_pause_us));
+            obj->set_property("minorPauses", pauses(t.minor_pauses));
+            obj->set_property("majorSlicePauses", pauses(t.major_slice_pauses));
+            obj->set_property("cycles", Value(cycles.release()));
+            obj->freeze();
+            return Value(obj.release());
+        }, 0);
+
     auto gc_obj_collect_fn = ObjectFactory::create_native_function("collect",
         [](Context& ctx, std::span<const Value> args, Value receiver) -> Value {
             (void)ctx; (void)args;
@@ -1563,6 +1625,7 @@ void register_global_builtins(Context& ctx) {
         }, 0);
 
     gc_obj->set_property("stats", Value(gc_obj_stats_fn.release()), PropertyAttributes::BuiltinFunction);
+    gc_obj->set_property("telemetry", Value(gc_obj_telemetry_fn.release()), PropertyAttributes::BuiltinFunction);
     gc_obj->set_property("collect", Value(gc_obj_collect_fn.release()), PropertyAttributes::BuiltinFunction);
     gc_obj->set_property("minor", Value(gc_obj_minor_fn.release()), PropertyAttributes::BuiltinFunction);
     gc_obj->set_property("heapSize", Value(gc_obj_heap_size_fn.release()), PropertyAttributes::BuiltinFunction);
@@ -0,0 +1,202 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "quanta/core/gc/AllocationSampler.h"
+#include "quanta/core/gc/Heap.h"
+#include "quanta/core/engine/CallStack.h"
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Quanta {
+
+namespace {
+
+const char* kind_frame(CellKind kind) {
+    switch (kind) {
+        case CellKind::Object: return "(Object)";
+        case CellKind::String: return "(String)";
+        case CellKind::Symbol: return "(Symbol)";
+        case CellKind::BigInt: return "(BigInt)";
+        case CellKind::kCount: break;
+    }
+    return "(cell)";
+}
+
+// One distinct (stack, kind): the folded line it will be written as, and the
+// bytes its samples stand for. Doubles, not integers: a sample's weight is
+// an estimate with a fractional part, and rounding each one would bias a
+// stack whose cells are all just over a whole number of bytes.
+struct Site {
+    std::string folded;
+    double allocated_bytes = 0;
+    double live_bytes = 0;
+};
+
+struct LiveSample {
+    uint32_t site;
+    double weight;
+};
+
+struct SamplerState {
+    size_t interval = 0;
+    bool running = false;
+    std::vector<Site> sites;
+    std::unordered_map<std::string, uint32_t> site_index;
+    // Sampled cells the last collection left alive, by address.
+    std::unordered_map<const void*, LiveSample> live;
+    size_t samples = 0;
+    // Reused across samples, so taking one does not allocate a fresh key.
+    std::string key;
+};
+
+SamplerState& state() {
+    thread_local SamplerState s;
+    return s;
+}
+
+void append_frame(std::string& out, const CallStackFrame& frame) {
+    const std::string& name = frame.name();
+    size_t start = out.size();
+    out += name.empty() ? "(anonymous)" : name;
+    if (frame.filename && !frame.filename->empty()) {
+        out += ' ';
+        out += *frame.filename;
+        out += ':';
+        out += std::to_string(frame.position().line);
+    }
+    // ';' separates frames and a newline ends the line; neither may appear
+    // inside one.
+    for (size_t i = start; i < out.size(); i++) {
+        if (out[i] == ';') out[i] = ',';
+        else if (out[i] == '\n' || out[i] == '\r') out[i] = ' ';
+    }
+}
+
+// The number of bytes a sample of a `size`-byte cell stands for. A cell is
+// sampled when a sampling point falls inside it, which for a cell of size s
+// at mean interval I happens with probability 1 - e^(-s/I); dividing by that
+// makes the estimate unbiased for cells of every size, from ones far smaller
+// than the interval (weight close to I) to ones larger (weight close to s).
+double sample_weight(size_t size, size_t interval) {
+    const double s = static_cast<double>(size);
+    return s / -std::expm1(-s / static_cast<double>(interval));
+}
+
+void on_sample(void* cell, size_t size, CellKind kind) {
+    SamplerState& st = state();
+    st.key.clear();
+    st.key += "(program)";
+    for (const CallStackFrame& frame : CallStack::instance().frames()) {
+        st.key += ';';
+        append_frame(st.key, frame);
+    }
+    st.key += ';';
+    st.key += kind_frame(kind);
+
+    auto [it, inserted] = st.site_index.try_emplace(st.key, static_cast<uint32_t>(st.sites.size()));
+    if (inserted) st.sites.push_back({st.key});
+    const uint32_t site = it->second;
+    const double weight = sample_weight(size, st.interval);
+    st.sites[site].allocated_bytes += weight;
+    st.sites[site].live_bytes += weight;
+    st.samples++;
+    // A cell sampled twice is one whose slot was freed and reused without
+    // the profile hearing of it; the old sample's cell is gone.
+    auto [live_it, fresh] = st.live.try_emplace(cell, LiveSample{site, weight});
+    if (!fresh) {
+        st.sites[live_it->second.site].live_bytes -= live_it->second.weight;
+        live_it->second = LiveSample{site, weight};
+    }
+}
+
+void on_free(void* cell) {
+    SamplerState& st = state();
+    if (st.live.empty()) return;
+    auto it = st.live.find(cell);
+    if (it == st.live.end()) return;
+    st.sites[it->second.site].live_bytes -= it->second.weight;
+    st.live.erase(it);
+}
+
+}
+
+void AllocationSampler::start(size_t mean_interval) {
+    SamplerState& st = state();
+    st.interval = mean_interval ? mean_interval : kDefaultInterval;
+    st.running = true;
+    Heap::set_allocation_sampling(st.interval, on_sample, on_free);
+}
+
+void AllocationSampler::stop() {
+    SamplerState& st = state();
+    if (!st.running) return;
+    st.running = false;
+    Heap::set_allocation_sampling(0, nullptr, nullptr);
+    st.live.clear();
+}
+
+bool AllocationSampler::running() {
+    return state().running;
+}
+
+void AllocationSampler::clear() {
+    SamplerState& st = state();
+    st.sites.clear();
+    st.site_index.clear();
+    st.live.clear();
+    st.samples = 0;
+}
+
+void AllocationSampler::drop_dead_samples() {
+    SamplerState& st = state();
+    for (auto it = st.live.begin(); it != st.live.end();) {
+        const Heap::ProbeResult cell = Heap::exact_cell(it->first);
+        if (cell.cell == it->first && Heap::test_mark(cell)) {
+            ++it;
+            continue;
+        }
+        st.sites[it->second.site].live_bytes -= it->second.weight;
+        it = st.live.erase(it);
+    }
+}
+
+bool AllocationSampler::write_folded(std::ostream& out, Metric metric) {
+    const SamplerState& st = state();
+    // Largest first, so the head of the file is already the answer.
+    std::vector<std::pair<uint64_t, const Site*>> lines;
+    lines.reserve(st.sites.size());
+    for (const Site& site : st.sites) {
+        const double bytes = metric == Metric::LiveBytes ? site.live_bytes : site.allocated_bytes;
+        const uint64_t rounded = static_cast<uint64_t>(std::llround(std::max(bytes, 0.0)));
+        if (rounded) lines.emplace_back(rounded, &site);
+    }
+    std::sort(lines.begin(), lines.end(), [](const auto& a, const auto& b) {
+        return a.first != b.first ? a.first > b.first : a.second->folded < b.second->folded;
+    });
+    for (const auto& [bytes, site] : lines) out << site->folded << ' ' << bytes << '\n';
+    out.flush();
+    return static_cast<bool>(out);
+}
+
+AllocationSampler::Totals AllocationSampler::totals() {
+    const SamplerState& st = state();
+    Totals t;
+    t.samples = st.samples;
+    t.live_samples = st.live.size();
+    double allocated = 0, live = 0;
+    for (const Site& site : st.sites) {
+        allocated += site.allocated_bytes;
+        live += site.live_bytes;
+    }
+    t.allocated_bytes = static_cast<size_t>(std::llround(std::max(allocated, 0.0)));
+    t.live_bytes = static_cast<size_t>(std::llround(std::max(live, 0.0)));
+    return t;
+}
+
+}
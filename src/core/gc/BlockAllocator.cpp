@@ -154,7 +154,14 @@ void BlockAllocator::grow() {
 }
 
 void* BlockAllocator::allocate_block_region() {
-    if (free_regions_.empty()) grow();
+    if (free_regions_.empty()) {
+        if (!decommitted_regions_.empty()) {
+            void* region = decommitted_regions_.back();
+            decommitted_regions_.pop_back();
+            return region;
+        }
+        grow();
+    }
     void* region = free_regions_.back();
     free_regions_.pop_back();
     return region;
@@ -164,29 +171,40 @@ void BlockAllocator::release_block_region(void* region) {
     free_regions_.push_back(region);
 }
 
-void BlockAllocator::decommit_idle_chunks() const {
-    for (void* chunk : chunks_) {
-        uintptr_t base = reinterpret_cast<uintptr_t>(chunk);
-        uintptr_t end = base + kChunkSize;
-        size_t free_in_chunk = 0;
-        for (void* r : free_regions_) {
-            uintptr_t a = reinterpret_cast<uintptr_t>(r);
-            if (a >= base && a < end) free_in_chunk++;
+void BlockAllocator::reserve(size_t bytes) {
+    while (chunks_.size() * kChunkSize < bytes) grow();
+}
+
+void BlockAllocator::decommit_idle_regions() {
+    if (free_regions_.size() <= kCommittedReserve) return;
+    // The front of the list is what was released longest ago; the back is
+    // what allocation takes next.
+    const auto cold_end = free_regions_.end() - kCommittedReserve;
+    std::vector<void*> cold(free_regions_.begin(), cold_end);
+    free_regions_.erase(free_regions_.begin(), cold_end);
+    std::sort(cold.begin(), cold.end());
+    // One call per run of adjacent regions: a chunk that emptied out whole
+    // still costs one, as it did before.
+    for (size_t i = 0; i < cold.size();) {
+        char* run = static_cast<char*>(cold[i]);
+        size_t len = HeapBlock::kBlockSize;
+        size_t j = i + 1;
+        while (j < cold.size() && static_cast<char*>(cold[j]) == run + len) {
+            len += HeapBlock::kBlockSize;
+            j++;
         }
-        if (free_in_chunk < kBlocksPerChunk) continue;
-        // Every block in this chunk is free: hand its physical pages back to
-        // the OS without unmapping the virtual range. The chunk stays a
-        // known-valid address for the registry and its thread-local MRU
-        // cache, so a stale hit here just faults in a fresh zero page
-        // instead of touching unmapped memory -- HeapBlock::init()
-        // overwrites every field on the next use regardless of what the OS
-        // hands back.
+        // The virtual range stays mapped: the chunk remains a known-valid
+        // address for the registry and its thread-local MRU cache, so a
+        // stale hit here just faults in a fresh zero page instead of
+        // touching unmapped memory.
 #ifdef _WIN32
-        DiscardVirtualMemory(chunk, kChunkSize);
+        DiscardVirtualMemory(run, len);
 #else
-        madvise(chunk, kChunkSize, MADV_DONTNEED);
+        madvise(run, len, MADV_DONTNEED);
 #endif
+        i = j;
     }
+    decommitted_regions_.insert(decommitted_regions_.end(), cold.begin(), cold.end());
 }
 
 bool BlockAllocator::owns_address(const void* p) {
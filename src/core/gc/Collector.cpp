@@ -5,9 +5,11 @@
  */
 
 #include "quanta/core/gc/Collector.h"
+#include "quanta/core/gc/AllocationSampler.h"
 #include "quanta/core/gc/FiberRegistry.h"
 #include "quanta/core/runtime/RegExp.h"
 #include "quanta/core/gc/Heap.h"
+#include "quanta/core/gc/ParallelMarker.h"
 #include "quanta/core/gc/Visitor.h"
 #include "quanta/core/engine/Engine.h"
 #include "quanta/core/engine/Context.h"
@@ -23,17 +25,24 @@
 #include "quanta/core/runtime/Generator.h"
 #include "quanta/core/modules/ModuleLoader.h"
 #include "quanta/parser/FunctionExecutable.h"
+#include "quanta/core/vm/Bytecode.h"
 #include "quanta/core/runtime/MapSet.h"
 #include "quanta/core/runtime/Promise.h"
 #include "quanta/core/runtime/ProxyReflect.h"
+#include "quanta/core/runtime/Shape.h"
 #include "quanta/core/runtime/String.h"
 #include "quanta/core/runtime/Symbol.h"
 #include "quanta/core/runtime/TypedArray.h"
 #include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <unordered_set>
 #include <vector>
 #ifdef _WIN32
@@ -66,6 +75,7 @@ namespace {
 // object graphs cannot overflow the stack.
 // Defined below, next to env_flag; declared here for MarkVisitor and
 // release_env, both of which sit above it.
+bool env_flag(const char* name);
 bool env_hunt();
 void hunt_note_free(const Environment* env);
 void hunt_check(const Environment* env, const char* who);
@@ -77,6 +87,80 @@ void hunt_check(const Environment* env, const char* who);
 // run_minor_collection's survivor prune.
 constinit thread_local uint8_t g_major_epoch = 1;
 
+// Parallel marking. A stop-the-world drain -- a minor, a major finished in one
+// go, the ephemeron fixpoint -- used to walk the whole live set on the
+// collecting thread while every other core sat idle, and on a heap of a
+// million live cells that walk is most of the pause. With
+// QUANTA_GC_MARK_THREADS above one, such a drain hands its gray backlog to a
+// pool of markers (the collecting thread is marker 0) that trace in parallel
+// and steal from each other's worklists when their own runs dry.
+//
+// Only cells are traced in parallel. Contexts and environments have no mark
+// bit to claim -- their visited state is the seen_contexts_ set and a cycle
+// stamp, neither of which can take concurrent writers -- so a marker that
+// meets one only records it, and the collecting thread resolves the lot
+// afterwards in drain_contexts_and_environments, the same place the serial
+// path resolves them. Weak-container hooks are gathered the same way. An
+// incremental slice stays serial: it is bounded to half a millisecond, and a
+// phase costs a wakeup of every helper.
+//
+// Helpers never clear a cell's remembered bit, which trace_cell does during a
+// major to re-arm the insertion barrier. There is nothing to re-arm: a
+// parallel drain is always a full one, the mutator does not run again before
+// the cycle ends, and finish_major_cycle clears every bit the barrier set.
+const unsigned g_mark_threads = [] {
+    const char* val = std::getenv("QUANTA_GC_MARK_THREADS");
+    if (!val || !*val) return 1u;
+    long n = std::strtol(val, nullptr, 10);
+    return static_cast<unsigned>(std::clamp(n, 1L, 64L));
+}();
+
+// Gray entries per marker a drain needs before it goes parallel. A phase runs
+// until the whole subgraph under its seed is marked, not just the seed, so
+// the bar is only "enough to start every marker off": a graph that never fans
+// out -- a long list -- keeps its backlog near one and stays serial, where a
+// wakeup of every helper would buy nothing.
+constexpr size_t kParallelMarkSeedPerMarker = 4;
+
+// Collector::set_mark_threads' count for this thread; zero until it is
+// called, which leaves QUANTA_GC_MARK_THREADS in charge.
+constinit thread_local unsigned t_mark_threads = 0;
+
+unsigned mark_threads() {
+    return t_mark_threads ? t_mark_threads : g_mark_threads;
+}
+
+}
+
+MarkerPool* marker_pool() {
+    const unsigned n = mark_threads();
+    if (n <= 1) return nullptr;
+    static thread_local std::unique_ptr<MarkerPool> pool;
+    if (!pool || pool->size() != n) pool = std::make_unique<MarkerPool>(n);
+    return pool.get();
+}
+
+void ParallelMarker::trace(uintptr_t w) {
+    Heap::ProbeResult p = decode(w);
+    stats.traced++;
+    if (p.kind == CellKind::Object) static_cast<Object*>(p.cell)->trace(*this);
+    else static_cast<String*>(p.cell)->gc_trace(*this);
+}
+
+namespace {
+
+// Per-marker lines for QUANTA_GC_PROFILE, after the collection's own line.
+void print_marker_profile() {
+    if (mark_threads() <= 1) return;
+    MarkerPool* pool = marker_pool();
+    for (unsigned i = 0; i < pool->size(); i++) {
+        const ParallelMarker::Stats& s = pool->marker(i).stats;
+        std::fprintf(stderr, "[gc-prof]   marker=%u phases=%u traced=%zu marked=%zu stolen=%zu busy=%ldus\n",
+                     i, pool->phases(), s.traced, s.marked, s.stolen,
+                     static_cast<long>(s.busy.count()));
+    }
+}
+
 class MarkVisitor final : public Visitor {
 public:
     size_t marked_cells = 0;
@@ -257,7 +341,18 @@ public:
     }
 
     void drain() {  // full, uninterruptible drain to quiescence
-        while (step()) {}
+        MarkerPool* pool = marker_pool();
+        if (!pool) {
+            while (step()) {}
+            return;
+        }
+        for (;;) {
+            if (gray_.size() + pf_count_ >= kParallelMarkSeedPerMarker * pool->size()) {
+                drain_in_parallel(*pool);
+                continue;
+            }
+            if (!step()) return;
+        }
     }
 
     // Cycle boundary: called at the start of every collection (minor or
@@ -275,6 +370,8 @@ public:
         pending_weak_sets_.clear();
         pending_weak_refs_.clear();
         pending_fin_registries_.clear();
+        ephemeron_entries = 0;
+        if (MarkerPool* pool = marker_pool()) pool->reset_stats();
     }
 
     static bool alive(const void* p) {
@@ -283,32 +380,39 @@ public:
     }
 
     // A WeakMap/WeakSet value is only reachable through a live key; marking
-    // it can itself unlock other maps' entries (ephemeron chains), so this
-    // iterates to a fixpoint, redraining ordinary edges after each pass.
+    // it can itself unlock other maps' entries (ephemeron chains). Rescanning
+    // every map until a pass marks nothing made a chain of n such links cost
+    // n passes over all of them, so instead each entry is looked at once: a
+    // live key's value is visited on the spot, and a dead one's waits in
+    // ephemeron_waiters_ under its key until mark_edge marks that key and
+    // moves it to woken_. Maps first met while this runs (a WeakMap held
+    // only by a WeakMap value) are taken as they turn up.
+    //
+    // The drains in here are serial: the markers of a parallel drain mark
+    // without going through this visitor, so they would never wake anything.
+    // What is left to mark this late is only what hangs off weak entries,
+    // which the main drain has already excluded from the bulk of the heap.
     void drain_ephemerons() {
-        bool progress = true;
-        while (progress) {
-            progress = false;
-            for (WeakMap* wm : pending_weak_maps_) {
-                for (auto& e : wm->raw_entries()) {
-                    if (!alive(e.first)) continue;
-                    size_t before = marked_cells;
-                    visit(e.second);
-                    if (marked_cells != before) progress = true;
-                }
-                if (auto* sm = wm->raw_symbol_entries()) {
-                    for (auto& e : *sm) {
-                        if (!alive(e.first)) continue;
-                        size_t before = marked_cells;
-                        visit(e.second);
-                        if (marked_cells != before) progress = true;
-                    }
-                }
+        ephemerons_open_ = true;
+        size_t entered = 0;
+        for (;;) {
+            while (entered < pending_weak_maps_.size()) enter_ephemerons(pending_weak_maps_[entered++]);
+            while (!woken_.empty()) {
+                const Value* value = woken_.back();
+                woken_.pop_back();
+                visit(*value);
             }
-            if (progress) drain();
+            bool traced = false;
+            while (step()) traced = true;
+            if (!traced && woken_.empty() && entered == pending_weak_maps_.size()) break;
         }
+        ephemerons_open_ = false;
+        ephemeron_waiters_.clear();
     }
 
+    // Entries drain_ephemerons has taken in, for QUANTA_GC_PROFILE.
+    size_t ephemeron_entries = 0;
+
     // Keys/targets still unmarked after the fixpoint are truly dead. Erases
     // dead WeakMap/WeakSet entries (a stale Object* key must not linger --
     // once its memory is reused, pointer-identity lookups would alias a new
@@ -369,12 +473,72 @@ public:
     }
 
 private:
+    // One parallel phase over everything gray, ring included, then the
+    // markers' deferred contexts, environments and weak containers taken
+    // back through this visitor's own hooks -- so they are deduplicated,
+    // stamped and queued exactly as if the serial trace had met them, and
+    // the caller's next step() resolves them.
+    void drain_in_parallel(MarkerPool& pool) {
+        handoff_.clear();
+        while (pf_count_ > 0) {
+            handoff_.push_back(pf_[pf_head_]);
+            pf_head_ = (pf_head_ + 1) & (kPrefetchRing - 1);
+            pf_count_--;
+        }
+        pf_head_ = pf_tail_ = 0;
+        handoff_.insert(handoff_.end(), gray_.begin(), gray_.end());
+        gray_.clear();
+        std::vector<size_t> marked_before(pool.size());
+        for (unsigned i = 0; i < pool.size(); i++) marked_before[i] = pool.marker(i).stats.marked;
+        pool.run(handoff_);
+        for (unsigned i = 0; i < pool.size(); i++) {
+            ParallelMarker& m = pool.marker(i);
+            marked_cells += m.stats.marked - marked_before[i];
+            for (Context* ctx : m.contexts) visit_context(ctx);
+            for (Environment* env : m.environments) visit_environment(env);
+            for (WeakMap* w : m.weak_maps) visit_weak_map(w);
+            for (WeakSet* w : m.weak_sets) visit_weak_set(w);
+            for (WeakRef* w : m.weak_refs) visit_weak_ref(w);
+            for (FinalizationRegistry* r : m.fin_registries) visit_finalization_registry(r);
+            m.contexts.clear();
+            m.environments.clear();
+            m.weak_maps.clear();
+            m.weak_sets.clear();
+            m.weak_refs.clear();
+            m.fin_registries.clear();
+        }
+    }
+
+    template <typename Key>
+    void enter_ephemerons(std::unordered_map<Key*, Value>& entries) {
+        ephemeron_entries += entries.size();
+        for (auto& e : entries) {
+            if (alive(e.first)) visit(e.second);
+            else ephemeron_waiters_[e.first].push_back(&e.second);
+        }
+    }
+    void enter_ephemerons(WeakMap* wm) {
+        enter_ephemerons(wm->raw_entries());
+        if (auto* sm = wm->raw_symbol_entries()) enter_ephemerons(*sm);
+    }
+
+    // A key drain_ephemerons is waiting on was just marked: its values are
+    // reachable now. Queued rather than visited, which would recurse once per
+    // link of a chain.
+    void wake_ephemerons(const void* key) {
+        auto it = ephemeron_waiters_.find(key);
+        if (it == ephemeron_waiters_.end()) return;
+        woken_.insert(woken_.end(), it->second.begin(), it->second.end());
+        ephemeron_waiters_.erase(it);
+    }
+
     // Marking from a trace edge, where the kind comes from the edge and the
     // pointer is a cell base -- see Heap::mark_exact.
     void mark_edge(const void* p, CellKind kind) {
         Heap::ProbeResult r = Heap::mark_exact(p, kind);
         if (!r.cell) return;
         marked_cells++;
+        if (ephemerons_open_) wake_ephemerons(r.cell);
         if (r.kind == CellKind::Object || r.kind == CellKind::String) {
             gray_.push_back(r);
         }
@@ -384,6 +548,7 @@ private:
         if (!p.cell || Heap::test_mark(p)) return;
         Heap::set_mark(p);
         marked_cells++;
+        if (ephemerons_open_) wake_ephemerons(p.cell);
         // Symbols and BigInts are leaves; their marking is complete here.
         if (p.kind == CellKind::Object || p.kind == CellKind::String) {
             gray_.push_back(p);
@@ -406,6 +571,8 @@ private:
     static constexpr uint32_t kPrefetchRing = QUANTA_GC_PREFETCH_RING;
     Heap::ProbeResult pf_[kPrefetchRing];
     uint32_t pf_head_ = 0, pf_tail_ = 0, pf_count_ = 0;
+    // drain_in_parallel's seed, kept so its capacity is too.
+    std::vector<Heap::ProbeResult> handoff_;
     std::vector<Context*> context_work_;
     std::vector<Environment*> environment_work_;
     // Which collection this is. An environment queued during it carries the
@@ -420,6 +587,12 @@ private:
     std::vector<WeakSet*> pending_weak_sets_;
     std::vector<WeakRef*> pending_weak_refs_;
     std::vector<FinalizationRegistry*> pending_fin_registries_;
+
+    // See drain_ephemerons. Keyed by the key's cell address, which is what
+    // mark_edge has in hand when it marks one.
+    bool ephemerons_open_ = false;
+    std::unordered_map<const void*, std::vector<const Value*>> ephemeron_waiters_;
+    std::vector<const Value*> woken_;
 };
 
 // Post-mark verifier: the single-pass form of the tri-color invariant.
@@ -475,8 +648,9 @@ constinit thread_local size_t g_scanned_words = 0;
 #  define QUANTA_NO_ASAN
 #endif
 
+template <typename Sink>
 QUANTA_NO_ASAN
-void scan_range(MarkVisitor& v, const void* lo, const void* hi) {
+void scan_range(Sink& v, const void* lo, const void* hi) {
     auto a = (reinterpret_cast<uintptr_t>(lo) + sizeof(uint64_t) - 1) & ~(sizeof(uint64_t) - 1);
     auto b = reinterpret_cast<uintptr_t>(hi) & ~(sizeof(uint64_t) - 1);
     g_scanned_words += (b > a) ? (b - a) / sizeof(uint64_t) : 0;
@@ -517,9 +691,55 @@ void main_thread_stack_bounds(const char** lo, const char** hi) {
     *hi = cached_hi;
 }
 
+std::vector<Collector::RegisterFile*>& register_files() {
+    static thread_local std::vector<Collector::RegisterFile*> files;
+    return files;
+}
+
+// The banks scan_register_files has read precisely, by address, for the
+// stack scan to step over. Rebuilt by every scan; kept for its capacity.
+thread_local std::vector<std::pair<const char*, const char*>> g_register_holes;
+
+// Every registered bank's live registers, as Values; the rest are skipped and
+// left as they are (see Collector::RegisterFile).
+template <typename Sink>
+void scan_register_files(Sink& v) {
+    static const bool whole = env_flag("QUANTA_GC_CONSERVATIVE_FRAMES");
+    g_register_holes.clear();
+    for (Collector::RegisterFile* file : register_files()) {
+        const uint32_t count = file->chunk->register_count;
+        const uint64_t* live = whole ? nullptr : VM::register_liveness(*file->chunk).at(*file->pc);
+        for (uint32_t r = 0; r < count; r++) {
+            if (!live || ((live[r / 64] >> (r % 64)) & 1)) v.visit(file->regs[r]);
+        }
+        const char* lo = reinterpret_cast<const char*>(file->regs);
+        g_register_holes.emplace_back(lo, lo + count * sizeof(Value));
+    }
+    std::sort(g_register_holes.begin(), g_register_holes.end());
+}
+
+// scan_range over [lo, hi) minus the register banks in it.
+template <typename Sink>
+void scan_stack_range(Sink& v, const char* lo, const char* hi) {
+    const auto& holes = g_register_holes;
+    auto it = std::lower_bound(holes.begin(), holes.end(), std::make_pair(lo, lo),
+                               [](const auto& a, const auto& b) { return a.second <= b.first; });
+    for (; it != holes.end() && it->first < hi; ++it) {
+        if (it->first > lo) scan_range(v, lo, it->first);
+        if (it->second > lo) lo = it->second;
+    }
+    if (lo < hi) scan_range(v, lo, hi);
+}
+
+// A template over what is done with each word: marking, or, for
+// Collector::trace_roots, reporting the cell it names as a root.
+template <typename Sink>
 __attribute__((no_sanitize("address")))
-void scan_stacks(MarkVisitor& v) {
+void scan_stacks(Sink& v) {
     g_scanned_words = 0;
+    // First, so the banks it reads are known before the stacks holding them
+    // are walked.
+    scan_register_files(v);
     // Spill registers into a struct scanned explicitly below -- relying on
     // it falling inside [sp, main_hi] by luck of stack layout missed a
     // register-resident pointer under some compilers/flags (observed with
@@ -541,7 +761,7 @@ void scan_stacks(MarkVisitor& v) {
     const char* sp = &probe;
     if (sp >= main_lo && sp < main_hi) {
         // Running on the host stack: live region is [sp, top].
-        scan_range(v, sp, main_hi);
+        scan_stack_range(v, sp, main_hi);
     } else {
         // Running inside a fiber: the host stack is suspended somewhere at or
         // below its deepest recorded fiber-enter point.
@@ -550,7 +770,7 @@ void scan_stacks(MarkVisitor& v) {
             const char* c = static_cast<const char*>(esp);
             if (c >= main_lo && c < main_hi && c < deepest) deepest = c;
         });
-        scan_range(v, deepest, main_hi);
+        scan_stack_range(v, deepest, main_hi);
     }
 
     // A suspended fiber's saved registers live in its mco_coro control block,
@@ -581,7 +801,7 @@ void scan_stacks(MarkVisitor& v) {
             from = (deepest - rec.stack_lo > static_cast<ptrdiff_t>(kSwitchMargin))
                        ? deepest - kSwitchMargin : rec.stack_lo;
         }
-        scan_range(v, from, rec.stack_hi);
+        scan_stack_range(v, from, rec.stack_hi);
         if (rec.state && rec.state->co) {
             mco_coro* co = rec.state->co;
             const char* control_end = rec.stack_lo;
@@ -594,8 +814,107 @@ void scan_stacks(MarkVisitor& v) {
 }
 
 
+// scan_stacks' sink for Collector::trace_roots: a stack word that names a
+// cell becomes an edge to it, and a fiber's extra roots pass straight
+// through to the caller's visitor.
+class StackRootVisitor final : public Visitor {
+public:
+    explicit StackRootVisitor(Visitor& out) : out_(out) {}
+
+    void mark_word(uint64_t word) {
+        Heap::ProbeResult r = Heap::probe_word(word);
+        if (!r.cell) return;
+        switch (r.kind) {
+            case CellKind::Object: out_.visit_object(static_cast<Object*>(r.cell)); break;
+            case CellKind::String: out_.visit_string(static_cast<String*>(r.cell)); break;
+            case CellKind::Symbol: out_.visit_symbol(static_cast<Symbol*>(r.cell)); break;
+            case CellKind::BigInt: out_.visit_bigint(static_cast<BigInt*>(r.cell)); break;
+            case CellKind::kCount: break;
+        }
+    }
+
+    void visit_object(Object* o) override { out_.visit_object(o); }
+    void visit_string(String* s) override { out_.visit_string(s); }
+    void visit_symbol(Symbol* s) override { out_.visit_symbol(s); }
+    void visit_bigint(BigInt* b) override { out_.visit_bigint(b); }
+    void visit_context(Context* ctx) override { out_.visit_context(ctx); }
+    void visit_environment(Environment* env) override { out_.visit_environment(env); }
+
+private:
+    Visitor& out_;
+};
+
 thread_local Collector::CycleStats g_last_cycle;
 
+// Collector::telemetry's rings. Grown to their bound once and then
+// overwritten in place, so recording a collection never allocates past the
+// first few.
+struct Telemetry {
+    std::vector<Collector::CycleRecord> cycles;
+    size_t cycles_recorded = 0;
+    std::vector<uint32_t> minor_pauses;
+    size_t minor_pauses_recorded = 0;
+    std::vector<uint32_t> major_pauses;
+    size_t major_pauses_recorded = 0;
+    size_t minor_count = 0;
+    size_t major_count = 0;
+    uint64_t total_pause_us = 0;
+    uint64_t max_pause_us = 0;
+    // The major cycle in progress, filled in slice by slice.
+    Collector::CycleRecord major;
+};
+thread_local Telemetry g_telemetry;
+
+const std::chrono::steady_clock::time_point g_clock_origin = std::chrono::steady_clock::now();
+
+uint64_t elapsed_us(std::chrono::steady_clock::time_point a, std::chrono::steady_clock::time_point b) {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(b - a).count());
+}
+
+template <typename T>
+void ring_push(std::vector<T>& ring, size_t& recorded, size_t bound, const T& value) {
+    if (ring.size() < bound) ring.push_back(value);
+    else ring[recorded % bound] = value;
+    recorded++;
+}
+
+void record_pause(uint64_t us, bool minor) {
+    const uint32_t clamped = us > UINT32_MAX ? UINT32_MAX : static_cast<uint32_t>(us);
+    if (minor) ring_push(g_telemetry.minor_pauses, g_telemetry.minor_pauses_recorded, Collector::kTelemetryPauses, clamped);
+    else ring_push(g_telemetry.major_pauses, g_telemetry.major_pauses_recorded, Collector::kTelemetryPauses, clamped);
+    g_telemetry.total_pause_us += us;
+    if (us > g_telemetry.max_pause_us) g_telemetry.max_pause_us = us;
+}
+
+// Completes a record with what every collection reports the same way, once
+// its sweep has run, and files it.
+void record_cycle(Collector::CycleRecord& rec, size_t live_bytes) {
+    rec.marked_cells = g_last_cycle.marked_cells;
+    rec.swept_cells = g_last_cycle.swept_cells;
+    rec.live_bytes = live_bytes;
+    rec.stack_words_scanned = g_scanned_words;
+    for (Engine* engine : Engine::all_engines()) {
+        rec.survivor_contexts += engine->get_survivor_contexts().size();
+        rec.survivor_environments += engine->get_survivor_environments().size();
+    }
+    if (rec.minor) g_telemetry.minor_count++;
+    else g_telemetry.major_count++;
+    ring_push(g_telemetry.cycles, g_telemetry.cycles_recorded, Collector::kTelemetryCycles, rec);
+}
+
+Collector::PauseDistribution pause_distribution(const std::vector<uint32_t>& ring) {
+    Collector::PauseDistribution d;
+    if (ring.empty()) return d;
+    std::vector<uint32_t> sorted(ring);
+    std::sort(sorted.begin(), sorted.end());
+    auto at = [&](size_t percent) { return sorted[(sorted.size() - 1) * percent / 100]; };
+    d.count = sorted.size();
+    d.p50_us = at(50);
+    d.p99_us = at(99);
+    d.max_us = sorted.back();
+    return d;
+}
+
 
 // How many requested collections per major. Halved back to the floor by a
 // major that reclaimed a worthwhile share of what it marked, doubled by one
@@ -663,6 +982,25 @@ std::vector<Value>& remembered_values() {
     return values;
 }
 
+// Old arrays with dirty cards (see Collector::write_barrier_element), each
+// once: CardTable::listed says whether it is here already. Drained by every
+// minor, dropped by every major, like remembered_values.
+std::vector<Heap::ProbeResult>& carded_objects() {
+    static thread_local std::vector<Heap::ProbeResult> cells;
+    return cells;
+}
+
+// Forgets every listed table's cards. Only a major may: it is the cycle that
+// has no use for them, having traced every old array whole.
+void drop_carded_objects() {
+    for (const Heap::ProbeResult& p : carded_objects()) {
+        Heap::ProbeResult fresh = Heap::exact_cell(p.cell);
+        if (fresh.cell != p.cell || fresh.kind != CellKind::Object) continue;
+        if (CardTable* cards = static_cast<Object*>(p.cell)->card_table()) cards->clear();
+    }
+    carded_objects().clear();
+}
+
 std::vector<Environment*>& remembered_envs() {
     static thread_local std::vector<Environment*> envs;
     return envs;
@@ -739,6 +1077,128 @@ void hunt_check(const Environment* env, const char* who) {
                  who, static_cast<const void*>(env));
 }
 
+// The background sweeper's finalizer: the kinds whose destructor releases
+// nothing but the cell's own malloc'd storage, and so can run on any thread.
+// Object is not among them -- a butterfly goes back to SmallMapPool, which is
+// per thread, and most object types own far more than that.
+void finalize_off_thread(void* cell, CellKind kind) {
+    switch (kind) {
+        case CellKind::String: static_cast<String*>(cell)->~String(); break;
+        case CellKind::Symbol: static_cast<Symbol*>(cell)->~Symbol(); break;
+        case CellKind::BigInt: static_cast<BigInt*>(cell)->~BigInt(); break;
+        default: break;
+    }
+}
+
+// Runs a dead cell's destructor, whatever it is. Every sweep comes through
+// here: the pause's, and allocation's for a lazy block.
+void finalize_cell(void* cell, CellKind kind) {
+    switch (kind) {
+        case CellKind::Object: {
+            Object* obj = static_cast<Object*>(cell);
+            // Explicit per-type dispatch instead of a virtual ~Object()
+            // call -- Object carries no vtable. Function/TypedArrayBase/
+            // CustomObjectBase keep their own small vtables, so casting
+            // to those three still reaches every further subclass
+            // (AsyncFunction/GeneratorFunction/...; 11 numeric
+            // TypedArrays; Generator/AsyncGenerator/AsyncIterator/
+            // Iterator+4) via ordinary virtual dispatch from here.
+            using OT = Object::ObjectType;
+            switch (obj->get_type()) {
+                case OT::Function: {
+                    // Function itself carries no vtable (see Object.h's note on
+                    // why); AsyncFunction/GeneratorFunction/AsyncGeneratorFunction
+                    // need their own destructor called explicitly, same reasoning
+                    // as the outer switch on get_type().
+                    Function* fn = static_cast<Function*>(obj);
+                    switch (fn->get_function_kind()) {
+                        case Function::FunctionKind::Async: static_cast<AsyncFunction*>(fn)->~AsyncFunction(); break;
+                        case Function::FunctionKind::Generator: static_cast<GeneratorFunction*>(fn)->~GeneratorFunction(); break;
+                        case Function::FunctionKind::AsyncGenerator: static_cast<AsyncGeneratorFunction*>(fn)->~AsyncGeneratorFunction(); break;
+                        default: fn->~Function(); break;
+                    }
+                    break;
+                }
+                case OT::Custom: {
+                    // CustomObjectBase itself carries no vtable either (see
+                    // Object.h's note); every concrete kind sharing
+                    // ObjectType::Custom needs its own destructor called
+                    // explicitly, same reasoning as the outer switch.
+                    CustomObjectBase* cob = static_cast<CustomObjectBase*>(obj);
+                    using CK = CustomObjectBase::CustomKind;
+                    switch (cob->get_custom_kind()) {
+                        case CK::Generator: static_cast<Generator*>(cob)->~Generator(); break;
+                        case CK::AsyncGenerator: static_cast<AsyncGenerator*>(cob)->~AsyncGenerator(); break;
+                        case CK::AsyncIterator: static_cast<AsyncIterator*>(cob)->~AsyncIterator(); break;
+                        case CK::ArrayIterator: static_cast<ArrayIterator*>(cob)->~ArrayIterator(); break;
+                        case CK::StringIterator: static_cast<StringIterator*>(cob)->~StringIterator(); break;
+                        case CK::MapIterator: static_cast<MapIterator*>(cob)->~MapIterator(); break;
+                        case CK::SetIterator: static_cast<SetIterator*>(cob)->~SetIterator(); break;
+                        case CK::ModuleNamespace: static_cast<ModuleNamespaceObject*>(cob)->~ModuleNamespaceObject(); break;
+                        case CK::DeferredNamespace: static_cast<DeferredNamespaceObject*>(cob)->~DeferredNamespaceObject(); break;
+                    }
+                    break;
+                }
+                case OT::TypedArray: static_cast<TypedArrayBase*>(obj)->~TypedArrayBase(); break;
+                case OT::Error: static_cast<Error*>(obj)->~Error(); break;
+                case OT::Promise: static_cast<Promise*>(obj)->~Promise(); break;
+                case OT::Proxy: static_cast<Proxy*>(obj)->~Proxy(); break;
+                case OT::Map: static_cast<Map*>(obj)->~Map(); break;
+                case OT::Set: static_cast<Set*>(obj)->~Set(); break;
+                case OT::WeakMap: static_cast<WeakMap*>(obj)->~WeakMap(); break;
+                case OT::WeakSet: static_cast<WeakSet*>(obj)->~WeakSet(); break;
+                case OT::WeakRef: static_cast<WeakRef*>(obj)->~WeakRef(); break;
+                case OT::FinalizationRegistry:
+                    static_cast<FinalizationRegistry*>(obj)->~FinalizationRegistry(); break;
+                case OT::ArrayBuffer: static_cast<ArrayBuffer*>(obj)->~ArrayBuffer(); break;
+                case OT::DataView: static_cast<DataView*>(obj)->~DataView(); break;
+                // Holds a shared_ptr<RegExp>, and that RegExp owns the
+                // compiled pattern. Running only ~Object() here left every
+                // regex literal's compiled code behind for good.
+                case OT::RegExp: static_cast<RegExpObject*>(obj)->~RegExpObject(); break;
+                // The rest have no subclass of their own, so ~Object() is
+                // the whole destructor: Ordinary, Array, Arguments, and the
+                // String/Number/Boolean/Date/Symbol/BigInt wrappers.
+                default: obj->~Object(); break;
+            }
+            break;
+        }
+        case CellKind::String: static_cast<String*>(cell)->~String(); break;
+        case CellKind::Symbol: static_cast<Symbol*>(cell)->~Symbol(); break;
+        case CellKind::BigInt: static_cast<BigInt*>(cell)->~BigInt(); break;
+        default: break;
+    }
+}
+
+// Whether finalize_cell may run on this dead cell from inside allocation --
+// see Heap::LazySweep. The types with their own case above are out, bar the
+// ones whose destructor is defaulted over plain containers: Promise hands its
+// context back to the event loop, ArrayBuffer and the views reach into each
+// other, Generator tears down a fiber, a native Function's closure can own
+// anything. What is left, ~Object() and what it frees, is most of the garbage
+// a program makes anyway.
+bool finalizes_anywhere(void* cell, CellKind kind) {
+    if (kind != CellKind::Object) return true;
+    using OT = Object::ObjectType;
+    switch (static_cast<Object*>(cell)->get_type()) {
+        case OT::Function:
+        case OT::Custom:
+        case OT::TypedArray:
+        case OT::Promise:
+        case OT::Proxy:
+        case OT::WeakMap:
+        case OT::WeakSet:
+        case OT::WeakRef:
+        case OT::FinalizationRegistry:
+        case OT::ArrayBuffer:
+        case OT::DataView:
+        case OT::RegExp:
+            return false;
+        default:
+            return true;
+    }
+}
+
 size_t run_sweep(bool minor) {
     // Two passes: destructors may consult other cells' memory only through
     // their own backing stores (audited rule), but collecting the dead list
@@ -747,89 +1207,25 @@ size_t run_sweep(bool minor) {
     // hands over millions of cells, and growing the list from nothing again
     // every cycle costs more than the destructors it is holding.
     static thread_local std::vector<Heap::DeadCell> dead;
+    static thread_local std::vector<HeapBlock*> background;
     dead.clear();
-    Heap::collect_dead_cells(dead, minor);
     // QUANTA_GC_POISON=1: fill freed cells with a recognizable pattern and
     // leak the slot instead of reusing it -- any use-after-free then crashes
     // deterministically on the poison instead of silently reading a
     // recycled cell. Debug tool for hunting invisible lambda captures.
     static const bool poison = env_flag("QUANTA_GC_POISON");
+    // QUANTA_GC_NO_BACKGROUND_SWEEP=1 keeps the background sweeper out of it
+    // and QUANTA_GC_NO_LAZY_SWEEP=1 leaves nothing for allocation to sweep
+    // (see Heap::LazySweep); with both, every cell dies in the pause. Poison
+    // mode turns both off: it retires slots rather than freeing them, which
+    // neither of the other sweeps knows how to do.
+    static const bool in_background = !poison && !env_flag("QUANTA_GC_NO_BACKGROUND_SWEEP");
+    static const bool lazy = !poison && !env_flag("QUANTA_GC_NO_LAZY_SWEEP");
+    static constexpr Heap::LazySweep kLazySweep{finalizes_anywhere, finalize_cell};
+    const size_t deferred = Heap::collect_dead_cells(dead, minor, in_background ? &background : nullptr,
+                                                     lazy ? &kLazySweep : nullptr);
     for (const Heap::DeadCell& d : dead) {
-        switch (d.kind) {
-            case CellKind::Object: {
-                Object* obj = static_cast<Object*>(d.cell);
-                // Explicit per-type dispatch instead of a virtual ~Object()
-                // call -- Object carries no vtable. Function/TypedArrayBase/
-                // CustomObjectBase keep their own small vtables, so casting
-                // to those three still reaches every further subclass
-                // (AsyncFunction/GeneratorFunction/...; 11 numeric
-                // TypedArrays; Generator/AsyncGenerator/AsyncIterator/
-                // Iterator+4) via ordinary virtual dispatch from here.
-                using OT = Object::ObjectType;
-                switch (obj->get_type()) {
-                    case OT::Function: {
-                        // Function itself carries no vtable (see Object.h's note on
-                        // why); AsyncFunction/GeneratorFunction/AsyncGeneratorFunction
-                        // need their own destructor called explicitly, same reasoning
-                        // as the outer switch on get_type().
-                        Function* fn = static_cast<Function*>(obj);
-                        switch (fn->get_function_kind()) {
-                            case Function::FunctionKind::Async: static_cast<AsyncFunction*>(fn)->~AsyncFunction(); break;
-                            case Function::FunctionKind::Generator: static_cast<GeneratorFunction*>(fn)->~GeneratorFunction(); break;
-                            case Function::FunctionKind::AsyncGenerator: static_cast<AsyncGeneratorFunction*>(fn)->~AsyncGeneratorFunction(); break;
-                            default: fn->~Function(); break;
-                        }
-                        break;
-                    }
-                    case OT::Custom: {
-                        // CustomObjectBase itself carries no vtable either (see
-                        // Object.h's note); every concrete kind sharing
-                        // ObjectType::Custom needs its own destructor called
-                        // explicitly, same reasoning as the outer switch.
-                        CustomObjectBase* cob = static_cast<CustomObjectBase*>(obj);
-                        using CK = CustomObjectBase::CustomKind;
-                        switch (cob->get_custom_kind()) {
-                            case CK::Generator: static_cast<Generator*>(cob)->~Generator(); break;
-                            case CK::AsyncGenerator: static_cast<AsyncGenerator*>(cob)->~AsyncGenerator(); break;
-                            case CK::AsyncIterator: static_cast<AsyncIterator*>(cob)->~AsyncIterator(); break;
-                            case CK::ArrayIterator: static_cast<ArrayIterator*>(cob)->~ArrayIterator(); break;
-                            case CK::StringIterator: static_cast<StringIterator*>(cob)->~StringIterator(); break;
-                            case CK::MapIterator: static_cast<MapIterator*>(cob)->~MapIterator(); break;
-                            case CK::SetIterator: static_cast<SetIterator*>(cob)->~SetIterator(); break;
-                            case CK::ModuleNamespace: static_cast<ModuleNamespaceObject*>(cob)->~ModuleNamespaceObject(); break;
-                            case CK::DeferredNamespace: static_cast<DeferredNamespaceObject*>(cob)->~DeferredNamespaceObject(); break;
-                        }
-                        break;
-                    }
-                    case OT::TypedArray: static_cast<TypedArrayBase*>(obj)->~TypedArrayBase(); break;
-                    case OT::Error: static_cast<Error*>(obj)->~Error(); break;
-                    case OT::Promise: static_cast<Promise*>(obj)->~Promise(); break;
-                    case OT::Proxy: static_cast<Proxy*>(obj)->~Proxy(); break;
-                    case OT::Map: static_cast<Map*>(obj)->~Map(); break;
-                    case OT::Set: static_cast<Set*>(obj)->~Set(); break;
-                    case OT::WeakMap: static_cast<WeakMap*>(obj)->~WeakMap(); break;
-                    case OT::WeakSet: static_cast<WeakSet*>(obj)->~WeakSet(); break;
-                    case OT::WeakRef: static_cast<WeakRef*>(obj)->~WeakRef(); break;
-                    case OT::FinalizationRegistry:
-                        static_cast<FinalizationRegistry*>(obj)->~FinalizationRegistry(); break;
-                    case OT::ArrayBuffer: static_cast<ArrayBuffer*>(obj)->~ArrayBuffer(); break;
-                    case OT::DataView: static_cast<DataView*>(obj)->~DataView(); break;
-                    // Holds a shared_ptr<RegExp>, and that RegExp owns the
-                    // compiled pattern. Running only ~Object() here left every
-                    // regex literal's compiled code behind for good.
-                    case OT::RegExp: static_cast<RegExpObject*>(obj)->~RegExpObject(); break;
-                    // The rest have no subclass of their own, so ~Object() is
-                    // the whole destructor: Ordinary, Array, Arguments, and the
-                    // String/Number/Boolean/Date/Symbol/BigInt wrappers.
-                    default: obj->~Object(); break;
-                }
-                break;
-            }
-            case CellKind::String: static_cast<String*>(d.cell)->~String(); break;
-            case CellKind::Symbol: static_cast<Symbol*>(d.cell)->~Symbol(); break;
-            case CellKind::BigInt: static_cast<BigInt*>(d.cell)->~BigInt(); break;
-            default: break;
-        }
+        finalize_cell(d.cell, d.kind);
         if (poison && BlockAllocator::owns_address(d.cell)) {
             HeapBlock* block = HeapBlock::from_cell(d.cell);
             std::memset(d.cell, 0xD9, block->cell_size());
@@ -838,7 +1234,8 @@ size_t run_sweep(bool minor) {
         }
         Heap::cell_free(d.cell);
     }
-    return dead.size();
+    Heap::sweep_in_background(background, finalize_off_thread);
+    return dead.size() + deferred;
 }
 
 void run_verify(Collector::CycleStats& stats) {
@@ -861,6 +1258,13 @@ void run_minor_collection() {
     static const bool prof = env_flag("QUANTA_GC_PROFILE");
 
     Heap::clear_gc_request();
+    // Marking reads the bitmaps the last sweep's background half may still
+    // be writing. Lazy blocks can wait through a minor (see Heap::LazySweep),
+    // but the ones allocation turned down are waiting on a safepoint, and
+    // this is one.
+    auto tw = std::chrono::steady_clock::now();
+    Heap::finish_background_sweep();
+    Heap::sweep_refused_blocks();
     auto t0 = std::chrono::steady_clock::now();
 
     MarkVisitor& v = mark_visitor();
@@ -875,10 +1279,27 @@ void run_minor_collection() {
     // whole different (kind, size-class) block if the old one was emptied
     // and reclaimed. Re-probing confirms the address is still a live,
     // same-kind cell before it's dispatched through a virtual trace() call.
+    //
+    // A carded array is the exception: its elements are read by card, so
+    // only the rest of it is retraced here, and the dirty runs with it.
+    size_t dirty_cards = 0;
     for (const Heap::ProbeResult& p : remembered_cells()) {
         Heap::ProbeResult fresh = Heap::exact_cell(p.cell);
-        if (fresh.cell == p.cell && fresh.kind == p.kind) v.push_remembered(fresh);
+        if (fresh.cell != p.cell || fresh.kind != p.kind) continue;
+        Object* obj = fresh.kind == CellKind::Object ? static_cast<Object*>(fresh.cell) : nullptr;
+        if (obj && obj->card_table()) dirty_cards += obj->trace_dirty_cards(v, /*whole_cell=*/true);
+        else v.push_remembered(fresh);
     }
+    for (const Heap::ProbeResult& p : carded_objects()) {
+        Heap::ProbeResult fresh = Heap::exact_cell(p.cell);
+        if (fresh.cell != p.cell || fresh.kind != CellKind::Object) continue;
+        Object* obj = static_cast<Object*>(fresh.cell);
+        if (CardTable* cards = obj->card_table()) {
+            dirty_cards += obj->trace_dirty_cards(v, /*whole_cell=*/false);
+            cards->listed = false;
+        }
+    }
+    carded_objects().clear();
     // Null entries are environments freed since being remembered, plus ones
     // whose earlier entry a later barrier superseded -- see
     // Collector::release_env. visit_environment already ignores them.
@@ -994,9 +1415,16 @@ void run_minor_collection() {
     // simply never looked at. The next completed major decides.
     (void)0;
 
+    // The mark is final and nothing has been freed: a sampled cell it did
+    // not reach is dead, and its address is not yet anyone else's.
+    AllocationSampler::drop_dead_samples();
+
     static const bool mark_only = env_flag("QUANTA_GC_MARK_ONLY");
+    Collector::CycleRecord rec;
+    size_t live_after = 0;
     if (!mark_only) {
         g_last_cycle.swept_cells = run_sweep(/*minor=*/true);
+        rec.swept_bytes = Heap::last_dead_bytes();
         // Budget the next collection against what this one cost, but the two
         // halves of that cost do not behave alike: marking the live set is
         // amortizable (collecting sooner leaves less floating garbage), while
@@ -1004,15 +1432,32 @@ void run_minor_collection() {
         // handed over separately. The live figure comes back from the rebuild,
         // which has to touch every block anyway.
         Heap::reset_dirty_blocks();
-        const size_t live_after = Heap::rebuild_allocation_candidates();
+        live_after = Heap::rebuild_allocation_candidates();
         Heap::retune_budget(live_after, g_scanned_words * sizeof(uint64_t));
     }
     auto t6 = std::chrono::steady_clock::now();
 
+    rec.minor = true;
+    rec.dirty_cards = dirty_cards;
+    rec.start_us = elapsed_us(g_clock_origin, tw);
+    rec.pause_us = elapsed_us(tw, t6);
+    rec.longest_slice_us = rec.pause_us;
+    rec.slices = 1;
+    rec.sweep_wait_us = elapsed_us(tw, t0);
+    rec.roots_us = elapsed_us(t0, t2);
+    rec.mark_us = elapsed_us(t2, t3);
+    rec.ephemeron_us = elapsed_us(t3, t4);
+    rec.verify_us = elapsed_us(t4, t5);
+    rec.sweep_us = elapsed_us(t5, t6);
+    record_pause(rec.pause_us, /*minor=*/true);
+    record_cycle(rec, live_after);
+
     if (prof) {
         auto us = [](auto a, auto b) { return std::chrono::duration_cast<std::chrono::microseconds>(b - a).count(); };
-        std::fprintf(stderr, "[gc-prof] minor scan_stacks=%ldus roots=%ldus drain=%ldus ephemeron=%ldus verify=%ldus sweep+rebuild=%ldus marked=%zu\n",
-                     us(t0,t1), us(t1,t2), us(t2,t3), us(t3,t4), us(t4,t5), us(t5,t6), v.marked_cells);
+        std::fprintf(stderr, "[gc-prof] minor sweep_wait=%ldus scan_stacks=%ldus roots=%ldus drain=%ldus ephemeron=%ldus verify=%ldus sweep+rebuild=%ldus marked=%zu ephemerons=%zu\n",
+                     us(tw,t0), us(t0,t1), us(t1,t2), us(t2,t3), us(t3,t4), us(t4,t5), us(t5,t6), v.marked_cells,
+                     v.ephemeron_entries);
+        print_marker_profile();
     }
     if (log) {
         std::fprintf(stderr, "[gc] minor marked=%zu swept=%zu verify_violations=%zu\n",
@@ -1055,6 +1500,7 @@ void scan_major_roots(MarkVisitor& v) {
 }
 
 thread_local std::chrono::steady_clock::time_point g_major_cycle_start;
+thread_local std::chrono::microseconds g_major_sweep_wait{0};
 constinit thread_local uint32_t g_major_slice_count = 0;
 
 // Only reachable once Collector::mark_step has returned CycleComplete, i.e.
@@ -1114,13 +1560,18 @@ void finish_major_cycle(MarkVisitor& v) {
         for (Context* ctx : candidates) delete ctx;
     }
 
+    Collector::CycleRecord& rec = g_telemetry.major;
+    auto ephemeron_t0 = std::chrono::steady_clock::now();
     v.drain_ephemerons();
     v.finalize_ephemerons();
+    auto verify_t0 = std::chrono::steady_clock::now();
+    rec.ephemeron_us = elapsed_us(ephemeron_t0, verify_t0);
 
     g_last_cycle = Collector::CycleStats{};
     g_last_cycle.minor = false;
     g_last_cycle.marked_cells = v.marked_cells;
     if (verify) run_verify(g_last_cycle);
+    rec.verify_us = elapsed_us(verify_t0, std::chrono::steady_clock::now());
 
     // Must run before sweep/decommit below: a fully-dead block can be
     // decommitted (madvise'd, pages zeroed) once swept, and a stale entry
@@ -1132,6 +1583,7 @@ void finish_major_cycle(MarkVisitor& v) {
     // is marked and whatever was not is gone, and either way the edges it
     // recorded have been accounted for by the mark that just finished.
     remembered_values().clear();
+    drop_carded_objects();
     for (Environment* e : remembered_envs()) if (e) { e->gc_remembered_ = false; e->gc_in_remembered_ = false; }
     remembered_envs().clear();
     resolve_pending_env_frees(v);
@@ -1166,29 +1618,53 @@ void finish_major_cycle(MarkVisitor& v) {
             env_survivors.end());
     }
 
+    AllocationSampler::drop_dead_samples();
+
     static const bool mark_only = env_flag("QUANTA_GC_MARK_ONLY");
+    auto sweep_t0 = std::chrono::steady_clock::now();
+    size_t live_after = 0;
     if (!mark_only) {
+        // The mark is final, so a shape no traced object used is one no live
+        // object uses. The caches that name such shapes let go of them first:
+        // a freed shape's address comes back as the next new shape's.
+        Shape::settle_reachability();
+        BytecodeChunk::drop_dead_shapes();
+        Function::drop_dead_shapes();
+        rec.shapes_freed = Shape::prune_unreached();
+        rec.shapes = Shape::count();
+        // The keys go after the shapes, since a pruned shape was one of
+        // their holders; the chunks are the holders nothing traces.
+        BytecodeChunk::note_keys_reached();
+        rec.keys_freed = Shape::sweep_unreached_keys();
+        rec.interned_keys = Shape::key_count();
         g_last_cycle.swept_cells = run_sweep(/*minor=*/false);
+        rec.swept_bytes = Heap::last_dead_bytes();
         // See the minor path for why the two halves of the cost are handed
         // over separately, and why the live figure comes from the rebuild.
         Heap::reset_dirty_blocks();
-        const size_t live_after = Heap::rebuild_allocation_candidates();
+        live_after = Heap::rebuild_allocation_candidates();
         Heap::retune_budget(live_after, g_scanned_words * sizeof(uint64_t));
         Heap::note_major_done(live_after);
         note_major_yield(g_last_cycle.marked_cells, g_last_cycle.swept_cells);
         Heap::decommit_idle_memory();
     }
+    rec.sweep_us = elapsed_us(sweep_t0, std::chrono::steady_clock::now());
+    rec.live_bytes = live_after;
 
     if (prof) {
-        auto total_us = std::chrono::duration_cast<std::chrono::microseconds>(
-            std::chrono::steady_clock::now() - g_major_cycle_start).count();
-        std::fprintf(stderr, "[gc-prof] major slices=%u total=%ldus marked=%zu\n",
-                     g_major_slice_count, total_us, v.marked_cells);
+        auto now = std::chrono::steady_clock::now();
+        auto total_us = std::chrono::duration_cast<std::chrono::microseconds>(now - g_major_cycle_start).count();
+        auto sweep_us = std::chrono::duration_cast<std::chrono::microseconds>(now - sweep_t0).count();
+        std::fprintf(stderr, "[gc-prof] major slices=%u total=%ldus sweep_wait=%ldus ephemeron=%ldus sweep=%ldus marked=%zu ephemerons=%zu\n",
+                     g_major_slice_count, total_us, static_cast<long>(g_major_sweep_wait.count()),
+                     static_cast<long>(rec.ephemeron_us), sweep_us, v.marked_cells, v.ephemeron_entries);
+        print_marker_profile();
     }
     if (log) {
-        std::fprintf(stderr, "[gc] major slices=%u marked=%zu swept=%zu verify_violations=%zu\n",
+        std::fprintf(stderr, "[gc] major slices=%u marked=%zu swept=%zu verify_violations=%zu shapes=%zu(-%zu) keys=%zu(-%zu)\n",
                      g_major_slice_count, g_last_cycle.marked_cells, g_last_cycle.swept_cells,
-                     g_last_cycle.verify_violations);
+                     g_last_cycle.verify_violations, rec.shapes, rec.shapes_freed,
+                     rec.interned_keys, rec.keys_freed);
     }
 
     Collector::major_in_progress_ = false;
@@ -1217,11 +1693,25 @@ constexpr auto kMaxCycleWallClockBeforeForceFinish = std::chrono::seconds(5);
 Collector::SliceResult run_major_slice(std::chrono::microseconds budget) {
     static const bool prof = env_flag("QUANTA_GC_PROFILE");
 
+    auto pause_t0 = std::chrono::steady_clock::now();
     MarkVisitor& v = mark_visitor();
     bool cycle_opened = false;
     if (!Collector::major_in_progress_) {
+        g_telemetry.major = Collector::CycleRecord{};
+        g_telemetry.major.start_us = elapsed_us(g_clock_origin, pause_t0);
         Heap::clear_gc_request();
+        // See run_minor_collection; nothing sweeps again until this cycle ends.
+        // Clearing the marks erases the only record of which cells in a lazy
+        // block are live, so whatever allocation did not get to is swept now.
+        auto tw = std::chrono::steady_clock::now();
+        Heap::finish_background_sweep();
+        Heap::finish_lazy_sweep();
+        g_major_sweep_wait = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - tw);
+        g_telemetry.major.sweep_wait_us = static_cast<uint64_t>(g_major_sweep_wait.count());
         Heap::clear_all_marks();
+        Shape::begin_reachability();
+        Shape::begin_key_reachability();
         v.reset_for_new_cycle();
         // Symmetric with clear_all_marks: this cycle re-derives reachability
         // from scratch, so every Context's "a real edge reached me" stamp goes
@@ -1248,14 +1738,19 @@ Collector::SliceResult run_major_slice(std::chrono::microseconds budget) {
     // Nothing has run between this scan and the drain below, so a cycle that
     // both opens and drains inside this one call needs no second scan.
     bool roots_scanned_here = cycle_opened;
-    if (cycle_opened) scan_major_roots(v);
+    auto timed_root_scan = [&v] {
+        auto t0 = std::chrono::steady_clock::now();
+        scan_major_roots(v);
+        g_telemetry.major.roots_us += elapsed_us(t0, std::chrono::steady_clock::now());
+    };
+    if (cycle_opened) timed_root_scan();
     Collector::SliceResult result = Collector::mark_step(budget);
     if (result == Collector::SliceResult::CycleComplete && !roots_scanned_here) {
         // Marking has drained, but the mutator has run since the last root
         // scan and the roots carry no barrier. Re-scan and drain again; only a
         // drain that immediately follows a scan may end the cycle, and if this
         // one runs out of budget the next slice tries again.
-        scan_major_roots(v);
+        timed_root_scan();
         result = Collector::mark_step(budget);
     }
     if (prof) {
@@ -1266,8 +1761,26 @@ Collector::SliceResult run_major_slice(std::chrono::microseconds budget) {
                      result == Collector::SliceResult::Continuing ? " continuing" : " complete",
                      forced_finish ? " forced-finish" : "");
     }
-    if (result == Collector::SliceResult::Continuing) return result;
+    // A slice is a pause of its own; see Collector::telemetry.
+    auto note_slice = [pause_t0] {
+        Collector::CycleRecord& rec = g_telemetry.major;
+        const uint64_t us = elapsed_us(pause_t0, std::chrono::steady_clock::now());
+        rec.pause_us += us;
+        rec.slices++;
+        if (us > rec.longest_slice_us) rec.longest_slice_us = us;
+        record_pause(us, /*minor=*/false);
+    };
+    if (result == Collector::SliceResult::Continuing) {
+        note_slice();
+        return result;
+    }
     finish_major_cycle(v);
+    note_slice();
+    Collector::CycleRecord& rec = g_telemetry.major;
+    // Whatever the slices spent that no other phase accounts for was marking.
+    const uint64_t other = rec.sweep_wait_us + rec.roots_us + rec.ephemeron_us + rec.verify_us + rec.sweep_us;
+    rec.mark_us = rec.pause_us > other ? rec.pause_us - other : 0;
+    record_cycle(rec, rec.live_bytes);
     return result;
 }
 
@@ -1305,6 +1818,84 @@ std::chrono::microseconds next_slice_budget() {
     return default_major_slice_budget();
 }
 
+// Requested collections since the thread started, for the one-in-
+// major_interval() cadence below and GC_STRESS=2's one-in-64.
+uint32_t& requested_cycles() {
+    static thread_local uint32_t count = 0;
+    return count;
+}
+
+// Whether the heap has grown past the last major's live set by enough to
+// call for another: half of it, scaled by the interval's backoff (see
+// major_called_for), and divided by `share` for a caller that starts early.
+bool major_growth_reached(size_t share) {
+    const size_t live = Heap::live_after_major();
+    const size_t growth_needed = (live / 2) * (major_interval() / kMajorIntervalFloor) / share;
+    return live > 0 && Heap::bytes_since_major() >= growth_needed;
+}
+
+// Whether a requested collection has to be a major rather than a minor. The
+// one answer safepoint_slow and idle_work both act on, so idle time cannot
+// run a minor the limit logic here refuses.
+//
+// Majors must keep coming -- minors never reclaim old-generation garbage --
+// but a fixed one-in-eight charges the same price whether the last one paid
+// for itself or not. A program whose old generation is nearly all live pays
+// a full mark of it to free what a minor frees anyway, so the interval backs
+// off when that is what happened and snaps back the moment a major earns its
+// keep. Backing off cannot strand the survivor pool: a minor prunes it now
+// (see run_minor_collection), so it no longer depends on a major arriving.
+// The interval backs off when majors come back empty-handed, which is right
+// until the heap starts growing on top of what the last major left live:
+// that growth is old-generation garbage no minor can reclaim, and no amount
+// of poor yield makes it collectable any other way. Ask for one once the
+// heap has added half of the live set again. Scaled by the same backoff the
+// interval uses. Growth on top of the last live set is the signal that
+// old-generation garbage is piling up, but it is only a guess -- and when
+// the majors it forces keep coming back empty, it is a wrong guess. The
+// interval is the collector's own measurement of exactly that, so the
+// threshold rides it: unproductive majors make this trigger progressively
+// harder to reach instead of firing on the same half-a-live-set forever.
+// None of that applies within a quarter of a heap limit
+// (Heap::near_heap_limit): a minor there only postpones the emergency major.
+bool major_called_for() {
+    return barriers_disabled() || major_growth_reached(1) || Heap::near_heap_limit() ||
+           ++requested_cycles() % major_interval() == 0;
+}
+
+// The safepoint's answer to Heap::heap_limit_reached: everything the heaps
+// can give back, and then the embedder. True when some heap is still over its
+// limit and its callback would not raise it.
+bool handle_heap_limit() {
+    static const bool log = env_flag("QUANTA_GC_LOG");
+    Heap::clear_heap_limit_reached();
+    if (!Heap::over_limit_heap()) return false;
+    // An open incremental cycle keeps whatever it marked before the mutator
+    // dropped it, so finishing it is not the most a major can free: a fresh
+    // one after it starts from today's roots.
+    if (Collector::major_in_progress_) run_major_slice(std::chrono::microseconds(-1));
+    run_major_slice(std::chrono::microseconds(-1));
+    // The footprint counts blocks, and a block only goes back once it is swept
+    // and found empty. A major leaves most of its sweeping to allocation and
+    // the background sweeper, so both are finished here and the candidates
+    // rebuilt, which is what hands the empty blocks back.
+    Heap::finish_background_sweep();
+    Heap::finish_lazy_sweep();
+    Heap::reset_dirty_blocks();
+    Heap::rebuild_allocation_candidates();
+    Heap::decommit_idle_memory();
+    while (Heap* heap = Heap::over_limit_heap()) {
+        const size_t limit = heap->heap_limit();
+        const bool raised = heap->raise_limit_for_footprint();
+        if (log) {
+            std::fprintf(stderr, "[gc] heap limit footprint=%zu limit=%zu %s%zu\n", heap->footprint(),
+                         limit, raised ? "raised to " : "kept at ", heap->heap_limit());
+        }
+        if (!raised) return true;
+    }
+    return false;
+}
+
 }
 
 void Collector::collect() {
@@ -1319,6 +1910,89 @@ void Collector::collect_minor() {
     }
 }
 
+void Collector::set_mark_threads(unsigned count) {
+    t_mark_threads = std::clamp(count, 1u, 64u);
+}
+
+bool Collector::idle_work(std::chrono::steady_clock::time_point deadline) {
+    // Whether idle time has swept something since it last gave memory back.
+    static thread_local bool trim_due = false;
+    // Never negative: run_major_slice reads that as "no deadline".
+    auto left = [&] {
+        auto us = std::chrono::duration_cast<std::chrono::microseconds>(deadline - std::chrono::steady_clock::now());
+        return std::max(us, std::chrono::microseconds(0));
+    };
+
+    // A request goes the way safepoint_slow would take it. Unrequested, a
+    // major starts at half the growth a safepoint waits for: far enough along
+    // that the cycle is worth its mark, early enough that it finishes here
+    // rather than in slices between the host's requests.
+    if (left().count() > 0 && !major_in_progress_) {
+        if (Heap::gc_requested()) {
+            if (major_called_for()) run_major_slice(left());
+            else run_minor_collection();
+        } else if (major_growth_reached(2) || Heap::near_heap_limit()) {
+            run_major_slice(left());
+        }
+    }
+    while (major_in_progress_ && left().count() > 0) run_major_slice(left());
+    if (major_in_progress_) return true;
+
+    if (left().count() > 0 && Heap::sweep_lazy_until(deadline) > 0) trim_due = true;
+    if (Heap::lazy_sweep_pending()) return true;
+    if (trim_due && left().count() > 0) {
+        Heap::decommit_idle_memory();
+        trim_due = false;
+    }
+    return trim_due || Heap::gc_requested();
+}
+
+
+// The same set scan_major_roots marks from, in the same order, with the
+// survivor pools added: they are not roots to the collector, which prunes
+// them by reachability, but until a major does they are what holds their
+// entries, and a snapshot that left them out would show those entries held
+// by nothing.
+void Collector::trace_roots(Visitor& v, const std::function<void(const char*)>& group) {
+    group("(Conservative stack roots)");
+    StackRootVisitor stack(v);
+    scan_stacks(stack);
+    group("(Contexts)");
+    for (Engine* engine : Engine::all_engines()) {
+        v.visit_context(engine->get_global_context());
+        if (ModuleLoader* loader = engine->get_module_loader()) {
+            for (const auto& kv : loader->modules()) {
+                if (Context* ctx = kv.second->get_context()) v.visit_context(ctx);
+            }
+        }
+    }
+    v.visit_context(Object::current_context_);
+    for (Engine* engine : Engine::all_engines())
+        for (ExecContextScope* s = engine->exec_top_scope(); s; s = s->prev())
+            v.visit_context(s->context());
+    group("(Handles)");
+    FiberRegistry::for_each([&](const FiberRegistry::Record& rec) {
+        if (rec.owner_cell) v.visit_object(rec.owner_cell);
+    });
+    for (Engine* engine : Engine::all_engines())
+        if (ModuleLoader* loader = engine->get_module_loader()) loader->gc_trace(v);
+    for (const std::vector<Value>* vec : value_vector_roots())
+        for (const Value& val : *vec) v.visit(val);
+    for (const FixedArray<Value>* arr : value_array_roots())
+        for (const Value& val : *arr) v.visit(val);
+    for (const BytecodeChunk* chunk : chunk_roots()) chunk->trace(v);
+    group("(Runtime)");
+    Symbol::gc_trace_roots(v);
+    String::gc_trace_roots(v);
+    trace_atomics_gc_roots(v);
+    FunctionExecutable::gc_trace_roots(v);
+    group("(Context survivor pool)");
+    for (Engine* engine : Engine::all_engines())
+        for (Context* ctx : engine->get_survivor_contexts()) v.visit_context(ctx);
+    group("(Environment survivor pool)");
+    for (Engine* engine : Engine::all_engines())
+        for (Environment* env : engine->get_survivor_environments()) v.visit_environment(env);
+}
 
 Collector::SliceResult Collector::mark_step(std::chrono::microseconds budget) {
     MarkVisitor& v = mark_visitor();
@@ -1388,6 +2062,51 @@ void Collector::write_barrier_value(const void* cell, const Value& value) {
     remembered_values().push_back(value);
 }
 
+void Collector::write_barrier_element(Object* obj, uint32_t index, const Value& value) {
+    if (barriers_disabled() || !obj) return;
+    if (!value.is_object() && !value.is_function() && !value.is_string() &&
+        !value.is_symbol() && !value.is_bigint()) {
+        return;
+    }
+    if (Collector::major_in_progress_) mark_visitor().visit(value);
+    Heap::ProbeResult p = Heap::exact_cell_base(obj);
+    if (!p.cell || !Heap::test_mark(p)) return;
+    // A large array takes a card instead of an edge: an array filled in place
+    // -- every slot of a buffer overwritten between two minors -- would grow
+    // remembered_values by one entry per store, where the card is one byte
+    // per 128 stores and the minor re-reads the run once.
+    if (CardTable* cards = obj->ensure_card_table()) {
+        cards->mark(index);
+        if (!cards->listed) {
+            cards->listed = true;
+            carded_objects().push_back(p);
+        }
+        return;
+    }
+    remembered_values().push_back(value);
+}
+
+void Collector::write_barrier_elements(Object* obj, uint32_t begin, uint32_t count) {
+    if (barriers_disabled() || !obj || !count) return;
+    // An open major has to see the run whatever it holds, and re-tracing the
+    // container is the only way to do that without reading it here.
+    if (Collector::major_in_progress_) {
+        write_barrier(obj);
+        return;
+    }
+    Heap::ProbeResult p = Heap::exact_cell_base(obj);
+    if (!p.cell || !Heap::test_mark(p)) return;
+    if (CardTable* cards = obj->ensure_card_table()) {
+        cards->mark_range(begin, count);
+        if (!cards->listed) {
+            cards->listed = true;
+            carded_objects().push_back(p);
+        }
+        return;
+    }
+    write_barrier(obj);
+}
+
 void Collector::write_barrier_env_for(Environment* env, const Value& value) {
     if (value.is_object() || value.is_function() || value.is_string() ||
         value.is_symbol() || value.is_bigint()) {
@@ -1438,7 +2157,15 @@ void Collector::release_env(Environment* env) {
     pending_env_frees().push_back(env);
 }
 
-void Collector::safepoint_slow() {
+bool Collector::safepoint_slow() {
+    // Ahead of every policy below, stress modes included: the limit is a
+    // promise to the embedder, not a pacing choice.
+    if (Heap::heap_limit_refused()) return true;
+    if (Heap::heap_limit_reached() && handle_heap_limit()) {
+        Heap::refuse_heap_limit();
+        return true;
+    }
+
     // QUANTA_GC_STRESS: "2" = minor at every safepoint (write-barrier soak,
     // full every 64th); any other truthy value = full at every safepoint.
     // Resolved into the shared field so safepoint()'s inline test can read
@@ -1448,7 +2175,6 @@ void Collector::safepoint_slow() {
         stress_mode_ = (!v || !*v || *v == '0') ? 0 : (*v == '2' ? 2 : 1);
     }
     const int stress = stress_mode_;
-    static thread_local uint32_t cycle_count = 0;
 
     // Stress modes always run a collection to completion in one call, same
     // as before incremental slicing existed -- including finishing off an
@@ -1458,15 +2184,15 @@ void Collector::safepoint_slow() {
     // mode into an accidental incremental soak that never keeps pace.
     if (stress == 1) {
         run_major_slice(std::chrono::microseconds(-1));
-        return;
+        return false;
     }
     if (stress == 2) {
-        if (Collector::major_in_progress_ || ++cycle_count % 64 == 0) {
+        if (Collector::major_in_progress_ || ++requested_cycles() % 64 == 0) {
             run_major_slice(std::chrono::microseconds(-1));
         } else {
             run_minor_collection();
         }
-        return;
+        return false;
     }
 
     // An open incremental major always continues before anything else is
@@ -1474,45 +2200,42 @@ void Collector::safepoint_slow() {
     // worklists/mark-bit state in the same window.
     if (Collector::major_in_progress_) {
         run_major_slice(next_slice_budget());
-        return;
+        return false;
     }
 
     if (Heap::gc_requested()) {
-        // Majors must keep coming -- minors never reclaim old-generation
-        // garbage -- but a fixed one-in-eight charges the same price whether
-        // the last one paid for itself or not. A program whose old generation
-        // is nearly all live pays a full mark of it to free what a minor
-        // frees anyway, so the interval backs off when that is what happened
-        // and snaps back the moment a major earns its keep. Backing off cannot
-        // strand the survivor pool: a minor prunes it now (see
-        // run_minor_collection), so it no longer depends on a major arriving.
-        // The interval above backs off when majors come back empty-handed,
-        // which is right until the heap starts growing on top of what the last
-        // major left live: that growth is old-generation garbage no minor can
-        // reclaim, and no amount of poor yield makes it collectable any other
-        // way. Ask for one once the heap has added half of the live set again.
-        // Scaled by the same backoff the interval uses. Growth on top of the
-        // last live set is the signal that old-generation garbage is piling
-        // up, but it is only a guess -- and when the majors it forces keep
-        // coming back empty, it is a wrong guess. The interval is the
-        // collector's own measurement of exactly that, so the threshold rides
-        // it: unproductive majors make this trigger progressively harder to
-        // reach instead of firing on the same half-a-live-set forever.
-        const size_t live = Heap::live_after_major();
-        const size_t growth_needed = (live / 2) * (major_interval() / kMajorIntervalFloor);
-        const bool grown_enough = live > 0 && Heap::bytes_since_major() >= growth_needed;
-        if (!barriers_disabled() && !grown_enough && ++cycle_count % major_interval() != 0) {
-            run_minor_collection();
-        } else {
-            run_major_slice(next_slice_budget());
-        }
+        if (major_called_for()) run_major_slice(next_slice_budget());
+        else run_minor_collection();
     }
+    return false;
+}
+
+void Collector::raise_heap_limit_error(Context& ctx) {
+    Heap::clear_heap_limit_refused();
+    ctx.throw_range_error("Maximum heap size exceeded");
 }
 
 const Collector::CycleStats& Collector::last_cycle() {
     return g_last_cycle;
 }
 
+Collector::Telemetry Collector::telemetry() {
+    Telemetry t;
+    const size_t n = g_telemetry.cycles.size();
+    t.cycles.reserve(n);
+    // Once the ring has wrapped, the oldest record is the one the next
+    // collection will overwrite.
+    const size_t oldest = n < kTelemetryCycles ? 0 : g_telemetry.cycles_recorded % kTelemetryCycles;
+    for (size_t i = 0; i < n; i++) t.cycles.push_back(g_telemetry.cycles[(oldest + i) % n]);
+    t.minor_pauses = pause_distribution(g_telemetry.minor_pauses);
+    t.major_slice_pauses = pause_distribution(g_telemetry.major_pauses);
+    t.minor_count = g_telemetry.minor_count;
+    t.major_count = g_telemetry.major_count;
+    t.total_pause_us = g_telemetry.total_pause_us;
+    t.max_pause_us = g_telemetry.max_pause_us;
+    return t;
+}
+
 void Collector::push_chunk(const BytecodeChunk* chunk) {
     chunk_roots().push_back(chunk);
 }
@@ -1537,6 +2260,28 @@ void Collector::pop_value_vector(const std::vector<Value>* vec) {
     }
 }
 
+void Collector::push_register_file(RegisterFile* file) {
+    register_files().push_back(file);
+}
+
+void Collector::pop_register_file(RegisterFile* file) {
+    auto& files = register_files();
+    if (!files.empty() && files.back() == file) { files.pop_back(); return; }
+    for (size_t i = files.size(); i-- > 0;) {
+        if (files[i] == file) { files.erase(files.begin() + static_cast<long>(i)); return; }
+    }
+}
+
+void Collector::forget_register_files(const void* stack_lo, const void* stack_hi) {
+    auto& files = register_files();
+    const auto* lo = static_cast<const char*>(stack_lo);
+    const auto* hi = static_cast<const char*>(stack_hi);
+    std::erase_if(files, [&](const RegisterFile* file) {
+        const auto* at = reinterpret_cast<const char*>(file);
+        return at >= lo && at < hi;
+    });
+}
+
 void Collector::push_value_array(const FixedArray<Value>* arr) {
     value_array_roots().push_back(arr);
 }
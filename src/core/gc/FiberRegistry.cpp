@@ -5,6 +5,7 @@
  */
 
 #include "quanta/core/gc/FiberRegistry.h"
+#include "quanta/core/gc/Collector.h"
 #include <vector>
 
 namespace Quanta {
@@ -35,6 +36,9 @@ void FiberRegistry::unregister_fiber(const void* owner) {
     auto& r = records();
     for (size_t i = 0; i < r.size(); i++) {
         if (r[i].owner == owner) {
+            // The stack goes back to the pool as it is. A fiber dropped while
+            // suspended never unwound, so its frames are still registered.
+            Collector::forget_register_files(r[i].stack_lo, r[i].stack_hi);
             r[i] = r.back();
             r.pop_back();
             return;
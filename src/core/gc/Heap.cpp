@@ -6,11 +6,15 @@
 
 #include "quanta/core/gc/Heap.h"
 #include "quanta/core/runtime/Value.h"
+#include <algorithm>
 #include <cassert>
 #include <cstdio>
 #include <atomic>
+#include <condition_variable>
 #include <cstring>
 #include <mutex>
+#include <random>
+#include <thread>
 #ifdef __GLIBC__
 #include <malloc.h>
 #endif
@@ -21,6 +25,8 @@ constinit thread_local Heap* Heap::active_ = nullptr;
 constinit thread_local bool Heap::gc_requested_ = false;
 constinit thread_local size_t Heap::bytes_since_major_ = 0;
 constinit thread_local size_t Heap::live_after_major_ = 0;
+constinit thread_local bool Heap::heap_limit_reached_ = false;
+constinit thread_local bool Heap::heap_limit_refused_ = false;
 
 Heap& Heap::active() {
     assert(active_ && "no active Heap -- Engine init must install a HeapScope "
@@ -38,6 +44,84 @@ std::vector<Heap*>& thread_heaps() {
     return heaps;
 }
 
+// Set only on a parallel-mark helper for the length of a phase: the heaps of
+// the mutator it is marking for, which is stopped until the phase ends and
+// so cannot add or drop one underneath it. See Heap::adopt_owner_view.
+constinit thread_local const std::vector<Heap*>* g_adopted_heaps = nullptr;
+
+const std::vector<Heap*>& visible_heaps() {
+    return g_adopted_heaps ? *g_adopted_heaps : thread_heaps();
+}
+
+struct BackgroundSweeper;
+// Null until this thread first sweeps in the background, so allocation's
+// check costs a load rather than a thread_local's construction guard.
+constinit thread_local BackgroundSweeper* g_sweeper = nullptr;
+
+// The owning thread's background sweeper -- see Heap::sweep_in_background.
+// Joined when that thread exits, which for the main thread is before static
+// destructors start deleting cells out of these same blocks.
+struct BackgroundSweeper {
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable work;
+    std::condition_variable idle;
+    std::vector<HeapBlock*> queued;
+    std::vector<HeapBlock*> finished;
+    // Handed over and not yet finished: queued plus the one being swept.
+    size_t outstanding = 0;
+    // Lets allocation's slow path ask "anything to take back?" without the lock.
+    std::atomic<bool> any_finished{false};
+    Heap::Finalizer finalize = nullptr;
+    bool stop = false;
+
+    ~BackgroundSweeper() {
+        if (!thread.joinable()) return;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        work.notify_one();
+        thread.join();
+        // Cells can still be freed explicitly after this (static destructors),
+        // and one in a block still flagged would come asking for a sweeper
+        // that is gone.
+        Heap::finish_background_sweep();
+        g_sweeper = nullptr;
+    }
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            work.wait(lock, [&] { return stop || !queued.empty(); });
+            // Stopping still drains what was handed over.
+            if (queued.empty()) return;
+            HeapBlock* b = queued.back();
+            queued.pop_back();
+            Heap::Finalizer fn = finalize;
+            lock.unlock();
+            b->sweep_dead_cells(fn);
+            lock.lock();
+            finished.push_back(b);
+            any_finished.store(true, std::memory_order_release);
+            if (--outstanding == 0) idle.notify_all();
+        }
+    }
+};
+
+BackgroundSweeper& background_sweeper() {
+    static thread_local BackgroundSweeper sweeper;
+    if (!g_sweeper) {
+        g_sweeper = &sweeper;
+        sweeper.thread = std::thread([s = &sweeper] { s->run(); });
+    }
+    return sweeper;
+}
+
+// The collector's answer to "how is a lazily swept cell finalized", handed
+// over with the blocks themselves -- see Heap::collect_dead_cells.
+constinit thread_local Heap::LazySweep g_lazy_sweep{};
+
 // QUANTA_HEAP_STATS=1: dump every heap (any thread) at process exit. Heaps
 // are immortal for now, so the raw pointers stay valid until the atexit
 // handler runs. This list is process-wide by design (a diagnostic dump,
@@ -59,9 +143,9 @@ void dump_all_heap_stats() {
     for (Heap* heap : all_heaps_for_stats()) {
         Heap::Stats s = heap->stats();
         std::fprintf(stderr,
-            "[heap %d] chunks=%zu blocks=%zu live_cells=%zu live_bytes=%zu large=%zu/%zuB\n",
+            "[heap %d] chunks=%zu blocks=%zu live_cells=%zu live_bytes=%zu large=%zu/%zuB unswept=%zu/%zuB decommitted=%zuB\n",
             i++, s.chunk_count, s.block_count, s.live_cells, s.live_bytes,
-            s.large_count, s.large_bytes);
+            s.large_count, s.large_bytes, s.unswept_blocks, s.unswept_bytes, s.decommitted_bytes);
         for (size_t k = 0; k < kNumCellKinds; k++) {
             if (s.live_cells_by_kind[k])
                 std::fprintf(stderr, "         %-6s %zu\n", kind_names[k], s.live_cells_by_kind[k]);
@@ -120,9 +204,30 @@ HeapBlock* Heap::fresh_block(CellKind kind, HeapSegment segment, size_t cls) {
     block->set_next(all_blocks_[k][cls]);
     all_blocks_[k][cls] = block;
     block_count_++;
+    check_heap_limit();
     return block;
 }
 
+void Heap::set_heap_limit(size_t bytes) {
+    heap_limit_ = bytes;
+    initial_heap_limit_ = bytes;
+}
+
+Heap* Heap::over_limit_heap() {
+    for (Heap* heap : thread_heaps()) {
+        if (heap->footprint() > heap->heap_limit_) return heap;
+    }
+    return nullptr;
+}
+
+bool Heap::raise_limit_for_footprint() {
+    if (!near_limit_callback_) return false;
+    const size_t wanted = near_limit_callback_(heap_limit_, initial_heap_limit_);
+    if (wanted <= heap_limit_) return false;
+    heap_limit_ = wanted;
+    return true;
+}
+
 namespace {
 // ~4MB of accounted bytes between collections; the interpreter safepoint
 // consumes the request (never collect mid-allocation). Shared between
@@ -169,18 +274,78 @@ void Heap::retune_budget(size_t live_bytes, size_t root_scan_bytes) {
     if (want < root_scan_bytes) want = root_scan_bytes;
     if (want < kGcBudgetFloor) want = kGcBudgetFloor;
     if (want > kGcBudgetCap) want = kGcBudgetCap;
+    // A heap closing in on its limit collects before the garbage can carry it
+    // over: the budget shrinks to half the room left, so the emergency path in
+    // the safepoint is for live data outgrowing the limit, not for floating
+    // garbage the ordinary pacing let through. The floor still holds.
+    if (Heap* heap = active_or_null(); heap && heap->heap_limit_ != SIZE_MAX) {
+        const size_t used = heap->footprint();
+        const size_t room = heap->heap_limit_ > used ? heap->heap_limit_ - used : 0;
+        if (want > room / 2) want = std::max(room / 2, kGcBudgetFloor);
+    }
     g_gc_budget = want;
 }
 
+bool Heap::near_heap_limit() {
+    for (Heap* heap : thread_heaps()) {
+        if (heap->heap_limit_ == SIZE_MAX) continue;
+        if (heap->footprint() >= heap->heap_limit_ - heap->heap_limit_ / 4) return true;
+    }
+    return false;
+}
+
 void Heap::note_bytes_since_major(size_t bytes) { bytes_since_major_ += bytes; }
 
 void Heap::note_extra_bytes(size_t bytes) {
     account_bytes(bytes);
 }
 
+namespace {
+// Bytes left before the next sampled allocation; SIZE_MAX while sampling is
+// off, so the check allocate() makes is the same compare either way and
+// never fires.
+constinit thread_local size_t g_bytes_until_sample = SIZE_MAX;
+constinit thread_local size_t g_sample_interval = 0;
+constinit thread_local Heap::SampleHook g_sample_hook = nullptr;
+constinit thread_local Heap::FreeHook g_sample_free_hook = nullptr;
+
+// Exponentially distributed, mean g_sample_interval, at least 1: the gap to
+// the next sampled byte. Only drawn when a sample is taken, so the generator
+// stays off the allocation path.
+size_t next_sample_distance() {
+    thread_local std::mt19937_64 rng(0x9e3779b97f4a7c15ULL);
+    std::exponential_distribution<double> gap(1.0 / static_cast<double>(g_sample_interval));
+    double d = gap(rng);
+    if (d < 1.0) return 1;
+    if (d >= static_cast<double>(SIZE_MAX / 2)) return SIZE_MAX / 2;
+    return static_cast<size_t>(d);
+}
+}
+
+void Heap::set_allocation_sampling(size_t mean_interval, SampleHook on_sample, FreeHook on_free) {
+    g_sample_interval = on_sample ? mean_interval : 0;
+    g_sample_hook = g_sample_interval ? on_sample : nullptr;
+    g_sample_free_hook = g_sample_interval ? on_free : nullptr;
+    g_bytes_until_sample = g_sample_interval ? next_sample_distance() : SIZE_MAX;
+}
+
+void Heap::sample_allocation(void* cell, size_t size, CellKind kind) {
+    // One sample however many sampling points the cell spans; the hook
+    // weighs it by its size to make up for that.
+    g_bytes_until_sample = next_sample_distance();
+    g_sample_hook(cell, size, kind);
+}
+
 void* Heap::allocate(size_t size, CellKind kind, HeapSegment segment) {
     if (size == 0) size = 1;
     account_bytes(size);
+    void* p = allocate_cell(size, kind, segment);
+    if (size >= g_bytes_until_sample) [[unlikely]] sample_allocation(p, size, kind);
+    else g_bytes_until_sample -= size;
+    return p;
+}
+
+void* Heap::allocate_cell(size_t size, CellKind kind, HeapSegment segment) {
     size_t cls = size_class_index(size);
     if (cls == kNumSizeClasses) return allocate_large(size, kind);
 
@@ -189,6 +354,9 @@ void* Heap::allocate(size_t size, CellKind kind, HeapSegment segment) {
     if (block) {
         if (void* p = block->try_allocate()) return p;
     }
+    // Blocks the background sweeper has finished with come back here, where
+    // they are wanted, rather than at the next collection.
+    if (g_sweeper && g_sweeper->any_finished.load(std::memory_order_acquire)) adopt_swept_blocks();
     auto& partial = partial_blocks_[k][cls];
     while (!partial.empty()) {
         block = partial.back();
@@ -199,6 +367,15 @@ void* Heap::allocate(size_t size, CellKind kind, HeapSegment segment) {
             return p;
         }
     }
+    // Out of swept candidates: sweep one the last collection left behind
+    // before growing the heap for want of space it already has.
+    if (HeapBlock* swept = sweep_for_allocation(k, cls)) {
+        active_block_[k][cls] = swept;
+        note_dirty(swept);
+        void* p = swept->try_allocate();
+        assert(p && "a swept block with free slots must satisfy a Tier-1 allocation");
+        return p;
+    }
     block = fresh_block(kind, segment, cls);
     active_block_[k][cls] = block;
     note_dirty(block);
@@ -231,6 +408,8 @@ void* Heap::allocate_large(size_t size, CellKind kind) {
     lc->remembered = false;
     if (large_cells_) large_cells_->prev = lc;
     large_cells_ = lc;
+    large_bytes_ += size;
+    check_heap_limit();
     return reinterpret_cast<char*>(lc) + kLargeHeaderSize;
 }
 
@@ -241,13 +420,17 @@ void Heap::free_large(void* p) {
     if (lc->prev) lc->prev->next = lc->next;
     else heap->large_cells_ = lc->next;
     if (lc->next) lc->next->prev = lc->prev;
+    heap->large_bytes_ -= lc->size;
     std::free(lc);
 }
 
 void Heap::cell_free(void* p) {
     if (!p) return;
+    if (g_sample_free_hook) [[unlikely]] g_sample_free_hook(p);
     if (BlockAllocator::owns_address(p)) {
-        HeapBlock::from_cell(p)->free_cell(p);
+        HeapBlock* block = HeapBlock::from_cell(p);
+        if (block->in_background_sweep()) finish_background_sweep();
+        block->free_cell(p);
     } else {
         free_large(p);
     }
@@ -281,7 +464,7 @@ bool owned_by_this_thread(const Heap* heap) {
     // heap this thread is running on, and asking that is a compare where the
     // list below is a walk.
     if (heap == Heap::active_or_null()) return true;
-    for (Heap* h : thread_heaps()) {
+    for (Heap* h : visible_heaps()) {
         if (h == heap) return true;
     }
     return false;
@@ -303,7 +486,7 @@ Heap::ProbeResult probe_pointer(void* p) {
         }
         return r;
     }
-    for (Heap* heap : thread_heaps()) {
+    for (Heap* heap : visible_heaps()) {
         for (auto* lc = heap->large_cells_head(); lc; lc = lc->next) {
             char* payload = reinterpret_cast<char*>(lc) + Heap::kLargeHeaderSize;
             if (p >= payload && p < payload + lc->size) {
@@ -330,6 +513,11 @@ Heap::ProbeResult Heap::exact_cell(const void* p) {
     return probe_pointer(const_cast<void*>(p));
 }
 
+size_t Heap::cell_size(const void* cell) {
+    if (BlockAllocator::owns_address(cell)) return HeapBlock::from_cell(cell)->cell_size();
+    return reinterpret_cast<const LargeCell*>(static_cast<const char*>(cell) - kLargeHeaderSize)->size;
+}
+
 std::atomic<bool>& Heap::any_large_cell() { return g_any_large_cell; }
 
 Heap::ProbeResult Heap::exact_cell_base_foreign(const void* p) {
@@ -369,6 +557,33 @@ Heap::ProbeResult Heap::mark_exact(const void* p, CellKind kind) {
     return large;
 }
 
+Heap::ProbeResult Heap::mark_exact_atomic(const void* p, CellKind kind) {
+    ProbeResult r;
+    if (!p) return r;
+    if (!g_any_large_cell.load(std::memory_order_relaxed) || BlockAllocator::owns_address(p)) {
+        HeapBlock* block = HeapBlock::from_cell(p);
+        if (!owned_by_this_thread(block->heap())) return r;
+        if (!block->mark_if_unmarked_atomic(p)) return r;
+        r.cell = const_cast<void*>(p);
+        r.kind = kind;
+        return r;
+    }
+    ProbeResult large = probe_pointer(const_cast<void*>(p));
+    if (!large.cell) return r;
+    auto* lc = reinterpret_cast<LargeCell*>(static_cast<char*>(large.cell) - kLargeHeaderSize);
+    if (__atomic_exchange_n(&lc->marked, true, __ATOMIC_RELAXED)) return r;
+    return large;
+}
+
+Heap::OwnerView Heap::owner_view() {
+    return OwnerView{active_, &thread_heaps()};
+}
+
+void Heap::adopt_owner_view(const OwnerView& view) {
+    active_ = view.active;
+    g_adopted_heaps = view.heaps;
+}
+
 bool Heap::large_cell_marked(const void* cell) {
     auto* lc = reinterpret_cast<LargeCell*>(const_cast<char*>(static_cast<const char*>(cell)) - kLargeHeaderSize);
     return lc->marked;
@@ -405,6 +620,18 @@ void Heap::clear_remembered(const ProbeResult& p) {
     HeapBlock::from_cell(p.cell)->clear_remembered(p.cell);
 }
 
+namespace {
+// Cells never move. Compacting a fragmented heap would mean evacuating the
+// survivors of sparse blocks and forwarding every reference to them, and a
+// trace edge here is a pointer handed over by value (Visitor::visit_object),
+// with caches, shape links and address-keyed tables holding further raw
+// pointers that no trace reports at all. Nothing could be forwarded, so the
+// heap defragments without moving anything instead: allocation is steered
+// away from sparse blocks until they die off, and free regions go back to the
+// OS one at a time rather than a whole chunk at a time.
+constexpr size_t kSparseBlockDivisor = 4;
+}
+
 size_t Heap::rebuild_allocation_candidates() {
     // Only the active heap's, matching what the pacing used to ask stats()
     // for -- stats() is a member, and the collector called it on that heap.
@@ -419,6 +646,22 @@ size_t Heap::rebuild_allocation_candidates() {
                 HeapBlock* b = heap->all_blocks_[k][c];
                 while (b) {
                     HeapBlock* next = b->next();
+                    if (b->in_background_sweep()) {
+                        // The sweeper's until it hands it back; counted below.
+                        prev = b;
+                        b = next;
+                        continue;
+                    }
+                    if (b->awaiting_lazy_sweep()) {
+                        // Allocation's once it is swept, and not before; only
+                        // what the mark kept counts as live.
+                        if (heap == counted) {
+                            live_bytes += static_cast<size_t>(b->marked_count()) * b->cell_size();
+                        }
+                        prev = b;
+                        b = next;
+                        continue;
+                    }
                     if (b != heap->active_block_[k][c] && b->is_empty()) {
                         // Fully-dead block: unlink and return its raw 16KB region to
                         // the allocator's pool, so a future block of ANY (kind, size
@@ -440,10 +683,15 @@ size_t Heap::rebuild_allocation_candidates() {
                     }
                     b = next;
                 }
+                // Allocation pops from the back; see the declaration.
+                std::partition(partial.begin(), partial.end(), [](const HeapBlock* b) {
+                    return static_cast<size_t>(b->live_count()) * kSparseBlockDivisor < b->capacity();
+                });
             }
         }
         if (heap == counted) {
             for (LargeCell* lc = heap->large_cells_; lc; lc = lc->next) live_bytes += lc->size;
+            live_bytes += heap->background_live_bytes_;
         }
     }
     return live_bytes;
@@ -451,7 +699,7 @@ size_t Heap::rebuild_allocation_candidates() {
 
 void Heap::decommit_idle_memory() {
     for (Heap* heap : thread_heaps()) {
-        heap->block_allocator_.decommit_idle_chunks();
+        heap->block_allocator_.decommit_idle_regions();
     }
     // GC-managed cells are only part of the footprint: property storage
     // (shape_slots_/sparse_overflow_/descriptors_), array elements_, and rope/string
@@ -483,7 +731,12 @@ void Heap::for_each_cell(const std::function<void(void*, CellKind, bool)>& fn) {
             for (size_t c = 0; c < kNumSizeClasses; c++) {
                 for (HeapBlock* b = heap->all_blocks_[k][c]; b; b = b->next()) {
                     CellKind kind = b->cell_kind();
-                    b->for_each_cell([&](void* cell, bool marked) { fn(cell, kind, marked); });
+                    // An unmarked cell in a lazy block is dead, only not yet swept.
+                    const bool lazy = b->awaiting_lazy_sweep();
+                    b->for_each_cell([&](void* cell, bool marked) {
+                        if (lazy && !marked) return;
+                        fn(cell, kind, marked);
+                    });
                 }
             }
         }
@@ -493,11 +746,49 @@ void Heap::for_each_cell(const std::function<void(void*, CellKind, bool)>& fn) {
     }
 }
 
-void Heap::collect_dead_cells(std::vector<DeadCell>& out, bool minor_only) {
+namespace {
+constinit thread_local size_t g_last_dead_bytes = 0;
+}
+
+size_t Heap::last_dead_bytes() { return g_last_dead_bytes; }
+
+size_t Heap::collect_dead_cells(std::vector<DeadCell>& out, bool minor_only,
+                                std::vector<HeapBlock*>* background, const LazySweep* lazy) {
+    size_t deferred = 0;
+    size_t dead_bytes = 0;
+    if (lazy) g_lazy_sweep = *lazy;
     for (Heap* heap : thread_heaps()) {
-        auto sweep_block = [&out](HeapBlock* b) {
+        auto sweep_block = [&](HeapBlock* b) {
+            assert(!b->awaiting_lazy_sweep() && "a lazy block must be swept before the next sweep");
             const CellKind kind = b->cell_kind();
+            const size_t k = static_cast<size_t>(kind);
+            const size_t c = size_class_index(b->cell_size());
+            // Allocation is pointed at the active block and takes the next
+            // cell from it, which would be indistinguishable from a dead one.
+            if (b != heap->active_block_[k][c]) {
+                if (background && kind != CellKind::Object) {
+                    if (uint32_t dead = b->dead_count()) {
+                        b->set_sweep_state(HeapBlock::SweepState::Background);
+                        background->push_back(b);
+                        heap->background_live_bytes_ += static_cast<size_t>(b->marked_count()) * b->cell_size();
+                        deferred += dead;
+                        dead_bytes += static_cast<size_t>(dead) * b->cell_size();
+                    }
+                    return;
+                }
+                if (lazy) {
+                    if (uint32_t dead = b->dead_count()) {
+                        b->set_sweep_state(HeapBlock::SweepState::Lazy);
+                        heap->lazy_blocks_[k][c].push_back(b);
+                        deferred += dead;
+                        dead_bytes += static_cast<size_t>(dead) * b->cell_size();
+                    }
+                    return;
+                }
+            }
+            const size_t listed = out.size();
             b->for_each_dead_cell([&](void* cell) { out.push_back({cell, kind}); });
+            dead_bytes += (out.size() - listed) * b->cell_size();
         };
         if (minor_only) {
             for (HeapBlock* b : heap->dirty_blocks_) sweep_block(b);
@@ -513,9 +804,162 @@ void Heap::collect_dead_cells(std::vector<DeadCell>& out, bool minor_only) {
         for (LargeCell* lc = heap->large_cells_; lc; lc = lc->next) {
             if (!lc->marked) {
                 out.push_back({reinterpret_cast<char*>(lc) + kLargeHeaderSize, lc->kind});
+                dead_bytes += lc->size;
             }
         }
     }
+    g_last_dead_bytes = dead_bytes;
+    return deferred;
+}
+
+void Heap::sweep_in_background(std::vector<HeapBlock*>& blocks, Finalizer finalize) {
+    if (blocks.empty()) return;
+    BackgroundSweeper& sweeper = background_sweeper();
+    {
+        std::lock_guard<std::mutex> lock(sweeper.mutex);
+        sweeper.finalize = finalize;
+        sweeper.queued.insert(sweeper.queued.end(), blocks.begin(), blocks.end());
+        sweeper.outstanding += blocks.size();
+    }
+    blocks.clear();
+    sweeper.work.notify_one();
+}
+
+void Heap::finish_background_sweep() {
+    if (!g_sweeper) return;
+    {
+        std::unique_lock<std::mutex> lock(g_sweeper->mutex);
+        g_sweeper->idle.wait(lock, [] { return g_sweeper->outstanding == 0; });
+    }
+    adopt_swept_blocks();
+}
+
+void Heap::adopt_swept_blocks() {
+    std::vector<HeapBlock*> done;
+    {
+        std::lock_guard<std::mutex> lock(g_sweeper->mutex);
+        done.swap(g_sweeper->finished);
+        g_sweeper->any_finished.store(false, std::memory_order_relaxed);
+    }
+    for (HeapBlock* b : done) adopt_swept_block(b);
+}
+
+void Heap::adopt_swept_block(HeapBlock* b) {
+    b->set_sweep_state(HeapBlock::SweepState::Swept);
+    Heap* heap = b->heap();
+    heap->background_live_bytes_ -= static_cast<size_t>(b->live_count()) * b->cell_size();
+    // An emptied block is as good a candidate as any; the next rebuild hands
+    // it back to the allocator if it is still empty by then.
+    if (!b->is_full()) {
+        heap->partial_blocks_[static_cast<size_t>(b->cell_kind())][size_class_index(b->cell_size())]
+            .push_back(b);
+    }
+}
+
+void Heap::sweep_lazy_block(HeapBlock* b) {
+    b->sweep_dead_cells(g_lazy_sweep.finalize);
+    b->set_sweep_state(HeapBlock::SweepState::Swept);
+}
+
+HeapBlock* Heap::sweep_for_allocation(size_t k, size_t cls) {
+    auto& pending = lazy_blocks_[k][cls];
+    while (!pending.empty()) {
+        HeapBlock* b = pending.back();
+        pending.pop_back();
+        // Asked of the whole block before any of it is swept: a block swept
+        // in part would have its remaining dead cells look just like the
+        // unmarked ones allocation is about to put next to them.
+        const CellKind kind = b->cell_kind();
+        bool anywhere = true;
+        b->for_each_dead_cell([&](void* cell) {
+            if (anywhere && !g_lazy_sweep.finalizes_anywhere(cell, kind)) anywhere = false;
+        });
+        if (!anywhere) {
+            refused_blocks_.push_back(b);
+            continue;
+        }
+        sweep_lazy_block(b);
+        if (!b->is_full()) return b;
+    }
+    return nullptr;
+}
+
+void Heap::finish_lazy_sweep() {
+    for (Heap* heap : thread_heaps()) {
+        for (size_t k = 0; k < kNumCellKinds; k++) {
+            for (size_t c = 0; c < kNumSizeClasses; c++) {
+                auto& pending = heap->lazy_blocks_[k][c];
+                for (HeapBlock* b : pending) {
+                    sweep_lazy_block(b);
+                    if (!b->is_full()) heap->partial_blocks_[k][c].push_back(b);
+                }
+                pending.clear();
+            }
+        }
+    }
+    sweep_refused_blocks();
+}
+
+size_t Heap::sweep_lazy_until(std::chrono::steady_clock::time_point deadline) {
+    size_t swept = 0;
+    for (Heap* heap : thread_heaps()) {
+        // The refused blocks first, as finish_lazy_sweep does last: still
+        // one block per deadline check, so a long refused list cannot run
+        // the idle period over on its own.
+        auto& refused = heap->refused_blocks_;
+        while (!refused.empty()) {
+            if (std::chrono::steady_clock::now() >= deadline) return swept;
+            HeapBlock* b = refused.back();
+            refused.pop_back();
+            sweep_lazy_block(b);
+            if (!b->is_full()) {
+                heap->partial_blocks_[static_cast<size_t>(b->cell_kind())][size_class_index(b->cell_size())]
+                    .push_back(b);
+            }
+            swept++;
+        }
+        for (size_t k = 0; k < kNumCellKinds; k++) {
+            for (size_t c = 0; c < kNumSizeClasses; c++) {
+                auto& pending = heap->lazy_blocks_[k][c];
+                while (!pending.empty()) {
+                    if (std::chrono::steady_clock::now() >= deadline) return swept;
+                    HeapBlock* b = pending.back();
+                    pending.pop_back();
+                    sweep_lazy_block(b);
+                    if (!b->is_full()) heap->partial_blocks_[k][c].push_back(b);
+                    swept++;
+                }
+            }
+        }
+    }
+    return swept;
+}
+
+bool Heap::lazy_sweep_pending() {
+    for (Heap* heap : thread_heaps()) {
+        if (!heap->refused_blocks_.empty()) return true;
+        for (size_t k = 0; k < kNumCellKinds; k++) {
+            for (size_t c = 0; c < kNumSizeClasses; c++) {
+                if (!heap->lazy_blocks_[k][c].empty()) return true;
+            }
+        }
+    }
+    return false;
+}
+
+void Heap::sweep_refused_blocks() {
+    for (Heap* heap : thread_heaps()) {
+        for (HeapBlock* b : heap->refused_blocks_) {
+            sweep_lazy_block(b);
+            // As with adopt_swept_block: an emptied block waits for the next
+            // rebuild to decide whether the allocator gets it back.
+            if (!b->is_full()) {
+                heap->partial_blocks_[static_cast<size_t>(b->cell_kind())][size_class_index(b->cell_size())]
+                    .push_back(b);
+            }
+        }
+        heap->refused_blocks_.clear();
+    }
 }
 
 void Heap::reset_dirty_blocks() {
@@ -533,15 +977,23 @@ void Heap::reset_dirty_blocks() {
 }
 
 Heap::Stats Heap::stats() const {
+    finish_background_sweep();
     Stats s;
     s.chunk_count = block_allocator_.chunk_count();
+    s.decommitted_bytes = block_allocator_.decommitted_count() * HeapBlock::kBlockSize;
     s.block_count = block_count_;
     for (size_t k = 0; k < kNumCellKinds; k++) {
         for (size_t c = 0; c < kNumSizeClasses; c++) {
             for (HeapBlock* b = all_blocks_[k][c]; b; b = b->next()) {
-                s.live_cells += b->live_count();
-                s.live_bytes += static_cast<size_t>(b->live_count()) * b->cell_size();
-                s.live_cells_by_kind[k] += b->live_count();
+                uint32_t live = b->live_count();
+                if (b->awaiting_lazy_sweep()) {
+                    live = b->marked_count();
+                    s.unswept_blocks++;
+                    s.unswept_bytes += static_cast<size_t>(b->live_count() - live) * b->cell_size();
+                }
+                s.live_cells += live;
+                s.live_bytes += static_cast<size_t>(live) * b->cell_size();
+                s.live_cells_by_kind[k] += live;
             }
         }
     }
@@ -20,7 +20,8 @@ HeapBlock* HeapBlock::init(void* region, Heap* heap, CellKind kind,
     Header& h = block->h_;
     h.heap        = heap;
     h.next        = nullptr;
-    h.free_list   = nullptr;
+    h.run_cursor  = 0;
+    h.run_end     = 0;
     h.cell_size   = cell_size;
     h.capacity    = static_cast<uint32_t>(kPayloadSize / cell_size);
     h.bump_cursor = 0;
@@ -31,27 +32,41 @@ HeapBlock* HeapBlock::init(void* region, Heap* heap, CellKind kind,
     h.segment     = segment;
     // A recycled region arrives with whatever the last block left here.
     h.in_dirty_list = false;
+    h.sweep_state = SweepState::Swept;
     std::memset(h.alloc_bitmap, 0, sizeof(h.alloc_bitmap));
     std::memset(h.mark_bitmap, 0, sizeof(h.mark_bitmap));
     std::memset(h.remembered_bitmap, 0, sizeof(h.remembered_bitmap));
     return block;
 }
 
-void* HeapBlock::try_allocate() {
-    void* p;
-    if (h_.free_list) {
-        p = h_.free_list;
-        h_.free_list = h_.free_list->next;
-        h_.free_count--;
-    } else if (h_.bump_cursor < h_.capacity) {
-        p = payload_start() + static_cast<size_t>(h_.bump_cursor) * h_.cell_size;
-        h_.bump_cursor++;
-    } else {
-        return nullptr;
+bool HeapBlock::next_run() {
+    const uint32_t cap = h_.capacity;
+    uint32_t i = h_.run_end;
+    while (i < cap) {
+        uint32_t w = i / 64;
+        uint64_t taken = h_.alloc_bitmap[w] | h_.remembered_bitmap[w];
+        const uint64_t free = ~taken & (~static_cast<uint64_t>(0) << (i % 64));
+        if (!free) {
+            i = (w + 1) * 64;
+            continue;
+        }
+        const uint32_t start = w * 64 + static_cast<uint32_t>(__builtin_ctzll(free));
+        if (start >= cap) break;
+        // The run ends at the next taken slot, which may be words away in a
+        // block whose tail has never been handed out.
+        taken &= ~static_cast<uint64_t>(0) << (start % 64);
+        while (!taken) {
+            if (++w * 64 >= cap) break;
+            taken = h_.alloc_bitmap[w] | h_.remembered_bitmap[w];
+        }
+        uint32_t end = taken ? w * 64 + static_cast<uint32_t>(__builtin_ctzll(taken)) : cap;
+        if (end > cap) end = cap;
+        h_.run_cursor = start;
+        h_.run_end = end;
+        return true;
     }
-    size_t idx = slot_index(p);
-    h_.alloc_bitmap[idx / 64] |= (1ULL << (idx % 64));
-    return p;
+    h_.run_cursor = h_.run_end = cap;
+    return false;
 }
 
 void HeapBlock::free_cell(void* p) {
@@ -64,10 +79,20 @@ void HeapBlock::free_cell(void* p) {
     // inherit the dead cell's old-generation status.
     h_.mark_bitmap[idx / 64] &= ~bit;
     h_.remembered_bitmap[idx / 64] &= ~bit;
-    auto* cell = static_cast<FreeCell*>(p);
-    cell->next = h_.free_list;
-    h_.free_list = cell;
     h_.free_count++;
+    // The slot may lie behind the run; the next allocation finds it by
+    // reading the bitmaps from the top again. A sweep frees many cells in a
+    // row, and rewinding is two stores however many it frees.
+    h_.run_cursor = h_.run_end = 0;
+}
+
+void HeapBlock::sweep_dead_cells(void (*finalize)(void* cell, CellKind kind)) {
+    // for_each_dead_cell reads each bitmap word once, before visiting it, so
+    // free_cell clearing that word's bits underneath it is safe.
+    for_each_dead_cell([&](void* cell) {
+        finalize(cell, h_.cell_kind);
+        free_cell(cell);
+    });
 }
 
 void HeapBlock::retire_cell(void* p) {
@@ -76,7 +101,11 @@ void HeapBlock::retire_cell(void* p) {
     uint64_t bit = 1ULL << (idx % 64);
     h_.alloc_bitmap[idx / 64] &= ~bit;
     h_.mark_bitmap[idx / 64] &= ~bit;
-    h_.remembered_bitmap[idx / 64] &= ~bit;
+    // Allocation takes a slot whose alloc and remembered bits are both clear,
+    // so the remembered bit is what keeps this one from being handed out
+    // again: nothing asks a slot outside the alloc bitmap whether it is
+    // remembered, and the barrier only sets it for a cell it was given.
+    h_.remembered_bitmap[idx / 64] |= bit;
     h_.free_count++;
 }
 
@@ -91,6 +120,11 @@ void* HeapBlock::cell_containing(const void* p) {
     size_t idx = slot_index(p);
     if (idx == SIZE_MAX) return nullptr;
     if (!((h_.alloc_bitmap[idx / 64] >> (idx % 64)) & 1)) return nullptr;
+    // A dead cell waiting on its lazy sweep is still allocated, but it is not
+    // a cell any more: what it points at may already have been swept and the
+    // slot handed to something else, so a stale stack word must not revive it.
+    if (h_.sweep_state == SweepState::Lazy && !((h_.mark_bitmap[idx / 64] >> (idx % 64)) & 1))
+        return nullptr;
     return payload_start() + idx * h_.cell_size;
 }
 
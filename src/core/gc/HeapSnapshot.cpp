@@ -0,0 +1,654 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "quanta/core/gc/HeapSnapshot.h"
+#include "quanta/core/gc/Collector.h"
+#include "quanta/core/gc/Heap.h"
+#include "quanta/core/gc/Visitor.h"
+#include "quanta/core/engine/Context.h"
+#include "quanta/core/runtime/MapSet.h"
+#include "quanta/core/runtime/String.h"
+#include "quanta/core/runtime/Symbol.h"
+#include <algorithm>
+#include <charconv>
+#include <string_view>
+#include <unordered_map>
+
+namespace Quanta {
+
+namespace {
+
+// The order of both lists is the file format's: a node's or an edge's type
+// is written as its index into the list the header declares.
+enum NodeType : uint8_t {
+    kHiddenNode, kArrayNode, kStringNode, kObjectNode, kCodeNode, kClosureNode, kRegExpNode,
+    kNumberNode, kNativeNode, kSyntheticNode, kConsStringNode, kSlicedStringNode, kSymbolNode,
+    kBigIntNode
+};
+constexpr const char* kNodeTypeNames[] = {
+    "hidden", "array", "string", "object", "code", "closure", "regexp", "number", "native",
+    "synthetic", "concatenated string", "sliced string", "symbol", "bigint"
+};
+
+enum EdgeType : uint8_t {
+    kContextEdge, kElementEdge, kPropertyEdge, kInternalEdge, kHiddenEdge, kShortcutEdge, kWeakEdge
+};
+constexpr const char* kEdgeTypeNames[] = {
+    "context", "element", "property", "internal", "hidden", "shortcut", "weak"
+};
+
+constexpr size_t kNodeFieldCount = 7;
+constexpr uint32_t kNoNode = UINT32_MAX;
+// A string cell is named by its contents, and a heap can hold a few very
+// long ones; the name only has to let a reader recognise it.
+constexpr size_t kMaxStringName = 1024;
+
+// What a node stands for, which decides how it is expanded.
+enum class Holder : uint8_t { Synthetic, Cell, Context, Environment };
+
+class Graph {
+public:
+    struct NodeRec {
+        const void* ptr;
+        size_t self_size;
+        uint32_t name;
+        NodeType type;
+        Holder holder;
+        CellKind kind;
+    };
+
+    std::vector<NodeRec> nodes;
+    std::vector<uint32_t> edge_from;
+    std::vector<uint32_t> edge_to;
+    std::vector<uint32_t> edge_name;
+    std::vector<uint8_t> edge_type;
+    std::vector<std::string> strings;
+
+    Graph() { intern(""); }
+
+    uint32_t intern(std::string_view s) {
+        auto it = string_ids_.find(std::string(s));
+        if (it != string_ids_.end()) return it->second;
+        const uint32_t id = static_cast<uint32_t>(strings.size());
+        strings.emplace_back(s);
+        string_ids_.emplace(strings.back(), id);
+        return id;
+    }
+
+    uint32_t add_synthetic(const char* name) {
+        nodes.push_back({nullptr, 0, intern(name), kSyntheticNode, Holder::Synthetic, CellKind::Object});
+        return static_cast<uint32_t>(nodes.size() - 1);
+    }
+
+    void add_edge(uint32_t from, EdgeType type, uint32_t name_or_index, uint32_t to) {
+        if (to == kNoNode) return;
+        edge_from.push_back(from);
+        edge_to.push_back(to);
+        edge_name.push_back(name_or_index);
+        edge_type.push_back(type);
+    }
+
+    bool has_node(const void* p) const { return index_.count(p) != 0; }
+
+    // The node for a cell, created on first sight; kNoNode for a pointer that
+    // does not name a cell of this thread's heaps.
+    uint32_t cell_node(const void* p) {
+        if (!p) return kNoNode;
+        Heap::ProbeResult r = Heap::exact_cell(p);
+        if (!r.cell) return kNoNode;
+        auto it = index_.find(r.cell);
+        if (it != index_.end()) return it->second;
+        NodeRec rec{r.cell, Heap::cell_size(r.cell), 0, kObjectNode, Holder::Cell, r.kind};
+        describe_cell(rec);
+        return add(rec);
+    }
+
+    uint32_t value_node(const Value& v) {
+        if (v.is_object()) return cell_node(v.as_object());
+        if (v.is_function()) return cell_node(static_cast<Object*>(v.as_function()));
+        if (v.is_string()) return cell_node(v.as_string());
+        if (v.is_symbol()) return cell_node(v.as_symbol());
+        if (v.is_bigint()) return cell_node(v.as_bigint());
+        return kNoNode;
+    }
+
+    uint32_t context_node(const Context* ctx) {
+        if (!ctx) return kNoNode;
+        auto it = index_.find(ctx);
+        if (it != index_.end()) return it->second;
+        return add({ctx, sizeof(Context), intern("system / Context"), kObjectNode,
+                    Holder::Context, CellKind::Object});
+    }
+
+    uint32_t environment_node(const Environment* env) {
+        if (!env) return kNoNode;
+        auto it = index_.find(env);
+        if (it != index_.end()) return it->second;
+        return add({env, env->footprint_bytes(), intern("system / Environment"), kObjectNode,
+                    Holder::Environment, CellKind::Object});
+    }
+
+private:
+    uint32_t add(const NodeRec& rec) {
+        const uint32_t id = static_cast<uint32_t>(nodes.size());
+        nodes.push_back(rec);
+        index_.emplace(rec.ptr, id);
+        return id;
+    }
+
+    void describe_cell(NodeRec& rec) {
+        switch (rec.kind) {
+            case CellKind::Object: {
+                const Object* o = static_cast<const Object*>(rec.ptr);
+                rec.self_size += o->gc_out_of_line_bytes();
+                describe_object(o, rec);
+                break;
+            }
+            case CellKind::String: {
+                const String* s = static_cast<const String*>(rec.ptr);
+                if (!s->is_flat()) {
+                    // Flattening to get a name would allocate, and would
+                    // change the very heap being written down.
+                    rec.type = kConsStringNode;
+                    rec.name = intern("(concatenated string)");
+                    break;
+                }
+                rec.type = kStringNode;
+                const std::string& bytes = s->str();
+                static const size_t inline_capacity = std::string().capacity();
+                if (bytes.capacity() > inline_capacity) rec.self_size += bytes.capacity() + 1;
+                rec.name = intern(truncated(bytes));
+                break;
+            }
+            case CellKind::Symbol: {
+                const Symbol* s = static_cast<const Symbol*>(rec.ptr);
+                rec.type = kSymbolNode;
+                rec.name = intern("Symbol(" + truncated(s->get_description()) + ")");
+                break;
+            }
+            case CellKind::BigInt:
+            case CellKind::kCount:
+                rec.type = kBigIntNode;
+                rec.name = intern("bigint");
+                break;
+        }
+    }
+
+    void describe_object(const Object* o, NodeRec& rec) {
+        using T = Object::ObjectType;
+        switch (o->get_type()) {
+            case T::Function: {
+                rec.type = kClosureNode;
+                const std::string& name = static_cast<const Function*>(o)->get_name();
+                rec.name = intern(name.empty() ? "(anonymous)" : name);
+                return;
+            }
+            case T::RegExp: rec.type = kRegExpNode; rec.name = intern("RegExp"); return;
+            case T::Custom: rec.name = intern(custom_name(static_cast<const CustomObjectBase*>(o))); return;
+            case T::Ordinary: rec.name = constructor_name(o, "Object"); return;
+            case T::Error: rec.name = constructor_name(o, "Error"); return;
+            case T::TypedArray: rec.name = constructor_name(o, "TypedArray"); return;
+            case T::Array: rec.name = intern("Array"); return;
+            case T::Arguments: rec.name = intern("Arguments"); return;
+            case T::String: rec.name = intern("String"); return;
+            case T::Number: rec.name = intern("Number"); return;
+            case T::Boolean: rec.name = intern("Boolean"); return;
+            case T::Date: rec.name = intern("Date"); return;
+            case T::Promise: rec.name = intern("Promise"); return;
+            case T::Proxy: rec.name = intern("Proxy"); return;
+            case T::Map: rec.name = intern("Map"); return;
+            case T::Set: rec.name = intern("Set"); return;
+            case T::WeakMap: rec.name = intern("WeakMap"); return;
+            case T::WeakSet: rec.name = intern("WeakSet"); return;
+            case T::WeakRef: rec.name = intern("WeakRef"); return;
+            case T::FinalizationRegistry: rec.name = intern("FinalizationRegistry"); return;
+            case T::ArrayBuffer: rec.name = intern("ArrayBuffer"); return;
+            case T::DataView: rec.name = intern("DataView"); return;
+            case T::Symbol: rec.name = intern("Symbol"); return;
+            case T::BigInt: rec.name = intern("BigInt"); return;
+        }
+        rec.name = intern("Object");
+    }
+
+    static const char* custom_name(const CustomObjectBase* o) {
+        using K = CustomObjectBase::CustomKind;
+        switch (o->get_custom_kind()) {
+            case K::Generator: return "Generator";
+            case K::AsyncGenerator: return "AsyncGenerator";
+            case K::AsyncIterator: return "AsyncIterator";
+            case K::ArrayIterator: return "Array Iterator";
+            case K::StringIterator: return "String Iterator";
+            case K::MapIterator: return "Map Iterator";
+            case K::SetIterator: return "Set Iterator";
+            case K::ModuleNamespace: return "Module";
+            case K::DeferredNamespace: return "Deferred Module";
+        }
+        return "Object";
+    }
+
+    // What DevTools calls an object's class: the name of the function its
+    // prototype's own "constructor" data property holds. Asked once per
+    // prototype. A proxy or an exotic prototype could run script to answer,
+    // and an accessor would, so those fall back to the type's own name.
+    uint32_t constructor_name(const Object* o, const char* fallback) {
+        const Object* proto = o->get_prototype();
+        if (!proto) return intern(fallback);
+        auto it = constructor_names_.find(proto);
+        if (it != constructor_names_.end()) return it->second;
+        uint32_t name = intern(fallback);
+        const Object::ObjectType pt = proto->get_type();
+        if (pt != Object::ObjectType::Proxy && pt != Object::ObjectType::Custom) {
+            PropertyDescriptor desc = proto->get_property_descriptor("constructor");
+            if (desc.is_data_descriptor() && desc.get_value().is_function()) {
+                const std::string& ctor = desc.get_value().as_function()->get_name();
+                if (!ctor.empty()) name = intern(ctor);
+            }
+        }
+        constructor_names_.emplace(proto, name);
+        return name;
+    }
+
+    static std::string truncated(const std::string& s) {
+        if (s.size() <= kMaxStringName) return s;
+        size_t end = kMaxStringName;
+        // Not in the middle of a UTF-8 sequence.
+        while (end > 0 && (static_cast<unsigned char>(s[end]) & 0xC0) == 0x80) end--;
+        return s.substr(0, end) + "...";
+    }
+
+    std::unordered_map<const void*, uint32_t> index_;
+    std::unordered_map<std::string, uint32_t> string_ids_;
+    std::unordered_map<const Object*, uint32_t> constructor_names_;
+};
+
+// Records the edges one node's trace reports. Element edges are numbered in
+// the order the trace reports them -- trace() says where an edge goes, not
+// what it is called.
+class EdgeVisitor final : public Visitor {
+public:
+    explicit EdgeVisitor(Graph& g) : g_(g) {}
+
+    void begin(uint32_t from, uint32_t ordinal = 0) {
+        from_ = from;
+        ordinal_ = ordinal;
+    }
+    uint32_t ordinal() const { return ordinal_; }
+
+    void visit_object(Object* o) override { element(g_.cell_node(o)); }
+    void visit_string(String* s) override { element(g_.cell_node(s)); }
+    void visit_symbol(Symbol* s) override { element(g_.cell_node(s)); }
+    void visit_bigint(BigInt* b) override { element(g_.cell_node(b)); }
+    void visit_context(Context* ctx) override { element(g_.context_node(ctx)); }
+    void visit_environment(Environment* env) override { element(g_.environment_node(env)); }
+
+    // The weak halves are weak edges, which is what keeps them out of every
+    // retained size; a WeakMap's values are held by the map.
+    void visit_weak_map(WeakMap* w) override {
+        if (!w) return;
+        for (auto& e : w->raw_entries()) {
+            weak("key", g_.cell_node(e.first));
+            element(g_.value_node(e.second));
+        }
+        if (auto* sm = w->raw_symbol_entries()) {
+            for (auto& e : *sm) {
+                weak("key", g_.cell_node(e.first));
+                element(g_.value_node(e.second));
+            }
+        }
+    }
+    void visit_weak_set(WeakSet* w) override {
+        if (!w) return;
+        for (Object* o : w->raw_values()) weak("value", g_.cell_node(o));
+        if (auto* ss = w->raw_symbol_values())
+            for (Symbol* s : *ss) weak("value", g_.cell_node(s));
+    }
+    void visit_weak_ref(WeakRef* w) override {
+        if (!w) return;
+        weak("target", g_.cell_node(w->target_object()));
+        weak("target", g_.cell_node(w->target_symbol()));
+    }
+    void visit_finalization_registry(FinalizationRegistry* r) override {
+        if (!r) return;
+        for (const auto& cell : r->raw_cells()) {
+            weak("target", g_.cell_node(cell.target_object));
+            weak("target", g_.cell_node(cell.target_symbol));
+            weak("token", g_.cell_node(cell.token_object));
+            weak("token", g_.cell_node(cell.token_symbol));
+        }
+    }
+
+    void element(uint32_t to) {
+        if (to == kNoNode) return;
+        g_.add_edge(from_, kElementEdge, ordinal_++, to);
+    }
+
+private:
+    void weak(const char* name, uint32_t to) {
+        if (to != kNoNode) g_.add_edge(from_, kWeakEdge, g_.intern(name), to);
+    }
+
+    Graph& g_;
+    uint32_t from_ = 0;
+    uint32_t ordinal_ = 0;
+};
+
+void expand(Graph& g, EdgeVisitor& v, uint32_t n) {
+    const Graph::NodeRec rec = g.nodes[n];
+    v.begin(n);
+    switch (rec.holder) {
+        case Holder::Synthetic:
+            break;
+        case Holder::Cell:
+            if (rec.kind == CellKind::Object) {
+                static_cast<Object*>(const_cast<void*>(rec.ptr))->trace(v);
+            } else if (rec.kind == CellKind::String) {
+                static_cast<const String*>(rec.ptr)->gc_trace(v);
+            }
+            break;
+        case Holder::Context:
+            static_cast<const Context*>(rec.ptr)->gc_trace(v);
+            break;
+        case Holder::Environment: {
+            // Environment::gc_trace's edges, with the bindings named.
+            const Environment* env = static_cast<const Environment*>(rec.ptr);
+            env->for_each_binding([&](const std::string& name, const Value& value) {
+                const uint32_t to = g.value_node(value);
+                if (to != kNoNode) g.add_edge(n, kContextEdge, g.intern(name), to);
+            });
+            g.add_edge(n, kInternalEdge, g.intern("binding_object"), g.cell_node(env->get_binding_object()));
+            g.add_edge(n, kInternalEdge, g.intern("outer"), g.environment_node(env->get_outer()));
+            break;
+        }
+    }
+}
+
+// Node n's edges are edges[first[n] .. first[n + 1]) of `order`, which lists
+// edge indices grouped by source. Edges are recorded as nodes are expanded,
+// but a root group's edges, and the root's own, arrive out of that order.
+struct Adjacency {
+    std::vector<uint32_t> first;
+    std::vector<uint32_t> order;
+};
+
+Adjacency group_by_source(const Graph& g) {
+    const size_t n = g.nodes.size();
+    Adjacency a;
+    a.first.assign(n + 1, 0);
+    for (uint32_t from : g.edge_from) a.first[from + 1]++;
+    for (size_t i = 0; i < n; i++) a.first[i + 1] += a.first[i];
+    a.order.resize(g.edge_from.size());
+    std::vector<uint32_t> next(a.first.begin(), a.first.end() - 1);
+    for (uint32_t e = 0; e < g.edge_from.size(); e++) a.order[next[g.edge_from[e]]++] = e;
+    return a;
+}
+
+// Retained sizes from the dominator tree over the strong edges, rooted at
+// node 0: Cooper, Harvey and Kennedy's iteration over reverse postorder,
+// which is what DevTools runs on the same graph. A node the strong edges do
+// not reach retains only itself.
+std::vector<size_t> retained_sizes(const Graph& g, const Adjacency& adj) {
+    const size_t n = g.nodes.size();
+    std::vector<size_t> retained(n);
+    for (size_t i = 0; i < n; i++) retained[i] = g.nodes[i].self_size;
+    if (n == 0) return retained;
+
+    std::vector<uint32_t> post_of(n, kNoNode);
+    std::vector<uint32_t> postorder;
+    postorder.reserve(n);
+    {
+        std::vector<uint8_t> seen(n, 0);
+        std::vector<std::pair<uint32_t, uint32_t>> stack;
+        stack.push_back({0, adj.first[0]});
+        seen[0] = 1;
+        while (!stack.empty()) {
+            auto& top = stack.back();
+            if (top.second < adj.first[top.first + 1]) {
+                const uint32_t e = adj.order[top.second++];
+                if (g.edge_type[e] == kWeakEdge) continue;
+                const uint32_t to = g.edge_to[e];
+                if (seen[to]) continue;
+                seen[to] = 1;
+                stack.push_back({to, adj.first[to]});
+                continue;
+            }
+            post_of[top.first] = static_cast<uint32_t>(postorder.size());
+            postorder.push_back(top.first);
+            stack.pop_back();
+        }
+    }
+
+    const size_t reached = postorder.size();
+    std::vector<uint32_t> pred_first(reached + 1, 0);
+    for (uint32_t e = 0; e < g.edge_from.size(); e++) {
+        if (g.edge_type[e] == kWeakEdge) continue;
+        const uint32_t from = post_of[g.edge_from[e]], to = post_of[g.edge_to[e]];
+        if (from != kNoNode && to != kNoNode) pred_first[to + 1]++;
+    }
+    for (size_t i = 0; i < reached; i++) pred_first[i + 1] += pred_first[i];
+    std::vector<uint32_t> preds(pred_first[reached]);
+    {
+        std::vector<uint32_t> next(pred_first.begin(), pred_first.end() - 1);
+        for (uint32_t e = 0; e < g.edge_from.size(); e++) {
+            if (g.edge_type[e] == kWeakEdge) continue;
+            const uint32_t from = post_of[g.edge_from[e]], to = post_of[g.edge_to[e]];
+            if (from != kNoNode && to != kNoNode) preds[next[to]++] = from;
+        }
+    }
+
+    const uint32_t root = static_cast<uint32_t>(reached - 1);
+    std::vector<uint32_t> dom(reached, kNoNode);
+    dom[root] = root;
+    auto intersect = [&](uint32_t a, uint32_t b) {
+        while (a != b) {
+            while (a < b) a = dom[a];
+            while (b < a) b = dom[b];
+        }
+        return a;
+    };
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (uint32_t p = root; p-- > 0;) {
+            uint32_t idom = kNoNode;
+            for (uint32_t i = pred_first[p]; i < pred_first[p + 1]; i++) {
+                const uint32_t q = preds[i];
+                if (dom[q] == kNoNode) continue;
+                idom = idom == kNoNode ? q : intersect(q, idom);
+            }
+            if (idom != dom[p]) {
+                dom[p] = idom;
+                changed = true;
+            }
+        }
+    }
+
+    // Postorder puts every node before its dominator.
+    for (uint32_t p = 0; p < root; p++) retained[postorder[dom[p]]] += retained[postorder[p]];
+    size_t total = 0;
+    for (const Graph::NodeRec& rec : g.nodes) total += rec.self_size;
+    retained[0] = total;
+    return retained;
+}
+
+// Buffered so that a snapshot of millions of nodes is not millions of
+// stream calls, and bounded so that it is never more than a buffer's worth
+// of the file.
+class JsonWriter {
+public:
+    explicit JsonWriter(std::ostream& out) : out_(out) { buf_.reserve(kFlushAt + 256); }
+    ~JsonWriter() { flush(); }
+
+    void raw(std::string_view s) {
+        buf_.append(s);
+        if (buf_.size() >= kFlushAt) flush();
+    }
+    void number(uint64_t v) {
+        char tmp[24];
+        auto r = std::to_chars(tmp, tmp + sizeof(tmp), v);
+        raw(std::string_view(tmp, static_cast<size_t>(r.ptr - tmp)));
+    }
+    void string(std::string_view s) {
+        buf_.push_back('"');
+        for (char c : s) {
+            const unsigned char u = static_cast<unsigned char>(c);
+            if (c == '"' || c == '\\') {
+                buf_.push_back('\\');
+                buf_.push_back(c);
+            } else if (u < 0x20) {
+                static const char kHex[] = "0123456789abcdef";
+                buf_.append("\\u00");
+                buf_.push_back(kHex[u >> 4]);
+                buf_.push_back(kHex[u & 0xF]);
+            } else {
+                buf_.push_back(c);
+            }
+        }
+        buf_.push_back('"');
+        if (buf_.size() >= kFlushAt) flush();
+    }
+    void flush() {
+        out_.write(buf_.data(), static_cast<std::streamsize>(buf_.size()));
+        buf_.clear();
+    }
+
+private:
+    static constexpr size_t kFlushAt = 64 * 1024;
+    std::ostream& out_;
+    std::string buf_;
+};
+
+uint64_t node_id(const Graph::NodeRec& rec, uint32_t index) {
+    // Addresses, so that the same object keeps its id from one snapshot to
+    // the next and DevTools' comparison view can match it up: nothing here
+    // ever moves. Odd, as V8's are; synthetic nodes take the small odd
+    // numbers, below any address.
+    if (!rec.ptr) return 2 * static_cast<uint64_t>(index) + 1;
+    return (reinterpret_cast<uintptr_t>(rec.ptr) >> 3) | 1;
+}
+
+void write_list(JsonWriter& w, const char* const* names, size_t count) {
+    w.raw("[");
+    for (size_t i = 0; i < count; i++) {
+        if (i) w.raw(",");
+        w.string(names[i]);
+    }
+    w.raw("]");
+}
+
+}
+
+bool HeapSnapshot::write(std::ostream& out, Summary* summary, size_t top_retainers) {
+    // Only live cells: finish any major already under way, whose marks may
+    // be stale, then run one from scratch and finish every sweep it leaves.
+    if (Collector::major_in_progress()) Collector::collect();
+    Collector::collect();
+    Heap::finish_background_sweep();
+    Heap::finish_lazy_sweep();
+
+    Graph g;
+    EdgeVisitor v(g);
+    const uint32_t root = g.add_synthetic("(GC roots)");
+    uint32_t groups = 0;
+    uint32_t stack_group = kNoNode;
+    uint32_t stack_edges = 0;
+    Collector::trace_roots(v, [&](const char* name) {
+        const uint32_t group = g.add_synthetic(name);
+        // The first group is the stack's; see below.
+        if (stack_group == kNoNode) stack_group = group;
+        else if (groups == 1) stack_edges = v.ordinal();
+        g.add_edge(root, kElementEdge, groups++, group);
+        v.begin(group);
+    });
+    uint32_t next = 0;
+    for (; next < g.nodes.size(); next++) expand(g, v, next);
+
+    // Cells the collection kept from a stack word the scan above no longer
+    // sees -- a frame that has since returned. Live all the same, and held
+    // by the conservative scan, so they hang from its group.
+    std::vector<const void*> unreached;
+    Heap::for_each_cell([&](void* cell, CellKind, bool) {
+        if (!g.has_node(cell)) unreached.push_back(cell);
+    });
+    for (const void* cell : unreached) {
+        if (g.has_node(cell)) continue;
+        v.begin(stack_group, stack_edges);
+        v.element(g.cell_node(cell));
+        stack_edges = v.ordinal();
+        for (; next < g.nodes.size(); next++) expand(g, v, next);
+    }
+
+    const Adjacency adj = group_by_source(g);
+
+    JsonWriter w(out);
+    w.raw("{\"snapshot\":{\"meta\":{\"node_fields\":"
+          "[\"type\",\"name\",\"id\",\"self_size\",\"edge_count\",\"trace_node_id\",\"detachedness\"],"
+          "\"node_types\":[");
+    write_list(w, kNodeTypeNames, std::size(kNodeTypeNames));
+    w.raw(",\"string\",\"number\",\"number\",\"number\",\"number\",\"number\"],"
+          "\"edge_fields\":[\"type\",\"name_or_index\",\"to_node\"],\"edge_types\":[");
+    write_list(w, kEdgeTypeNames, std::size(kEdgeTypeNames));
+    w.raw(",\"string_or_number\",\"node\"],"
+          "\"trace_function_info_fields\":[\"function_id\",\"name\",\"script_name\",\"script_id\",\"line\",\"column\"],"
+          "\"trace_node_fields\":[\"id\",\"function_info_index\",\"count\",\"size\",\"children\"],"
+          "\"sample_fields\":[\"timestamp_us\",\"last_assigned_id\"],"
+          "\"location_fields\":[\"object_index\",\"script_id\",\"line\",\"column\"]},"
+          "\"node_count\":");
+    w.number(g.nodes.size());
+    w.raw(",\"edge_count\":");
+    w.number(g.edge_from.size());
+    w.raw(",\"trace_function_count\":0},\n\"nodes\":[");
+    for (uint32_t n = 0; n < g.nodes.size(); n++) {
+        const Graph::NodeRec& rec = g.nodes[n];
+        if (n) w.raw(",\n");
+        w.number(rec.type);
+        w.raw(",");
+        w.number(rec.name);
+        w.raw(",");
+        w.number(node_id(rec, n));
+        w.raw(",");
+        w.number(rec.self_size);
+        w.raw(",");
+        w.number(adj.first[n + 1] - adj.first[n]);
+        w.raw(",0,0");
+    }
+    w.raw("],\n\"edges\":[");
+    for (size_t i = 0; i < adj.order.size(); i++) {
+        const uint32_t e = adj.order[i];
+        if (i) w.raw(",\n");
+        w.number(g.edge_type[e]);
+        w.raw(",");
+        w.number(g.edge_name[e]);
+        w.raw(",");
+        w.number(static_cast<uint64_t>(g.edge_to[e]) * kNodeFieldCount);
+    }
+    w.raw("],\n\"trace_function_infos\":[],\"trace_tree\":[],\"samples\":[],\"locations\":[],\n\"strings\":[");
+    for (size_t i = 0; i < g.strings.size(); i++) {
+        if (i) w.raw(",\n");
+        w.string(g.strings[i]);
+    }
+    w.raw("]}\n");
+    w.flush();
+
+    if (summary) {
+        const std::vector<size_t> retained = retained_sizes(g, adj);
+        summary->node_count = g.nodes.size();
+        summary->edge_count = g.edge_from.size();
+        summary->total_bytes = retained.empty() ? 0 : retained[0];
+        std::vector<uint32_t> ranked;
+        for (uint32_t n = 0; n < g.nodes.size(); n++)
+            if (g.nodes[n].holder != Holder::Synthetic) ranked.push_back(n);
+        const size_t keep = std::min(top_retainers, ranked.size());
+        std::partial_sort(ranked.begin(), ranked.begin() + static_cast<std::ptrdiff_t>(keep), ranked.end(),
+                          [&](uint32_t a, uint32_t b) { return retained[a] > retained[b]; });
+        summary->top_retainers.clear();
+        for (size_t i = 0; i < keep; i++) {
+            const uint32_t n = ranked[i];
+            summary->top_retainers.push_back({g.strings[g.nodes[n].name], g.nodes[n].self_size, retained[n]});
+        }
+    }
+    return static_cast<bool>(out);
+}
+
+}
@@ -10,6 +10,8 @@
 #include "quanta/core/gc/Visitor.h"
 #include "quanta/parser/Parser.h"
 #include "quanta/parser/AST.h"
+#include "quanta/parser/ScriptUnit.h"
+#include "quanta/core/vm/CodeCache.h"
 #include "quanta/lexer/Lexer.h"
 #include "quanta/core/runtime/Object.h"
 #include "quanta/core/runtime/Error.h"
@@ -275,7 +277,13 @@ bool ModuleLoader::execute_module_file(Module* module, const std::string& filena
         parse_opts.source_type_module = true;
         parse_opts.strict_mode = true;
         Parser parser{token_sequence, parse_opts};
-        auto ast = parser.parse_program();
+        parser.set_source(source);
+        // Parsed into a unit, like a script, so the module's function literals
+        // lend their bodies instead of copying them and have a token to be
+        // found by in the code cache.
+        auto unit = parser.parse_program_unit();
+        unit->set_module_goal(true);
+        auto* ast = static_cast<Program*>(unit->root());
         if (!ast || parser.has_errors()) {
             const auto& errs = parser.get_errors();
             std::string msg = errs.empty() ? "Failed to parse module" : errs[0].message;
@@ -289,7 +297,9 @@ bool ModuleLoader::execute_module_file(Module* module, const std::string& filena
         module->set_context(std::move(module_context));
         module->get_context()->set_current_filename(filename);
 
+        VM::code_cache_open(*unit, VM::CodeCacheKind::Module);
         ast->evaluate(*module->get_context());
+        VM::code_cache_flush(*unit);
 
         if (module->get_context()->has_exception()) {
             module->set_thrown_exception(module->get_context()->get_exception());
@@ -28,7 +28,7 @@ Error::Error(Type type, const std::string& message)
 
 Error::Error(Type type, const std::string& message, const std::string& filename, int line, int column)
     : Object(Object::ObjectType::Error), error_type_(type), message_(message),
-      line_number_(line), column_number_(column), filename_(Shape::intern(filename)) {
+      line_number_(line), column_number_(column), filename_(Shape::intern_pinned(filename)) {
     generate_stack_trace();
     initialize_properties();
 }
@@ -60,7 +60,7 @@ void Error::initialize_properties() {
 }
 
 void Error::set_location(const std::string& filename, int line, int column) {
-    filename_ = Shape::intern(filename);
+    filename_ = Shape::intern_pinned(filename);
     line_number_ = line;
     column_number_ = column;
     initialize_properties();
@@ -12,6 +12,7 @@
 #include "quanta/core/engine/Engine.h"
 #include "quanta/core/engine/CallStack.h"
 #include "quanta/core/vm/BytecodeCompiler.h"
+#include "quanta/core/vm/CodeCache.h"
 #include "quanta/core/vm/Interpreter.h"
 #include "quanta/core/runtime/Async.h"
 #include "quanta/core/runtime/Generator.h"
@@ -259,6 +260,26 @@ Function::Function(const std::string& name,
     // "name"/"length" are lazy -- see the class-header comment.
 }
 
+// Leaked for the same reason as BytecodeChunk's list of chunks.
+std::unordered_set<Function::InstanceFeedback*>& Function::thread_instance_feedback() {
+    static thread_local auto* feedback = new std::unordered_set<InstanceFeedback*>();
+    return *feedback;
+}
+
+Function::InstanceFeedback::InstanceFeedback() {
+    thread_instance_feedback().insert(this);
+}
+
+Function::InstanceFeedback::~InstanceFeedback() {
+    thread_instance_feedback().erase(this);
+}
+
+void Function::drop_dead_shapes() {
+    for (InstanceFeedback* feedback : thread_instance_feedback()) {
+        for (BytecodeChunk::LookupCacheEntry& e : feedback->lookup_cache) BytecodeChunk::drop_dead_shape(e);
+    }
+}
+
 Function::~Function() {
     if (!instance_data_) return;
     if (is_native_) delete static_cast<NativeFunctionData*>(instance_data_);
@@ -443,11 +464,110 @@ Value Function::call(Context& ctx, const std::vector<Value>& args, Value this_va
     }
 }
 
+// A deferred body whose chunk an earlier run left in the code cache gets it
+// on its first call, before the gate below is resolved: the register-mode
+// path needs only the chunk, so the body is never rebuilt at all. The one
+// check the compile in call_tree_walker makes first is made here too -- a
+// `with` in the captured chain keeps a body off the VM, and that is a fact
+// about this closure, not about the source the entry was written for.
+static void attach_cached_chunk(Function* fn, Context& ctx, const FunctionExecutable* exe) {
+    Environment* env = fn->get_closure_environment();
+    if (!env && fn->get_closure_context()) env = fn->get_closure_context()->get_lexical_environment();
+    if (!env) env = ctx.get_lexical_environment();
+    for (Environment* e = env; e; e = e->get_outer()) {
+        if (e->is_with_environment()) return;
+    }
+    std::unique_ptr<BytecodeChunk> chunk = VM::code_cache_take(*exe);
+    if (!chunk) return;
+    exe->bytecode_chunk = std::move(chunk);
+    exe->recompute_fast_gate();
+    // Same barrier the compile path takes, for the same reason: the chunk's
+    // constants are new cells reachable only through an executable this
+    // Function may already have carried into an old generation.
+    Collector::write_barrier(fn);
+}
+
 Value Function::call_default(Context& ctx, const std::vector<Value>& args, Value this_value) {
     if (is_native_) return call_native_rooted(ctx, args, this_value);
     return call_default_impl(ctx, args, this_value, &args);
 }
 
+// The register-mode frame itself, once call_default_impl or call_monomorphic
+// has decided this call qualifies (see the gate at its call site).
+Value Function::run_register_frame(Context& ctx, std::span<const Value> args, Value this_value) {
+    // The context is heap-allocated and survivor-managed like the full
+    // path: native code (promise reactions, job queues) can capture the
+    // active context and run after this call returns, so a stack context
+    // would dangle. It is taken from the call pool rather than built,
+    // since consecutive calls differ in only the fields reset_for_call
+    // writes. The saving beyond that is everything else: no per-call
+    // Environment, no binding inserts, `this` as a run() param.
+    Engine* fast_engine = ctx.get_engine();
+    Context& fast_ctx = *CallContextPool::acquire(fast_engine, &ctx);
+    struct PoolRelease {
+        Context* c; Engine* e;
+        ~PoolRelease() { CallContextPool::release(c, e); }
+    } fast_release{&fast_ctx, fast_engine};
+    Environment* outer_env = get_closure_environment();
+    if (!outer_env && closure_context_) outer_env = closure_context_->get_lexical_environment();
+    if (!outer_env) outer_env = ctx.get_lexical_environment();
+    // The chain can outlive this call for the same reason the context can.
+    if (outer_env) outer_env->mark_escaped();
+    fast_ctx.set_lexical_environment(outer_env);
+    fast_ctx.set_variable_environment(outer_env);
+    fast_ctx.set_arrow_function_context(is_arrow_);
+    if (is_strict_ || executable_->fast_strict) fast_ctx.set_strict_mode(true);
+
+    Value fast_this = this_value;
+    // Skipped entirely when the body cannot observe `this`: Op::LdaThis is
+    // the only reader, and a native called from here is handed its own
+    // receiver rather than reading one off this context.
+    if (executable_->fast_uses_this) {
+        if (is_arrow_) {
+            // Own, not inherited: ArrowFunctionExpression::evaluate stamps
+            // these markers on the arrow itself, so asking has_property here
+            // only bought a walk up to Function.prototype and Object.prototype
+            // on every call.
+            if (has_arrow_this_) fast_this = arrow_this_;
+        } else if (!fast_ctx.is_strict_mode()) {
+            if (this_value.is_undefined() || this_value.is_null()) {
+                Object* global = fast_ctx.get_global_object();
+                if (global) fast_this = Value(global);
+            } else if (!this_value.is_object() && !this_value.is_function()) {
+                // box_primitive_this_sloppy's own first check is exactly this --
+                // skip the cross-TU call for the common already-object `this`
+                // (every ordinary method call), not just primitives.
+                fast_this = ObjectFactory::box_primitive_this_sloppy(fast_ctx, this_value);
+            }
+        }
+        if (fast_this.is_object() || fast_this.is_function()) {
+            fast_ctx.set_this_binding(fast_this.is_object() ? fast_this.as_object()
+                                                            : fast_this.as_function());
+        }
+    }
+
+    ExecContextScope gc_frame(&fast_ctx);
+    Context* prev_context = Object::current_context_;
+    Object::current_context_ = &fast_ctx;
+    // The chunk with its hot leaf calls inlined, once it has one (see
+    // Inliner.h). A spent baseline budget is what makes a chunk warm; the
+    // build is tried once, and leaves an empty record when nothing qualified.
+    const BytecodeChunk* chunk = executable_->bytecode_chunk.get();
+    if (chunk->inlined) {
+        if (chunk->inlined->variant) chunk = chunk->inlined->variant.get();
+    } else if (chunk->baseline_budget == 0 && VM::inlining_enabled()) {
+        VM::inline_compile(*chunk, this);
+        if (chunk->inlined->variant) chunk = chunk->inlined->variant.get();
+    }
+    Value vm_result = VM::run(*chunk, fast_ctx, args, &fast_this, this);
+    Object::current_context_ = prev_context;
+    if (fast_ctx.has_exception()) {
+        ctx.throw_exception(fast_ctx.get_exception(), true);
+        return Value();
+    }
+    return vm_result;
+}
+
 Value Function::call_default_impl(Context& ctx, std::span<const Value> args, Value this_value,
                                   const std::vector<Value>* args_vec) {
     // A vector's storage is malloc'd and invisible to the stack scan, so it
@@ -502,6 +622,10 @@ Value Function::call_default_impl(Context& ctx, std::span<const Value> args, Val
     // A set fast_gate already means all three resolved, so a warm call skips
     // the block outright instead of re-asking three questions it settled on
     // its first trip through.
+    if (g_vm_enabled && executable_ && !executable_->bytecode_chunk &&
+        executable_->body_is_deferred() && !executable_->vm_incompatible) {
+        attach_cached_chunk(this, ctx, executable_.get());
+    }
     if (executable_ && !executable_->fast_gate && executable_->bytecode_chunk) {
         if (executable_->strict_directive_state < 0) {
             // A concise arrow body is an expression, which cannot carry a
@@ -540,67 +664,7 @@ Value Function::call_default_impl(Context& ctx, std::span<const Value> args, Val
     bool ctor_ok = !is_class_constructor_ || !is_derived_ctor();
     if (g_vm_enabled && executable_ && executable_->fast_gate && ctor_ok &&
         !(is_arrow_ && closure_context_ && closure_context_->this_needs_super())) {
-        // The context is heap-allocated and survivor-managed like the full
-        // path: native code (promise reactions, job queues) can capture the
-        // active context and run after this call returns, so a stack context
-        // would dangle. It is taken from the call pool rather than built,
-        // since consecutive calls differ in only the fields reset_for_call
-        // writes. The saving beyond that is everything else: no per-call
-        // Environment, no binding inserts, `this` as a run() param.
-        Engine* fast_engine = ctx.get_engine();
-        Context& fast_ctx = *CallContextPool::acquire(fast_engine, &ctx);
-        struct PoolRelease {
-            Context* c; Engine* e;
-            ~PoolRelease() { CallContextPool::release(c, e); }
-        } fast_release{&fast_ctx, fast_engine};
-        Environment* outer_env = get_closure_environment();
-        if (!outer_env && closure_context_) outer_env = closure_context_->get_lexical_environment();
-        if (!outer_env) outer_env = ctx.get_lexical_environment();
-        // The chain can outlive this call for the same reason the context can.
-        if (outer_env) outer_env->mark_escaped();
-        fast_ctx.set_lexical_environment(outer_env);
-        fast_ctx.set_variable_environment(outer_env);
-        fast_ctx.set_arrow_function_context(is_arrow_);
-        if (is_strict_ || executable_->fast_strict) fast_ctx.set_strict_mode(true);
-
-        Value fast_this = this_value;
-        // Skipped entirely when the body cannot observe `this`: Op::LdaThis is
-        // the only reader, and a native called from here is handed its own
-        // receiver rather than reading one off this context.
-        if (executable_->fast_uses_this) {
-            if (is_arrow_) {
-                // Own, not inherited: ArrowFunctionExpression::evaluate stamps
-                // these markers on the arrow itself, so asking has_property here
-                // only bought a walk up to Function.prototype and Object.prototype
-                // on every call.
-                if (has_arrow_this_) fast_this = arrow_this_;
-            } else if (!fast_ctx.is_strict_mode()) {
-                if (this_value.is_undefined() || this_value.is_null()) {
-                    Object* global = fast_ctx.get_global_object();
-                    if (global) fast_this = Value(global);
-                } else if (!this_value.is_object() && !this_value.is_function()) {
-                    // box_primitive_this_sloppy's own first check is exactly this --
-                    // skip the cross-TU call for the common already-object `this`
-                    // (every ordinary method call), not just primitives.
-                    fast_this = ObjectFactory::box_primitive_this_sloppy(fast_ctx, this_value);
-                }
-            }
-            if (fast_this.is_object() || fast_this.is_function()) {
-                fast_ctx.set_this_binding(fast_this.is_object() ? fast_this.as_object()
-                                                                : fast_this.as_function());
-            }
-        }
-
-        ExecContextScope gc_frame(&fast_ctx);
-        Context* prev_context = Object::current_context_;
-        Object::current_context_ = &fast_ctx;
-        Value vm_result = VM::run(*executable_->bytecode_chunk, fast_ctx, args, &fast_this, this);
-        Object::current_context_ = prev_context;
-        if (fast_ctx.has_exception()) {
-            ctx.throw_exception(fast_ctx.get_exception(), true);
-            return Value();
-        }
-        return vm_result;
+        return run_register_frame(ctx, args, this_value);
     }
 
     // Environment-mode functions take the general path today only because the
@@ -785,6 +849,32 @@ Value Function::call_native_rooted(Context& ctx, const std::vector<Value>& args_
     return result;
 }
 
+// call_default_impl's register-mode gate, less the parts a call site that has
+// pinned this function's executable already knows: it is compiled, not
+// native, and of the plain kind. fast_gate is still asked -- the executable
+// can lose it -- and so is the arrow's super check, which is per closure.
+bool Function::register_call_ready() const {
+    return g_vm_enabled && executable_ && executable_->fast_gate && !is_class_constructor_ &&
+           !(is_arrow_ && closure_context_ && closure_context_->this_needs_super());
+}
+
+// The monomorphic call site's entry (see CallFeedback). What is left of
+// call_default_impl's prologue once the gate has been answered is what
+// call_native keeps too: the two recursion guards, a frame, and the
+// pending-construct flag.
+Value Function::call_monomorphic(Context& ctx, std::span<const Value> args, Value this_value) {
+    if (!register_call_ready()) return call_register_args(ctx, args, this_value);
+    ctx.consume_pending_construct_call();
+    CallStack& stack = CallStack::instance();
+    if (stack.depth() >= CallStack::MAX_STACK_DEPTH) return throw_call_stack_exceeded(ctx);
+    if (const char* floor = current_stack_floor()) {
+        const char probe = 0;
+        if (&probe < floor) return throw_call_stack_exceeded(ctx);
+    }
+    CheckedDepthFrameGuard frame_guard(stack, &ctx.get_current_filename(), this);
+    return run_register_frame(ctx, args, this_value);
+}
+
 // A register-mode call never reaches this, so it is not part of that call's
 // function. Safe to split because it reads nothing the caller's prologue
 // produced: the frame guard and the argument root stay live there across it.
@@ -1929,7 +2019,7 @@ std::unique_ptr<Function> create_js_function(const std::string& name,
 
 std::unique_ptr<Function> create_native_function(const std::string& name,
                                                  std::function<Value(Context&, std::span<const Value>, Value)> fn) {
-    auto func = std::make_unique<Function>(name, fn, false);
+    auto func = std::make_unique<Function>(name, std::move(fn), false);
     Object* func_proto = get_function_prototype();
     if (func_proto) {
         // Freshly made here and not handed to JS yet.
@@ -1941,7 +2031,7 @@ std::unique_ptr<Function> create_native_function(const std::string& name,
 std::unique_ptr<Function> create_native_function(const std::string& name,
                                                  std::function<Value(Context&, std::span<const Value>, Value)> fn,
                                                  uint32_t arity) {
-    auto func = std::make_unique<Function>(name, fn, arity, false);
+    auto func = std::make_unique<Function>(name, std::move(fn), arity, false);
     Object* func_proto = get_function_prototype();
     if (func_proto) {
         // Freshly made here and not handed to JS yet.
@@ -1953,7 +2043,7 @@ std::unique_ptr<Function> create_native_function(const std::string& name,
 std::unique_ptr<Function> create_native_constructor(const std::string& name,
                                                     std::function<Value(Context&, std::span<const Value>, Value)> fn,
                                                     uint32_t arity) {
-    auto func = std::make_unique<Function>(name, fn, arity, true);
+    auto func = std::make_unique<Function>(name, std::move(fn), arity, true);
     Object* func_proto = get_function_prototype();
     if (func_proto) {
         // Freshly made here and not handed to JS yet.
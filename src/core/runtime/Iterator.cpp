@@ -266,9 +266,9 @@ Value Iterator::create_iterator_result(const Value& value, bool done) {
     // Every one of these is the same two properties in the same order on a
     // fresh object, so it passes through the same two shapes every time and
     // the transitions can be remembered instead of looked up by name -- which
-    // was most of what producing an iterator result cost. Shapes are immortal
-    // for the thread, so holding them is safe, and the from-shape is compared
-    // rather than assumed.
+    // was most of what producing an iterator result cost. The shapes are
+    // pinned, so a collection's pruning cannot free them from under these,
+    // and the from-shape is compared rather than assumed.
     static thread_local Shape* from_shape = nullptr;
     static thread_local Shape* after_value = nullptr;
     static thread_local Shape* after_done = nullptr;
@@ -286,6 +286,9 @@ Value Iterator::create_iterator_result(const Value& value, bool done) {
         after_value = obj->get_shape();
         obj->create_own_data_property("done", Value(done));
         after_done = obj->get_shape();
+        if (from_shape) Shape::pin(from_shape);
+        if (after_value) Shape::pin(after_value);
+        if (after_done) Shape::pin(after_done);
     }
     return Value(result_obj.release());
 }
@@ -1115,7 +1115,10 @@ void Set::setup_set_prototype(Context& ctx) {
         Value next_fn = it->get_property("next");
         if (ctx.has_exception() || !next_fn.is_function()) return result;
         for (;;) {
-            Collector::safepoint();
+            if (Collector::safepoint()) {
+                Collector::raise_heap_limit_error(ctx);
+                break;
+            }
             Value res = next_fn.as_function()->call(ctx, {}, iter);
             if (ctx.has_exception() || !res.is_object()) break;
             if (res.as_object()->get_property("done").to_boolean()) break;
@@ -1138,7 +1141,11 @@ void Set::setup_set_prototype(Context& ctx) {
         Value next_fn = it->get_property("next");
         if (ctx.has_exception() || !next_fn.is_function()) return;
         for (;;) {
-            Collector::safepoint();
+            if (Collector::safepoint()) {
+                Collector::raise_heap_limit_error(ctx);
+                close_iterator(it, ctx);
+                return;
+            }
             Value res = next_fn.as_function()->call(ctx, {}, iter);
             if (ctx.has_exception() || !res.is_object()) return;
             if (res.as_object()->get_property("done").to_boolean()) return;
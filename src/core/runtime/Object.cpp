@@ -52,8 +52,6 @@ constinit thread_local Context* Object::current_context_ = nullptr;
 constinit thread_local uint64_t Object::proto_epoch_ = 0;
 constinit thread_local uint64_t Object::descriptor_epoch_ = 0;
 
-thread_local std::unordered_map<std::string, std::string> Object::interned_keys_;
-
 void* Object::operator new(size_t size) {
     return Heap::active().allocate(size, CellKind::Object);
 }
@@ -84,6 +82,7 @@ void Object::adopt_inline_butterfly(size_t object_bytes, uint32_t slots) {
 }
 
 void Object::trace(Visitor& v) {
+    if (Shape* shape = shape_.get()) shape->note_reached();
     switch (get_type()) {
         case ObjectType::Function: static_cast<Function*>(this)->trace(v); return;
         case ObjectType::TypedArray: static_cast<TypedArrayBase*>(this)->trace(v); return;
@@ -113,6 +112,10 @@ void Object::trace_default(Visitor& v) {
         uint32_t scount = shape_->slot_count();
         for (uint32_t i = 0; i < scount; i++) v.visit(*shape_slot_ptr(i));
     }
+    trace_extras(v);
+}
+
+void Object::trace_extras(Visitor& v) {
     // One walk to the extras, not three: all three of these live in the same
     // block, and an object that has none -- which is most of them -- used to
     // pay the trip to find that out once per question.
@@ -126,6 +129,7 @@ void Object::trace_default(Visitor& v) {
     }
     if (auto* d = extras->descriptors.get()) {
         for (size_t i = 0; i < d->inline_size(); i++) {
+            Shape::note_key_reached(&d->inline_key(i));
             const PropertyDescriptor& desc = d->inline_value(i);
             if (desc.has_value()) v.visit(desc.get_value());
             v.visit_object(desc.get_getter());
@@ -142,6 +146,41 @@ void Object::trace_default(Visitor& v) {
     }
 }
 
+CardTable* Object::card_table() const {
+    RareExtras* extras = peek_extras();
+    return extras ? extras->cards.get() : nullptr;
+}
+
+CardTable* Object::ensure_card_table() {
+    if (get_type() != ObjectType::Array || elements_capacity() < CardTable::kMinElements) return nullptr;
+    RareExtras& extras = ensure_extras();
+    if (!extras.cards) {
+        extras.cards = std::make_unique<CardTable>();
+        extras.cards->mark_range(0, elements_length());
+    }
+    return extras.cards.get();
+}
+
+size_t Object::trace_dirty_cards(Visitor& v, bool whole_cell) {
+    if (whole_cell) {
+        if (Shape* shape = shape_.get()) shape->note_reached();
+        v.visit_object(proto_);
+        if (shape_) {
+            uint32_t scount = shape_->slot_count();
+            for (uint32_t i = 0; i < scount; i++) v.visit(*shape_slot_ptr(i));
+        }
+    }
+    // Always, not only for a whole cell: an element store the barrier carded
+    // can land in the sparse overflow or a descriptor instead of the element
+    // store (set_element decides after the barrier), and no card covers those.
+    trace_extras(v);
+    CardTable* cards = card_table();
+    if (!cards) return 0;
+    return cards->take_dirty(elements_length(), [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) v.visit(*element_ptr(i));
+    });
+}
+
 Value* Object::find_shape_slot(const std::string& key) {
     if (!shape_) return nullptr;
     int32_t slot = shape_->find_slot(key);
@@ -1788,7 +1827,7 @@ Value Object::get_element(uint32_t index) const {
 
 void Object::move_elements(uint32_t dst, uint32_t src, uint32_t count) {
     if (!count || dst == src) return;
-    Collector::write_barrier(this);
+    Collector::write_barrier_elements(this, dst, count);
     // Elements run downward in memory (element_ptr subtracts the index), so a
     // run of `count` starting at `i` is the block whose lowest address is
     // element_ptr(i + count - 1).
@@ -1800,7 +1839,7 @@ void Object::copy_elements_from(const Object& src, uint32_t src_i, uint32_t dst_
                                uint32_t count) {
     if (!count) return;
     if (dst_i + count > elements_length()) resize_elements(dst_i + count);
-    Collector::write_barrier(this);
+    Collector::write_barrier_elements(this, dst_i, count);
     // memmove, not memcpy: the source may be this same array.
     std::memmove(element_ptr(dst_i + count - 1), src.element_ptr(src_i + count - 1),
                  static_cast<size_t>(count) * sizeof(Value));
@@ -1809,12 +1848,12 @@ void Object::copy_elements_from(const Object& src, uint32_t src_i, uint32_t dst_
 void Object::copy_elements_reversed_from(const Object& src, uint32_t count) {
     if (!count) return;
     if (count > elements_length()) resize_elements(count);
-    Collector::write_barrier(this);
+    Collector::write_barrier_elements(this, 0, count);
     for (uint32_t i = 0; i < count; i++) *element_ptr(i) = *src.element_ptr(count - 1 - i);
 }
 
 bool Object::set_element(uint32_t index, const Value& value) {
-    Collector::write_barrier_value(this, value);
+    Collector::write_barrier_element(this, index, value);
     // Same dispatch problem as get_element: TypedArrayBase::set_element(size_t) doesn't
     // override this uint32_t signature, so generic Array.prototype methods called via
     // .call()/.apply() on a typed array must be routed there explicitly.
@@ -1907,7 +1946,7 @@ bool Object::set_element(uint32_t index, const Value& value) {
 }
 
 bool Object::store_dense_element(uint32_t index, const Value& value) {
-    Collector::write_barrier_value(this, value);
+    Collector::write_barrier_element(this, index, value);
     if (index == elements_length()) {
         if (__builtin_expect(!has_plain_array_length(), 0)) return false;
         resize_elements(index + 1);
@@ -2368,6 +2407,7 @@ bool Object::set_property_descriptor_default(const std::string& key, const Prope
                             uint32_t idx;
                             if (is_array_index(key, &idx)) {
                                 if (idx >= elements_length()) resize_elements(idx + 1);
+                                Collector::write_barrier_element(this, idx, desc.get_value());
                                 (*element_ptr(idx)) = desc.get_value();
                             }
                         }
@@ -2413,6 +2453,7 @@ bool Object::set_property_descriptor_default(const std::string& key, const Prope
                         }
                     }
                 }
+                Collector::write_barrier_element(this, index, desc.get_value());
                 (*element_ptr(index)) = desc.get_value();
                 if (auto* de = deleted_elements()) de->erase(index);
                 // ArraySetLength side effect: defining index N on an Array bumps length to N+1
@@ -2591,6 +2632,7 @@ bool Object::set_property_descriptor_default(const std::string& key, const Prope
                         uint32_t idx;
                         if (is_array_index(key, &idx)) {
                             if (idx >= elements_length()) resize_elements(idx + 1);
+                            Collector::write_barrier_element(this, idx, cur);
                             (*element_ptr(idx)) = cur;
                         }
                     }
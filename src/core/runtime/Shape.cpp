@@ -5,6 +5,8 @@
  */
 
 #include "quanta/core/runtime/Shape.h"
+#include <string_view>
+#include <type_traits>
 #include <unordered_set>
 
 namespace Quanta {
@@ -16,25 +18,78 @@ static_assert(sizeof(Shape) <= 256);
 #endif
 
 namespace {
-// Never erased from, so returned pointers are stable for the thread's
-// lifetime -- see the field's own doc comment in Shape.h.
-std::unordered_set<std::string>& intern_table() {
-    static thread_local std::unordered_set<std::string> table;
+// Every shape this thread holds, so a long-running process can see whether
+// the tree is keeping steady.
+constinit thread_local size_t g_shape_count = 0;
+
+// Node-based, so an entry never moves while it stays: the pointers intern()
+// hands out are the entries' own addresses. Looked up by plain string without
+// building an entry first.
+static_assert(std::is_standard_layout_v<Shape::InternedKey>,
+              "note_key_reached casts a key pointer back to its entry");
+
+struct InternHash {
+    using is_transparent = void;
+    size_t operator()(std::string_view s) const { return std::hash<std::string_view>{}(s); }
+    size_t operator()(const Shape::InternedKey& k) const { return (*this)(std::string_view(k.text)); }
+};
+struct InternEq {
+    using is_transparent = void;
+    static std::string_view view(std::string_view s) { return s; }
+    static std::string_view view(const Shape::InternedKey& k) { return k.text; }
+    template <typename A, typename B>
+    bool operator()(const A& a, const B& b) const { return view(a) == view(b); }
+};
+using InternTable = std::unordered_set<Shape::InternedKey, InternHash, InternEq>;
+
+// See the pool's doc comment in Shape.h for when entries go.
+InternTable& intern_table() {
+    static thread_local InternTable table;
     return table;
 }
+
+const Shape::InternedKey& intern_entry(const std::string& key) {
+    auto& table = intern_table();
+    auto it = table.find(std::string_view(key));
+    if (it == table.end()) return *table.insert(Shape::InternedKey{key}).first;
+    it->reached = true;
+    return *it;
+}
 }  // namespace
 
 const std::string* Shape::intern(const std::string& key) {
-    auto& table = intern_table();
-    auto it = table.find(key);
-    if (it == table.end()) it = table.insert(key).first;
-    return &*it;
+    return &intern_entry(key).text;
+}
+
+const std::string* Shape::intern_pinned(const std::string& key) {
+    const InternedKey& entry = intern_entry(key);
+    entry.pinned = true;
+    return &entry.text;
 }
 
 const std::string* Shape::intern_existing(const std::string& key) {
     auto& table = intern_table();
-    auto it = table.find(key);
-    return it == table.end() ? nullptr : &*it;
+    auto it = table.find(std::string_view(key));
+    return it == table.end() ? nullptr : &it->text;
+}
+
+void Shape::begin_key_reachability() {
+    for (const InternedKey& entry : intern_table()) entry.reached = false;
+}
+
+size_t Shape::sweep_unreached_keys() {
+    note_keys_below(root());
+    return std::erase_if(intern_table(), [](const InternedKey& entry) {
+        return !entry.reached && !entry.pinned;
+    });
+}
+
+size_t Shape::key_count() {
+    return intern_table().size();
+}
+
+Shape::Shape() {
+    g_shape_count++;
 }
 
 Shape::Shape(Shape* parent, const std::string* key, uint32_t slot_index, bool is_accessor)
@@ -43,11 +98,19 @@ Shape::Shape(Shape* parent, const std::string* key, uint32_t slot_index, bool is
       has_any_accessor_(is_accessor || (parent && parent->has_any_accessor_)) {
     if (parent_) slots_ = parent_->slots_;
     slots_.set(key, slot_index, is_accessor);
+    g_shape_count++;
+}
+
+// Takes the whole subtree with it: each table owns its children.
+Shape::~Shape() {
+    transition_free(transitions_, transitions_is_single_);
+    transition_free(accessor_transitions_, accessor_transitions_is_single_);
+    g_shape_count--;
 }
 
 Shape* Shape::root() {
-    // Heap-allocated (leaked, matching "immortal for the thread's lifetime"
-    // above) rather than a plain `static thread_local Shape instance` --
+    // Heap-allocated (leaked: the root is never pruned, and every other shape
+    // hangs off it) rather than a plain `static thread_local Shape instance` --
     // thread-local storage doesn't reliably honor over-alignment (Shape is
     // alignas(32), Object.h's TaggedShapePtr tag bits), while `new` does
     // (C++17 over-aligned dynamic allocation).
@@ -91,6 +154,109 @@ std::pair<Shape*, bool> Shape::transition_insert(void*& table, bool is_single,
     return {raw, false};
 }
 
+template <typename F>
+void Shape::transition_for_each(void* table, bool is_single, F&& f) {
+    if (!table) return;
+    if (is_single) {
+        f(static_cast<SingleTransition*>(table)->child.get());
+        return;
+    }
+    for (auto& e : static_cast<TransitionMap*>(table)->entries) f(e.value.get());
+}
+
+void Shape::transition_free(void* table, bool is_single) {
+    if (!table) return;
+    if (is_single) delete static_cast<SingleTransition*>(table);
+    else delete static_cast<TransitionMap*>(table);
+}
+
+bool Shape::transition_prune(void*& table, bool is_single, size_t& freed) {
+    if (!table) return false;
+    if (is_single) {
+        auto* single = static_cast<SingleTransition*>(table);
+        if (single->child->reached_) {
+            prune_children(single->child.get(), freed);
+            return true;
+        }
+        freed += subtree_size(single->child.get());
+        delete single;
+        table = nullptr;
+        return false;
+    }
+    auto* map = static_cast<TransitionMap*>(table);
+    std::erase_if(map->entries, [&freed](const TransitionMap::Entry& e) {
+        if (e.value->reached_) return false;
+        freed += subtree_size(e.value.get());
+        return true;
+    });
+    if (map->entries.empty()) {
+        delete map;
+        table = nullptr;
+        return false;
+    }
+    for (auto& e : map->entries) prune_children(e.value.get(), freed);
+    return false;
+}
+
+void Shape::prune_children(Shape* s, size_t& freed) {
+    s->transitions_is_single_ = transition_prune(s->transitions_, s->transitions_is_single_, freed);
+    s->accessor_transitions_is_single_ =
+        transition_prune(s->accessor_transitions_, s->accessor_transitions_is_single_, freed);
+}
+
+size_t Shape::subtree_size(Shape* s) {
+    size_t n = 1;
+    auto add = [&n](Shape* child) { n += subtree_size(child); };
+    transition_for_each(s->transitions_, s->transitions_is_single_, add);
+    transition_for_each(s->accessor_transitions_, s->accessor_transitions_is_single_, add);
+    return n;
+}
+
+void Shape::clear_reached(Shape* s) {
+    s->reached_ = false;
+    transition_for_each(s->transitions_, s->transitions_is_single_, clear_reached);
+    transition_for_each(s->accessor_transitions_, s->accessor_transitions_is_single_, clear_reached);
+}
+
+// Post-order, so one walk carries a descendant's mark all the way up. Every
+// child is visited whatever an earlier one answered: each needs its own mark
+// settled before prune_unreached reads it.
+bool Shape::settle(Shape* s) {
+    bool reached = s->reached_ || s->pinned_;
+    auto visit = [&reached](Shape* child) { reached |= settle(child); };
+    transition_for_each(s->transitions_, s->transitions_is_single_, visit);
+    transition_for_each(s->accessor_transitions_, s->accessor_transitions_is_single_, visit);
+    s->reached_ = reached;
+    return reached;
+}
+
+// Recursion is bounded by the tree's depth, which kMaxSlots caps: every
+// child holds at least one slot more than its parent.
+void Shape::begin_reachability() {
+    clear_reached(root());
+}
+
+void Shape::settle_reachability() {
+    settle(root());
+    root()->reached_ = true;
+}
+
+size_t Shape::prune_unreached() {
+    size_t freed = 0;
+    prune_children(root(), freed);
+    return freed;
+}
+
+size_t Shape::count() {
+    return g_shape_count;
+}
+
+void Shape::note_keys_below(Shape* s) {
+    if (s->added_key_) note_key_reached(s->added_key_);
+    transition_for_each(s->transitions_, s->transitions_is_single_, note_keys_below);
+    transition_for_each(s->accessor_transitions_, s->accessor_transitions_is_single_, note_keys_below);
+}
+
 Shape* Shape::transition(const std::string& key) {
     // transition_find() compares by value, no interning needed for the
     // (common) case this child already exists -- only intern() on an
@@ -0,0 +1,647 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "quanta/core/vm/BaselineJit.h"
+#include "vm_internal.h"
+#include "quanta/core/gc/Collector.h"
+#include "quanta/core/runtime/Object.h"
+#include <bit>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#if defined(__x86_64__) && !defined(_WIN32)
+#include <sys/mman.h>
+#include <unistd.h>
+#define QUANTA_BASELINE_X64 1
+#endif
+
+namespace Quanta {
+namespace VM {
+
+static_assert(static_cast<size_t>(Op::kCount) <= kBaselineExitByte,
+              "kBaselineExitByte collides with a real opcode");
+// Native code moves Values around as raw 64-bit words.
+static_assert(sizeof(Value) == sizeof(uint64_t) && std::is_trivially_copyable_v<Value>);
+
+namespace {
+
+// Read at startup rather than through a function-local static: it is asked
+// once per chunk, but from the interpreter's own call path.
+const bool g_baseline_on = [] {
+    const char* env = std::getenv("QUANTA_JIT");
+    if (!env) return true;
+    return env[0] != '0';
+}();
+
+// Left in f.pc by native code before it calls out. A handler chain that comes
+// back through baseline_exit overwrites it with where to resume; one that
+// ends in Return (or an exception nothing in this frame catches) leaves it,
+// which is how the native code tells the two apart.
+constexpr uint32_t kReturned = UINT32_MAX;
+
+// A C++ exception raised under a call-out. It cannot unwind through native
+// frames -- they have no unwind tables -- so call_out catches it, the native
+// code returns normally, and baseline_enter rethrows it from C++, where run()'s
+// catch clauses see exactly what the interpreter would have shown them. One
+// slot is enough: nothing runs between the catch and the rethrow.
+thread_local std::exception_ptr g_pending_exception;
+
+inline uint64_t bits_of(const Value& v) { return std::bit_cast<uint64_t>(v); }
+
+inline uint16_t operand_u16(const uint8_t* code, uint32_t pc) {
+    return static_cast<uint16_t>(code[pc]) | (static_cast<uint16_t>(code[pc + 1]) << 8);
+}
+
+inline int16_t operand_i16(const uint8_t* code, uint32_t pc) {
+    return static_cast<int16_t>(operand_u16(code, pc));
+}
+
+Value call_out(Frame& f, uint32_t pc, Value acc, Handler h) {
+    try {
+        return h(f, pc, acc);
+    } catch (...) {
+        g_pending_exception = std::current_exception();
+        f.pc = kReturned;
+        return Value();
+    }
+}
+
+// A back-edge's safepoint, with the loop head it jumps to: the collector
+// reads the frame's registers as live at instr_pc. A heap over its limit
+// leaves native code the way a call-out's C++ exception does: the RangeError
+// goes on the context, the native code returns, and baseline_enter's rethrow
+// lands in run(), which hands it to the handler covering instr_pc.
+uint32_t safepoint_thunk(Frame& f, uint32_t pc) {
+    f.instr_pc = pc;
+    if (!Collector::safepoint()) [[likely]] return 0;
+    Collector::raise_heap_limit_error(f.ctx);
+    g_pending_exception = std::make_exception_ptr(std::runtime_error("RangeError: Maximum heap size exceeded"));
+    return kReturned;
+}
+
+// Not a value any property can hold: the TDZ marker never leaves a register.
+const uint64_t kIcMiss = bits_of(Value::vm_tdz_sentinel());
+
+// h_GetNamedFast's first probe, minus the dispatch: the site's first learned
+// shape against the receiver's. Anything else -- a second shape, an accessor,
+// a miss -- is the handler's to decide.
+uint64_t get_named_ic(Frame& f, uint32_t pc) {
+    const Value& receiver = f.regs[f.code[pc + 1]];
+    if (!receiver.is_object()) return kIcMiss;
+    Object* obj = receiver.as_object();
+    if (obj->get_type() != Object::ObjectType::Ordinary) return kIcMiss;
+    const FeedbackSlot::Entry& e = f.chunk.feedback[operand_u16(f.code, pc + 4)].entries[0];
+    if (!e.shape || e.is_accessor || e.shape != obj->get_shape() ||
+        obj->has_any_descriptor_override()) {
+        return kIcMiss;
+    }
+    const Value* slot = obj->get_shape_slot_unchecked(e.slot_index);
+    return slot ? bits_of(*slot) : kIcMiss;
+}
+
+#ifdef QUANTA_BASELINE_X64
+
+enum Reg : uint8_t {
+    RAX = 0, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+    R8, R9, R10, R11, R12, R13, R14, R15
+};
+
+// Condition codes, as the low nibble of Jcc/SETcc.
+enum Cond : uint8_t {
+    kO = 0x0, kB = 0x2, kAE = 0x3, kE = 0x4, kNE = 0x5, kBE = 0x6, kA = 0x7,
+    kL = 0xC, kGE = 0xD, kLE = 0xE, kG = 0xF
+};
+
+// Just the encodings the stencils below use. Memory operands are always
+// [base + disp32], which has no special cases beyond the SIB byte rsp/r12
+// need as a base.
+class Assembler {
+public:
+    std::vector<uint8_t> buf;
+
+    size_t here() const { return buf.size(); }
+    void byte(uint8_t b) { buf.push_back(b); }
+    void u32(uint32_t v) { for (int i = 0; i < 4; i++) byte(static_cast<uint8_t>(v >> (8 * i))); }
+    void u64(uint64_t v) { for (int i = 0; i < 8; i++) byte(static_cast<uint8_t>(v >> (8 * i))); }
+
+    void rex(bool w, uint8_t reg, uint8_t rm) {
+        uint8_t r = 0x40 | (w ? 8 : 0) | ((reg & 8) ? 4 : 0) | ((rm & 8) ? 1 : 0);
+        if (r != 0x40) byte(r);
+    }
+    void modrm_rr(uint8_t reg, uint8_t rm) { byte(0xC0 | ((reg & 7) << 3) | (rm & 7)); }
+    void modrm_mem(uint8_t reg, uint8_t base, int32_t disp) {
+        byte(0x80 | ((reg & 7) << 3) | (base & 7));
+        if ((base & 7) == 4) byte(0x24);
+        u32(static_cast<uint32_t>(disp));
+    }
+
+    void push(uint8_t r) { if (r & 8) byte(0x41); byte(0x50 + (r & 7)); }
+    void pop(uint8_t r) { if (r & 8) byte(0x41); byte(0x58 + (r & 7)); }
+    void ret() { byte(0xC3); }
+    void ud2() { byte(0x0F); byte(0x0B); }
+
+    void mov(uint8_t dst, uint8_t src) { rex(true, src, dst); byte(0x89); modrm_rr(src, dst); }
+    void mov_imm(uint8_t dst, uint64_t imm) { rex(true, 0, dst); byte(0xB8 + (dst & 7)); u64(imm); }
+    void mov_imm32(uint8_t dst, uint32_t imm) { rex(false, 0, dst); byte(0xB8 + (dst & 7)); u32(imm); }
+    void load(uint8_t dst, uint8_t base, int32_t disp) { rex(true, dst, base); byte(0x8B); modrm_mem(dst, base, disp); }
+    void store(uint8_t base, int32_t disp, uint8_t src) { rex(true, src, base); byte(0x89); modrm_mem(src, base, disp); }
+    void load32(uint8_t dst, uint8_t base, int32_t disp) { rex(false, dst, base); byte(0x8B); modrm_mem(dst, base, disp); }
+    void store32_imm(uint8_t base, int32_t disp, uint32_t imm) {
+        rex(false, 0, base); byte(0xC7); modrm_mem(0, base, disp); u32(imm);
+    }
+    // mov dst, [base + index*8]
+    void load_indexed(uint8_t dst, uint8_t base, uint8_t index) {
+        rex(true, dst, base);
+        if (index & 8) buf[buf.size() - 1] |= 2;  // REX.X, only reached with a REX already emitted
+        byte(0x8B);
+        byte(0x04 | ((dst & 7) << 3));
+        byte(0xC0 | ((index & 7) << 3) | (base & 7));
+    }
+    // Zero-extends the low half in place.
+    void mov32(uint8_t dst, uint8_t src) { rex(false, src, dst); byte(0x89); modrm_rr(src, dst); }
+
+    void and_(uint8_t dst, uint8_t src) { rex(true, src, dst); byte(0x21); modrm_rr(src, dst); }
+    void or_(uint8_t dst, uint8_t src) { rex(true, src, dst); byte(0x09); modrm_rr(src, dst); }
+    void cmp(uint8_t a, uint8_t b) { rex(true, b, a); byte(0x39); modrm_rr(b, a); }
+    void cmp32_imm(uint8_t r, uint32_t imm) { rex(false, 0, r); byte(0x81); byte(0xF8 | (r & 7)); u32(imm); }
+    void shl_imm(uint8_t r, uint8_t n) { rex(true, 0, r); byte(0xC1); byte(0xE0 | (r & 7)); byte(n); }
+    void shr_imm(uint8_t r, uint8_t n) { rex(true, 0, r); byte(0xC1); byte(0xE8 | (r & 7)); byte(n); }
+    // 32-bit forms, for the int32 Value form; each zero-extends into the
+    // full register.
+    void add32(uint8_t dst, uint8_t src) { rex(false, src, dst); byte(0x01); modrm_rr(src, dst); }
+    void sub32(uint8_t dst, uint8_t src) { rex(false, src, dst); byte(0x29); modrm_rr(src, dst); }
+    void cmp32(uint8_t a, uint8_t b) { rex(false, b, a); byte(0x39); modrm_rr(b, a); }
+    void add32_imm8(uint8_t r, int8_t imm) {
+        rex(false, 0, r); byte(0x83); byte(0xC0 | (r & 7)); byte(static_cast<uint8_t>(imm));
+    }
+    void add_rsp(uint8_t n) { byte(0x48); byte(0x83); byte(0xC4); byte(n); }
+    void sub_rsp(uint8_t n) { byte(0x48); byte(0x83); byte(0xEC); byte(n); }
+
+    // xmm0..xmm7 only, which is all the stencils use.
+    void movq_to_xmm(uint8_t xmm, uint8_t gpr) { byte(0x66); rex(true, xmm, gpr); byte(0x0F); byte(0x6E); modrm_rr(xmm, gpr); }
+    void movq_from_xmm(uint8_t gpr, uint8_t xmm) { byte(0x66); rex(true, xmm, gpr); byte(0x0F); byte(0x7E); modrm_rr(xmm, gpr); }
+    void sse(uint8_t prefix, uint8_t op, uint8_t dst, uint8_t src) {
+        if (prefix) byte(prefix);
+        byte(0x0F); byte(op); modrm_rr(dst, src);
+    }
+    void addsd(uint8_t d, uint8_t s) { sse(0xF2, 0x58, d, s); }
+    void subsd(uint8_t d, uint8_t s) { sse(0xF2, 0x5C, d, s); }
+    void mulsd(uint8_t d, uint8_t s) { sse(0xF2, 0x59, d, s); }
+    void ucomisd(uint8_t a, uint8_t b) { sse(0x66, 0x2E, a, b); }
+    void setcc_al(Cond c) { byte(0x0F); byte(0x90 | c); byte(0xC0); }
+    void movzx_eax_al() { byte(0x0F); byte(0xB6); byte(0xC0); }
+
+    void call_abs(const void* fn) {
+        mov_imm(RAX, reinterpret_cast<uint64_t>(fn));
+        byte(0xFF); byte(0xD0);
+    }
+    void jmp_reg(uint8_t r) { if (r & 8) byte(0x41); byte(0xFF); byte(0xE0 | (r & 7)); }
+
+    // Forward/backward rel32 branches: emit with a hole, patch once the
+    // target's offset is known.
+    size_t jmp32() { byte(0xE9); size_t at = here(); u32(0); return at; }
+    size_t jcc32(Cond c) { byte(0x0F); byte(0x80 | c); size_t at = here(); u32(0); return at; }
+    void patch(size_t at, size_t target) {
+        int32_t rel = static_cast<int32_t>(static_cast<int64_t>(target) - static_cast<int64_t>(at + 4));
+        std::memcpy(&buf[at], &rel, sizeof(rel));
+    }
+};
+
+// Register assignment for the whole native body:
+//   rbx  Frame*            r13  register bank
+//   rbp  &Frame::pc        r14  constant pool
+//   r12  accumulator       r15  the exponent mask of a finite-double test
+// All callee-saved, so a call-out leaves every one of them where it was.
+//
+// Native signature: (Frame*, pc, acc, regs, constants, &f.pc) -> acc. The
+// last three are handed over rather than loaded through the Frame so the code
+// never depends on Frame's layout.
+using NativeEntry = uint64_t (*)(Frame*, uint32_t, uint64_t, Value*, const Value*, uint32_t*);
+
+constexpr uint64_t kExponentMask = 0x7FF0000000000000ULL;
+// Value::from_int32's tag, which is the whole upper half of the word.
+const uint64_t kInt32Tag = bits_of(Value::from_int32(0));
+
+class Compiler {
+public:
+    Compiler(const BytecodeChunk& chunk, BaselineCode& out)
+        : chunk_(chunk), out_(out), code_(chunk.code.data()), size_(static_cast<uint32_t>(chunk.code.size())),
+          label_(size_ + 1, kNoLabel) {}
+
+    bool compile();
+
+private:
+    static constexpr size_t kNoLabel = SIZE_MAX;
+
+    struct Fixup { size_t at; uint32_t target_pc; };
+    // An out-of-line fallback: the generic handler for one instruction, for
+    // when a stencil's guard fails. Emitted after the body so the guarded
+    // path falls straight through to the next instruction.
+    struct Cold { std::vector<size_t> from; uint32_t pc; Op op; };
+
+    void emit_prologue();
+    void emit_epilogue();
+    void emit_call_out(uint32_t pc, Op op, bool fall_through);
+    void emit_safepoint(uint32_t target_pc);
+    void branch_to(uint32_t target_pc) { fixups_.push_back({a_.jmp32(), target_pc}); }
+    void branch_if(Cond c, uint32_t target_pc) { fixups_.push_back({a_.jcc32(c), target_pc}); }
+    void guard_finite(uint8_t reg, Cold& cold);
+    size_t jump_unless_int32(uint8_t reg);
+    void box_int32_rax_into_acc();
+    bool emit_native(uint32_t pc, Op op, Cold& cold);
+
+    const BytecodeChunk& chunk_;
+    BaselineCode& out_;
+    const uint8_t* code_;
+    uint32_t size_;
+    Assembler a_;
+    std::vector<size_t> label_;  // native offset of each instruction start
+    std::vector<Fixup> fixups_;
+    std::vector<size_t> to_resume_;
+    std::vector<Cold> cold_;
+    size_t dispatch_ = 0, resume_ = 0, trap_ = 0;
+};
+
+void Compiler::emit_prologue() {
+    a_.push(RBX); a_.push(RBP); a_.push(R12); a_.push(R13); a_.push(R14); a_.push(R15);
+    a_.sub_rsp(8);  // six pushes and the return address: realign to 16
+    a_.mov(RBX, RDI);
+    a_.mov(R12, RDX);
+    a_.mov(R13, RCX);
+    a_.mov(R14, R8);
+    a_.mov(RBP, R9);
+    a_.mov_imm(R15, kExponentMask);
+    a_.mov32(RSI, RSI);
+    // Entry and every non-sequential resume: pc in esi, look it up.
+    dispatch_ = a_.here();
+    a_.mov_imm(RAX, reinterpret_cast<uint64_t>(out_.entries.get()));
+    a_.load_indexed(RAX, RAX, RSI);
+    a_.jmp_reg(RAX);
+}
+
+void Compiler::emit_epilogue() {
+    a_.mov(RAX, R12);
+    a_.add_rsp(8);
+    a_.pop(R15); a_.pop(R14); a_.pop(R13); a_.pop(R12); a_.pop(RBP); a_.pop(RBX);
+    a_.ret();
+}
+
+void Compiler::emit_safepoint(uint32_t target_pc) {
+    a_.mov(RDI, RBX);
+    a_.mov_imm32(RSI, target_pc);
+    a_.call_abs(reinterpret_cast<const void*>(&safepoint_thunk));
+    a_.mov(RSI, RAX);
+    a_.cmp32_imm(RSI, kReturned);
+    to_resume_.push_back(a_.jcc32(kE));
+}
+
+// Runs the instruction at pc through its interpreter handler. The handler
+// chain either comes back at the next instruction (the common case, checked
+// inline), comes back somewhere else (a taken jump, a catch handler), or
+// finishes the function.
+void Compiler::emit_call_out(uint32_t pc, Op op, bool fall_through) {
+    const uint32_t next = pc + 1 + static_cast<uint32_t>(op_operand_bytes(op));
+    a_.store32_imm(RBP, 0, kReturned);
+    a_.mov(RDI, RBX);
+    a_.mov_imm32(RSI, pc);
+    a_.mov(RDX, R12);
+    a_.mov_imm(RCX, reinterpret_cast<uint64_t>(kHandlers[static_cast<uint8_t>(op)]));
+    a_.call_abs(reinterpret_cast<const void*>(&call_out));
+    a_.mov(R12, RAX);
+    a_.load32(RSI, RBP, 0);
+    a_.cmp32_imm(RSI, next);
+    if (fall_through && next < size_) {
+        to_resume_.push_back(a_.jcc32(kNE));
+    } else {
+        branch_if(kE, next);
+        to_resume_.push_back(a_.jmp32());
+    }
+}
+
+void Compiler::guard_finite(uint8_t reg, Cold& cold) {
+    a_.mov(RCX, reg);
+    a_.and_(RCX, R15);
+    a_.cmp(RCX, R15);
+    cold.from.push_back(a_.jcc32(kE));
+}
+
+// Jumps (to be patched) when `reg` is not in the int32 form. Clobbers rcx.
+size_t Compiler::jump_unless_int32(uint8_t reg) {
+    a_.mov(RCX, reg);
+    a_.shr_imm(RCX, 32);
+    a_.cmp32_imm(RCX, static_cast<uint32_t>(kInt32Tag >> 32));
+    return a_.jcc32(kNE);
+}
+
+// eax holds an int32 result with the upper half already clear.
+void Compiler::box_int32_rax_into_acc() {
+    a_.mov_imm(RCX, kInt32Tag);
+    a_.or_(RAX, RCX);
+    a_.mov(R12, RAX);
+}
+
+bool Compiler::emit_native(uint32_t pc, Op op, Cold& cold) {
+    const uint8_t* c = code_ + pc;
+    auto reg_disp = [](uint8_t r) { return static_cast<int32_t>(r) * 8; };
+    switch (op) {
+        case Op::LdaZero: a_.mov_imm(R12, bits_of(Value::from_int32(0))); return true;
+        case Op::LdaUndefined: a_.mov_imm(R12, bits_of(Value())); return true;
+        case Op::LdaNull: a_.mov_imm(R12, bits_of(Value::null())); return true;
+        case Op::LdaTrue: a_.mov_imm(R12, bits_of(Value(true))); return true;
+        case Op::LdaFalse: a_.mov_imm(R12, bits_of(Value(false))); return true;
+        case Op::LdaSmi:
+            a_.mov_imm(R12, bits_of(Value::from_int32(static_cast<int8_t>(c[1]))));
+            return true;
+        case Op::LdaConst: a_.load(R12, R14, operand_u16(c, 1) * 8); return true;
+        case Op::Ldar: a_.load(R12, R13, reg_disp(c[1])); return true;
+        case Op::Star: a_.store(R13, reg_disp(c[1]), R12); return true;
+        case Op::Mov:
+            a_.load(RAX, R13, reg_disp(c[1]));
+            a_.store(R13, reg_disp(c[2]), RAX);
+            return true;
+        case Op::LdarStar:
+            a_.load(R12, R13, reg_disp(c[1]));
+            a_.store(R13, reg_disp(c[2]), R12);
+            return true;
+        case Op::LdaSmiStar:
+            a_.mov_imm(R12, bits_of(Value::from_int32(static_cast<int8_t>(c[1]))));
+            a_.store(R13, reg_disp(c[2]), R12);
+            return true;
+        case Op::LdaZeroStar:
+            a_.mov_imm(R12, bits_of(Value::from_int32(0)));
+            a_.store(R13, reg_disp(c[1]), R12);
+            return true;
+        case Op::LdaConstStar:
+            a_.load(R12, R14, operand_u16(c, 1) * 8);
+            a_.store(R13, reg_disp(c[3]), R12);
+            return true;
+        case Op::Return:
+            emit_epilogue();
+            return true;
+        case Op::Jump: {
+            int16_t off = operand_i16(c, 1);
+            uint32_t target = pc + 3 + static_cast<uint32_t>(static_cast<int32_t>(off));
+            if (off < 0) emit_safepoint(target);
+            branch_to(target);
+            return true;
+        }
+        case Op::JumpIfTrue:
+        case Op::JumpIfFalse: {
+            // Only a real boolean decides here; anything needing ToBoolean is
+            // the handler's, which also knows to take the safepoint.
+            int16_t off = operand_i16(c, 1);
+            uint32_t taken = pc + 3 + static_cast<uint32_t>(static_cast<int32_t>(off));
+            uint32_t fall = pc + 3;
+            bool on_true = op == Op::JumpIfTrue;
+            a_.mov_imm(RAX, bits_of(Value(on_true)));
+            a_.cmp(R12, RAX);
+            size_t not_taken = a_.jcc32(kNE);
+            if (off < 0) emit_safepoint(taken);
+            branch_to(taken);
+            a_.patch(not_taken, a_.here());
+            a_.mov_imm(RAX, bits_of(Value(!on_true)));
+            a_.cmp(R12, RAX);
+            cold.from.push_back(a_.jcc32(kNE));
+            if (fall == size_) branch_to(fall);
+            return true;
+        }
+        case Op::Add: case Op::Sub: case Op::Mul:
+        case Op::TestLt: case Op::TestGt: case Op::TestLe: case Op::TestGe:
+        case Op::TestEq: case Op::TestNe: case Op::TestStrictEq: case Op::TestStrictNe: {
+            // Two finite doubles, as in NUMERIC_BINARY_HANDLER; a result that
+            // overflows is recomputed by the handler, which boxes it. A site
+            // the threaded stream has only ever seen strings or objects at
+            // would fail the guards every time, so it is a plain call-out.
+            if (chunk_.threaded) {
+                uint8_t seen = chunk_.threaded->binary_feedback(pc);
+                if (seen != kBinaryNone && !(seen & kBinaryNumber)) return false;
+            }
+            a_.load(RAX, R13, reg_disp(c[1]));
+            // Two int32s first, as in the handler. Mul's has the -0 case on
+            // top of overflow, and is left to the handler.
+            size_t int_done = kNoLabel;
+            if (op != Op::Mul) {
+                size_t lhs_not_int = jump_unless_int32(RAX);
+                size_t acc_not_int = jump_unless_int32(R12);
+                if (op == Op::Add || op == Op::Sub) {
+                    if (op == Op::Add) a_.add32(RAX, R12); else a_.sub32(RAX, R12);
+                    cold.from.push_back(a_.jcc32(kO));
+                    box_int32_rax_into_acc();
+                } else {
+                    Cond icc = kE;
+                    switch (op) {
+                        case Op::TestLt: icc = kL; break;
+                        case Op::TestGt: icc = kG; break;
+                        case Op::TestLe: icc = kLE; break;
+                        case Op::TestGe: icc = kGE; break;
+                        case Op::TestNe: case Op::TestStrictNe: icc = kNE; break;
+                        default: icc = kE; break;
+                    }
+                    a_.cmp32(RAX, R12);
+                    a_.setcc_al(icc);
+                    a_.movzx_eax_al();
+                    a_.shl_imm(RAX, 48);
+                    a_.mov_imm(R12, bits_of(Value(false)));
+                    a_.or_(R12, RAX);
+                }
+                int_done = a_.jmp32();
+                a_.patch(lhs_not_int, a_.here());
+                a_.patch(acc_not_int, a_.here());
+            }
+            guard_finite(RAX, cold);
+            guard_finite(R12, cold);
+            a_.movq_to_xmm(0, RAX);
+            a_.movq_to_xmm(1, R12);
+            if (op == Op::Add || op == Op::Sub || op == Op::Mul) {
+                if (op == Op::Add) a_.addsd(0, 1);
+                else if (op == Op::Sub) a_.subsd(0, 1);
+                else a_.mulsd(0, 1);
+                a_.movq_from_xmm(RAX, 0);
+                guard_finite(RAX, cold);
+                a_.mov(R12, RAX);
+                if (int_done != kNoLabel) a_.patch(int_done, a_.here());
+                return true;
+            }
+            Cond cc = kE;
+            switch (op) {
+                case Op::TestLt: cc = kB; break;
+                case Op::TestGt: cc = kA; break;
+                case Op::TestLe: cc = kBE; break;
+                case Op::TestGe: cc = kAE; break;
+                case Op::TestNe: case Op::TestStrictNe: cc = kNE; break;
+                default: cc = kE; break;
+            }
+            // Neither side is NaN, so the flags need no parity check, and
+            // ucomisd already has +0 equal to -0 the way === does.
+            a_.ucomisd(0, 1);
+            a_.setcc_al(cc);
+            a_.movzx_eax_al();
+            a_.shl_imm(RAX, 48);  // false and true differ in the tag's low bit
+            a_.mov_imm(R12, bits_of(Value(false)));
+            a_.or_(R12, RAX);
+            if (int_done != kNoLabel) a_.patch(int_done, a_.here());
+            return true;
+        }
+        case Op::Inc:
+        case Op::Dec: {
+            size_t not_int = jump_unless_int32(R12);
+            a_.mov32(RAX, R12);
+            a_.add32_imm8(RAX, op == Op::Inc ? 1 : -1);
+            cold.from.push_back(a_.jcc32(kO));
+            box_int32_rax_into_acc();
+            size_t int_done = a_.jmp32();
+            a_.patch(not_int, a_.here());
+            guard_finite(R12, cold);
+            a_.movq_to_xmm(0, R12);
+            a_.mov_imm(RAX, bits_of(Value(1.0)));
+            a_.movq_to_xmm(1, RAX);
+            if (op == Op::Inc) a_.addsd(0, 1); else a_.subsd(0, 1);
+            a_.movq_from_xmm(R12, 0);
+            a_.patch(int_done, a_.here());
+            return true;
+        }
+        case Op::GetNamed:
+            a_.mov(RDI, RBX);
+            a_.mov_imm32(RSI, pc);
+            a_.call_abs(reinterpret_cast<const void*>(&get_named_ic));
+            a_.mov_imm(RCX, kIcMiss);
+            a_.cmp(RAX, RCX);
+            cold.from.push_back(a_.jcc32(kE));
+            a_.mov(R12, RAX);
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool Compiler::compile() {
+    out_.entries = std::make_unique<const void*[]>(size_ + 1);
+    out_.exit_code = std::make_unique<uint8_t[]>(size_);
+    std::memcpy(out_.exit_code.get(), code_, size_);
+
+    emit_prologue();
+    for (uint32_t pc = 0; pc < size_;) {
+        Op op = static_cast<Op>(code_[pc]);
+        if (static_cast<size_t>(op) >= static_cast<size_t>(Op::kCount)) return false;
+        uint32_t next = pc + 1 + static_cast<uint32_t>(op_operand_bytes(op));
+        if (next > size_) return false;
+        label_[pc] = a_.here();
+        Cold cold{{}, pc, op};
+        if (emit_native(pc, op, cold)) {
+            out_.exit_code[pc] = kBaselineExitByte;
+            out_.native_ops++;
+            if (!cold.from.empty()) cold_.push_back(std::move(cold));
+        } else {
+            emit_call_out(pc, op, /*fall_through=*/true);
+            out_.call_out_ops++;
+        }
+        pc = next;
+    }
+    // Running off the end cannot happen in compiled code -- every chunk ends
+    // in Return -- but a label has to exist for a jump that names it.
+    label_[size_] = a_.here();
+    trap_ = a_.here();
+    a_.ud2();
+
+    for (Cold& cold : cold_) {
+        size_t at = a_.here();
+        for (size_t from : cold.from) a_.patch(from, at);
+        emit_call_out(cold.pc, cold.op, /*fall_through=*/false);
+    }
+
+    resume_ = a_.here();
+    a_.cmp32_imm(RSI, kReturned);
+    size_t to_dispatch = a_.jcc32(kNE);
+    a_.patch(to_dispatch, dispatch_);
+    emit_epilogue();
+    for (size_t at : to_resume_) a_.patch(at, resume_);
+    for (const Fixup& fx : fixups_) {
+        if (fx.target_pc > size_ || label_[fx.target_pc] == kNoLabel) return false;
+        a_.patch(fx.at, label_[fx.target_pc]);
+    }
+
+    const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    const size_t mapped = (a_.buf.size() + page - 1) & ~(page - 1);
+    void* mem = mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) return false;
+    std::memcpy(mem, a_.buf.data(), a_.buf.size());
+    if (mprotect(mem, mapped, PROT_READ | PROT_EXEC) != 0) {
+        munmap(mem, mapped);
+        return false;
+    }
+    out_.code = mem;
+    out_.mapped_size = mapped;
+    auto* base = static_cast<const uint8_t*>(mem);
+    for (uint32_t pc = 0; pc <= size_; pc++) {
+        out_.entries[pc] = base + (label_[pc] == kNoLabel ? trap_ : label_[pc]);
+    }
+    return true;
+}
+
+// A chunk this large spends more on its pc-indexed entry table than the
+// native code saves it, and is rarely a loop body anyway.
+constexpr size_t kMaxBaselineCodeBytes = 1 << 16;
+
+#endif
+
+}
+
+bool baseline_enabled() {
+#ifdef QUANTA_BASELINE_X64
+    return g_baseline_on;
+#else
+    return false;
+#endif
+}
+
+BaselineCode::~BaselineCode() {
+#ifdef QUANTA_BASELINE_X64
+    if (code) munmap(code, mapped_size);
+#endif
+}
+
+void baseline_compile(const BytecodeChunk& chunk) {
+    chunk.baseline_budget = 0;
+#ifdef QUANTA_BASELINE_X64
+    if (!g_baseline_on || chunk.baseline) return;
+    if (chunk.code.size() == 0 || chunk.code.size() > kMaxBaselineCodeBytes) return;
+    auto out = std::make_unique<BaselineCode>();
+    Compiler compiler(chunk, *out);
+    if (!compiler.compile()) return;
+    // chunk.baseline is set on a const chunk the same way the interpreter
+    // fills in EnvBundle's interned keys: once, the first time it is needed.
+    const_cast<BytecodeChunk&>(chunk).baseline = std::move(out);
+#endif
+}
+
+Value baseline_exit(Frame& f, uint32_t pc, Value acc) {
+    f.pc = pc;
+    return acc;
+}
+
+Value baseline_enter(Frame& f, uint32_t pc, Value acc) {
+#ifdef QUANTA_BASELINE_X64
+    auto native = reinterpret_cast<NativeEntry>(f.baseline->code);
+    uint64_t result = native(&f, pc, bits_of(acc), f.regs, f.constants, &f.pc);
+    if (g_pending_exception) {
+        std::exception_ptr e = std::move(g_pending_exception);
+        g_pending_exception = nullptr;
+        std::rethrow_exception(e);
+    }
+    return std::bit_cast<Value>(result);
+#else
+    // Unreachable: nothing attaches a frame to native code without a backend.
+    (void)f; (void)pc;
+    return acc;
+#endif
+}
+
+}
+}
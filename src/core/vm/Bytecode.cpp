@@ -7,10 +7,12 @@
 #include "quanta/core/vm/Bytecode.h"
 #include "quanta/parser/AST.h"
 #include "quanta/core/gc/Visitor.h"
+#include "quanta/core/runtime/Shape.h"
 #include "quanta/parser/FunctionExecutable.h"
 #include <sstream>
 #include <cstdio>
 #include <cstdlib>
+#include <unordered_set>
 
 namespace Quanta {
 
@@ -18,26 +20,111 @@ namespace Quanta {
 // carries prebuilt ClosureTemplates, while treewalk_nodes goes away entirely
 // once the compiler can emit every construct that currently escapes
 // (Op::EvalAst).
+// baseline and threaded are the two pointers past the old 128: every chunk
+// pays for them, but a side table keyed by chunk would put a hash probe on
+// every call instead. call_feedback is the 16 past that, and for the same
+// reason: nearly every body has a call site. inlined is the 8 after it, and
+// is read on every register-mode call. classes is 8 more, beside closures.
+// liveness is the last 8, and only the collector ever reads it.
 #if defined(__GLIBCXX__)
-static_assert(sizeof(BytecodeChunk) == 128);
+static_assert(sizeof(BytecodeChunk) == 184);
 #else
-static_assert(sizeof(BytecodeChunk) <= 192);
+static_assert(sizeof(BytecodeChunk) <= 200);
 #endif
 
-BytecodeChunk::BytecodeChunk() = default;
-BytecodeChunk::~BytecodeChunk() = default;
+namespace {
+
+// Every chunk alive on this thread. Leaked, like Shape::root(): a chunk owned
+// by something torn down at thread exit may outlive a plain thread_local.
+std::unordered_set<BytecodeChunk*>& thread_chunks() {
+    static thread_local auto* chunks = new std::unordered_set<BytecodeChunk*>();
+    return *chunks;
+}
+
+bool dead_shape(const Shape* s) {
+    return s && !s->reached();
+}
+
+// Drops the entries `dead` picks out of the first `count`, keeping the rest
+// in order, and returns how many are left. The slots freed at the end are
+// reset, so what they held (a cached Value, a key) goes with them.
+template <typename Entry, size_t N, typename Dead>
+uint8_t compact_entries(std::array<Entry, N>& entries, uint8_t count, Dead dead) {
+    uint8_t kept = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        if (dead(entries[i])) continue;
+        if (kept != i) entries[kept] = std::move(entries[i]);
+        kept++;
+    }
+    for (uint8_t i = kept; i < count; i++) entries[i] = Entry{};
+    return kept;
+}
+
+}
+
+BytecodeChunk::BytecodeChunk() {
+    thread_chunks().insert(this);
+}
+
+BytecodeChunk::~BytecodeChunk() {
+    thread_chunks().erase(this);
+}
+
+void BytecodeChunk::drop_dead_shape(LookupCacheEntry& e) {
+    if (dead_shape(e.obj_shape)) e = LookupCacheEntry{};
+}
+
+void BytecodeChunk::drop_dead_shapes() {
+    for (BytecodeChunk* chunk : thread_chunks()) {
+        for (FeedbackSlot& fb : chunk->feedback) {
+            fb.count = compact_entries(fb.entries, fb.count,
+                [](const FeedbackSlot::Entry& e) { return dead_shape(e.shape); });
+            fb.transition_count = compact_entries(fb.transitions, fb.transition_count,
+                [](const FeedbackSlot::TransitionEntry& e) {
+                    return dead_shape(e.from_shape) || dead_shape(e.to_shape);
+                });
+            fb.proto_count = compact_entries(fb.proto_entries, fb.proto_count,
+                [](const FeedbackSlot::ProtoEntry& e) { return dead_shape(e.receiver_shape); });
+        }
+        if (chunk->ic_feedback) {
+            for (KeyedFeedback& kf : chunk->ic_feedback->keyed_feedback) {
+                kf.count = compact_entries(kf.entries, kf.count,
+                    [](const KeyedFeedback::Entry& e) { return dead_shape(e.shape); });
+            }
+        }
+        for (LookupCacheEntry& e : chunk->lookup_cache) drop_dead_shape(e);
+    }
+}
+
+void BytecodeChunk::note_keys_reached() {
+    for (BytecodeChunk* chunk : thread_chunks()) {
+        for (const std::string* name : chunk->names) Shape::note_key_reached(name);
+        if (!chunk->env) continue;
+        for (const std::string* key : chunk->env->env_param_keys) Shape::note_key_reached(key);
+        for (const std::string* key : chunk->env->env_local_keys) Shape::note_key_reached(key);
+        for (const auto& keys : chunk->env->loop_env_keys) {
+            for (const std::string* key : keys) Shape::note_key_reached(key);
+        }
+    }
+}
 
 std::vector<ClosureTemplate>& BytecodeChunk::ensure_closures() {
     if (!closures) closures = std::make_unique<std::vector<ClosureTemplate>>();
     return *closures;
 }
 
+std::vector<ClassTemplate>& BytecodeChunk::ensure_classes() {
+    if (!classes) classes = std::make_unique<std::vector<ClassTemplate>>();
+    return *classes;
+}
+
 void BytecodeChunk::trace(Visitor& v) const {
     for (const auto& c : constants) {
         v.visit(c);
     }
-    // feedback's Shape* fields need no tracing (immortal, not a GC cell), but
-    // every Object* in a cache entry is a real cell.
+    // feedback's Shape* fields need no tracing (not cells, and held weakly:
+    // see drop_dead_shapes), but every Object* in a cache entry is a real
+    // cell.
     for (const auto& fb : feedback) {
         for (uint8_t i = 0; i < fb.proto_count; i++) {
             v.visit_object(fb.proto_entries[i].holder);
@@ -59,6 +146,15 @@ void BytecodeChunk::trace(Visitor& v) const {
         v.visit_object(fb.own_desc_receiver);
         v.visit(fb.own_desc_value);
     }
+    for (const auto& cf : call_feedback) {
+        v.visit_object(cf.function);
+        v.visit_object(cf.target);
+        v.visit(cf.bound_this);
+    }
+    if (inlined) {
+        for (const auto& t : inlined->targets) v.visit_object(t.function);
+        if (inlined->variant) inlined->variant->trace(v);
+    }
 }
 
 namespace {
@@ -100,7 +196,7 @@ const OpInfo& op_info(Op op) {
         {"EvalAst", 2, 'z'},
         {"CopyRestProperties", 2, 'r'},
         {"CreateRestArray", 1, 'A'},
-        {"Call", 5, 'c'}, {"CallResolved", 6, 'v'}, {"Construct", 5, 'c'},
+        {"Call", 7, 'y'}, {"CallResolved", 8, 'v'}, {"Construct", 5, 'c'},
         {"CallSpread", 5, 'w'}, {"ConstructSpread", 4, 'W'}, {"SpreadInto", 2, 'r'}, {"ObjectSpreadInto", 1, 'r'}, {"HasPrivate", 2, 'n'},
         {"LdaEngineHelper", 1, 'E'},
         {"CreateRegExp", 4, 'X'},
@@ -135,7 +231,9 @@ const OpInfo& op_info(Op op) {
         {"ResolveBindingEnv", 3, 'n'},
         {"LdaResolvedEnv", 3, 'i'}, {"StaResolvedEnv", 3, 'i'},
         {"EnterParamEval", 1, 'i'}, {"SetDirectEval", 1, 'i'},
-        {"DefineClass", 2, 'z'}
+        {"DefineClass", 2, 'z'},
+        {"InlineGuard", 6, 'Y'},
+        {"CreateClass", 3, 'L'}, {"DefineClassMember", 5, 'M'}
     };
     static_assert(sizeof(table) / sizeof(table[0]) == static_cast<size_t>(Op::kCount),
                   "op_info table out of sync with Op enum");
@@ -147,6 +245,41 @@ const OpInfo& op_info(Op op) {
 int op_operand_bytes(Op op) { return op_info(op).operand_bytes; }
 char op_operand_kind(Op op) { return op_info(op).kind; }
 
+int op_jump_offset(Op op) {
+    switch (op_info(op).kind) {
+        case 'o': return 0;
+        case 'j': return 2;
+        case 'J': return 3;
+        case 'Y': return 4;
+        default: return -1;
+    }
+}
+
+RegisterOperands register_operands(Op op) {
+    RegisterOperands r;
+    auto reg = [&r](uint8_t i) { r.at[r.count++] = i; };
+    auto run = [&r](int8_t first, int8_t count) { r.run_first = first; r.run_count = count; };
+    const OpInfo& info = op_info(op);
+    switch (info.kind) {
+        case 'r': for (int i = 0; i < info.operand_bytes; i++) reg(static_cast<uint8_t>(i)); break;
+        case 'S': run(0, 1); break;
+        case 'c': case 'y': reg(0); run(1, 2); break;
+        case 'v': reg(0); reg(1); run(2, 3); break;
+        case 'w': reg(0); reg(1); reg(2); break;
+        case 'Y': case 'W': case 'x': case 'j': reg(0); reg(1); break;
+        case 'g': case 'f': case 'l': case 'm': case 's': case 'C': reg(0); break;
+        case 'J': case 'p': reg(0); reg(1); reg(2); break;
+        case 'I': reg(1); break;
+        case 'K': case 'N': reg(2); break;
+        case 'F': reg(3); break;
+        case 'G': reg(0); reg(5); break;
+        case 'L': reg(0); break;
+        case 'M': reg(0); reg(1); break;
+        default: break;
+    }
+    return r;
+}
+
 #ifdef QUANTA_VALIDATE_BYTECODE
 void validate_chunk_registers(const BytecodeChunk& chunk, const std::string& name) {
     const uint32_t limit = chunk.register_count;
@@ -188,9 +321,10 @@ void validate_chunk_registers(const BytecodeChunk& chunk, const std::string& nam
         switch (info.kind) {
             case 'r': for (int i = 0; i < info.operand_bytes; i++) check(i, "reads"); break;
             case 'S': check_run(0, 1); break;
-            case 'c': check(0, "calls"); check_run(1, 2); break;
+            case 'c': case 'y': check(0, "calls"); check_run(1, 2); break;
             case 'v': check(0, "calls"); check(1, "receiver"); check_run(2, 3); break;
             case 'w': check(0, "calls"); check(1, "receiver"); check(2, "spread array"); break;
+            case 'Y': check(0, "guards"); check(1, "receiver"); break;
             case 'W': check(0, "constructs"); check(1, "spread array"); break;
             case 'g': case 'f': case 'l': case 'm': case 's': check(0, "receiver"); break;
             case 'C': check(0, "closes the iterator in"); break;
@@ -202,6 +336,8 @@ void validate_chunk_registers(const BytecodeChunk& chunk, const std::string& nam
             case 'F': check(3, "stores into"); break;
             case 'G': check(0, "receiver"); check(5, "stores into"); break;
             case 'p': check(0, "reads"); check(1, "key"); check(2, "raw key"); break;
+            case 'L': check(0, "extends"); break;
+            case 'M': check(0, "defines on"); check(1, "key"); break;
             default: break;  // no register operands
         }
         pc = operand_pc + info.operand_bytes;
@@ -294,23 +430,39 @@ std::string disassemble_chunk(const BytecodeChunk& chunk, const std::string& nam
                 out << " " << EngineHelper::slot_name(
                     static_cast<EngineHelper::Kind>(chunk.code[operand_pc]));
                 break;
-            case 'c': {
+            case 'c': case 'y': {
                 uint16_t idx = static_cast<uint16_t>(chunk.code[operand_pc + 3]) |
                                (static_cast<uint16_t>(chunk.code[operand_pc + 4]) << 8);
                 out << " r" << static_cast<int>(chunk.code[operand_pc])
                     << " args=r" << static_cast<int>(chunk.code[operand_pc + 1])
                     << " argc=" << static_cast<int>(chunk.code[operand_pc + 2])
                     << " '" << chunk.name_at(idx) << "'";
+                if (info.kind == 'y') {
+                    out << " cf=" << (static_cast<uint16_t>(chunk.code[operand_pc + 5]) |
+                                      (static_cast<uint16_t>(chunk.code[operand_pc + 6]) << 8));
+                }
                 break;
             }
             case 'v': {
                 uint16_t name_idx = static_cast<uint16_t>(chunk.code[operand_pc + 4]) |
                                     (static_cast<uint16_t>(chunk.code[operand_pc + 5]) << 8);
+                uint16_t cf_idx = static_cast<uint16_t>(chunk.code[operand_pc + 6]) |
+                                  (static_cast<uint16_t>(chunk.code[operand_pc + 7]) << 8);
                 out << " func=r" << static_cast<int>(chunk.code[operand_pc])
                     << " this=r" << static_cast<int>(chunk.code[operand_pc + 1])
                     << " args=r" << static_cast<int>(chunk.code[operand_pc + 2])
                     << " argc=" << static_cast<int>(chunk.code[operand_pc + 3])
-                    << " '" << chunk.name_at(name_idx) << "'";
+                    << " '" << chunk.name_at(name_idx) << "' cf=" << cf_idx;
+                break;
+            }
+            case 'Y': {
+                uint16_t raw = static_cast<uint16_t>(chunk.code[operand_pc + 4]) |
+                               (static_cast<uint16_t>(chunk.code[operand_pc + 5]) << 8);
+                out << " r" << static_cast<int>(chunk.code[operand_pc])
+                    << " this=r" << static_cast<int>(chunk.code[operand_pc + 1])
+                    << " target=" << static_cast<int>(chunk.code[operand_pc + 2])
+                    << " flags=" << static_cast<int>(chunk.code[operand_pc + 3])
+                    << " else -> " << (operand_pc + 6 + static_cast<int16_t>(raw));
                 break;
             }
             case 'w': {
@@ -447,6 +599,31 @@ std::string disassemble_chunk(const BytecodeChunk& chunk, const std::string& nam
                     << " kind=" << static_cast<int>(chunk.code[operand_pc + 3]);
                 break;
             }
+            case 'L': {
+                uint16_t idx = static_cast<uint16_t>(chunk.code[operand_pc + 1]) |
+                               (static_cast<uint16_t>(chunk.code[operand_pc + 2]) << 8);
+                out << " r" << static_cast<int>(chunk.code[operand_pc]) << " [" << idx << "]";
+                if (chunk.classes && idx < chunk.classes->size())
+                    out << " ; class " << (*chunk.classes)[idx].constructor_name;
+                break;
+            }
+            case 'M': {
+                uint16_t idx = static_cast<uint16_t>(chunk.code[operand_pc + 2]) |
+                               (static_cast<uint16_t>(chunk.code[operand_pc + 3]) << 8);
+                const uint8_t member = chunk.code[operand_pc + 4];
+                out << " r" << static_cast<int>(chunk.code[operand_pc])
+                    << " key=r" << static_cast<int>(chunk.code[operand_pc + 1])
+                    << " [" << idx << "." << static_cast<int>(member) << "]";
+                if (chunk.classes && idx < chunk.classes->size() &&
+                    member < (*chunk.classes)[idx].members.size()) {
+                    const auto& m = (*chunk.classes)[idx].members[member];
+                    out << " ; " << (m.is_static ? "static " : "")
+                        << (m.kind == ClassTemplate::Member::Kind::Getter ? "get " :
+                            m.kind == ClassTemplate::Member::Kind::Setter ? "set " : "")
+                        << (m.is_computed ? "[computed]" : m.key);
+                }
+                break;
+            }
             case 'C':
                 // Second operand is a close mode, not a register.
                 out << " r" << static_cast<int>(chunk.code[operand_pc])
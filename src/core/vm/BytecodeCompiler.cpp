@@ -5,7 +5,9 @@
  */
 
 #include <cstdio>
+#include <cstdlib>
 #include "quanta/core/vm/BytecodeCompiler.h"
+#include "quanta/core/vm/BytecodePasses.h"
 #include <functional>
 #include "quanta/core/runtime/BigInt.h"
 #include <algorithm>
@@ -27,12 +29,53 @@ Value get_template_object(class TemplateLiteral* tmpl);
 // function literal instantiates from, so the compiled and interpreted paths
 // build closures from the identical data.
 ClosureTemplate closure_template_for(const ASTNode* literal);
+// And the same file's description of a class body Op::CreateClass can build;
+// false leaves the class to Op::DefineClass.
+bool class_template_for(const ClassDeclaration* node, ClassTemplate& tpl);
 
 
 namespace {
 
 constexpr int kMaxRegisters = 255;
 
+// QUANTA_VM_CLASSES=0 sends every class back through Op::DefineClass, for
+// comparing the two. Read once.
+const bool g_native_classes = [] {
+    const char* env = std::getenv("QUANTA_VM_CLASSES");
+    return !env || env[0] != '0';
+}();
+
+// ClassHeritage is strict code even in a sloppy function, and define_class
+// switches the context's mode around it. Compiled code reads the mode off the
+// context as it runs, so a heritage is compiled in place only when it cannot
+// tell: names, member reads and calls made of those, with no literal that
+// would come out a sloppy function.
+bool heritage_is_mode_neutral(const ASTNode* node) {
+    if (!node) return false;
+    switch (node->get_type()) {
+        case ASTNode::Type::IDENTIFIER:
+        case ASTNode::Type::NULL_LITERAL:
+        case ASTNode::Type::STRING_LITERAL:
+        case ASTNode::Type::NUMBER_LITERAL:
+            return true;
+        case ASTNode::Type::MEMBER_EXPRESSION: {
+            const auto* m = static_cast<const MemberExpression*>(node);
+            return heritage_is_mode_neutral(m->get_object()) &&
+                   (!m->is_computed() || heritage_is_mode_neutral(m->get_property()));
+        }
+        case ASTNode::Type::CALL_EXPRESSION: {
+            const auto* c = static_cast<const CallExpression*>(node);
+            if (c->is_optional() || !heritage_is_mode_neutral(c->get_callee())) return false;
+            for (const auto& arg : c->get_arguments()) {
+                if (!heritage_is_mode_neutral(arg.get())) return false;
+            }
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
 // Freezes the compiler's name pool into the chunk's interned form. This is the
 // one place a name's text is hashed; from here on every reader holds the
 // canonical pointer, which is what lets a binding lookup compare pointers
@@ -4132,11 +4175,13 @@ std::unique_ptr<BytecodeChunk> BytecodeCompiler::compile(
             compiler.chunk_->lookup_cache = FixedArray<BytecodeChunk::LookupCacheEntry>::filled(
                 static_cast<uint32_t>(compiler.names_.size()), BytecodeChunk::LookupCacheEntry{});
         }
+        compiler.run_passes();
         compiler.fuse_store_pairs();
         compiler.chunk_->code = FixedArray<uint8_t>::from(std::move(compiler.code_));
         compiler.chunk_->constants = FixedArray<Value>::from(std::move(compiler.constants_));
         compiler.chunk_->names = intern_name_pool(std::move(compiler.names_));
         compiler.chunk_->feedback = FixedArray<FeedbackSlot>::from(std::move(compiler.feedback_));
+        compiler.chunk_->call_feedback = FixedArray<CallFeedback>::filled(compiler.call_feedback_count_, CallFeedback{});
 #ifdef QUANTA_VALIDATE_BYTECODE
             if (compiler.chunk_) validate_chunk_registers(*compiler.chunk_, std::string());
 #endif
@@ -4198,11 +4243,13 @@ std::unique_ptr<BytecodeChunk> BytecodeCompiler::compile(
         compiler.chunk_->lookup_cache = FixedArray<BytecodeChunk::LookupCacheEntry>::filled(
             static_cast<uint32_t>(compiler.names_.size()), BytecodeChunk::LookupCacheEntry{});
     }
+    compiler.run_passes();
     compiler.fuse_store_pairs();
     compiler.chunk_->code = FixedArray<uint8_t>::from(std::move(compiler.code_));
     compiler.chunk_->constants = FixedArray<Value>::from(std::move(compiler.constants_));
     compiler.chunk_->names = intern_name_pool(std::move(compiler.names_));
     compiler.chunk_->feedback = FixedArray<FeedbackSlot>::from(std::move(compiler.feedback_));
+    compiler.chunk_->call_feedback = FixedArray<CallFeedback>::filled(compiler.call_feedback_count_, CallFeedback{});
 #ifdef QUANTA_VALIDATE_BYTECODE
         if (compiler.chunk_) validate_chunk_registers(*compiler.chunk_, std::string());
 #endif
@@ -4421,11 +4468,13 @@ std::unique_ptr<BytecodeChunk> BytecodeCompiler::compile_script(
         compiler.chunk_->lookup_cache = FixedArray<BytecodeChunk::LookupCacheEntry>::filled(
             static_cast<uint32_t>(compiler.names_.size()), BytecodeChunk::LookupCacheEntry{});
     }
+    compiler.run_passes();
     compiler.fuse_store_pairs();
     compiler.chunk_->code = FixedArray<uint8_t>::from(std::move(compiler.code_));
     compiler.chunk_->constants = FixedArray<Value>::from(std::move(compiler.constants_));
     compiler.chunk_->names = intern_name_pool(std::move(compiler.names_));
     compiler.chunk_->feedback = FixedArray<FeedbackSlot>::from(std::move(compiler.feedback_));
+    compiler.chunk_->call_feedback = FixedArray<CallFeedback>::filled(compiler.call_feedback_count_, CallFeedback{});
 #ifdef QUANTA_VALIDATE_BYTECODE
         if (compiler.chunk_) validate_chunk_registers(*compiler.chunk_, std::string());
 #endif
@@ -4814,6 +4863,61 @@ bool BytecodeCompiler::declare_local(const std::string& name) {
     return true;
 }
 
+// Op::CreateClass for the class itself, then one Op::DefineClassMember per
+// method in source order, a computed key evaluated just ahead of the method it
+// names -- ClassDefinitionEvaluation's order. The heritage goes first, before
+// any key, which is the spec's order and define_class's too.
+// Leaves the constructor in the accumulator. 1 when emitted, 0 when the class
+// is one for Op::DefineClass (nothing emitted), -1 when compiling failed.
+int BytecodeCompiler::emit_class_definition(const ClassDeclaration* cd) {
+    if (!g_native_classes) return 0;
+    if (cd->has_superclass() && !heritage_is_mode_neutral(cd->get_superclass())) return 0;
+    if (chunk_->classes && chunk_->classes->size() >= 0xFFFF) return 0;
+    ClassTemplate tpl;
+    if (!class_template_for(cd, tpl)) return 0;
+    const bool has_heritage = tpl.has_heritage;
+    auto& classes = chunk_->ensure_classes();
+    const auto idx = static_cast<uint16_t>(classes.size());
+    classes.push_back(std::move(tpl));
+
+    int class_reg = alloc_temp();
+    if (failed_) return -1;
+    if (has_heritage) {
+        if (!compile_expression(cd->get_superclass())) return -1;
+        emit(Op::Star);
+        emit_u8(static_cast<uint8_t>(class_reg));
+    }
+    emit(Op::CreateClass);
+    emit_u8(static_cast<uint8_t>(class_reg));
+    emit_u16(idx);
+    emit(Op::Star);
+    emit_u8(static_cast<uint8_t>(class_reg));
+
+    uint8_t member = 0;
+    for (const auto& stmt : cd->get_body()->get_statements()) {
+        const auto* method = static_cast<const MethodDefinition*>(stmt.get());
+        if (method->is_constructor()) continue;
+        int key_reg = class_reg;
+        if (method->is_computed()) {
+            key_reg = alloc_temp();
+            if (failed_) return -1;
+            if (!compile_expression(method->get_key())) return -1;
+            emit(Op::Star);
+            emit_u8(static_cast<uint8_t>(key_reg));
+        }
+        emit(Op::DefineClassMember);
+        emit_u8(static_cast<uint8_t>(class_reg));
+        emit_u8(static_cast<uint8_t>(key_reg));
+        emit_u16(idx);
+        emit_u8(member++);
+        if (key_reg != class_reg) free_temp(key_reg);
+    }
+    emit(Op::Ldar);
+    emit_u8(static_cast<uint8_t>(class_reg));
+    free_temp(class_reg);
+    return failed_ ? -1 : 1;
+}
+
 int BytecodeCompiler::alloc_temp() {
     if (next_register_ >= kMaxRegisters) { failed_ = true; return 0; }
     int reg = next_register_++;
@@ -4924,14 +5028,11 @@ Op fused_store_form(Op producer) {
     }
 }
 
-// Where an instruction of this kind keeps its jump offset, or -1 for the ones
-// that hold none. Both forms are relative to the byte after the offset.
-int jump_offset_at(char kind) {
-    if (kind == 'o') return 0;
-    if (kind == 'j') return 2;
-    if (kind == 'J') return 3;
-    return -1;
 }
+
+void BytecodeCompiler::run_passes() {
+    if (failed_ || !chunk_) return;
+    VM::optimize_bytecode(code_, constants_, *chunk_);
 }
 
 void BytecodeCompiler::fuse_store_pairs() {
@@ -4952,7 +5053,7 @@ void BytecodeCompiler::fuse_store_pairs() {
     // names would pull code into a try region that was not in it.
     std::vector<bool> pinned(n + 1, false);
     for (uint32_t s : starts) {
-        const int off_at = jump_offset_at(op_operand_kind(static_cast<Op>(code_[s])));
+        const int off_at = op_jump_offset(static_cast<Op>(code_[s]));
         if (off_at < 0) continue;
         const size_t off_pos = s + 1 + static_cast<size_t>(off_at);
         const int16_t off = static_cast<int16_t>(
@@ -5010,7 +5111,7 @@ void BytecodeCompiler::fuse_store_pairs() {
     // the new one. Only shrinking happens here, so an offset that fit before
     // still fits.
     for (const auto& [new_pc, old_pc] : placed) {
-        const int off_at = jump_offset_at(op_operand_kind(static_cast<Op>(out[new_pc])));
+        const int off_at = op_jump_offset(static_cast<Op>(out[new_pc]));
         if (off_at < 0) continue;
         const size_t old_off_pos = old_pc + 1 + static_cast<size_t>(off_at);
         const int16_t old_off = static_cast<int16_t>(
@@ -5091,6 +5192,13 @@ uint16_t BytecodeCompiler::alloc_feedback_slot() {
     return static_cast<uint16_t>(feedback_.size() - 1);
 }
 
+// Only counted here: a call site's slot starts out empty, so the array is
+// built at its final length in one go when the chunk is frozen.
+uint16_t BytecodeCompiler::alloc_call_feedback() {
+    if (call_feedback_count_ >= 0xFFFF) { failed_ = true; return 0; }
+    return static_cast<uint16_t>(call_feedback_count_++);
+}
+
 uint16_t BytecodeCompiler::alloc_private_feedback() {
     auto& pf = chunk_->ensure_ic_feedback().private_feedback;
     if (pf.size() >= 0xFFFF) { failed_ = true; return 0; }
@@ -7007,6 +7115,27 @@ bool BytecodeCompiler::compile_statement(const ASTNode* node) {
             // ctx.create_lexical_binding() on the environment directly, so a
             // register-resident name is never written -- force it here.
             if (!env_mode_) return false;
+            const auto* cd = static_cast<const ClassDeclaration*>(node);
+            const Identifier* class_id = cd->get_id();
+            // Built in place, the class is only a value: the name is bound
+            // here, the way a let is. A name that is neither a register nor
+            // an env local, nor a script's own, is left to define_class.
+            if (class_id && !class_id->get_name().empty() &&
+                (env_names_.count(class_id->get_name()) ||
+                 lookup_local(class_id->get_name()) >= 0 || script_mode_)) {
+                int built = emit_class_definition(cd);
+                if (built < 0) return false;
+                if (built > 0) {
+                    const std::string& name = class_id->get_name();
+                    if (!env_names_.count(name) && lookup_local(name) < 0) {
+                        emit(Op::StaEnvInit);
+                        emit_u16(add_name(name));
+                    } else {
+                        emit_write_local(name, /*is_declaration=*/true);
+                    }
+                    return !failed_;
+                }
+            }
             if (chunk_->ensure_treewalk_nodes().size() >= 0xFFFF) return false;
             chunk_->ensure_treewalk_nodes().push_back(node);
             emit(Op::DefineClass);
@@ -7015,7 +7144,6 @@ bool BytecodeCompiler::compile_statement(const ASTNode* node) {
             // has to mirror it into a register when the name has one. A module
             // or script top level has neither a register nor an env slot for
             // it, and asking for one there used to yield register -1.
-            const Identifier* class_id = static_cast<const ClassDeclaration*>(node)->get_id();
             if (class_id && !class_id->get_name().empty() &&
                 !env_names_.count(class_id->get_name()) &&
                 lookup_local(class_id->get_name()) >= 0) {
@@ -7094,6 +7222,10 @@ bool BytecodeCompiler::compile_expression(const ASTNode* node, bool discard) {
                        !(v == 0.0 && std::signbit(v))) {
                 emit(Op::LdaSmi);
                 emit_u8(static_cast<uint8_t>(static_cast<int8_t>(v)));
+            } else if (v == std::trunc(v) && v >= INT32_MIN && v <= INT32_MAX && v != 0.0) {
+                // The int32 form, so a loop bound meets its counter on the
+                // fast path. Not -0, which has none.
+                emit_load_const(Value::from_int32(static_cast<int32_t>(v)));
             } else {
                 emit_load_const(Value(v));
             }
@@ -8351,6 +8483,7 @@ bool BytecodeCompiler::compile_expression(const ASTNode* node, bool discard) {
                 emit_u8(static_cast<uint8_t>(args_start));
                 emit_u8(argc);
                 emit_u16(add_name(method_name));
+                emit_u16(alloc_call_feedback());
                 free_temp(obj_reg);
                 return !failed_;
             }
@@ -8467,6 +8600,7 @@ bool BytecodeCompiler::compile_expression(const ASTNode* node, bool discard) {
             emit_u8(static_cast<uint8_t>(args_start));
             emit_u8(argc);
             emit_u16(add_name(callee_name));
+            if (!direct_eval) emit_u16(alloc_call_feedback());
             free_temp(callee_reg);
             return !failed_;
         }
@@ -8586,12 +8720,14 @@ bool BytecodeCompiler::compile_expression(const ASTNode* node, bool discard) {
             return true;
         }
 
-        // A class expression is not a function literal: evaluate() builds the
-        // whole class (heritage, methods, fields, private brands), none of
-        // which the compiler can emit yet -- so it goes through the generic
-        // tree-walk escape, not CreateClosure.
+        // A class expression is not a function literal. One made of methods
+        // alone is built in place (emit_class_definition); fields, static
+        // blocks and private names still go to define_class whole.
         case ASTNode::Type::CLASS_DECLARATION: {
             if (!env_mode_) return false;
+            int built = emit_class_definition(static_cast<const ClassDeclaration*>(node));
+            if (built < 0) return false;
+            if (built > 0) return true;
             if (chunk_->ensure_treewalk_nodes().size() >= 0xFFFF) return false;
             chunk_->ensure_treewalk_nodes().push_back(node);
             emit(Op::DefineClass);
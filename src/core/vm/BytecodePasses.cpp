@@ -0,0 +1,982 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "quanta/core/vm/BytecodePasses.h"
+#include "quanta/core/vm/Bytecode.h"
+#include "quanta/core/runtime/Value.h"
+#include <algorithm>
+#include <bitset>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace Quanta {
+namespace VM {
+
+namespace {
+
+const bool g_passes_on = [] {
+    const char* env = std::getenv("QUANTA_VM_PASSES");
+    if (!env) return true;
+    return env[0] != '0';
+}();
+
+const bool g_report = [] {
+    const char* env = std::getenv("QUANTA_VM_DISASM");
+    return env && env[0] == '1';
+}();
+
+// FinalizeStaticProperty's, the widest operand run there is.
+constexpr int kMaxOperandBytes = 8;
+
+// Liveness keeps a set per instruction; past this many a body (in practice a
+// large script) costs more to analyse than the stores it would lose.
+constexpr size_t kMaxLivenessInsns = 16384;
+
+// One instruction, decoded. A jump holds its target as an instruction index,
+// so passes can drop and rewrite instructions without re-measuring offsets;
+// the encoder measures them once at the end. A dropped instruction stays in
+// place, marked dead: anything aimed at it lands on the next live one.
+struct Insn {
+    Op op;
+    uint8_t width;
+    uint8_t operand[kMaxOperandBytes];
+    int32_t target = -1;
+    bool dead = false;
+};
+
+// A HandlerEntry, in instruction indices.
+struct Region {
+    int32_t start, end, handler, genreturn;
+};
+
+struct Body {
+    std::vector<Insn> insns;
+    std::vector<Region> regions;
+    uint16_t register_count = 0;
+    uint8_t parameter_count = 0;
+    bool needs_arguments = false;
+
+    int32_t size() const { return static_cast<int32_t>(insns.size()); }
+    int32_t live_at(int32_t i) const {
+        while (i < size() && insns[i].dead) i++;
+        return i;
+    }
+    int32_t next_live(int32_t i) const { return live_at(i + 1); }
+};
+
+inline uint16_t u16_at(const uint8_t* p) {
+    return static_cast<uint16_t>(p[0]) | (static_cast<uint16_t>(p[1]) << 8);
+}
+
+bool is_terminator(Op op) {
+    return op == Op::Return || op == Op::Throw || op == Op::ReraiseGeneratorReturn;
+}
+
+bool is_plain_jump(Op op) {
+    return op_operand_kind(op) == 'o';
+}
+
+bool decode(const uint8_t* code, size_t n, const BytecodeChunk& chunk, Body& b) {
+    std::vector<int32_t> index_of(n + 1, -1);
+    std::vector<int64_t> target_pc;
+    for (size_t pc = 0; pc < n;) {
+        const Op op = static_cast<Op>(code[pc]);
+        if (op >= Op::kCount) return false;
+        const int width = op_operand_bytes(op);
+        if (width > kMaxOperandBytes || pc + 1 + static_cast<size_t>(width) > n) return false;
+        Insn in;
+        in.op = op;
+        in.width = static_cast<uint8_t>(width);
+        std::memcpy(in.operand, &code[pc + 1], static_cast<size_t>(width));
+        index_of[pc] = b.size();
+        const int off_at = op_jump_offset(op);
+        int64_t target = -1;
+        if (off_at >= 0) {
+            const size_t at = pc + 1 + static_cast<size_t>(off_at);
+            target = static_cast<int64_t>(at) + 2 + static_cast<int16_t>(u16_at(&code[at]));
+            if (target < 0 || target > static_cast<int64_t>(n)) return false;
+        }
+        target_pc.push_back(target);
+        b.insns.push_back(in);
+        pc += 1 + static_cast<size_t>(width);
+    }
+    index_of[n] = b.size();
+    for (int32_t i = 0; i < b.size(); i++) {
+        if (target_pc[i] < 0) continue;
+        b.insns[i].target = index_of[static_cast<size_t>(target_pc[i])];
+        if (b.insns[i].target < 0) return false;
+    }
+    if (chunk.handlers) {
+        auto index = [&](int64_t pc) -> int32_t {
+            return pc >= 0 && pc <= static_cast<int64_t>(n) ? index_of[static_cast<size_t>(pc)] : -1;
+        };
+        for (const HandlerEntry& h : *chunk.handlers) {
+            Region r{index(h.start_pc), index(h.end_pc), index(h.handler_pc),
+                     h.genreturn_pc >= 0 ? index(h.genreturn_pc) : -2};
+            if (r.start < 0 || r.end < 0 || r.handler < 0 || r.genreturn == -1) return false;
+            if (r.genreturn == -2) r.genreturn = -1;
+            b.regions.push_back(r);
+        }
+    }
+    b.register_count = chunk.register_count;
+    b.parameter_count = chunk.parameter_count;
+    b.needs_arguments = chunk.needs_arguments;
+    return true;
+}
+
+bool encode(const Body& b, std::vector<uint8_t>& out, std::vector<HandlerEntry>* handlers) {
+    std::vector<uint32_t> at(b.insns.size() + 1);
+    uint32_t pos = 0;
+    for (int32_t i = 0; i < b.size(); i++) {
+        at[i] = pos;
+        if (!b.insns[i].dead) pos += 1 + b.insns[i].width;
+    }
+    at[b.insns.size()] = pos;
+
+    out.clear();
+    out.reserve(pos);
+    for (int32_t i = 0; i < b.size(); i++) {
+        const Insn& in = b.insns[i];
+        if (in.dead) continue;
+        out.push_back(static_cast<uint8_t>(in.op));
+        out.insert(out.end(), in.operand, in.operand + in.width);
+        const int off_at = op_jump_offset(in.op);
+        if (off_at < 0) continue;
+        const uint32_t off_pos = at[i] + 1 + static_cast<uint32_t>(off_at);
+        const int64_t delta = static_cast<int64_t>(at[in.target]) - static_cast<int64_t>(off_pos + 2);
+        if (delta < INT16_MIN || delta > INT16_MAX) return false;
+        const uint16_t enc = static_cast<uint16_t>(static_cast<int16_t>(delta));
+        out[off_pos] = static_cast<uint8_t>(enc & 0xFF);
+        out[off_pos + 1] = static_cast<uint8_t>(enc >> 8);
+    }
+
+    if (!handlers) return true;
+    // The interpreter picks the narrowest region covering a throw. Two nested
+    // regions that differed only by instructions dropped here would tie, and
+    // the tie goes to list order rather than to the inner one.
+    for (size_t x = 0; x < b.regions.size(); x++) {
+        for (size_t y = x + 1; y < b.regions.size(); y++) {
+            const Region& p = b.regions[x];
+            const Region& q = b.regions[y];
+            const bool same_before = p.start == q.start && p.end == q.end;
+            const bool same_after = at[p.start] == at[q.start] && at[p.end] == at[q.end];
+            if (same_after && !same_before) return false;
+        }
+    }
+    for (size_t x = 0; x < b.regions.size(); x++) {
+        const Region& r = b.regions[x];
+        HandlerEntry& h = (*handlers)[x];
+        h.start_pc = at[r.start];
+        h.end_pc = at[r.end];
+        h.handler_pc = at[r.handler];
+        if (r.genreturn >= 0) h.genreturn_pc = static_cast<int32_t>(at[r.genreturn]);
+    }
+    return true;
+}
+
+// What an instruction does to the frame. An opaque one is assumed to read
+// every register and the accumulator and to leave nothing known about
+// either; everything else is exactly its listed reads and writes. Operand
+// positions are byte offsets into Insn::operand.
+struct Effect {
+    bool opaque = true;
+    bool reads_acc = false;
+    // Leaves something other than what it found in the accumulator. Set, with
+    // reads_acc, on the stores that may or may not hand their value back:
+    // saying it is overwritten is the answer that cannot be wrong.
+    bool writes_acc = false;
+    // Has no effect beyond its one write, so it can go when that is dead.
+    bool removable = false;
+    uint8_t uses = 0;
+    uint8_t use_at[3] = {};
+    int8_t run_first = -1;
+    int8_t run_count = -1;
+    int8_t def_at = -1;
+};
+
+Effect effect_of(const Insn& in) {
+    Effect e;
+    auto known = [&e](bool reads_acc, bool writes_acc) {
+        e.opaque = false;
+        e.reads_acc = reads_acc;
+        e.writes_acc = writes_acc;
+    };
+    auto use = [&e](uint8_t at) { e.use_at[e.uses++] = at; };
+    switch (in.op) {
+        case Op::LdaConst: case Op::LdaConstWide: case Op::LdaZero: case Op::LdaSmi:
+        case Op::LdaUndefined: case Op::LdaNull: case Op::LdaTrue: case Op::LdaFalse:
+        case Op::LdaTdz:
+            known(false, true);
+            e.removable = true;
+            break;
+        case Op::Ldar:
+            known(false, true);
+            use(0);
+            e.removable = true;
+            break;
+        case Op::Star:
+            known(true, false);
+            e.def_at = 0;
+            e.removable = true;
+            break;
+        case Op::Mov:
+            known(false, false);
+            use(0);
+            e.def_at = 1;
+            e.removable = true;
+            break;
+        case Op::LdaThis:
+        case Op::LdaLookup: case Op::LdaLookupTypeof: case Op::LdaEnv: case Op::LdaEnvSlot:
+        case Op::CreateObject: case Op::CreateArray:
+            known(false, true);
+            break;
+        case Op::LdarChecked:
+            known(false, true);
+            use(0);
+            break;
+        case Op::StarChecked:
+            known(true, false);
+            use(0);
+            e.def_at = 0;
+            break;
+        case Op::Add: case Op::Sub: case Op::Mul: case Op::Div: case Op::Mod: case Op::Exp:
+        case Op::BitAnd: case Op::BitOr: case Op::BitXor:
+        case Op::Shl: case Op::Shr: case Op::Sar:
+        case Op::TestEq: case Op::TestNe: case Op::TestStrictEq: case Op::TestStrictNe:
+        case Op::TestLt: case Op::TestGt: case Op::TestLe: case Op::TestGe:
+        case Op::TestInstanceOf: case Op::TestIn:
+            known(true, true);
+            use(0);
+            break;
+        case Op::Neg: case Op::LogicalNot: case Op::BitNot: case Op::TypeOf:
+        case Op::ToNumber: case Op::ToNumeric: case Op::Inc: case Op::Dec:
+        case Op::ToTemplateString: case Op::ToPropertyKey: case Op::ToPropertyKeyStrict:
+        case Op::CheckObjectCoercible:
+        case Op::StaLookup: case Op::StaEnv: case Op::StaEnvInit:
+        case Op::StaEnvSlot: case Op::StaEnvSlotInit:
+            known(true, true);
+            break;
+        case Op::Jump:
+            known(false, false);
+            break;
+        case Op::JumpIfTrue: case Op::JumpIfFalse: case Op::JumpIfNullish:
+        case Op::JumpIfNotNullish: case Op::JumpIfNotUndefined:
+        case Op::Return: case Op::Throw:
+            known(true, false);
+            break;
+        case Op::GetNamed:
+            known(false, true);
+            use(0);
+            break;
+        case Op::SetNamed: case Op::DefineOwn: case Op::GetKeyed:
+            known(true, true);
+            use(0);
+            break;
+        case Op::SetKeyed:
+            known(true, true);
+            use(0);
+            use(1);
+            break;
+        case Op::Call: case Op::Construct:
+            known(false, true);
+            use(0);
+            e.run_first = 1;
+            e.run_count = 2;
+            break;
+        case Op::CallResolved:
+            known(false, true);
+            use(0);
+            use(1);
+            e.run_first = 2;
+            e.run_count = 3;
+            break;
+        default:
+            break;
+    }
+    return e;
+}
+
+// Where control goes after `i`, besides an exception: up to two live indices.
+int successors(const Body& b, int32_t i, int32_t out[2]) {
+    const Insn& in = b.insns[i];
+    int n = 0;
+    if (is_terminator(in.op)) return 0;
+    if (in.target >= 0) {
+        const int32_t t = b.live_at(in.target);
+        if (t < b.size()) out[n++] = t;
+        if (in.op == Op::Jump) return n;
+    }
+    const int32_t next = b.next_live(i);
+    if (next < b.size()) out[n++] = next;
+    return n;
+}
+
+// Instructions a block starts at: where control can arrive other than by
+// falling through, and after anything that does not fall through. Facts the
+// block-local passes carry are dropped at each.
+std::vector<bool> block_starts(const Body& b) {
+    std::vector<bool> starts(b.insns.size() + 1, false);
+    starts[b.live_at(0)] = true;
+    for (int32_t i = 0; i < b.size(); i++) {
+        const Insn& in = b.insns[i];
+        if (in.dead) continue;
+        if (in.target >= 0) starts[b.live_at(in.target)] = true;
+        if (in.target >= 0 || is_terminator(in.op)) starts[b.next_live(i)] = true;
+    }
+    for (const Region& r : b.regions) {
+        starts[b.live_at(r.start)] = true;
+        starts[b.live_at(r.end)] = true;
+        starts[b.live_at(r.handler)] = true;
+        if (r.genreturn >= 0) starts[b.live_at(r.genreturn)] = true;
+    }
+    return starts;
+}
+
+// --- fold -----------------------------------------------------------------
+
+struct Known {
+    enum Kind : uint8_t { None, Int, True, False, Undefined, Null };
+    Kind kind = None;
+    int32_t v = 0;
+
+    static Known of_int(int64_t x) {
+        Known k;
+        if (x >= INT32_MIN && x <= INT32_MAX) { k.kind = Int; k.v = static_cast<int32_t>(x); }
+        return k;
+    }
+    static Known of_bool(bool t) { Known k; k.kind = t ? True : False; return k; }
+    bool known() const { return kind != None; }
+    bool truthy() const { return kind == True || (kind == Int && v != 0); }
+    bool nullish() const { return kind == Undefined || kind == Null; }
+};
+
+Known known_constant(const Value& c) {
+    if (c.is_int32()) return Known::of_int(c.as_int32());
+    if (!c.is_number()) return Known{};
+    const double d = c.as_number();
+    if (d != std::trunc(d) || d < INT32_MIN || d > INT32_MAX || (d == 0.0 && std::signbit(d))) {
+        return Known{};
+    }
+    return Known::of_int(static_cast<int64_t>(d));
+}
+
+Known known_load(const Insn& in, const std::vector<Value>& constants) {
+    switch (in.op) {
+        case Op::LdaZero: return Known::of_int(0);
+        case Op::LdaSmi: return Known::of_int(static_cast<int8_t>(in.operand[0]));
+        case Op::LdaTrue: return Known::of_bool(true);
+        case Op::LdaFalse: return Known::of_bool(false);
+        case Op::LdaUndefined: { Known k; k.kind = Known::Undefined; return k; }
+        case Op::LdaNull: { Known k; k.kind = Known::Null; return k; }
+        case Op::LdaConst: {
+            const uint16_t idx = u16_at(in.operand);
+            return idx < constants.size() ? known_constant(constants[idx]) : Known{};
+        }
+        default: return Known{};
+    }
+}
+
+// Rewrites `in` as the load of `k`. `wide_ok` allows an int that needs a
+// constant-pool entry; a rewrite that would only trade one two-byte load for
+// a three-byte one passes false.
+bool load_known(Insn& in, Known k, std::vector<Value>& constants, bool wide_ok) {
+    in.target = -1;
+    switch (k.kind) {
+        case Known::Int:
+            if (k.v == 0) { in.op = Op::LdaZero; in.width = 0; return true; }
+            if (k.v >= INT8_MIN && k.v <= INT8_MAX) {
+                in.op = Op::LdaSmi;
+                in.width = 1;
+                in.operand[0] = static_cast<uint8_t>(static_cast<int8_t>(k.v));
+                return true;
+            }
+            if (!wide_ok || constants.size() >= 0xFFFF) return false;
+            constants.push_back(Value::from_int32(k.v));
+            in.op = Op::LdaConst;
+            in.width = 2;
+            in.operand[0] = static_cast<uint8_t>((constants.size() - 1) & 0xFF);
+            in.operand[1] = static_cast<uint8_t>((constants.size() - 1) >> 8);
+            return true;
+        case Known::True: in.op = Op::LdaTrue; in.width = 0; return true;
+        case Known::False: in.op = Op::LdaFalse; in.width = 0; return true;
+        case Known::Undefined: in.op = Op::LdaUndefined; in.width = 0; return true;
+        case Known::Null: in.op = Op::LdaNull; in.width = 0; return true;
+        default: return false;
+    }
+}
+
+// lhs is the register operand, rhs the accumulator, as the handlers have it.
+Known fold_binary(Op op, Known lhs, Known rhs) {
+    if (lhs.kind == Known::Int && rhs.kind == Known::Int) {
+        const int64_t a = lhs.v, b = rhs.v;
+        const uint32_t shift = static_cast<uint32_t>(b) & 31;
+        switch (op) {
+            case Op::Add: return Known::of_int(a + b);
+            case Op::Sub: return Known::of_int(a - b);
+            // A zero product with a negative factor is -0, which is no int32.
+            case Op::Mul: return (a * b == 0 && (a < 0 || b < 0)) ? Known{} : Known::of_int(a * b);
+            case Op::BitAnd: return Known::of_int(lhs.v & rhs.v);
+            case Op::BitOr: return Known::of_int(lhs.v | rhs.v);
+            case Op::BitXor: return Known::of_int(lhs.v ^ rhs.v);
+            case Op::Shl: return Known::of_int(static_cast<int32_t>(static_cast<uint32_t>(lhs.v) << shift));
+            case Op::Sar: return Known::of_int(lhs.v >> shift);
+            case Op::Shr: return Known::of_int(static_cast<int64_t>(static_cast<uint32_t>(lhs.v) >> shift));
+            case Op::TestEq: case Op::TestStrictEq: return Known::of_bool(a == b);
+            case Op::TestNe: case Op::TestStrictNe: return Known::of_bool(a != b);
+            case Op::TestLt: return Known::of_bool(a < b);
+            case Op::TestGt: return Known::of_bool(a > b);
+            case Op::TestLe: return Known::of_bool(a <= b);
+            case Op::TestGe: return Known::of_bool(a >= b);
+            default: return Known{};
+        }
+    }
+    if (!lhs.known() || !rhs.known()) return Known{};
+    const bool same = lhs.kind == rhs.kind && (lhs.kind != Known::Int || lhs.v == rhs.v);
+    switch (op) {
+        case Op::TestStrictEq: return Known::of_bool(same);
+        case Op::TestStrictNe: return Known::of_bool(!same);
+        case Op::TestEq: case Op::TestNe: {
+            // Only what needs no conversion: null and undefined equal each
+            // other and nothing else.
+            if (!lhs.nullish() && !rhs.nullish()) return same ? Known::of_bool(op == Op::TestEq) : Known{};
+            const bool eq = lhs.nullish() && rhs.nullish();
+            return Known::of_bool(op == Op::TestEq ? eq : !eq);
+        }
+        default: return Known{};
+    }
+}
+
+uint32_t fold(Body& b, std::vector<Value>& constants) {
+    const std::vector<bool> starts = block_starts(b);
+    uint32_t changed = 0;
+    Known acc;
+    std::vector<Known> regs(256);
+    auto forget = [&] { acc = Known{}; std::fill(regs.begin(), regs.end(), Known{}); };
+    for (int32_t i = 0; i < b.size(); i++) {
+        Insn& in = b.insns[i];
+        if (in.dead) continue;
+        if (starts[i]) forget();
+        const Effect e = effect_of(in);
+        if (e.opaque) { forget(); continue; }
+        switch (in.op) {
+            case Op::Ldar: {
+                const Known k = regs[in.operand[0]];
+                if (k.known() && load_known(in, k, constants, false)) changed++;
+                acc = k;
+                continue;
+            }
+            case Op::Star:
+                regs[in.operand[0]] = acc;
+                continue;
+            case Op::Mov:
+                regs[in.operand[1]] = regs[in.operand[0]];
+                continue;
+            case Op::Add: case Op::Sub: case Op::Mul:
+            case Op::BitAnd: case Op::BitOr: case Op::BitXor:
+            case Op::Shl: case Op::Shr: case Op::Sar:
+            case Op::TestEq: case Op::TestNe: case Op::TestStrictEq: case Op::TestStrictNe:
+            case Op::TestLt: case Op::TestGt: case Op::TestLe: case Op::TestGe: {
+                const Known k = fold_binary(in.op, regs[in.operand[0]], acc);
+                if (k.known() && load_known(in, k, constants, true)) changed++;
+                acc = k;
+                continue;
+            }
+            case Op::Neg: case Op::BitNot: case Op::Inc: case Op::Dec: case Op::LogicalNot: {
+                Known k;
+                if (in.op == Op::LogicalNot && acc.known()) {
+                    k = Known::of_bool(!acc.truthy());
+                } else if (acc.kind == Known::Int) {
+                    const int64_t v = acc.v;
+                    if (in.op == Op::BitNot) k = Known::of_int(~acc.v);
+                    else if (in.op == Op::Inc) k = Known::of_int(v + 1);
+                    else if (in.op == Op::Dec) k = Known::of_int(v - 1);
+                    else if (v != 0) k = Known::of_int(-v);  // -0 is no int32
+                }
+                if (k.known() && load_known(in, k, constants, true)) changed++;
+                acc = k;
+                continue;
+            }
+            case Op::ToNumber: case Op::ToNumeric:
+                if (acc.kind == Known::Int) { in.dead = true; changed++; }
+                else acc = Known{};
+                continue;
+            case Op::JumpIfTrue: case Op::JumpIfFalse: case Op::JumpIfNullish:
+            case Op::JumpIfNotNullish: case Op::JumpIfNotUndefined: {
+                if (!acc.known()) continue;
+                bool taken = false;
+                switch (in.op) {
+                    case Op::JumpIfTrue: taken = acc.truthy(); break;
+                    case Op::JumpIfFalse: taken = !acc.truthy(); break;
+                    case Op::JumpIfNullish: taken = acc.nullish(); break;
+                    case Op::JumpIfNotNullish: taken = !acc.nullish(); break;
+                    default: taken = acc.kind != Known::Undefined; break;
+                }
+                if (taken) in.op = Op::Jump;
+                else in.dead = true;
+                changed++;
+                continue;
+            }
+            default:
+                break;
+        }
+        if (e.writes_acc) acc = known_load(in, constants);
+        if (e.def_at >= 0) regs[in.operand[e.def_at]] = Known{};
+    }
+    return changed;
+}
+
+// --- copyprop -------------------------------------------------------------
+
+uint32_t copyprop(Body& b) {
+    const std::vector<bool> starts = block_starts(b);
+    uint32_t changed = 0;
+    // copy_of[r]: a register r currently holds the same value as. acc_is: a
+    // register the accumulator currently holds the value of.
+    int16_t copy_of[256];
+    int16_t acc_is = -1;
+    auto forget = [&] { std::fill(std::begin(copy_of), std::end(copy_of), -1); acc_is = -1; };
+    auto kill = [&](uint8_t r) {
+        copy_of[r] = -1;
+        for (int16_t& c : copy_of) if (c == r) c = -1;
+        if (acc_is == r) acc_is = -1;
+    };
+    auto source = [&](uint8_t r) -> uint8_t { return copy_of[r] >= 0 ? static_cast<uint8_t>(copy_of[r]) : r; };
+    forget();
+    for (int32_t i = 0; i < b.size(); i++) {
+        Insn& in = b.insns[i];
+        if (in.dead) continue;
+        if (starts[i]) forget();
+        const Effect e = effect_of(in);
+        if (e.opaque) { forget(); continue; }
+        switch (in.op) {
+            case Op::Ldar: {
+                const uint8_t r = in.operand[0];
+                const uint8_t s = source(r);
+                if (acc_is == r || acc_is == s) { in.dead = true; changed++; continue; }
+                if (s != r) { in.operand[0] = s; changed++; }
+                acc_is = s;
+                continue;
+            }
+            case Op::Star: {
+                const uint8_t r = in.operand[0];
+                if (acc_is == r) { in.dead = true; changed++; continue; }
+                const int16_t held = acc_is;
+                kill(r);
+                if (held >= 0) { copy_of[r] = held; acc_is = held; }
+                else acc_is = r;
+                continue;
+            }
+            case Op::Mov: {
+                const uint8_t s = source(in.operand[0]);
+                const uint8_t d = in.operand[1];
+                if (s == d || copy_of[d] == s) { in.dead = true; changed++; continue; }
+                if (s != in.operand[0]) { in.operand[0] = s; changed++; }
+                kill(d);
+                copy_of[d] = s;
+                continue;
+            }
+            case Op::LdarChecked: case Op::StarChecked:
+                // Read for their TDZ check by the name they carry; left as
+                // they are.
+                break;
+            default:
+                for (uint8_t u = 0; u < e.uses; u++) {
+                    uint8_t& r = in.operand[e.use_at[u]];
+                    const uint8_t s = source(r);
+                    if (s != r) { r = s; changed++; }
+                }
+                break;
+        }
+        if (e.writes_acc) acc_is = -1;
+        if (e.def_at >= 0) kill(in.operand[e.def_at]);
+    }
+    return changed;
+}
+
+// --- jumps ----------------------------------------------------------------
+
+// Only the two whose handlers take the safepoint on a backward branch, as
+// Jump does: the Jump being folded away may be a loop's back edge.
+Op inverse_jump(Op op) {
+    switch (op) {
+        case Op::JumpIfTrue: return Op::JumpIfFalse;
+        case Op::JumpIfFalse: return Op::JumpIfTrue;
+        default: return Op::kCount;
+    }
+}
+
+uint32_t thread_jumps(Body& b) {
+    uint32_t changed = 0;
+    for (int round = 0; round < 8; round++) {
+        uint32_t before = changed;
+
+        // A jump to a Jump goes where that one goes.
+        for (int32_t i = 0; i < b.size(); i++) {
+            Insn& in = b.insns[i];
+            if (in.dead || !is_plain_jump(in.op)) continue;
+            int32_t t = b.live_at(in.target);
+            for (int hops = 0; hops < 16 && t < b.size() && t != i && b.insns[t].op == Op::Jump; hops++) {
+                t = b.live_at(b.insns[t].target);
+            }
+            // The nullish branches take no safepoint going backward, so one
+            // must not become a loop's back edge in place of a Jump.
+            const bool safepoints = in.op == Op::Jump || in.op == Op::JumpIfTrue || in.op == Op::JumpIfFalse;
+            if (!safepoints && t <= i) continue;
+            if (t != b.live_at(in.target)) { in.target = t; changed++; }
+        }
+
+        // Which instructions something jumps to or a region names, so that a
+        // Jump that is one is not folded into the branch in front of it.
+        std::vector<bool> landed(b.insns.size() + 1, false);
+        for (const Insn& in : b.insns) {
+            if (!in.dead && in.target >= 0) landed[b.live_at(in.target)] = true;
+        }
+        for (const Region& r : b.regions) {
+            for (int32_t x : {r.start, r.end, r.handler, r.genreturn}) {
+                if (x >= 0) landed[b.live_at(x)] = true;
+            }
+        }
+
+        for (int32_t i = 0; i < b.size(); i++) {
+            Insn& in = b.insns[i];
+            if (in.dead || !is_plain_jump(in.op)) continue;
+            const int32_t next = b.next_live(i);
+            // A jump to where control would go anyway.
+            if (b.live_at(in.target) == next) { in.dead = true; changed++; continue; }
+            // `if (c) goto L1; goto L2; L1:` is `if (!c) goto L2; L1:`.
+            const Op inverse = inverse_jump(in.op);
+            if (inverse == Op::kCount || next >= b.size()) continue;
+            Insn& over = b.insns[next];
+            if (over.op != Op::Jump || landed[next]) continue;
+            if (b.live_at(in.target) != b.next_live(next)) continue;
+            in.op = inverse;
+            in.target = over.target;
+            over.dead = true;
+            changed++;
+        }
+
+        // Whatever nothing reaches any more.
+        std::vector<bool> reached(b.insns.size(), false);
+        std::vector<int32_t> work;
+        auto reach = [&](int32_t x) {
+            if (x >= 0 && x < b.size() && !reached[x]) { reached[x] = true; work.push_back(x); }
+        };
+        reach(b.live_at(0));
+        for (const Region& r : b.regions) {
+            reach(b.live_at(r.handler));
+            if (r.genreturn >= 0) reach(b.live_at(r.genreturn));
+        }
+        while (!work.empty()) {
+            const int32_t x = work.back();
+            work.pop_back();
+            int32_t succ[2];
+            const int n = successors(b, x, succ);
+            for (int k = 0; k < n; k++) reach(succ[k]);
+        }
+        for (int32_t i = 0; i < b.size(); i++) {
+            if (!b.insns[i].dead && !reached[i]) { b.insns[i].dead = true; changed++; }
+        }
+
+        if (changed == before) break;
+    }
+    return changed;
+}
+
+// --- dse ------------------------------------------------------------------
+
+// Bits 0..255 are registers, bit 256 the accumulator.
+using Live = std::bitset<257>;
+constexpr size_t kAcc = 256;
+
+uint32_t eliminate_dead_stores(Body& b) {
+    if (b.insns.size() > kMaxLivenessInsns) return 0;
+    const size_t n = b.insns.size();
+
+    // The handlers and generator-return pads each instruction can unwind to.
+    std::vector<std::vector<int32_t>> unwinds_to(n);
+    for (const Region& r : b.regions) {
+        for (int32_t i = r.start; i < r.end && i < b.size(); i++) {
+            unwinds_to[i].push_back(r.handler);
+            if (r.genreturn >= 0) unwinds_to[i].push_back(r.genreturn);
+        }
+    }
+    Live everything;
+    everything.set();
+
+    uint32_t removed = 0;
+    for (;;) {
+        std::vector<Effect> effects(n);
+        for (size_t i = 0; i < n; i++) {
+            if (!b.insns[i].dead) effects[i] = effect_of(b.insns[i]);
+        }
+        std::vector<Live> live_in(n), live_out(n);
+        bool moved = true;
+        while (moved) {
+            moved = false;
+            for (int32_t i = b.size() - 1; i >= 0; i--) {
+                const Insn& in = b.insns[i];
+                if (in.dead) continue;
+                Live out;
+                int32_t succ[2];
+                const int ns = successors(b, i, succ);
+                for (int k = 0; k < ns; k++) out |= live_in[succ[k]];
+                const Effect& e = effects[i];
+                Live inside;
+                if (e.opaque) {
+                    inside = everything;
+                } else {
+                    inside = out;
+                    if (e.def_at >= 0) inside.reset(in.operand[e.def_at]);
+                    if (e.writes_acc) inside.reset(kAcc);
+                    if (e.reads_acc) inside.set(kAcc);
+                    for (uint8_t u = 0; u < e.uses; u++) inside.set(in.operand[e.use_at[u]]);
+                    if (e.run_first >= 0) {
+                        const uint32_t first = in.operand[e.run_first];
+                        const uint32_t count = in.operand[e.run_count];
+                        for (uint32_t r = first; r < first + count && r < 256; r++) inside.set(r);
+                    }
+                }
+                // Unwinding leaves before the instruction writes anything, and
+                // arrives with the exception in the accumulator.
+                for (int32_t h : unwinds_to[i]) {
+                    const int32_t lh = b.live_at(h);
+                    if (lh >= b.size()) continue;
+                    Live via = live_in[lh];
+                    via.reset(kAcc);
+                    inside |= via;
+                }
+                if (inside != live_in[i] || out != live_out[i]) {
+                    live_in[i] = inside;
+                    live_out[i] = out;
+                    moved = true;
+                }
+            }
+        }
+
+        uint32_t round = 0;
+        for (int32_t i = 0; i < b.size(); i++) {
+            Insn& in = b.insns[i];
+            if (in.dead || !effects[i].removable) continue;
+            const Effect& e = effects[i];
+            bool dead;
+            if (e.def_at >= 0) {
+                const uint8_t r = in.operand[e.def_at];
+                // A parameter the arguments object may still be built from.
+                dead = !live_out[i].test(r) && !(b.needs_arguments && r < b.parameter_count);
+            } else {
+                dead = !live_out[i].test(kAcc);
+            }
+            if (dead) { in.dead = true; round++; }
+        }
+        removed += round;
+        if (round == 0) break;
+    }
+    return removed;
+}
+
+// --- register liveness, for the collector ----------------------------------
+
+// The analysis runs once per chunk, on the first collection that finds it
+// running, so it can afford far larger bodies than dse -- a big top-level
+// script is exactly the frame that holds the most registers for longest.
+constexpr size_t kMaxGcLivenessInsns = 262144;
+
+using RegSet = std::bitset<256>;
+
+// The operand byte of a register the instruction only ever writes, and writes
+// whole, or -1. Only the plain moves and the fused stores: anything else that
+// writes a register counts as reading it too, which costs a little retention
+// and can never cost a value.
+int overwritten_register(Op op) {
+    switch (op) {
+        case Op::Star: case Op::LdaZeroStar: case Op::LdaThisStar: return 0;
+        case Op::Mov: case Op::LdarStar: case Op::LdaSmiStar: return 1;
+        case Op::LdaConstStar: case Op::LdaEnvStar: case Op::LdaLookupStar: return 2;
+        case Op::LdaEnvSlotStar: return 3;
+        case Op::GetNamedStar: return 5;
+        default: return -1;
+    }
+}
+
+void build_register_liveness(const BytecodeChunk& chunk, RegisterLiveness& out) {
+    Body b;
+    if (chunk.code.size() == 0 || !decode(chunk.code.data(), chunk.code.size(), chunk, b)) return;
+    const size_t n = b.insns.size();
+    if (n > kMaxGcLivenessInsns) return;
+
+    std::vector<std::vector<int32_t>> unwinds_to(n);
+    for (const Region& r : b.regions) {
+        for (int32_t i = r.start; i < r.end && i < b.size(); i++) {
+            unwinds_to[i].push_back(r.handler);
+            if (r.genreturn >= 0) unwinds_to[i].push_back(r.genreturn);
+        }
+    }
+    // Every register each instruction names; the ones it reads, which is all
+    // of those but an overwritten operand; and that operand's register.
+    std::vector<RegSet> named(n), reads(n);
+    std::vector<int16_t> kills(n, -1);
+    for (size_t i = 0; i < n; i++) {
+        const Insn& in = b.insns[i];
+        const RegisterOperands ro = register_operands(in.op);
+        const int def_at = overwritten_register(in.op);
+        for (uint8_t k = 0; k < ro.count; k++) {
+            named[i].set(in.operand[ro.at[k]]);
+            if (ro.at[k] != def_at) reads[i].set(in.operand[ro.at[k]]);
+        }
+        if (ro.run_first >= 0) {
+            const uint32_t first = in.operand[ro.run_first];
+            const uint32_t count = in.operand[ro.run_count];
+            for (uint32_t r = first; r < first + count && r < 256; r++) {
+                named[i].set(r);
+                reads[i].set(r);
+            }
+        }
+        if (def_at >= 0) kills[i] = in.operand[def_at];
+    }
+
+    std::vector<RegSet> live_in(n), live_out(n);
+    bool moved = true;
+    while (moved) {
+        moved = false;
+        for (int32_t i = b.size() - 1; i >= 0; i--) {
+            RegSet out;
+            int32_t succ[2];
+            const int ns = successors(b, i, succ);
+            for (int k = 0; k < ns; k++) out |= live_in[succ[k]];
+            RegSet inside = out;
+            if (kills[i] >= 0) inside.reset(static_cast<size_t>(kills[i]));
+            inside |= reads[i];
+            // Unwinding leaves before the instruction writes anything.
+            for (int32_t h : unwinds_to[i]) {
+                const int32_t lh = b.live_at(h);
+                if (lh < b.size()) inside |= live_in[lh];
+            }
+            if (inside != live_in[i] || out != live_out[i]) {
+                live_in[i] = inside;
+                live_out[i] = out;
+                moved = true;
+            }
+        }
+    }
+
+    RegSet params;
+    for (uint32_t r = 0; r < chunk.parameter_count && r < 256; r++) params.set(r);
+    out.words = (static_cast<uint32_t>(chunk.register_count) + 63) / 64;
+    out.pcs.reserve(n);
+    out.rows.assign(n * out.words, 0);
+    uint32_t pc = 0;
+    for (size_t i = 0; i < n; i++) {
+        out.pcs.push_back(pc);
+        pc += 1 + b.insns[i].width;
+        const RegSet row = live_in[i] | live_out[i] | named[i] | params;
+        uint64_t* dst = &out.rows[i * out.words];
+        for (uint32_t r = 0; r < chunk.register_count && r < 256; r++) {
+            if (row.test(r)) dst[r / 64] |= uint64_t{1} << (r % 64);
+        }
+    }
+}
+
+// --- renumber -------------------------------------------------------------
+
+uint32_t renumber(Body& b) {
+    std::vector<bool> named(256, false);
+    for (uint32_t r = 0; r < b.parameter_count; r++) named[r] = true;
+    for (const Insn& in : b.insns) {
+        if (in.dead) continue;
+        const RegisterOperands ro = register_operands(in.op);
+        for (uint8_t k = 0; k < ro.count; k++) named[in.operand[ro.at[k]]] = true;
+        if (ro.run_first >= 0) {
+            const uint32_t first = in.operand[ro.run_first];
+            const uint32_t count = in.operand[ro.run_count];
+            for (uint32_t r = first; r < first + count && r < 256; r++) named[r] = true;
+        }
+    }
+    // Kept in order, so an argument run stays a run: every register in one is
+    // named by the call that reads it.
+    uint8_t to[257];
+    uint32_t next = 0;
+    for (uint32_t r = 0; r < 256; r++) {
+        to[r] = static_cast<uint8_t>(next);
+        if (named[r]) next++;
+    }
+    if (next >= b.register_count) return 0;
+    for (Insn& in : b.insns) {
+        if (in.dead) continue;
+        const RegisterOperands ro = register_operands(in.op);
+        for (uint8_t k = 0; k < ro.count; k++) in.operand[ro.at[k]] = to[in.operand[ro.at[k]]];
+        // An empty run names the register it would have started at, which
+        // nothing reads; whatever it maps to is as good.
+        if (ro.run_first >= 0) in.operand[ro.run_first] = to[in.operand[ro.run_first]];
+    }
+    const uint32_t dropped = b.register_count - next;
+    b.register_count = static_cast<uint16_t>(next);
+    return dropped;
+}
+
+}
+
+const uint64_t* RegisterLiveness::at(uint32_t pc) const {
+    auto it = std::lower_bound(pcs.begin(), pcs.end(), pc);
+    if (it == pcs.end() || *it != pc) return nullptr;
+    return &rows[static_cast<size_t>(it - pcs.begin()) * words];
+}
+
+const RegisterLiveness& register_liveness(const BytecodeChunk& chunk) {
+    if (!chunk.liveness) {
+        auto liveness = std::make_unique<RegisterLiveness>();
+        build_register_liveness(chunk, *liveness);
+        chunk.liveness = std::move(liveness);
+    }
+    return *chunk.liveness;
+}
+
+bool passes_enabled() {
+    return g_passes_on;
+}
+
+PassStats optimize_bytecode(std::vector<uint8_t>& code, std::vector<Value>& constants,
+                            BytecodeChunk& chunk) {
+    PassStats stats;
+    stats.bytes_before = stats.bytes_after = static_cast<uint32_t>(code.size());
+    if (!g_passes_on || code.empty()) return stats;
+
+    Body b;
+    if (!decode(code.data(), code.size(), chunk, b)) return stats;
+    const size_t constants_before = constants.size();
+    stats.folded = fold(b, constants);
+    stats.propagated = copyprop(b);
+    stats.threaded = thread_jumps(b);
+    stats.dead_stores = eliminate_dead_stores(b);
+    // A second sweep for what the stores going left behind: a branch now
+    // jumping to the next instruction, a load only a dropped store read.
+    stats.threaded += thread_jumps(b);
+    stats.dead_stores += eliminate_dead_stores(b);
+    stats.registers_dropped = renumber(b);
+
+    std::vector<uint8_t> out;
+    if (!encode(b, out, chunk.handlers.get())) {
+        constants.resize(constants_before);
+        PassStats unchanged;
+        unchanged.bytes_before = unchanged.bytes_after = stats.bytes_before;
+        return unchanged;
+    }
+    code.swap(out);
+    chunk.register_count = b.register_count;
+    stats.bytes_after = static_cast<uint32_t>(code.size());
+    if (g_report) {
+        std::fprintf(stderr,
+                     "-- passes: fold %u, copyprop %u, jumps %u, dse %u, renumber -%u regs; "
+                     "%u -> %u bytes\n",
+                     stats.folded, stats.propagated, stats.threaded, stats.dead_stores,
+                     stats.registers_dropped, stats.bytes_before, stats.bytes_after);
+    }
+    return stats;
+}
+
+}
+}
@@ -0,0 +1,591 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "quanta/core/vm/CodeCache.h"
+#include "quanta/core/vm/Bytecode.h"
+#include "quanta/core/runtime/Shape.h"
+#include "quanta/core/runtime/String.h"
+#include "quanta/parser/AST.h"
+#include "quanta/parser/FunctionExecutable.h"
+#include "quanta/parser/ScriptUnit.h"
+#include <bit>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <type_traits>
+#include <vector>
+
+namespace Quanta {
+namespace VM {
+
+static_assert(sizeof(Value) == sizeof(uint64_t) && std::is_trivially_copyable_v<Value>);
+
+namespace {
+
+// Bump whenever the meaning of an encoded chunk changes without the opcode
+// count changing with it: an operand's width, a flag's sense, what a
+// constant-pool index points at. A file from another version is a miss.
+constexpr uint32_t kFormatVersion = 2;  // 2: Call/CallResolved carry a call-feedback slot
+constexpr uint32_t kMagic = 0x43434a51;  // "QJCC"
+
+// Header: magic, version, opcode count, kind, source hash, source size,
+// entry count. Each entry then opens with its body token and its size, and
+// the file closes on a checksum of everything before it.
+constexpr size_t kHeaderSize = 4 + 4 + 4 + 4 + 8 + 8 + 4;
+constexpr size_t kChecksumSize = 8;
+
+const std::string g_cache_dir = [] {
+    const char* env = std::getenv("QUANTA_CODE_CACHE");
+    return std::string(env && env[0] ? env : "");
+}();
+
+// FNV-1a, for both the source key and the checksum. A source runs to a few
+// megabytes at most, and this is one pass over it next to the lexer's one.
+uint64_t fnv1a(const void* data, size_t size, uint64_t h = 0xcbf29ce484222325ull) {
+    const auto* p = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; i++) {
+        h ^= p[i];
+        h *= 0x100000001b3ull;
+    }
+    return h;
+}
+
+class Writer {
+public:
+    std::string out;
+
+    void u8(uint8_t v) { out.push_back(static_cast<char>(v)); }
+    void u16(uint16_t v) { put(v); }
+    void u32(uint32_t v) { put(v); }
+    void u64(uint64_t v) { put(v); }
+    void str(const std::string& s) {
+        u32(static_cast<uint32_t>(s.size()));
+        out.append(s);
+    }
+
+private:
+    template <typename T> void put(T v) {
+        char b[sizeof(T)];
+        std::memcpy(b, &v, sizeof(T));
+        out.append(b, sizeof(T));
+    }
+};
+
+// Every read is bounds-checked and a short read poisons the reader rather
+// than throwing: a bad entry is a miss, never an error the script sees.
+class Reader {
+public:
+    Reader(const char* p, size_t size) : p_(p), end_(p + size) {}
+
+    bool ok() const { return ok_; }
+    bool at_end() const { return p_ == end_; }
+
+    uint8_t u8() { return get<uint8_t>(); }
+    uint16_t u16() { return get<uint16_t>(); }
+    uint32_t u32() { return get<uint32_t>(); }
+    uint64_t u64() { return get<uint64_t>(); }
+    std::string str() {
+        uint32_t n = u32();
+        if (!take(n)) return std::string();
+        return std::string(p_ - n, n);
+    }
+    const char* bytes(size_t n) { return take(n) ? p_ - n : nullptr; }
+    // A count that claims more items than there are bytes left is corrupt,
+    // and is refused before anything is sized from it.
+    uint32_t count(size_t min_item_size) {
+        uint32_t n = u32();
+        if (ok_ && static_cast<size_t>(end_ - p_) / min_item_size < n) ok_ = false;
+        return ok_ ? n : 0;
+    }
+
+private:
+    bool take(size_t n) {
+        if (!ok_ || static_cast<size_t>(end_ - p_) < n) { ok_ = false; return false; }
+        p_ += n;
+        return true;
+    }
+    template <typename T> T get() {
+        T v{};
+        if (take(sizeof(T))) std::memcpy(&v, p_ - sizeof(T), sizeof(T));
+        return v;
+    }
+
+    const char* p_;
+    const char* end_;
+    bool ok_ = true;
+};
+
+enum ChunkFlags : uint8_t {
+    kEnvMode = 1 << 0,
+    kEnvParamsTdz = 1 << 1,
+    kLexScopeSplit = 1 << 2,
+    kScriptMode = 1 << 3,
+    kNeedsArguments = 1 << 4,
+    kUsesLookupCache = 1 << 5,
+    kUsesThis = 1 << 6,
+};
+
+enum ConstantKind : uint8_t { kConstBits = 0, kConstString = 1 };
+
+enum EnvVarFlags : uint8_t { kLexical = 1 << 0, kConst = 1 << 1, kCopyForward = 1 << 2 };
+
+// Only the parts of a chunk the compiler fixed. Feedback, inline caches and
+// the lookup cache are written as their sizes and start empty again, and the
+// interned env keys are rebuilt on the first call the way they always are.
+bool encode_chunk(const BytecodeChunk& chunk, const FunctionExecutable& exe, Writer& w) {
+    if (chunk.closures && !chunk.closures->empty()) return false;
+    if (chunk.classes && !chunk.classes->empty()) return false;
+    if (chunk.treewalk_nodes && !chunk.treewalk_nodes->empty()) return false;
+
+    const Position& start = exe.body_start();
+    w.u32(start.offset);
+    w.u32(start.line);
+    w.u32(start.column);
+    w.u16(chunk.register_count);
+    w.u8(chunk.parameter_count);
+    uint8_t flags = 0;
+    if (chunk.env_mode) flags |= kEnvMode;
+    if (chunk.env_params_tdz) flags |= kEnvParamsTdz;
+    if (chunk.lex_scope_split) flags |= kLexScopeSplit;
+    if (chunk.script_mode) flags |= kScriptMode;
+    if (chunk.needs_arguments) flags |= kNeedsArguments;
+    if (chunk.uses_lookup_cache) flags |= kUsesLookupCache;
+    if (chunk.uses_this) flags |= kUsesThis;
+    w.u8(flags);
+
+    w.u32(chunk.code.size());
+    w.out.append(reinterpret_cast<const char*>(chunk.code.data()), chunk.code.size());
+
+    // A constant is either a string or a Value whose bits mean the same thing
+    // in any process -- a number, a boolean, undefined, null. Anything else
+    // the compiler put in the pool is a cell this run allocated.
+    w.u32(chunk.constants.size());
+    for (uint32_t i = 0; i < chunk.constants.size(); i++) {
+        const Value& v = chunk.constants[i];
+        if (v.is_string()) {
+            w.u8(kConstString);
+            w.str(v.as_string()->str());
+        } else if (v.is_symbol() || v.is_bigint() || v.is_object() || v.is_function()) {
+            return false;
+        } else {
+            w.u8(kConstBits);
+            w.u64(std::bit_cast<uint64_t>(v));
+        }
+    }
+
+    w.u32(chunk.names.size());
+    for (uint32_t i = 0; i < chunk.names.size(); i++) w.str(*chunk.names[i]);
+
+    w.u32(chunk.feedback.size());
+    w.u32(chunk.call_feedback.size());
+    w.u32(chunk.ic_feedback ? static_cast<uint32_t>(chunk.ic_feedback->private_feedback.size()) : 0);
+    w.u32(chunk.ic_feedback ? static_cast<uint32_t>(chunk.ic_feedback->keyed_feedback.size()) : 0);
+
+    const uint32_t handler_count = chunk.handlers ? static_cast<uint32_t>(chunk.handlers->size()) : 0;
+    w.u32(handler_count);
+    for (uint32_t i = 0; i < handler_count; i++) {
+        const HandlerEntry& h = (*chunk.handlers)[i];
+        w.u32(h.start_pc);
+        w.u32(h.end_pc);
+        w.u32(h.handler_pc);
+        w.u32(static_cast<uint32_t>(h.genreturn_pc));
+    }
+
+    w.u8(chunk.env ? 1 : 0);
+    if (chunk.env) {
+        const auto& env = *chunk.env;
+        w.u32(static_cast<uint32_t>(env.env_params.size()));
+        for (const auto& p : env.env_params) w.str(p);
+        w.u32(static_cast<uint32_t>(env.env_locals.size()));
+        for (const auto& l : env.env_locals) {
+            w.str(l.name);
+            w.u8((l.is_lexical ? kLexical : 0) | (l.is_const ? kConst : 0));
+        }
+        w.u32(static_cast<uint32_t>(env.loop_envs.size()));
+        for (const auto& loop : env.loop_envs) {
+            w.u32(static_cast<uint32_t>(loop.size()));
+            for (const auto& v : loop) {
+                w.str(v.name);
+                w.u8((v.is_lexical ? kLexical : 0) | (v.is_const ? kConst : 0) |
+                     (v.copy_forward ? kCopyForward : 0));
+            }
+        }
+        w.u16(env.env_slot_total);
+    }
+    return true;
+}
+
+// The checksum already rules out a damaged file; this rules out one that is
+// intact but wrong for the chunk it claims to be. The interpreter trusts every
+// operand the compiler wrote -- a register byte indexes the bank, a table
+// index reads its table, a jump lands wherever it points -- and none of that
+// is re-checked at run time, so an entry is only taken if each of those holds
+// here: every opcode real and the last one ending where the code does, every
+// register below register_count, every index inside its table, and every jump
+// and handler pc on the start of an instruction.
+bool code_is_well_formed(const BytecodeChunk& chunk) {
+    const uint32_t size = chunk.code.size();
+    if (size == 0 || chunk.parameter_count > chunk.register_count) return false;
+    const uint8_t* code = chunk.code.data();
+    std::vector<bool> starts(size, false);
+    uint32_t pc = 0;
+    while (pc < size) {
+        uint8_t op = code[pc];
+        if (op >= static_cast<uint8_t>(Op::kCount)) return false;
+        starts[pc] = true;
+        pc += 1 + static_cast<uint32_t>(op_operand_bytes(static_cast<Op>(op)));
+    }
+    if (pc != size) return false;
+    auto is_start = [&](uint32_t target) { return target < size && starts[target]; };
+
+    if (chunk.handlers) {
+        for (const HandlerEntry& h : *chunk.handlers) {
+            if (!is_start(h.start_pc) || h.start_pc > h.end_pc || !is_start(h.handler_pc)) return false;
+            if (h.end_pc != size && !is_start(h.end_pc)) return false;
+            if (h.genreturn_pc >= 0 && !is_start(static_cast<uint32_t>(h.genreturn_pc))) return false;
+        }
+    }
+
+    const uint32_t registers = chunk.register_count;
+    const size_t private_count = chunk.ic_feedback ? chunk.ic_feedback->private_feedback.size() : 0;
+    const size_t keyed_count = chunk.ic_feedback ? chunk.ic_feedback->keyed_feedback.size() : 0;
+    const size_t loop_env_count = chunk.env ? chunk.env->loop_envs.size() : 0;
+    for (pc = 0; pc < size;) {
+        const Op op = static_cast<Op>(code[pc]);
+        const uint8_t* operands = code + pc + 1;
+        const uint32_t next = pc + 1 + static_cast<uint32_t>(op_operand_bytes(op));
+        auto u16_at = [operands](int i) {
+            return static_cast<uint32_t>(operands[i]) | (static_cast<uint32_t>(operands[i + 1]) << 8);
+        };
+        auto name = [&](int i) { return u16_at(i) < chunk.names.size(); };
+
+        // Registers, decoded the way every pass that renames them decodes
+        // them. An empty argument run may name the register one past the end,
+        // since it never reads it.
+        const RegisterOperands regs = register_operands(op);
+        for (uint8_t i = 0; i < regs.count; i++) {
+            if (operands[regs.at[i]] >= registers) return false;
+        }
+        if (regs.run_first >= 0 && operands[regs.run_count] != 0 &&
+            static_cast<uint32_t>(operands[regs.run_first]) + operands[regs.run_count] > registers)
+            return false;
+
+        const int jump = op_jump_offset(op);
+        if (jump >= 0) {
+            const int64_t target = static_cast<int64_t>(pc) + 1 + jump + 2 +
+                                   static_cast<int16_t>(u16_at(jump));
+            if (target < 0 || !is_start(static_cast<uint32_t>(target))) return false;
+        }
+
+        bool ok = true;
+        switch (op_operand_kind(op)) {
+            case 'k': case 'K': ok = u16_at(0) < chunk.constants.size(); break;
+            case 'q': ok = (u16_at(0) | (u16_at(2) << 16)) < chunk.constants.size(); break;
+            case 'n': case 'N': case 'X': ok = name(0) && (op != Op::CreateRegExp || name(2)); break;
+            case 'l': case 'e': case 'F': ok = name(1); break;
+            case 'W': ok = name(2); break;
+            case 'c': case 'w': ok = name(3); break;
+            case 'y': ok = name(3) && u16_at(5) < chunk.call_feedback.size(); break;
+            case 'v': ok = name(4) && u16_at(6) < chunk.call_feedback.size(); break;
+            case 'g':
+                ok = name(1) && u16_at(3) < (op == Op::GetPrivate || op == Op::SetPrivate
+                                                 ? private_count : chunk.feedback.size());
+                break;
+            case 'G': ok = name(1) && u16_at(3) < chunk.feedback.size(); break;
+            case 'm': ok = name(1) && name(3); break;
+            case 's': ok = name(1) && name(3) && u16_at(6) < chunk.feedback.size(); break;
+            case 'f': ok = u16_at(1) < keyed_count; break;
+            case 'x': ok = u16_at(2) < keyed_count; break;
+            case 'E': ok = operands[0] <= static_cast<uint8_t>(EngineHelper::Kind::ClassFieldKey); break;
+            // Closures, classes, tree-walk nodes and inlined targets are never
+            // written (encode_chunk refuses a chunk with any), so the only
+            // table one of these may name is the loop environments.
+            case 'z':
+                ok = (op == Op::EnterLoopEnv || op == Op::AdvanceLoopEnv) && u16_at(0) < loop_env_count;
+                break;
+            case 'L': case 'M': case 'Y': ok = false; break;
+            default: break;
+        }
+        if (!ok) return false;
+        pc = next;
+    }
+    return true;
+}
+
+std::unique_ptr<BytecodeChunk> decode_chunk(Reader& r, const FunctionExecutable& exe) {
+    // The body has to start where it did when the entry was written. The
+    // source hash already matched, so a mismatch here means the token index
+    // now names a different literal -- a lexer or parser that changed under
+    // an unchanged format version.
+    const Position& start = exe.body_start();
+    const uint32_t offset = r.u32(), line = r.u32(), column = r.u32();
+    if (!r.ok() || offset != start.offset || line != start.line || column != start.column) return nullptr;
+
+    auto chunk = std::make_unique<BytecodeChunk>();
+    chunk->register_count = r.u16();
+    chunk->parameter_count = r.u8();
+    const uint8_t flags = r.u8();
+    chunk->env_mode = (flags & kEnvMode) != 0;
+    chunk->env_params_tdz = (flags & kEnvParamsTdz) != 0;
+    chunk->lex_scope_split = (flags & kLexScopeSplit) != 0;
+    chunk->script_mode = (flags & kScriptMode) != 0;
+    chunk->needs_arguments = (flags & kNeedsArguments) != 0;
+    chunk->uses_lookup_cache = (flags & kUsesLookupCache) != 0;
+    chunk->uses_this = (flags & kUsesThis) != 0;
+
+    const uint32_t code_size = r.count(1);
+    const char* code = r.bytes(code_size);
+    if (!code) return nullptr;
+    chunk->code = FixedArray<uint8_t>::from(
+        std::vector<uint8_t>(reinterpret_cast<const uint8_t*>(code),
+                             reinterpret_cast<const uint8_t*>(code) + code_size));
+
+    // String constants are allocated here, with nothing rooting the ones
+    // already made. That is safe for the same reason the compiler's own pool
+    // is: the collector runs only at safepoints, and none is reached before
+    // the chunk is attached and traced through its executable.
+    const uint32_t constant_count = r.count(1);
+    std::vector<Value> constants;
+    constants.reserve(constant_count);
+    for (uint32_t i = 0; i < constant_count && r.ok(); i++) {
+        const uint8_t kind = r.u8();
+        if (kind == kConstString) {
+            constants.push_back(Value(r.str()));
+        } else if (kind == kConstBits) {
+            const Value v = std::bit_cast<Value>(r.u64());
+            if (v.is_string() || v.is_symbol() || v.is_bigint() || v.is_object() || v.is_function())
+                return nullptr;
+            constants.push_back(v);
+        } else {
+            return nullptr;
+        }
+    }
+    chunk->constants = FixedArray<Value>::from(std::move(constants));
+
+    const uint32_t name_count = r.count(4);
+    std::vector<const std::string*> names;
+    names.reserve(name_count);
+    for (uint32_t i = 0; i < name_count && r.ok(); i++) names.push_back(Shape::intern(r.str()));
+    chunk->names = FixedArray<const std::string*>::from(std::move(names));
+    if (chunk->uses_lookup_cache) {
+        chunk->lookup_cache = FixedArray<BytecodeChunk::LookupCacheEntry>::filled(
+            chunk->names.size(), BytecodeChunk::LookupCacheEntry{});
+    }
+
+    const uint32_t feedback_count = r.u32();
+    const uint32_t call_count = r.u32();
+    const uint32_t private_count = r.u32();
+    const uint32_t keyed_count = r.u32();
+    // Each of these is addressed by a u16 operand, so a larger count is not
+    // something the compiler wrote.
+    if (!r.ok() || feedback_count > 0x10000 || call_count > 0x10000 ||
+        private_count > 0x10000 || keyed_count > 0x10000)
+        return nullptr;
+    chunk->feedback = FixedArray<FeedbackSlot>::filled(feedback_count);
+    chunk->call_feedback = FixedArray<CallFeedback>::filled(call_count);
+    if (private_count) chunk->ensure_ic_feedback().private_feedback.resize(private_count);
+    if (keyed_count) chunk->ensure_ic_feedback().keyed_feedback.resize(keyed_count);
+
+    const uint32_t handler_count = r.count(16);
+    if (handler_count) {
+        auto& handlers = chunk->ensure_handlers();
+        handlers.reserve(handler_count);
+        for (uint32_t i = 0; i < handler_count && r.ok(); i++) {
+            HandlerEntry h;
+            h.start_pc = r.u32();
+            h.end_pc = r.u32();
+            h.handler_pc = r.u32();
+            h.genreturn_pc = static_cast<int32_t>(r.u32());
+            handlers.push_back(h);
+        }
+    }
+
+    if (r.u8()) {
+        auto& env = chunk->ensure_env();
+        const uint32_t param_count = r.count(4);
+        for (uint32_t i = 0; i < param_count && r.ok(); i++) env.env_params.push_back(r.str());
+        const uint32_t local_count = r.count(5);
+        for (uint32_t i = 0; i < local_count && r.ok(); i++) {
+            std::string name = r.str();
+            const uint8_t f = r.u8();
+            env.env_locals.push_back({std::move(name), (f & kLexical) != 0, (f & kConst) != 0});
+        }
+        const uint32_t loop_count = r.count(4);
+        env.loop_envs.resize(loop_count);
+        for (uint32_t i = 0; i < loop_count && r.ok(); i++) {
+            const uint32_t var_count = r.count(5);
+            for (uint32_t j = 0; j < var_count && r.ok(); j++) {
+                std::string name = r.str();
+                const uint8_t f = r.u8();
+                env.loop_envs[i].push_back({std::move(name), (f & kLexical) != 0, (f & kConst) != 0,
+                                            (f & kCopyForward) != 0});
+            }
+        }
+        env.env_slot_total = r.u16();
+    }
+
+    if (!r.ok() || !r.at_end() || !code_is_well_formed(*chunk)) return nullptr;
+    return chunk;
+}
+
+// Units opened with a cache, kept until the engine shuts down so a function
+// whose first call comes after its entry point returned is still written.
+thread_local std::vector<ExecutableRef<ScriptUnit>> g_open_units;
+
+}
+
+bool code_cache_enabled() {
+    return !g_cache_dir.empty();
+}
+
+void CodeCacheFile::load() {
+    std::ifstream in(path_, std::ios::binary);
+    if (!in.is_open()) return;
+    std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (bytes.size() < kHeaderSize + kChecksumSize || bytes.size() > UINT32_MAX) return;
+
+    const size_t body = bytes.size() - kChecksumSize;
+    uint64_t stored_sum;
+    std::memcpy(&stored_sum, bytes.data() + body, sizeof stored_sum);
+    if (fnv1a(bytes.data(), body) != stored_sum) return;
+
+    Reader r(bytes.data(), body);
+    if (r.u32() != kMagic || r.u32() != kFormatVersion ||
+        r.u32() != static_cast<uint32_t>(Op::kCount) ||
+        r.u32() != static_cast<uint32_t>(kind_) || r.u64() != source_hash_ ||
+        r.u64() != source_size_) {
+        return;
+    }
+    const uint32_t count = r.count(8);
+    std::unordered_map<uint32_t, Span> entries;
+    size_t offset = kHeaderSize;
+    for (uint32_t i = 0; i < count && r.ok(); i++) {
+        const uint32_t tok = r.u32();
+        const uint32_t size = r.u32();
+        offset += 8;
+        if (!r.bytes(size)) return;
+        entries[tok] = Span{static_cast<uint32_t>(offset), size};
+        offset += size;
+    }
+    if (!r.ok() || !r.at_end()) return;
+    bytes_ = std::move(bytes);
+    entries_ = std::move(entries);
+}
+
+std::unique_ptr<BytecodeChunk> CodeCacheFile::take(const FunctionExecutable& exe, uint32_t body_tok) {
+    auto it = entries_.find(body_tok);
+    if (it == entries_.end()) return nullptr;
+    Reader r(bytes_.data() + it->second.offset, it->second.size);
+    std::unique_ptr<BytecodeChunk> chunk = decode_chunk(r, exe);
+    if (!chunk) entries_.erase(it);
+    return chunk;
+}
+
+void CodeCacheFile::flush(const ScriptUnit& unit) {
+    // Entries already in the file are carried over as they are: a chunk that
+    // was taken from one encodes back to the same bytes, and one that was not
+    // asked for has nothing newer to say. One that was asked for and refused
+    // is gone from entries_ (see take), and its body's fresh chunk is added.
+    Writer added;
+    uint32_t added_count = 0;
+    for (const auto& [tok, exe] : unit.executables()) {
+        if (!exe || !exe->bytecode_chunk || tok == 0 || exe->body_token() != tok) continue;
+        if (entries_.count(tok)) continue;
+        Writer entry;
+        if (!encode_chunk(*exe->bytecode_chunk, *exe, entry)) continue;
+        added.u32(tok);
+        added.u32(static_cast<uint32_t>(entry.out.size()));
+        added.out.append(entry.out);
+        added_count++;
+    }
+    if (added_count == 0) return;
+
+    Writer w;
+    w.u32(kMagic);
+    w.u32(kFormatVersion);
+    w.u32(static_cast<uint32_t>(Op::kCount));
+    w.u32(static_cast<uint32_t>(kind_));
+    w.u64(source_hash_);
+    w.u64(source_size_);
+    w.u32(static_cast<uint32_t>(entries_.size()) + added_count);
+    for (const auto& [tok, span] : entries_) {
+        w.u32(tok);
+        w.u32(span.size);
+        w.out.append(bytes_, span.offset, span.size);
+    }
+    w.out.append(added.out);
+    w.u64(fnv1a(w.out.data(), w.out.size()));
+
+    // Written beside the target and renamed over it, so a reader in another
+    // process sees the old file or the new one and never half of either.
+    std::error_code ec;
+    std::filesystem::create_directories(std::filesystem::path(path_).parent_path(), ec);
+    const std::string tmp = path_ + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) return;
+        out.write(w.out.data(), static_cast<std::streamsize>(w.out.size()));
+        if (!out) { out.close(); std::remove(tmp.c_str()); return; }
+    }
+    if (std::rename(tmp.c_str(), path_.c_str()) != 0) {
+        std::remove(tmp.c_str());
+        return;
+    }
+
+    // What was just written is now what the file holds; the carried-over
+    // entries moved with the new layout, so every span is read back off it.
+    w.out.resize(w.out.size() - kChecksumSize);
+    entries_.clear();
+    for (size_t offset = kHeaderSize; offset < w.out.size();) {
+        uint32_t tok, size;
+        std::memcpy(&tok, w.out.data() + offset, sizeof tok);
+        std::memcpy(&size, w.out.data() + offset + 4, sizeof size);
+        offset += 8;
+        entries_[tok] = Span{static_cast<uint32_t>(offset), size};
+        offset += size;
+    }
+    bytes_ = std::move(w.out);
+}
+
+void code_cache_open(ScriptUnit& unit, CodeCacheKind kind) {
+    if (!code_cache_enabled() || unit.code_cache()) return;
+    // Keyed on the text alone, so the same bundle under another path or
+    // name still hits; the kind is hashed in as well, since the same text
+    // compiles differently as a module.
+    const std::string& source = unit.source();
+    const uint8_t kind_byte = static_cast<uint8_t>(kind);
+    const uint64_t hash = fnv1a(source.data(), source.size(), fnv1a(&kind_byte, 1));
+    char name[32];
+    std::snprintf(name, sizeof name, "%016llx.qcc", static_cast<unsigned long long>(hash));
+    auto file = std::make_unique<CodeCacheFile>(
+        (std::filesystem::path(g_cache_dir) / name).string(), kind, hash, source.size());
+    file->load();
+    unit.set_code_cache(std::move(file));
+    g_open_units.push_back(ExecutableRef<ScriptUnit>(&unit));
+}
+
+std::unique_ptr<BytecodeChunk> code_cache_take(const FunctionExecutable& exe) {
+    const uint32_t tok = exe.body_token();
+    if (tok == 0 || !exe.unit()) return nullptr;
+    CodeCacheFile* file = exe.unit()->code_cache();
+    return file ? file->take(exe, tok) : nullptr;
+}
+
+void code_cache_flush(const ScriptUnit& unit) {
+    if (CodeCacheFile* file = unit.code_cache()) file->flush(unit);
+}
+
+void code_cache_flush_all() {
+    auto units = std::move(g_open_units);
+    g_open_units.clear();
+    for (const auto& unit : units) code_cache_flush(*unit);
+}
+
+}
+}
@@ -0,0 +1,441 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "quanta/core/vm/Inliner.h"
+#include "quanta/core/vm/Bytecode.h"
+#include "quanta/core/gc/Collector.h"
+#include "quanta/core/runtime/Object.h"
+#include "quanta/parser/FunctionExecutable.h"
+#include <cstdio>
+#include <cstdlib>
+#include <unordered_map>
+
+namespace Quanta {
+namespace VM {
+
+InlinedCode::InlinedCode() = default;
+InlinedCode::~InlinedCode() = default;
+
+namespace {
+
+const bool g_inline_on = [] {
+    const char* env = std::getenv("QUANTA_VM_INLINE");
+    if (!env) return true;
+    return env[0] != '0';
+}();
+
+// A body past this many bytes costs more to copy into every site than the
+// frame it saves: the accessors and arithmetic helpers this is for are a
+// handful of instructions.
+constexpr uint32_t kMaxBodyBytes = 64;
+// The guard names its target in a byte.
+constexpr uint32_t kMaxSites = 255;
+
+inline uint16_t u16_at(const uint8_t* code, uint32_t pc) {
+    return static_cast<uint16_t>(code[pc]) | (static_cast<uint16_t>(code[pc + 1]) << 8);
+}
+
+// Whether a leaf body may hold this instruction. Each one touches nothing but
+// the accumulator, its own registers, its constants and a value's properties,
+// so it means the same thing in the caller's frame once its registers are
+// moved. LdaThis and Return are rewritten on the way in.
+bool leaf_op(Op op) {
+    switch (op) {
+        case Op::LdaConst: case Op::LdaZero: case Op::LdaSmi: case Op::LdaUndefined:
+        case Op::LdaNull: case Op::LdaTrue: case Op::LdaFalse: case Op::LdaThis:
+        case Op::Ldar: case Op::Star: case Op::Mov:
+        case Op::LdaTdz: case Op::LdarChecked: case Op::StarChecked:
+        case Op::Add: case Op::Sub: case Op::Mul: case Op::Div: case Op::Mod: case Op::Exp:
+        case Op::BitAnd: case Op::BitOr: case Op::BitXor:
+        case Op::Shl: case Op::Shr: case Op::Sar:
+        case Op::TestEq: case Op::TestNe: case Op::TestStrictEq: case Op::TestStrictNe:
+        case Op::TestLt: case Op::TestGt: case Op::TestLe: case Op::TestGe:
+        case Op::Neg: case Op::LogicalNot: case Op::BitNot: case Op::TypeOf:
+        case Op::ToNumber: case Op::ToNumeric: case Op::Inc: case Op::Dec:
+        case Op::Jump: case Op::JumpIfTrue: case Op::JumpIfFalse:
+        case Op::JumpIfNullish: case Op::JumpIfNotNullish: case Op::JumpIfNotUndefined:
+        case Op::GetNamed: case Op::GetNamedStar:
+        case Op::LdarStar: case Op::LdaSmiStar: case Op::LdaConstStar: case Op::LdaZeroStar:
+        case Op::LdaThisStar:
+        case Op::Return:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// What one qualifying site calls, with what the guard has to test for it.
+struct Callee {
+    Function* function;
+    const BytecodeChunk* body;
+    uint8_t flags;
+};
+
+// Whether `fn`'s body can stand in for a call of it from a site that does
+// (has_receiver) or does not pass a receiver.
+bool inlinable(Function* fn, bool has_receiver, uint8_t& flags) {
+    if (!fn || fn->get_function_kind() != Function::FunctionKind::Plain) return false;
+    if (!fn->register_call_ready()) return false;
+    const FunctionExecutable* exe = fn->get_executable().get();
+    const BytecodeChunk* body = exe ? exe->bytecode_chunk.get() : nullptr;
+    if (!body || body->code.size() == 0 || body->code.size() > kMaxBodyBytes) return false;
+    if (body->env_mode || body->env || body->needs_arguments || body->uses_lookup_cache ||
+        body->handlers || body->closures || body->treewalk_nodes || body->ic_feedback ||
+        !body->call_feedback.empty()) {
+        return false;
+    }
+    flags = 0;
+    if (body->uses_this) {
+        // An arrow's `this` is its closure's, which the site knows nothing of.
+        if (fn->is_arrow()) return false;
+        if (!fn->is_strict() && !exe->fast_strict) {
+            // Sloppy `this` with no receiver is the global object.
+            if (!has_receiver) return false;
+            flags |= InlinedCode::kObjectThis;
+        }
+    }
+    const uint8_t* code = body->code.data();
+    const uint32_t size = body->code.size();
+    for (uint32_t pc = 0; pc < size;) {
+        Op op = static_cast<Op>(code[pc]);
+        if (op >= Op::kCount || !leaf_op(op)) return false;
+        pc += 1 + static_cast<uint32_t>(op_operand_bytes(op));
+        if (pc > size) return false;
+    }
+    return true;
+}
+
+// Emits the variant's code: the caller's instructions in order, a qualifying
+// site expanded in place. Jumps are written with a placeholder and patched
+// once every target has an address; an offset that no longer fits in 16 bits
+// fails the whole build.
+class Builder {
+public:
+    Builder(const BytecodeChunk& chunk)
+        : chunk_(chunk),
+          constants_(chunk.constants.begin(), chunk.constants.end()),
+          names_(chunk.names.begin(), chunk.names.end()),
+          feedback_(chunk.feedback.begin(), chunk.feedback.end()) {}
+
+    bool build(const std::unordered_map<uint32_t, uint8_t>& sites, const std::vector<Callee>& callees);
+    std::unique_ptr<BytecodeChunk> finish(std::vector<InlinedCode::Target> targets);
+    uint16_t extra_registers() const { return extra_registers_; }
+
+private:
+    struct Fixup { uint32_t at; uint32_t target; };
+
+    void u8(uint8_t b) { out_.push_back(b); }
+    void u16(uint16_t v) { out_.push_back(static_cast<uint8_t>(v)); out_.push_back(static_cast<uint8_t>(v >> 8)); }
+    uint32_t here() const { return static_cast<uint32_t>(out_.size()); }
+    // A jump operand to a target in the output, patched by resolve().
+    void jump_to_later(std::vector<Fixup>& fixups) { fixups.push_back({here(), 0}); u16(0); }
+    bool patch(uint32_t at, uint32_t target) {
+        const int64_t off = static_cast<int64_t>(target) - static_cast<int64_t>(at + 2);
+        if (off < INT16_MIN || off > INT16_MAX) return false;
+        const uint16_t raw = static_cast<uint16_t>(static_cast<int16_t>(off));
+        out_[at] = static_cast<uint8_t>(raw);
+        out_[at + 1] = static_cast<uint8_t>(raw >> 8);
+        return true;
+    }
+    uint16_t add_constant(const Value& v) { constants_.push_back(v); return static_cast<uint16_t>(constants_.size() - 1); }
+    uint16_t add_name(const std::string* n) {
+        auto [it, fresh] = name_ids_.try_emplace(n, static_cast<uint16_t>(names_.size()));
+        if (fresh) names_.push_back(n);
+        return it->second;
+    }
+    uint16_t add_feedback(const FeedbackSlot& fb) { feedback_.push_back(fb); return static_cast<uint16_t>(feedback_.size() - 1); }
+    bool pools_fit() const {
+        return constants_.size() <= 0xFFFF && names_.size() <= 0xFFFF && feedback_.size() <= 0xFFFF;
+    }
+
+    bool expand(uint32_t pc, Op op, uint8_t target, const Callee& callee);
+
+    const BytecodeChunk& chunk_;
+    std::vector<uint8_t> out_;
+    std::vector<Value> constants_;
+    std::vector<const std::string*> names_;
+    std::unordered_map<const std::string*, uint16_t> name_ids_;
+    std::vector<FeedbackSlot> feedback_;
+    // Old pc -> new pc, for every instruction start of the caller plus its end.
+    std::vector<uint32_t> moved_;
+    // The caller's own jumps, target still an old pc.
+    std::vector<Fixup> caller_jumps_;
+    uint16_t extra_registers_ = 0;
+};
+
+bool Builder::build(const std::unordered_map<uint32_t, uint8_t>& sites,
+                    const std::vector<Callee>& callees) {
+    const uint8_t* code = chunk_.code.data();
+    const uint32_t size = chunk_.code.size();
+    moved_.assign(size + 1, 0);
+    out_.reserve(size * 2);
+    for (const auto* n : names_) name_ids_.try_emplace(n, static_cast<uint16_t>(name_ids_.size()));
+
+    for (uint32_t pc = 0; pc < size;) {
+        const Op op = static_cast<Op>(code[pc]);
+        const uint32_t width = 1 + static_cast<uint32_t>(op_operand_bytes(op));
+        moved_[pc] = here();
+        auto site = sites.find(pc);
+        if (site != sites.end()) {
+            if (!expand(pc, op, site->second, callees[site->second])) return false;
+        } else {
+            const int off_at = op_jump_offset(op);
+            for (uint32_t k = 0; k < width; k++) u8(code[pc + k]);
+            if (off_at >= 0) {
+                const uint32_t at = pc + 1 + static_cast<uint32_t>(off_at);
+                const int16_t off = static_cast<int16_t>(u16_at(code, at));
+                const int64_t target = static_cast<int64_t>(at) + 2 + off;
+                if (target < 0 || target > size) return false;
+                caller_jumps_.push_back({moved_[pc] + 1 + static_cast<uint32_t>(off_at),
+                                         static_cast<uint32_t>(target)});
+            }
+        }
+        pc += width;
+    }
+    moved_[size] = here();
+    for (const Fixup& j : caller_jumps_) {
+        if (!patch(j.at, moved_[j.target])) return false;
+    }
+    return pools_fit();
+}
+
+// One site, laid out as Inliner.h draws it. The callee's registers sit past
+// the caller's own; every site shares that area, since no two are live at once.
+bool Builder::expand(uint32_t pc, Op op, uint8_t target, const Callee& callee) {
+    const uint8_t* code = chunk_.code.data();
+    const BytecodeChunk& body = *callee.body;
+    const bool resolved = op == Op::CallResolved;
+    const uint8_t callee_reg = code[pc + 1];
+    const uint8_t this_reg = resolved ? code[pc + 2] : callee_reg;
+    const uint8_t args_start = code[pc + (resolved ? 3 : 2)];
+    const uint8_t argc = code[pc + (resolved ? 4 : 3)];
+    const uint32_t base = chunk_.register_count;
+    if (base + body.register_count > 255) return false;
+    if (body.register_count > extra_registers_) extra_registers_ = body.register_count;
+    auto reg = [&](uint8_t r) { return static_cast<uint8_t>(base + r); };
+
+    std::vector<Fixup> to_slow;
+    std::vector<Fixup> to_done;
+    u8(static_cast<uint8_t>(Op::InlineGuard));
+    u8(callee_reg);
+    u8(this_reg);
+    u8(target);
+    u8(callee.flags);
+    jump_to_later(to_slow);
+
+    // The frame VM::run would have built: parameters from the arguments that
+    // were passed, everything else undefined.
+    u8(static_cast<uint8_t>(Op::LdaUndefined));
+    for (uint32_t r = 0; r < body.register_count; r++) {
+        if (r < body.parameter_count && r < argc) {
+            u8(static_cast<uint8_t>(Op::Mov));
+            u8(static_cast<uint8_t>(args_start + r));
+            u8(reg(static_cast<uint8_t>(r)));
+        } else {
+            u8(static_cast<uint8_t>(Op::Star));
+            u8(reg(static_cast<uint8_t>(r)));
+        }
+    }
+
+    const uint8_t* bc = body.code.data();
+    const uint32_t bsize = body.code.size();
+    std::vector<uint32_t> body_moved(bsize + 1, 0);
+    std::vector<Fixup> body_jumps;
+    auto load_this = [&]() {
+        if (resolved) { u8(static_cast<uint8_t>(Op::Ldar)); u8(this_reg); }
+        else u8(static_cast<uint8_t>(Op::LdaUndefined));
+    };
+    for (uint32_t bpc = 0; bpc < bsize;) {
+        const Op bop = static_cast<Op>(bc[bpc]);
+        const uint32_t width = 1 + static_cast<uint32_t>(op_operand_bytes(bop));
+        body_moved[bpc] = here();
+        switch (bop) {
+            case Op::LdaThis:
+                load_this();
+                break;
+            case Op::LdaThisStar:
+                load_this();
+                u8(static_cast<uint8_t>(Op::Star));
+                u8(reg(bc[bpc + 1]));
+                break;
+            case Op::Return:
+                u8(static_cast<uint8_t>(Op::Jump));
+                jump_to_later(to_done);
+                break;
+            case Op::LdaConst:
+                u8(static_cast<uint8_t>(bop));
+                u16(add_constant(body.constants[u16_at(bc, bpc + 1)]));
+                break;
+            case Op::LdaConstStar:
+                u8(static_cast<uint8_t>(bop));
+                u16(add_constant(body.constants[u16_at(bc, bpc + 1)]));
+                u8(reg(bc[bpc + 3]));
+                break;
+            case Op::LdaSmiStar:
+                u8(static_cast<uint8_t>(bop));
+                u8(bc[bpc + 1]);
+                u8(reg(bc[bpc + 2]));
+                break;
+            case Op::LdarChecked: case Op::StarChecked:
+                u8(static_cast<uint8_t>(bop));
+                u8(reg(bc[bpc + 1]));
+                u16(add_name(body.names[u16_at(bc, bpc + 2)]));
+                break;
+            case Op::GetNamed: case Op::GetNamedStar:
+                u8(static_cast<uint8_t>(bop));
+                u8(reg(bc[bpc + 1]));
+                u16(add_name(body.names[u16_at(bc, bpc + 2)]));
+                // Starts out with what the callee had learned, which is what
+                // this site will be handed.
+                u16(add_feedback(body.feedback[u16_at(bc, bpc + 4)]));
+                if (bop == Op::GetNamedStar) u8(reg(bc[bpc + 6]));
+                break;
+            default: {
+                const int off_at = op_jump_offset(bop);
+                u8(static_cast<uint8_t>(bop));
+                if (off_at >= 0) {
+                    // Every jump leaf_op admits is a bare offset.
+                    const int16_t off = static_cast<int16_t>(u16_at(bc, bpc + 1));
+                    const int64_t t = static_cast<int64_t>(bpc) + 3 + off;
+                    if (t < 0 || t > bsize) return false;
+                    body_jumps.push_back({here(), static_cast<uint32_t>(t)});
+                    u16(0);
+                } else if (op_operand_kind(bop) == 'r') {
+                    for (uint32_t k = 1; k < width; k++) u8(reg(bc[bpc + k]));
+                } else {
+                    for (uint32_t k = 1; k < width; k++) u8(bc[bpc + k]);
+                }
+                break;
+            }
+        }
+        bpc += width;
+    }
+    body_moved[bsize] = here();
+    for (const Fixup& j : body_jumps) {
+        if (!patch(j.at, body_moved[j.target])) return false;
+    }
+    // Every body ends in Return, so control never falls out of the bottom;
+    // the jump is here for a body that somehow did.
+    u8(static_cast<uint8_t>(Op::Jump));
+    jump_to_later(to_done);
+
+    const uint32_t slow = here();
+    const uint32_t width = 1 + static_cast<uint32_t>(op_operand_bytes(op));
+    for (uint32_t k = 0; k < width; k++) u8(code[pc + k]);
+    const uint32_t done = here();
+    for (const Fixup& j : to_slow) if (!patch(j.at, slow)) return false;
+    for (const Fixup& j : to_done) if (!patch(j.at, done)) return false;
+    return true;
+}
+
+std::unique_ptr<BytecodeChunk> Builder::finish(std::vector<InlinedCode::Target> targets) {
+    auto v = std::make_unique<BytecodeChunk>();
+    v->code = FixedArray<uint8_t>::from(std::move(out_));
+    v->constants = FixedArray<Value>::from(std::move(constants_));
+    v->names = FixedArray<const std::string*>::from(std::move(names_));
+    v->feedback = FixedArray<FeedbackSlot>::from(std::move(feedback_));
+    v->call_feedback = FixedArray<CallFeedback>::from(
+        std::vector<CallFeedback>(chunk_.call_feedback.begin(), chunk_.call_feedback.end()));
+    if (chunk_.uses_lookup_cache) {
+        v->lookup_cache = FixedArray<BytecodeChunk::LookupCacheEntry>::filled(
+            v->names.size(), BytecodeChunk::LookupCacheEntry{});
+    }
+    v->register_count = static_cast<uint16_t>(chunk_.register_count + extra_registers_);
+    v->parameter_count = chunk_.parameter_count;
+    v->env_mode = chunk_.env_mode;
+    v->env_params_tdz = chunk_.env_params_tdz;
+    v->lex_scope_split = chunk_.lex_scope_split;
+    v->script_mode = chunk_.script_mode;
+    v->needs_arguments = chunk_.needs_arguments;
+    v->uses_lookup_cache = chunk_.uses_lookup_cache;
+    v->uses_this = chunk_.uses_this;
+    // Built from code that has already run hot: straight to the baseline
+    // tier on its first call rather than earning it again.
+    v->baseline_budget = 1;
+    if (chunk_.ic_feedback) {
+        auto& ic = v->ensure_ic_feedback();
+        ic.private_feedback = chunk_.ic_feedback->private_feedback;
+        ic.keyed_feedback = chunk_.ic_feedback->keyed_feedback;
+    }
+    if (chunk_.closures) v->ensure_closures() = *chunk_.closures;
+    if (chunk_.classes) v->ensure_classes() = *chunk_.classes;
+    if (chunk_.treewalk_nodes) v->ensure_treewalk_nodes() = *chunk_.treewalk_nodes;
+    if (chunk_.handlers) {
+        auto& handlers = v->ensure_handlers();
+        for (HandlerEntry h : *chunk_.handlers) {
+            h.start_pc = moved_[h.start_pc];
+            h.end_pc = moved_[h.end_pc];
+            h.handler_pc = moved_[h.handler_pc];
+            if (h.genreturn_pc >= 0) h.genreturn_pc = static_cast<int32_t>(moved_[h.genreturn_pc]);
+            handlers.push_back(h);
+        }
+    }
+    v->inlined = std::make_unique<InlinedCode>();
+    v->inlined->targets = std::move(targets);
+    v->inlined->sites = static_cast<uint32_t>(v->inlined->targets.size());
+    return v;
+}
+
+}
+
+bool inlining_enabled() {
+    return g_inline_on;
+}
+
+void inline_compile(const BytecodeChunk& chunk, Function* owner) {
+    // Set on a const chunk the way chunk.threaded is, once. Whatever happens
+    // below, it is not tried again.
+    auto record = std::make_unique<InlinedCode>();
+    InlinedCode& result = *record;
+    const_cast<BytecodeChunk&>(chunk).inlined = std::move(record);
+    if (chunk.env || chunk.script_mode || chunk.call_feedback.empty()) return;
+
+    const uint8_t* code = chunk.code.data();
+    const uint32_t size = chunk.code.size();
+    std::unordered_map<uint32_t, uint8_t> sites;
+    std::vector<Callee> callees;
+    std::vector<InlinedCode::Target> targets;
+    for (uint32_t pc = 0; pc < size;) {
+        const Op op = static_cast<Op>(code[pc]);
+        if (op >= Op::kCount) return;
+        const uint32_t width = 1 + static_cast<uint32_t>(op_operand_bytes(op));
+        if (pc + width > size) return;
+        if ((op == Op::Call || op == Op::CallResolved) && callees.size() < kMaxSites) {
+            const CallFeedback& cf = chunk.call_feedback[u16_at(code, pc + width - 2)];
+            uint8_t flags = 0;
+            if (cf.kind == CallFeedback::Kind::Bytecode && cf.function &&
+                cf.function->get_executable().get() == cf.executable &&
+                inlinable(cf.function, op == Op::CallResolved, flags)) {
+                sites.emplace(pc, static_cast<uint8_t>(callees.size()));
+                callees.push_back({cf.function, cf.executable->bytecode_chunk.get(), flags});
+                targets.push_back({cf.function, cf.executable});
+            }
+        }
+        pc += width;
+    }
+    if (callees.empty()) return;
+
+    Builder builder(chunk);
+    if (!builder.build(sites, callees)) return;
+    result.variant = builder.finish(std::move(targets));
+    result.sites = static_cast<uint32_t>(callees.size());
+    // The variant's pools hold cells only the owner's trace reaches, and the
+    // owner may already be old.
+    Collector::write_barrier(owner);
+
+    static const bool disasm = [] {
+        const char* env = std::getenv("QUANTA_VM_DISASM");
+        return env && env[0] == '1';
+    }();
+    if (disasm) {
+        std::fprintf(stderr, "%s", disassemble_chunk(*result.variant,
+                                                     owner ? owner->get_name() + " (inlined)"
+                                                           : std::string("(inlined)")).c_str());
+    }
+}
+
+}
+}
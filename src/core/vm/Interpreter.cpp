@@ -7,6 +7,7 @@
 #include <array>
 #include "quanta/core/vm/Interpreter.h"
 #include "quanta/core/vm/BytecodeCompiler.h"
+#include "vm_internal.h"
 #include "quanta/core/engine/CallStack.h"
 #include "quanta/core/engine/Context.h"
 #include "quanta/core/gc/Collector.h"
@@ -65,6 +66,10 @@ Value build_rest_object(Context& ctx, const Value& source_value, Object* source_
 // And from language.cpp, backing Op::CreateClosure / Op::DeclareFunction.
 Value instantiate_closure(Context& ctx, const ClosureTemplate& tpl);
 Value declare_function(Context& ctx, const ClosureTemplate& tpl);
+// And from language.cpp, backing Op::CreateClass / Op::DefineClassMember.
+Value create_class(Context& ctx, const ClassTemplate& tpl, const Value& heritage);
+void define_class_member(Context& ctx, Function* constructor_fn, const ClassTemplate& tpl,
+                         uint8_t index, const Value& computed_key);
 // And from call.cpp, backing Op::SuperCall.
 Value perform_super_call(Context& ctx, std::span<const Value> arg_values, bool super_already_called);
 // And from member.cpp, backing the Op::GetSuper family.
@@ -961,8 +966,16 @@ void learn_keyed(KeyedFeedback* fb, Shape* shape, const std::string& key, uint32
 // A key that is already a number and is exactly a canonical array index.
 // Everything else, including fractions, negatives and the out-of-range
 // doubles, falls through to ToPropertyKey. -0 lands on 0, which is what
-// ToPropertyKey produces for it as well.
+// ToPropertyKey produces for it as well. The int32 form, which is what a loop
+// counter or a masked hash usually is by the time it indexes, needs only its
+// sign checked.
 inline bool array_index_key(const Value& v, uint32_t& out) {
+    if (LIKELY(v.is_int32())) {
+        int32_t i = v.as_int32();
+        if (i < 0) return false;
+        out = static_cast<uint32_t>(i);
+        return true;
+    }
     if (!v.is_number()) return false;
     double d = v.as_number();
     // Bound first: casting a double outside the uint32 range is undefined.
@@ -1247,57 +1260,6 @@ void set_private(Context& ctx, const Value& receiver, const std::string& name,
 
 }
 
-// Everything the dispatch loop reads or writes, so the loop can live in a
-// function of its own with no exception-handling region in it. run() keeps
-// the try/catch, the register bank and the env side-stack; this only hands
-// the loop pointers to them.
-struct Frame {
-    const BytecodeChunk& chunk;
-    Context& ctx;
-    std::span<const Value> args;
-    Function* owner;
-    // Whether this frame's inline caches may hold cells: true when a function
-    // owns the chunk and traces it, and true for the top-level script, whose
-    // chunk run_script roots for the duration. Separate from `owner`, which
-    // also decides ROUTING -- a chunk shared across instances needs each
-    // instance's own lookup/private caches, and only a function has those.
-    bool feedback_rooted;
-    Value* regs;
-    Environment** env_saves;
-    // A reference resolved before the right side of an assignment runs, parked
-    // until the store. Only a body with a direct eval needs it: eval is the one
-    // thing that can add a nearer binding between the two.
-    Environment** resolved_envs;
-    BytecodeChunk::LookupCacheEntry* lookup_cache_data;
-    PrivateFeedback* private_feedback_data;
-    const uint8_t* code;
-    const Value* constants;
-    Environment* entry_env;
-    // Written by the loop and read by run() after an exception unwinds out of
-    // it, so these cannot be locals of the dispatch function.
-    Value this_value;
-    Value acc;
-    uint32_t pc;
-    uint32_t instr_pc;
-    uint8_t env_save_top;
-    bool this_resolved;
-};
-
-// Tail-call threaded dispatch.
-//
-// This started as a single switch over every opcode, which kept the
-// interpreter's state on the stack: run's frame had 133 distinct slots and
-// even `code`, a pointer that never changes, was reloaded per opcode -- 48
-// instructions and ~15 loads for an opcode like Ldar that needs about four. A
-// handler per opcode carries the hot state in argument registers instead, and
-// musttail makes each one reuse the same machine frame rather than growing
-// the stack.
-//
-// `pc` names the opcode byte itself, never its operands, so a handler that
-// only covers the common shape can hand that same pc to a slower one.
-using Handler = Value (*)(Frame&, uint32_t, Value);
-
-extern const std::array<Handler, 256> kHandlers;
 
 #define DISPATCH() [[clang::musttail]] return kHandlers[f.code[pc]](f, pc, acc)
 
@@ -1310,7 +1272,7 @@ extern const std::array<Handler, 256> kHandlers;
         DISPATCH();                                                        \
     }
 
-CONST_HANDLER(h_LdaZero, Value(0.0))
+CONST_HANDLER(h_LdaZero, Value::from_int32(0))
 CONST_HANDLER(h_LdaUndefined, Value())
 CONST_HANDLER(h_LdaNull, Value::null())
 CONST_HANDLER(h_LdaTrue, Value(true))
@@ -1334,8 +1296,23 @@ Value h_Mov(Frame& f, uint32_t pc, Value acc) {
     DISPATCH();
 }
 
+// Only in a chunk the inliner built, so the chunk always has its targets.
+Value h_InlineGuard(Frame& f, uint32_t pc, Value acc) {
+    const uint8_t* code = f.code;
+    const Value& callee = f.regs[code[pc + 1]];
+    const InlinedCode::Target& target = f.chunk.inlined->targets[code[pc + 3]];
+    bool hit = callee.is_function() && callee.as_function()->get_executable().get() == target.executable;
+    if (hit && (code[pc + 4] & InlinedCode::kObjectThis)) {
+        const Value& receiver = f.regs[code[pc + 2]];
+        hit = receiver.is_object() || receiver.is_function();
+    }
+    pc += 7;
+    if (!hit) pc += read_i16(code, pc - 2);
+    DISPATCH();
+}
+
 Value h_LdaSmi(Frame& f, uint32_t pc, Value acc) {
-    acc = Value(static_cast<double>(static_cast<int8_t>(f.code[pc + 1])));
+    acc = Value::from_int32(static_cast<int8_t>(f.code[pc + 1]));
     pc += 2;
     DISPATCH();
 }
@@ -1351,14 +1328,14 @@ Value h_LdarStar(Frame& f, uint32_t pc, Value acc) {
 }
 
 Value h_LdaSmiStar(Frame& f, uint32_t pc, Value acc) {
-    acc = Value(static_cast<double>(static_cast<int8_t>(f.code[pc + 1])));
+    acc = Value::from_int32(static_cast<int8_t>(f.code[pc + 1]));
     f.regs[f.code[pc + 2]] = acc;
     pc += 3;
     DISPATCH();
 }
 
 Value h_LdaZeroStar(Frame& f, uint32_t pc, Value acc) {
-    acc = Value(0.0);
+    acc = Value::from_int32(0);
     f.regs[f.code[pc + 1]] = acc;
     pc += 2;
     DISPATCH();
@@ -1390,10 +1367,18 @@ Value h_Return(Frame& f, uint32_t pc, Value acc) {
     return acc;
 }
 
+// A back-edge is also where a loop that made its chunk hot moves onto the
+// chunk's native code, mid-iteration, without waiting for the next call.
 Value h_Jump(Frame& f, uint32_t pc, Value acc) {
     int16_t off = read_i16(f.code, pc + 1);
     pc += 3 + off;
-    if (off < 0) Collector::safepoint();
+    if (off < 0) {
+        // The collector reads this frame's registers as live at instr_pc.
+        f.instr_pc = pc;
+        if (Collector::safepoint()) [[unlikely]]
+            [[clang::musttail]] return heap_limit_exit(f, pc, acc);
+        if (baseline_tick(f)) [[clang::musttail]] return baseline_enter(f, pc, acc);
+    }
     DISPATCH();
 }
 
@@ -1403,7 +1388,13 @@ Value h_Jump(Frame& f, uint32_t pc, Value acc) {
         pc += 3;                                                           \
         if (cond) {                                                        \
             pc += off;                                                     \
-            if (off < 0) Collector::safepoint();                           \
+            if (off < 0) {                                                 \
+                f.instr_pc = pc;                                           \
+                if (Collector::safepoint()) [[unlikely]]                   \
+                    [[clang::musttail]] return heap_limit_exit(f, pc, acc); \
+                if (baseline_tick(f))                                      \
+                    [[clang::musttail]] return baseline_enter(f, pc, acc); \
+            }                                                              \
         }                                                                  \
         DISPATCH();                                                        \
     }
@@ -1445,9 +1436,9 @@ BRANCH_HANDLER(h_JumpIfTrue, acc.to_boolean())
     do {                                                                   \
         const Value& lhs = regs[code[pc]];                                 \
         pc += 1;                                                           \
-        if (LIKELY(lhs.is_finite_double() && acc.is_finite_double())) {    \
-            double l = lhs.as_finite_double();                             \
-            double r = acc.as_finite_double();                             \
+        if (LIKELY(lhs.is_finite_number() && acc.is_finite_number())) {    \
+            double l = lhs.as_finite_number();                             \
+            double r = acc.as_finite_number();                             \
             (void)l; (void)r;                                              \
             acc = (expr);                                                  \
         } else {                                                           \
@@ -1518,24 +1509,52 @@ BRANCH_HANDLER(h_JumpIfTrue, acc.to_boolean())
         pc = static_cast<uint32_t>(handler_pc);                           \
     } else ((void)0)
 
-// Two finite doubles is the whole fast form; a string, a BigInt or an object
-// with valueOf goes to binary_slow, and the split matters because the fast
-// half stays small enough to keep its operands in registers. Putting both in
-// one handler made every iteration of a numeric loop carry the prologue the
-// slow half needs -- chunk, ctx, instr_pc -- to reach a call it never makes.
-#define NUMERIC_BINARY_HANDLER(name, binop, expr)                          \
+Value heap_limit_exit(Frame& f, uint32_t pc, Value acc) {
+    const BytecodeChunk& chunk = f.chunk;
+    Context& ctx = f.ctx;
+    const uint32_t instr_pc = f.instr_pc;
+    Collector::raise_heap_limit_error(ctx);
+    CHECK_EXC_TAIL();
+    DISPATCH();
+}
+
+// Two int32s or two finite doubles is the whole fast form; a string, a
+// BigInt or an object with valueOf goes to binary_slow, and the split matters
+// because the fast half stays small enough to keep its operands in registers.
+// Putting both in one handler made every iteration of a numeric loop carry
+// the prologue the slow half needs -- chunk, ctx, instr_pc -- to reach a call
+// it never makes. An int32 against a double is common enough (a counter
+// against an array's length) to be the slow half's first question rather
+// than binary_slow's.
+#define NUMERIC_BINARY_HANDLER(name, binop, expr, int_expr)                \
     Value name##_slow(Frame& f, uint32_t pc, Value acc) {                  \
+        const Value& lhs = f.regs[f.code[pc + 1]];                         \
+        if (lhs.is_finite_number() && acc.is_finite_number()) {            \
+            double l = lhs.as_finite_number();                             \
+            double r = acc.as_finite_number();                             \
+            (void)l; (void)r;                                              \
+            acc = (expr);                                                  \
+            pc += 2;                                                       \
+            DISPATCH();                                                    \
+        }                                                                  \
         const BytecodeChunk& chunk = f.chunk;                              \
         Context& ctx = f.ctx;                                              \
         uint32_t& instr_pc = f.instr_pc;                                   \
         instr_pc = pc;                                                     \
-        acc = binary_slow(ctx, binop, f.regs[f.code[pc + 1]], acc);        \
+        acc = binary_slow(ctx, binop, lhs, acc);                           \
         pc += 2;                                                           \
         CHECK_EXC_TAIL();                                                  \
         DISPATCH();                                                        \
     }                                                                      \
     Value name(Frame& f, uint32_t pc, Value acc) {                         \
         const Value& lhs = f.regs[f.code[pc + 1]];                         \
+        if (LIKELY(lhs.is_int32() && acc.is_int32())) {                    \
+            int32_t a = lhs.as_int32();                                    \
+            int32_t b = acc.as_int32();                                    \
+            acc = (int_expr);                                              \
+            pc += 2;                                                       \
+            DISPATCH();                                                    \
+        }                                                                  \
         if (LIKELY(lhs.is_finite_double() && acc.is_finite_double())) {    \
             double l = lhs.as_finite_double();                             \
             double r = acc.as_finite_double();                             \
@@ -1547,23 +1566,24 @@ BRANCH_HANDLER(h_JumpIfTrue, acc.to_boolean())
         [[clang::musttail]] return name##_slow(f, pc, acc);                \
     }
 
-NUMERIC_BINARY_HANDLER(h_Add, BinOp::ADD, Value(l + r))
-NUMERIC_BINARY_HANDLER(h_Sub, BinOp::SUBTRACT, Value(l - r))
-NUMERIC_BINARY_HANDLER(h_Mul, BinOp::MULTIPLY, Value(l * r))
-NUMERIC_BINARY_HANDLER(h_TestLt, BinOp::LESS_THAN, Value(l < r))
-NUMERIC_BINARY_HANDLER(h_TestGt, BinOp::GREATER_THAN, Value(l > r))
-NUMERIC_BINARY_HANDLER(h_TestLe, BinOp::LESS_EQUAL, Value(l <= r))
-NUMERIC_BINARY_HANDLER(h_TestGe, BinOp::GREATER_EQUAL, Value(l >= r))
-NUMERIC_BINARY_HANDLER(h_TestEq, BinOp::EQUAL, Value(l == r))
-NUMERIC_BINARY_HANDLER(h_TestNe, BinOp::NOT_EQUAL, Value(l != r))
-NUMERIC_BINARY_HANDLER(h_TestStrictEq, BinOp::STRICT_EQUAL, Value(l == r))
-NUMERIC_BINARY_HANDLER(h_TestStrictNe, BinOp::STRICT_NOT_EQUAL, Value(l != r))
+NUMERIC_BINARY_HANDLER(h_Add, BinOp::ADD, Value(l + r), int32_add(a, b))
+NUMERIC_BINARY_HANDLER(h_Sub, BinOp::SUBTRACT, Value(l - r), int32_sub(a, b))
+NUMERIC_BINARY_HANDLER(h_Mul, BinOp::MULTIPLY, Value(l * r), int32_mul(a, b))
+NUMERIC_BINARY_HANDLER(h_TestLt, BinOp::LESS_THAN, Value(l < r), Value(a < b))
+NUMERIC_BINARY_HANDLER(h_TestGt, BinOp::GREATER_THAN, Value(l > r), Value(a > b))
+NUMERIC_BINARY_HANDLER(h_TestLe, BinOp::LESS_EQUAL, Value(l <= r), Value(a <= b))
+NUMERIC_BINARY_HANDLER(h_TestGe, BinOp::GREATER_EQUAL, Value(l >= r), Value(a >= b))
+NUMERIC_BINARY_HANDLER(h_TestEq, BinOp::EQUAL, Value(l == r), Value(a == b))
+NUMERIC_BINARY_HANDLER(h_TestNe, BinOp::NOT_EQUAL, Value(l != r), Value(a != b))
+NUMERIC_BINARY_HANDLER(h_TestStrictEq, BinOp::STRICT_EQUAL, Value(l == r), Value(a == b))
+NUMERIC_BINARY_HANDLER(h_TestStrictNe, BinOp::STRICT_NOT_EQUAL, Value(l != r), Value(a != b))
 
 // A bitwise op is a couple of instructions of real work, so the handler stays
 // as lean as the arithmetic one and splits its fallback out the same way.
 // ToInt32 already answers for NaN and the infinities, so being a number is the
 // entire gate; a string, a BigInt or an object with valueOf takes the slow
-// half, which reaches binary_slow directly.
+// half, which reaches binary_slow directly. Two int32s skip ToInt32, and the
+// result is always an int32 (a uint32, for >>>), so it is kept in that form.
 #define BITWISE_BINARY_HANDLER(name, binop, expr)                          \
     Value name##_slow(Frame& f, uint32_t pc, Value acc) {                  \
         const BytecodeChunk& chunk = f.chunk;                              \
@@ -1577,6 +1597,14 @@ NUMERIC_BINARY_HANDLER(h_TestStrictNe, BinOp::STRICT_NOT_EQUAL, Value(l != r))
     }                                                                      \
     Value name(Frame& f, uint32_t pc, Value acc) {                         \
         const Value& lhs = f.regs[f.code[pc + 1]];                         \
+        if (LIKELY(lhs.is_int32() && acc.is_int32())) {                    \
+            int32_t l = lhs.as_int32();                                    \
+            int32_t r = acc.as_int32();                                    \
+            (void)l; (void)r;                                              \
+            acc = (expr);                                                  \
+            pc += 2;                                                       \
+            DISPATCH();                                                    \
+        }                                                                  \
         if (LIKELY(lhs.is_number() && acc.is_number())) {                  \
             int32_t l = js_to_int32(lhs.as_number());                      \
             int32_t r = js_to_int32(acc.as_number());                      \
@@ -1588,14 +1616,14 @@ NUMERIC_BINARY_HANDLER(h_TestStrictNe, BinOp::STRICT_NOT_EQUAL, Value(l != r))
         [[clang::musttail]] return name##_slow(f, pc, acc);                \
     }
 
-BITWISE_BINARY_HANDLER(h_BitAnd, BinOp::BITWISE_AND, Value(static_cast<double>(l & r)))
-BITWISE_BINARY_HANDLER(h_BitOr,  BinOp::BITWISE_OR,  Value(static_cast<double>(l | r)))
-BITWISE_BINARY_HANDLER(h_BitXor, BinOp::BITWISE_XOR, Value(static_cast<double>(l ^ r)))
+BITWISE_BINARY_HANDLER(h_BitAnd, BinOp::BITWISE_AND, Value::from_int32(l & r))
+BITWISE_BINARY_HANDLER(h_BitOr,  BinOp::BITWISE_OR,  Value::from_int32(l | r))
+BITWISE_BINARY_HANDLER(h_BitXor, BinOp::BITWISE_XOR, Value::from_int32(l ^ r))
 BITWISE_BINARY_HANDLER(h_Shl, BinOp::LEFT_SHIFT,
-    Value(static_cast<double>(static_cast<int32_t>(static_cast<uint32_t>(l) << (r & 31)))))
-BITWISE_BINARY_HANDLER(h_Sar, BinOp::RIGHT_SHIFT, Value(static_cast<double>(l >> (r & 31))))
+    Value::from_int32(static_cast<int32_t>(static_cast<uint32_t>(l) << (r & 31))))
+BITWISE_BINARY_HANDLER(h_Sar, BinOp::RIGHT_SHIFT, Value::from_int32(l >> (r & 31)))
 BITWISE_BINARY_HANDLER(h_Shr, BinOp::UNSIGNED_RIGHT_SHIFT,
-    Value(static_cast<double>(static_cast<uint32_t>(l) >> (r & 31))))
+    uint32_value(static_cast<uint32_t>(l) >> (r & 31)))
 
 // ToNumeric plus the BigInt step, which is everything Inc and Dec do once the
 // accumulator turns out not to be a plain number.
@@ -1624,6 +1652,11 @@ static Value step_numeric(Context& ctx, const Value& acc, double delta) {
         DISPATCH();                                                        \
     }                                                                      \
     Value name(Frame& f, uint32_t pc, Value acc) {                         \
+        if (LIKELY(acc.is_int32())) {                                      \
+            acc = int32_add(acc.as_int32(), (delta));                      \
+            pc += 1;                                                       \
+            DISPATCH();                                                    \
+        }                                                                  \
         if (LIKELY(acc.is_number())) {                                     \
             acc = Value(acc.as_number() + (delta));                        \
             pc += 1;                                                       \
@@ -1632,8 +1665,8 @@ static Value step_numeric(Context& ctx, const Value& acc, double delta) {
         [[clang::musttail]] return name##_slow(f, pc, acc);                \
     }
 
-UNARY_STEP_HANDLER(h_Inc, 1.0)
-UNARY_STEP_HANDLER(h_Dec, -1.0)
+UNARY_STEP_HANDLER(h_Inc, 1)
+UNARY_STEP_HANDLER(h_Dec, -1)
 
 Value h_gen_LdaThis(Frame& f, uint32_t pc, Value acc) {
     const BytecodeChunk& chunk = f.chunk;
@@ -2556,7 +2589,7 @@ Value h_gen_LdaEnv(Frame& f, uint32_t pc, Value acc);
 // tail-call below.
 template <bool Fused>
 Value h_LdaEnvFast(Frame& f, uint32_t pc, Value acc) {
-    static const std::string* kThis = Shape::intern("this");
+    static const std::string* kThis = Shape::intern_pinned("this");
     const std::string* key = f.chunk.names[read_u16(f.code, pc + 1)];
     if (LIKELY(key != kThis)) {
         if (Environment* env = f.ctx.get_lexical_environment()) {
@@ -3322,6 +3355,54 @@ Value h_gen_CreateClosure(Frame& f, uint32_t pc, Value acc) {
     DISPATCH();
 }
 
+Value h_gen_CreateClass(Frame& f, uint32_t pc, Value acc) {
+    const BytecodeChunk& chunk = f.chunk;
+    Context& ctx = f.ctx;
+    Value* regs = f.regs;
+    const uint8_t* code = f.code;
+    uint32_t& instr_pc = f.instr_pc;
+    instr_pc = pc;
+    pc += 1;
+    do {
+                {
+                uint8_t heritage_reg = code[pc];
+                uint16_t idx = read_u16(code, pc + 1);
+                pc += 3;
+                acc = create_class(ctx, (*chunk.classes)[idx], regs[heritage_reg]);
+                CHECK_EXC();
+                break;
+            }
+    } while (0);
+    CHECK_EXC_TAIL();
+    DISPATCH();
+}
+
+Value h_gen_DefineClassMember(Frame& f, uint32_t pc, Value acc) {
+    const BytecodeChunk& chunk = f.chunk;
+    Context& ctx = f.ctx;
+    Value* regs = f.regs;
+    const uint8_t* code = f.code;
+    uint32_t& instr_pc = f.instr_pc;
+    instr_pc = pc;
+    pc += 1;
+    do {
+                {
+                uint8_t class_reg = code[pc];
+                uint8_t key_reg = code[pc + 1];
+                uint16_t idx = read_u16(code, pc + 2);
+                uint8_t member = code[pc + 4];
+                pc += 5;
+                // Only ever the value CreateClass left there.
+                define_class_member(ctx, regs[class_reg].as_function(), (*chunk.classes)[idx],
+                                    member, regs[key_reg]);
+                CHECK_EXC();
+                break;
+            }
+    } while (0);
+    CHECK_EXC_TAIL();
+    DISPATCH();
+}
+
 Value h_gen_DeclareFunction(Frame& f, uint32_t pc, Value acc) {
     const BytecodeChunk& chunk = f.chunk;
     Context& ctx = f.ctx;
@@ -3410,6 +3491,84 @@ Value h_gen_CopyRestProperties(Frame& f, uint32_t pc, Value acc) {
     DISPATCH();
 }
 
+// First call through a Call/CallResolved site: note what it called, if it is
+// one of the shapes CallFeedback knows, then make the call the generic way.
+// Anything else -- a generator, a class constructor, a body whose gate is
+// still shut -- leaves the site Mega from the start rather than asking again.
+[[gnu::noinline]] static Value learn_call_target(Frame& f, CallFeedback& cf, Function* fn,
+                                                 std::span<const Value> args, const Value& receiver) {
+    Context& ctx = f.ctx;
+    Value result = fn->call_register_args(ctx, args, receiver);
+    // The call may have settled the gate, so ask once it has returned. A site
+    // another call already taught in the meantime (recursion) is left alone.
+    if (cf.kind != CallFeedback::Kind::Uninit) return result;
+    if (!f.feedback_rooted) { cf.kind = CallFeedback::Kind::Mega; return result; }
+    if (fn->is_native()) {
+        Value bound_target = fn->get_internal_slot("__bound_target__");
+        if (!bound_target.is_undefined()) {
+            Function* target = bound_target.is_function() ? bound_target.as_function()
+                             : bound_target.is_object() ? as_function(bound_target.as_object())
+                                                        : nullptr;
+            if (target && fn->has_internal_slot("__bound_this__")) {
+                Collector::write_barrier(f.owner);
+                cf.function = fn;
+                cf.target = target;
+                cf.bound_this = fn->get_internal_slot("__bound_this__");
+                cf.kind = CallFeedback::Kind::Bound;
+                return result;
+            }
+            cf.kind = CallFeedback::Kind::Mega;
+            return result;
+        }
+        Collector::write_barrier(f.owner);
+        cf.function = fn;
+        cf.kind = CallFeedback::Kind::Native;
+        return result;
+    }
+    if (fn->get_function_kind() == Function::FunctionKind::Plain && fn->register_call_ready()) {
+        Collector::write_barrier(f.owner);
+        cf.function = fn;
+        cf.executable = fn->get_executable().get();
+        cf.kind = CallFeedback::Kind::Bytecode;
+        return result;
+    }
+    cf.kind = CallFeedback::Kind::Mega;
+    return result;
+}
+
+// Call and CallResolved both come through here once the callee is known to be
+// a Function. A hit skips what call_register_args would ask of it; the first
+// miss on a learned site drops its cells and sends it down the generic path
+// for good.
+static inline Value call_with_feedback(Frame& f, CallFeedback& cf, Function* fn,
+                                       std::span<const Value> args, const Value& receiver) {
+    Context& ctx = f.ctx;
+    switch (cf.kind) {
+        case CallFeedback::Kind::Bytecode:
+            if (fn->get_executable().get() == cf.executable)
+                return fn->call_monomorphic(ctx, args, receiver);
+            break;
+        case CallFeedback::Kind::Native:
+            if (fn == cf.function) return fn->call_register_args(ctx, args, receiver);
+            break;
+        case CallFeedback::Kind::Bound:
+            // Inside a constructor body the bound wrapper constructs rather
+            // than calls, so that case keeps going through the wrapper.
+            if (fn == cf.function) {
+                if (ctx.is_in_constructor_call()) return fn->call_register_args(ctx, args, receiver);
+                return cf.target->call_register_args(ctx, args, cf.bound_this);
+            }
+            break;
+        case CallFeedback::Kind::Uninit:
+            return learn_call_target(f, cf, fn, args, receiver);
+        case CallFeedback::Kind::Mega:
+            return fn->call_register_args(ctx, args, receiver);
+    }
+    cf = CallFeedback{};
+    cf.kind = CallFeedback::Kind::Mega;
+    return fn->call_register_args(ctx, args, receiver);
+}
+
 Value h_gen_Call(Frame& f, uint32_t pc, Value acc) {
     const BytecodeChunk& chunk = f.chunk;
     Context& ctx = f.ctx;
@@ -3424,11 +3583,13 @@ Value h_gen_Call(Frame& f, uint32_t pc, Value acc) {
                 uint8_t args_start = code[pc + 1];
                 uint8_t argc = code[pc + 2];
                 uint16_t name_idx = read_u16(code, pc + 3);
-                pc += 5;
+                uint16_t cf_idx = read_u16(code, pc + 5);
+                pc += 7;
                 const Value& callee = regs[callee_reg];
                 std::span<const Value> call_args(regs + args_start, argc);
                 if (callee.is_function()) {
-                    acc = callee.as_function()->call_register_args(ctx, call_args, Value());
+                    acc = call_with_feedback(f, chunk.call_feedback[cf_idx], callee.as_function(),
+                                             call_args, Value());
                 } else if (callee.is_object() &&
                            callee.as_object()->get_type() == Object::ObjectType::Proxy) {
                     std::vector<Value> trap_args(call_args.begin(), call_args.end());
@@ -3437,7 +3598,8 @@ Value h_gen_Call(Frame& f, uint32_t pc, Value acc) {
                     ctx.throw_type_error(chunk.name_at(name_idx) + " is not a function");
                 }
                 CHECK_EXC();
-                Collector::safepoint();
+                if (Collector::safepoint()) Collector::raise_heap_limit_error(ctx);
+                CHECK_EXC();
                 break;
             }
     } while (0);
@@ -3474,7 +3636,8 @@ Value h_gen_CallDirectEval(Frame& f, uint32_t pc, Value acc) {
                     ctx.throw_type_error(chunk.name_at(name_idx) + " is not a function");
                 }
                 CHECK_EXC();
-                Collector::safepoint();
+                if (Collector::safepoint()) Collector::raise_heap_limit_error(ctx);
+                CHECK_EXC();
                 break;
             }
     } while (0);
@@ -3500,12 +3663,14 @@ Value h_gen_CallResolved(Frame& f, uint32_t pc, Value acc) {
                 uint8_t args_start = code[pc + 2];
                 uint8_t argc = code[pc + 3];
                 uint16_t name_idx = read_u16(code, pc + 4);
-                pc += 6;
+                uint16_t cf_idx = read_u16(code, pc + 6);
+                pc += 8;
                 const Value& callee = regs[func_reg];
                 const Value& receiver = regs[this_reg];
                 std::span<const Value> call_args(regs + args_start, argc);
                 if (callee.is_function()) {
-                    acc = callee.as_function()->call_register_args(ctx, call_args, receiver);
+                    acc = call_with_feedback(f, chunk.call_feedback[cf_idx], callee.as_function(),
+                                             call_args, receiver);
                 } else if (callee.is_object() &&
                            callee.as_object()->get_type() == Object::ObjectType::Proxy) {
                     std::vector<Value> trap_args(call_args.begin(), call_args.end());
@@ -3514,7 +3679,8 @@ Value h_gen_CallResolved(Frame& f, uint32_t pc, Value acc) {
                     ctx.throw_type_error(chunk.name_at(name_idx) + " is not a function");
                 }
                 CHECK_EXC();
-                Collector::safepoint();
+                if (Collector::safepoint()) Collector::raise_heap_limit_error(ctx);
+                CHECK_EXC();
                 break;
             }
     } while (0);
@@ -3553,7 +3719,8 @@ Value h_gen_Construct(Frame& f, uint32_t pc, Value acc) {
                     ctx.throw_type_error(chunk.name_at(name_idx) + " is not a constructor");
                 }
                 CHECK_EXC();
-                Collector::safepoint();
+                if (Collector::safepoint()) Collector::raise_heap_limit_error(ctx);
+                CHECK_EXC();
                 break;
             }
     } while (0);
@@ -3597,7 +3764,8 @@ Value h_gen_CallSpread(Frame& f, uint32_t pc, Value acc) {
                     ctx.throw_type_error(chunk.name_at(name_idx) + " is not a function");
                 }
                 CHECK_EXC();
-                Collector::safepoint();
+                if (Collector::safepoint()) Collector::raise_heap_limit_error(ctx);
+                CHECK_EXC();
                 break;
             }
     } while (0);
@@ -3636,7 +3804,8 @@ Value h_gen_ConstructSpread(Frame& f, uint32_t pc, Value acc) {
                     ctx.throw_type_error(chunk.name_at(name_idx) + " is not a constructor");
                 }
                 CHECK_EXC();
-                Collector::safepoint();
+                if (Collector::safepoint()) Collector::raise_heap_limit_error(ctx);
+                CHECK_EXC();
                 break;
             }
     } while (0);
@@ -3842,7 +4011,8 @@ Value h_gen_SuperCall(Frame& f, uint32_t pc, Value acc) {
                 // tree-walker gets by OR-ing its before/after samples.
                 acc = perform_super_call(ctx, call_args, ctx.was_super_called());
                 CHECK_EXC();
-                Collector::safepoint();
+                if (Collector::safepoint()) Collector::raise_heap_limit_error(ctx);
+                CHECK_EXC();
                 break;
             }
     } while (0);
@@ -5275,6 +5445,9 @@ constexpr std::array<Handler, 256> make_handler_table() {
     t[static_cast<uint8_t>(Op::DeclareFunction)] = &h_gen_DeclareFunction;
     t[static_cast<uint8_t>(Op::EvalAst)] = &h_gen_EvalAst;
     t[static_cast<uint8_t>(Op::DefineClass)] = &h_gen_DefineClass;
+    t[static_cast<uint8_t>(Op::InlineGuard)] = &h_InlineGuard;
+    t[static_cast<uint8_t>(Op::CreateClass)] = &h_gen_CreateClass;
+    t[static_cast<uint8_t>(Op::DefineClassMember)] = &h_gen_DefineClassMember;
     t[static_cast<uint8_t>(Op::CopyRestProperties)] = &h_gen_CopyRestProperties;
     t[static_cast<uint8_t>(Op::Call)] = &h_gen_Call;
     t[static_cast<uint8_t>(Op::CallResolved)] = &h_gen_CallResolved;
@@ -5312,12 +5485,18 @@ constexpr std::array<Handler, 256> make_handler_table() {
     t[static_cast<uint8_t>(Op::CreateRestArray)] = &h_gen_CreateRestArray;
     t[static_cast<uint8_t>(Op::Throw)] = &h_gen_Throw;
     t[static_cast<uint8_t>(Op::ReraiseGeneratorReturn)] = &h_gen_ReraiseGeneratorReturn;
+    t[kBaselineExitByte] = &baseline_exit;
+    t[kThreadedExitByte] = &threaded_exit;
     return t;
 }
 const std::array<Handler, 256> kHandlers = make_handler_table();
 
-// Entry point: run() hands the frame over, the table takes it from there.
+// Entry point: run() hands the frame over, the table takes it from there --
+// or, once the frame is on the threaded stream or native code, that does,
+// including after a caught exception has moved pc to a handler.
 Value run_dispatch(Frame& f) {
+    if (f.baseline) return baseline_enter(f, f.pc, f.acc);
+    if (f.threaded) return threaded_enter(f, f.pc, f.acc);
     return kHandlers[f.code[f.pc]](f, f.pc, f.acc);
 }
 
@@ -5326,26 +5505,17 @@ Value run(const BytecodeChunk& chunk, Context& ctx, std::span<const Value> args,
     // Only the registers the chunk actually uses: a fixed 256 put the whole
     // bank on the C++ stack and zeroed it on every call, when the compiler
     // already knows the real count and it is small for most functions.
-    // Zero-initialized either way, so leftover stack garbage in an unused slot
-    // can't look like a live heap pointer to the conservative GC scan.
+    // Zero-initialized; the collector reads the live ones (VM::register_liveness).
     constexpr uint16_t kInlineRegs = 32;
     Value inline_regs[kInlineRegs] = {};
     Value* regs = inline_regs;
     std::vector<Value> spill_regs;
     if (chunk.register_count > kInlineRegs) {
-        // Off the C++ stack, so the conservative scan cannot see it: rooted
-        // explicitly for as long as this frame runs.
+        // Off the C++ stack, which the register-file root below does not
+        // care about: it scans the bank wherever it is.
         spill_regs.resize(chunk.register_count);
         regs = spill_regs.data();
     }
-    struct SpillRoot {
-        const std::vector<Value>* v;
-        ~SpillRoot() { if (v) Collector::pop_value_vector(v); }
-    } spill_root{nullptr};
-    if (!spill_regs.empty()) {
-        Collector::push_value_vector(&spill_regs);
-        spill_root.v = &spill_regs;
-    }
     const uint8_t param_count = chunk.parameter_count;
     for (uint8_t i = 0; i < param_count && i < args.size(); i++) {
         regs[i] = args[i];
@@ -5360,7 +5530,7 @@ Value run(const BytecodeChunk& chunk, Context& ctx, std::span<const Value> args,
     if (chunk.env_mode && chunk.env) {
         Environment* env = ctx.get_lexical_environment();
         // Intern the chunk's binding names once instead of once per call; the
-        // pointers are stable for the thread's lifetime.
+        // pool keeps them for as long as the chunk lives.
         env->reserve_slots(chunk.env->env_slot_total);
         if (!chunk.env->env_keys_ready) {
             auto& b = const_cast<BytecodeChunk::EnvBundle&>(*chunk.env);
@@ -5487,6 +5657,12 @@ Value run(const BytecodeChunk& chunk, Context& ctx, std::span<const Value> args,
                 lookup_cache_data,
                 private_feedback_data, code, constants, entry_env,
                 this_value, Value(), 0, 0, 0, this_resolved};
+    // From here on the collector reads the bank through the chunk's liveness
+    // map at frame.instr_pc. Nothing above can collect, so registering only
+    // once the frame exists costs nothing.
+    RegisterFileRoot register_root({regs, &chunk, &frame.instr_pc});
+    baseline_tick(frame);
+    if (!frame.baseline) threaded_attach(frame);
 
     for (;;) {
       try {
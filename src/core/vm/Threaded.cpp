@@ -0,0 +1,542 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "quanta/core/vm/ThreadedCode.h"
+#include "vm_internal.h"
+#include "quanta/core/engine/Context.h"
+#include "quanta/core/gc/Collector.h"
+#include "quanta/core/runtime/String.h"
+#include <algorithm>
+#include <bit>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+#ifndef LIKELY
+#ifdef __GNUC__
+#define LIKELY(x) __builtin_expect(!!(x), 1)
+#else
+#define LIKELY(x) (x)
+#endif
+#endif
+
+namespace Quanta {
+namespace VM {
+
+static_assert(static_cast<size_t>(Op::kCount) <= kThreadedExitByte,
+              "kThreadedExitByte collides with a real opcode");
+static_assert(kThreadedExitByte != kBaselineExitByte);
+// Three slots to a 64-byte line and a half; the handler pointer and the
+// operands a handler needs always share one.
+static_assert(sizeof(ThreadedSlot) == 24);
+static_assert(sizeof(Value) == sizeof(uint64_t) && std::is_trivially_copyable_v<Value>);
+
+namespace {
+
+const bool g_threaded_on = [] {
+    const char* env = std::getenv("QUANTA_VM_THREADED");
+    if (!env) return true;
+    return env[0] != '0';
+}();
+
+// Left in f.pc by the bridge before it runs a handler. A chain that comes
+// back through threaded_exit overwrites it with where to resume; one that
+// ends in Return, or in an exception nothing in this frame catches, leaves
+// it.
+constexpr uint32_t kFinished = UINT32_MAX;
+
+inline uint16_t operand_u16(const uint8_t* code, uint32_t pc) {
+    return static_cast<uint16_t>(code[pc]) | (static_cast<uint16_t>(code[pc + 1]) << 8);
+}
+
+inline uint32_t operand_u32(const uint8_t* code, uint32_t pc) {
+    return static_cast<uint32_t>(code[pc]) | (static_cast<uint32_t>(code[pc + 1]) << 8) |
+           (static_cast<uint32_t>(code[pc + 2]) << 16) | (static_cast<uint32_t>(code[pc + 3]) << 24);
+}
+
+inline uint64_t bits_of(const Value& v) { return std::bit_cast<uint64_t>(v); }
+
+inline const ThreadedSlot* target_of(const ThreadedSlot* s) {
+    return reinterpret_cast<const ThreadedSlot*>(static_cast<uintptr_t>(s->imm));
+}
+
+#define TDISPATCH() [[clang::musttail]] return s->fn(f, s, acc)
+
+// Everything not decoded, and every decoded fast path whose guard fails: the
+// table's handler for the instruction, run against the exit copy. The common
+// way back is the very next slot, so that is tried before the pc map.
+Value t_bridge(Frame& f, const ThreadedSlot* s, Value acc) {
+    f.pc = kFinished;
+    acc = kHandlers[s->op](f, s->pc, acc);
+    if (f.pc == kFinished) return acc;
+    if (s[1].pc != f.pc) {
+        const ThreadedCode& tc = *f.threaded;
+        s = &tc.slots[tc.slot_at[f.pc]];
+    } else {
+        s += 1;
+    }
+    TDISPATCH();
+}
+
+// Past the last instruction. Every chunk ends in Return, so this is only
+// here so that s[1] always exists; it answers the way h_invalid would.
+Value t_off_end(Frame& f, const ThreadedSlot* s, Value acc) {
+    (void)s;
+    (void)acc;
+    f.ctx.throw_exception(Value(std::string("VM: invalid opcode")));
+    return Value();
+}
+
+Value t_LdaImm(Frame& f, const ThreadedSlot* s, Value acc) {
+    acc = std::bit_cast<Value>(s->imm);
+    s += 1;
+    TDISPATCH();
+}
+
+Value t_LdaConst(Frame& f, const ThreadedSlot* s, Value acc) {
+    acc = f.constants[s->imm];
+    s += 1;
+    TDISPATCH();
+}
+
+Value t_Ldar(Frame& f, const ThreadedSlot* s, Value acc) {
+    acc = f.regs[s->r0];
+    s += 1;
+    TDISPATCH();
+}
+
+Value t_Star(Frame& f, const ThreadedSlot* s, Value acc) {
+    f.regs[s->r0] = acc;
+    s += 1;
+    TDISPATCH();
+}
+
+Value t_Mov(Frame& f, const ThreadedSlot* s, Value acc) {
+    f.regs[s->r1] = f.regs[s->r0];
+    s += 1;
+    TDISPATCH();
+}
+
+Value t_LdarStar(Frame& f, const ThreadedSlot* s, Value acc) {
+    acc = f.regs[s->r0];
+    f.regs[s->r1] = acc;
+    s += 1;
+    TDISPATCH();
+}
+
+Value t_LdaImmStar(Frame& f, const ThreadedSlot* s, Value acc) {
+    acc = std::bit_cast<Value>(s->imm);
+    f.regs[s->r0] = acc;
+    s += 1;
+    TDISPATCH();
+}
+
+Value t_LdaConstStar(Frame& f, const ThreadedSlot* s, Value acc) {
+    acc = f.constants[s->imm];
+    f.regs[s->r0] = acc;
+    s += 1;
+    TDISPATCH();
+}
+
+Value t_Return(Frame& f, const ThreadedSlot* s, Value acc) {
+    (void)f; (void)s;
+    return acc;
+}
+
+// What h_Jump does on a back-edge, for a frame on the stream: the safepoint,
+// and the charge toward the baseline tier. Moving onto native code is once
+// per frame, so that call is an ordinary one. A heap over its limit goes
+// through heap_limit_exit the way t_bridge goes through any handler.
+Value back_edge(Frame& f, const ThreadedSlot* s, Value acc) {
+    f.instr_pc = s->pc;
+    if (Collector::safepoint()) [[unlikely]] {
+        f.pc = kFinished;
+        acc = heap_limit_exit(f, s->pc, acc);
+        if (f.pc == kFinished) return acc;
+        const ThreadedCode& tc = *f.threaded;
+        s = &tc.slots[tc.slot_at[f.pc]];
+        TDISPATCH();
+    }
+    if (baseline_charge(f.chunk)) {
+        baseline_attach(f);
+        return baseline_enter(f, s->pc, acc);
+    }
+    TDISPATCH();
+}
+
+Value t_Jump(Frame& f, const ThreadedSlot* s, Value acc) {
+    const bool back = s->r1 != 0;
+    s = target_of(s);
+    if (back) [[clang::musttail]] return back_edge(f, s, acc);
+    TDISPATCH();
+}
+
+#define THREADED_BRANCH(name, cond)                                        \
+    Value name(Frame& f, const ThreadedSlot* s, Value acc) {               \
+        if (cond) {                                                        \
+            const bool back = s->r1 != 0;                                  \
+            s = target_of(s);                                              \
+            if (back) [[clang::musttail]] return back_edge(f, s, acc);     \
+        } else {                                                           \
+            s += 1;                                                        \
+        }                                                                  \
+        TDISPATCH();                                                       \
+    }
+
+THREADED_BRANCH(t_JumpIfFalse, !acc.to_boolean())
+THREADED_BRANCH(t_JumpIfTrue, acc.to_boolean())
+
+// The fast halves of NUMERIC_BINARY_HANDLER and BITWISE_BINARY_HANDLER, with
+// the register index out of the slot. The slow halves are the table's.
+#define THREADED_NUMERIC(name, expr, int_expr)                             \
+    Value name(Frame& f, const ThreadedSlot* s, Value acc) {               \
+        const Value& lhs = f.regs[s->r0];                                  \
+        if (LIKELY(lhs.is_int32() && acc.is_int32())) {                    \
+            int32_t a = lhs.as_int32();                                    \
+            int32_t b = acc.as_int32();                                    \
+            acc = (int_expr);                                              \
+            s += 1;                                                        \
+            TDISPATCH();                                                   \
+        }                                                                  \
+        if (LIKELY(lhs.is_finite_double() && acc.is_finite_double())) {    \
+            double l = lhs.as_finite_double();                             \
+            double r = acc.as_finite_double();                             \
+            (void)l; (void)r;                                              \
+            acc = (expr);                                                  \
+            s += 1;                                                        \
+            TDISPATCH();                                                   \
+        }                                                                  \
+        [[clang::musttail]] return t_bridge(f, s, acc);                    \
+    }
+
+THREADED_NUMERIC(t_Add, Value(l + r), int32_add(a, b))
+THREADED_NUMERIC(t_Sub, Value(l - r), int32_sub(a, b))
+THREADED_NUMERIC(t_Mul, Value(l * r), int32_mul(a, b))
+THREADED_NUMERIC(t_TestLt, Value(l < r), Value(a < b))
+THREADED_NUMERIC(t_TestGt, Value(l > r), Value(a > b))
+THREADED_NUMERIC(t_TestLe, Value(l <= r), Value(a <= b))
+THREADED_NUMERIC(t_TestGe, Value(l >= r), Value(a >= b))
+THREADED_NUMERIC(t_TestEq, Value(l == r), Value(a == b))
+THREADED_NUMERIC(t_TestNe, Value(l != r), Value(a != b))
+
+// Binary-op quickening. A site starts on t_binary_first, which records what
+// its operands are and rewrites the slot to the form specialized for that;
+// the specialized form re-tests only its own assumption and, when that fails,
+// t_binary_deopt records the new kind and rewrites the slot to the generic
+// handler above for good. A site that has seen two kinds of operand has told
+// us it will keep doing so, and flipping between forms would cost more than
+// the one test the generic handler spends.
+//
+// A number form differs from the generic one in what it takes without a
+// bridge: an int32 against a double, and NaN and the infinities, since the
+// feedback says numbers are what this site gets. A string form goes straight to the concatenation
+// binary_slow would have reached after its own type tests.
+
+inline bool is_int32_valued(double d) {
+    return d >= -2147483648.0 && d <= 2147483647.0 &&
+           d == static_cast<double>(static_cast<int32_t>(d));
+}
+
+uint8_t classify(const Value& l, const Value& r) {
+    if (l.is_number() && r.is_number()) {
+        return is_int32_valued(l.as_number()) && is_int32_valued(r.as_number()) ? kBinaryInt
+                                                                                : kBinaryDouble;
+    }
+    if (l.is_string() && r.is_string()) return kBinaryString;
+    return kBinaryOther;
+}
+
+Value t_binary_deopt(Frame& f, const ThreadedSlot* s, Value acc);
+
+#define THREADED_NUMBER_FORM(name, op, int_expr)                           \
+    Value name(Frame& f, const ThreadedSlot* s, Value acc) {               \
+        const Value& lhs = f.regs[s->r0];                                  \
+        if (LIKELY(lhs.is_int32() && acc.is_int32())) {                    \
+            int32_t a = lhs.as_int32();                                    \
+            int32_t b = acc.as_int32();                                    \
+            acc = (int_expr);                                              \
+            s += 1;                                                        \
+            TDISPATCH();                                                   \
+        }                                                                  \
+        if (LIKELY(lhs.is_finite_number() && acc.is_finite_number())) {    \
+            acc = Value(lhs.as_finite_number() op acc.as_finite_number()); \
+            s += 1;                                                        \
+            TDISPATCH();                                                   \
+        }                                                                  \
+        if (lhs.is_number() && acc.is_number()) {                          \
+            acc = Value(lhs.as_number() op acc.as_number());               \
+            s += 1;                                                        \
+            TDISPATCH();                                                   \
+        }                                                                  \
+        [[clang::musttail]] return t_binary_deopt(f, s, acc);              \
+    }
+
+THREADED_NUMBER_FORM(t_AddNumber, +, int32_add(a, b))
+THREADED_NUMBER_FORM(t_SubNumber, -, int32_sub(a, b))
+THREADED_NUMBER_FORM(t_MulNumber, *, int32_mul(a, b))
+THREADED_NUMBER_FORM(t_LtNumber, <, Value(a < b))
+THREADED_NUMBER_FORM(t_GtNumber, >, Value(a > b))
+THREADED_NUMBER_FORM(t_LeNumber, <=, Value(a <= b))
+THREADED_NUMBER_FORM(t_GeNumber, >=, Value(a >= b))
+
+Value t_AddString(Frame& f, const ThreadedSlot* s, Value acc) {
+    const Value& lhs = f.regs[s->r0];
+    if (LIKELY(lhs.is_string() && acc.is_string())) {
+        acc = Value(String::make_concat(lhs.as_string(), acc.as_string()));
+        s += 1;
+        TDISPATCH();
+    }
+    [[clang::musttail]] return t_binary_deopt(f, s, acc);
+}
+
+struct BinaryForms {
+    ThreadedHandler generic;
+    ThreadedHandler number;
+    ThreadedHandler string;  // null: no string form
+};
+
+BinaryForms forms_of(Op op) {
+    switch (op) {
+        case Op::Add: return {&t_Add, &t_AddNumber, &t_AddString};
+        case Op::Sub: return {&t_Sub, &t_SubNumber, nullptr};
+        case Op::Mul: return {&t_Mul, &t_MulNumber, nullptr};
+        case Op::TestLt: return {&t_TestLt, &t_LtNumber, nullptr};
+        case Op::TestGt: return {&t_TestGt, &t_GtNumber, nullptr};
+        case Op::TestLe: return {&t_TestLe, &t_LeNumber, nullptr};
+        case Op::TestGe:
+        default: return {&t_TestGe, &t_GeNumber, nullptr};
+    }
+}
+
+Value t_binary_first(Frame& f, const ThreadedSlot* s, Value acc) {
+    const uint8_t seen = classify(f.regs[s->r0], acc);
+    const BinaryForms forms = forms_of(static_cast<Op>(s->op));
+    s->feedback = seen;
+    if (seen & kBinaryNumber) s->fn = forms.number;
+    else if (seen == kBinaryString && forms.string) s->fn = forms.string;
+    else s->fn = forms.generic;
+    TDISPATCH();
+}
+
+Value t_binary_deopt(Frame& f, const ThreadedSlot* s, Value acc) {
+    s->feedback |= classify(f.regs[s->r0], acc);
+    s->fn = forms_of(static_cast<Op>(s->op)).generic;
+    TDISPATCH();
+}
+
+#undef THREADED_NUMBER_FORM
+
+#define THREADED_BITWISE(name, expr)                                       \
+    Value name(Frame& f, const ThreadedSlot* s, Value acc) {               \
+        const Value& lhs = f.regs[s->r0];                                  \
+        if (LIKELY(lhs.is_int32() && acc.is_int32())) {                    \
+            int32_t l = lhs.as_int32();                                    \
+            int32_t r = acc.as_int32();                                    \
+            (void)l; (void)r;                                              \
+            acc = (expr);                                                  \
+            s += 1;                                                        \
+            TDISPATCH();                                                   \
+        }                                                                  \
+        if (LIKELY(lhs.is_number() && acc.is_number())) {                  \
+            int32_t l = js_to_int32(lhs.as_number());                      \
+            int32_t r = js_to_int32(acc.as_number());                      \
+            (void)l; (void)r;                                              \
+            acc = (expr);                                                  \
+            s += 1;                                                        \
+            TDISPATCH();                                                   \
+        }                                                                  \
+        [[clang::musttail]] return t_bridge(f, s, acc);                    \
+    }
+
+THREADED_BITWISE(t_BitAnd, Value::from_int32(l & r))
+THREADED_BITWISE(t_BitOr,  Value::from_int32(l | r))
+THREADED_BITWISE(t_BitXor, Value::from_int32(l ^ r))
+THREADED_BITWISE(t_Shl,
+    Value::from_int32(static_cast<int32_t>(static_cast<uint32_t>(l) << (r & 31))))
+THREADED_BITWISE(t_Sar, Value::from_int32(l >> (r & 31)))
+THREADED_BITWISE(t_Shr, uint32_value(static_cast<uint32_t>(l) >> (r & 31)))
+
+#define THREADED_STEP(name, delta)                                         \
+    Value name(Frame& f, const ThreadedSlot* s, Value acc) {               \
+        if (LIKELY(acc.is_int32())) {                                      \
+            acc = int32_add(acc.as_int32(), (delta));                      \
+            s += 1;                                                        \
+            TDISPATCH();                                                   \
+        }                                                                  \
+        if (LIKELY(acc.is_number())) {                                     \
+            acc = Value(acc.as_number() + (delta));                        \
+            s += 1;                                                        \
+            TDISPATCH();                                                   \
+        }                                                                  \
+        [[clang::musttail]] return t_bridge(f, s, acc);                    \
+    }
+
+THREADED_STEP(t_Inc, 1)
+THREADED_STEP(t_Dec, -1)
+
+#undef THREADED_STEP
+#undef THREADED_BITWISE
+#undef THREADED_NUMERIC
+#undef THREADED_BRANCH
+#undef TDISPATCH
+
+// Fills in `s` for the instruction at `pc` when it is one the stream runs
+// itself. Jump targets are left as pcs here and resolved to slots once every
+// slot exists.
+bool decode(const uint8_t* c, uint32_t pc, Op op, ThreadedSlot& s) {
+    c += pc;
+    switch (op) {
+        case Op::LdaZero: s.fn = &t_LdaImm; s.imm = bits_of(Value::from_int32(0)); return true;
+        case Op::LdaUndefined: s.fn = &t_LdaImm; s.imm = bits_of(Value()); return true;
+        case Op::LdaNull: s.fn = &t_LdaImm; s.imm = bits_of(Value::null()); return true;
+        case Op::LdaTrue: s.fn = &t_LdaImm; s.imm = bits_of(Value(true)); return true;
+        case Op::LdaFalse: s.fn = &t_LdaImm; s.imm = bits_of(Value(false)); return true;
+        case Op::LdaSmi:
+            s.fn = &t_LdaImm;
+            s.imm = bits_of(Value::from_int32(static_cast<int8_t>(c[1])));
+            return true;
+        // The index rather than the Value: a constant is a heap pointer the
+        // pool keeps traced, and a copy here would not be.
+        case Op::LdaConst: s.fn = &t_LdaConst; s.imm = operand_u16(c, 1); return true;
+        case Op::LdaConstWide: s.fn = &t_LdaConst; s.imm = operand_u32(c, 1); return true;
+        case Op::Ldar: s.fn = &t_Ldar; s.r0 = c[1]; return true;
+        case Op::Star: s.fn = &t_Star; s.r0 = c[1]; return true;
+        case Op::Mov: s.fn = &t_Mov; s.r0 = c[1]; s.r1 = c[2]; return true;
+        case Op::LdarStar: s.fn = &t_LdarStar; s.r0 = c[1]; s.r1 = c[2]; return true;
+        case Op::LdaSmiStar:
+            s.fn = &t_LdaImmStar;
+            s.imm = bits_of(Value::from_int32(static_cast<int8_t>(c[1])));
+            s.r0 = c[2];
+            return true;
+        case Op::LdaZeroStar: s.fn = &t_LdaImmStar; s.imm = bits_of(Value::from_int32(0)); s.r0 = c[1]; return true;
+        case Op::LdaConstStar: s.fn = &t_LdaConstStar; s.imm = operand_u16(c, 1); s.r0 = c[3]; return true;
+        case Op::Return: s.fn = &t_Return; return true;
+        case Op::Jump:
+        case Op::JumpIfTrue:
+        case Op::JumpIfFalse: {
+            int16_t off = static_cast<int16_t>(operand_u16(c, 1));
+            s.fn = op == Op::Jump ? &t_Jump : op == Op::JumpIfTrue ? &t_JumpIfTrue : &t_JumpIfFalse;
+            s.r1 = off < 0;
+            s.imm = pc + 3 + static_cast<uint32_t>(static_cast<int32_t>(off));
+            return true;
+        }
+        case Op::Add: s.fn = &t_binary_first; s.r0 = c[1]; return true;
+        case Op::Sub: s.fn = &t_binary_first; s.r0 = c[1]; return true;
+        case Op::Mul: s.fn = &t_binary_first; s.r0 = c[1]; return true;
+        case Op::TestLt: s.fn = &t_binary_first; s.r0 = c[1]; return true;
+        case Op::TestGt: s.fn = &t_binary_first; s.r0 = c[1]; return true;
+        case Op::TestLe: s.fn = &t_binary_first; s.r0 = c[1]; return true;
+        case Op::TestGe: s.fn = &t_binary_first; s.r0 = c[1]; return true;
+        case Op::TestEq: s.fn = &t_TestEq; s.r0 = c[1]; return true;
+        case Op::TestNe: s.fn = &t_TestNe; s.r0 = c[1]; return true;
+        case Op::TestStrictEq: s.fn = &t_TestEq; s.r0 = c[1]; return true;
+        case Op::TestStrictNe: s.fn = &t_TestNe; s.r0 = c[1]; return true;
+        case Op::BitAnd: s.fn = &t_BitAnd; s.r0 = c[1]; return true;
+        case Op::BitOr: s.fn = &t_BitOr; s.r0 = c[1]; return true;
+        case Op::BitXor: s.fn = &t_BitXor; s.r0 = c[1]; return true;
+        case Op::Shl: s.fn = &t_Shl; s.r0 = c[1]; return true;
+        case Op::Sar: s.fn = &t_Sar; s.r0 = c[1]; return true;
+        case Op::Shr: s.fn = &t_Shr; s.r0 = c[1]; return true;
+        case Op::Inc: s.fn = &t_Inc; return true;
+        case Op::Dec: s.fn = &t_Dec; return true;
+        default:
+            return false;
+    }
+}
+
+bool is_jump(Op op) {
+    return op == Op::Jump || op == Op::JumpIfTrue || op == Op::JumpIfFalse;
+}
+
+// Decodes the whole chunk, or leaves slot_count at zero if any of it is not
+// well-formed enough to decode -- the table then runs it exactly as before.
+void build(const BytecodeChunk& chunk, ThreadedCode& out) {
+    const uint8_t* code = chunk.code.data();
+    const uint32_t size = static_cast<uint32_t>(chunk.code.size());
+    constexpr uint32_t kNoSlot = UINT32_MAX;
+
+    uint32_t count = 0;
+    for (uint32_t pc = 0; pc < size; count++) {
+        Op op = static_cast<Op>(code[pc]);
+        if (static_cast<size_t>(op) >= static_cast<size_t>(Op::kCount)) return;
+        pc += 1 + static_cast<uint32_t>(op_operand_bytes(op));
+        if (pc > size) return;
+    }
+
+    auto slots = std::make_unique<ThreadedSlot[]>(count + 1);
+    auto slot_at = std::make_unique<uint32_t[]>(size + 1);
+    auto exit_code = std::make_unique<uint8_t[]>(size);
+    std::fill_n(slot_at.get(), size + 1, kNoSlot);
+    std::memcpy(exit_code.get(), code, size);
+
+    uint32_t decoded = 0;
+    uint32_t i = 0;
+    for (uint32_t pc = 0; pc < size; i++) {
+        Op op = static_cast<Op>(code[pc]);
+        ThreadedSlot& s = slots[i];
+        s = ThreadedSlot{&t_bridge, pc, static_cast<uint8_t>(op), 0, 0, 0, 0};
+        if (decode(code, pc, op, s)) {
+            exit_code[pc] = kThreadedExitByte;
+            decoded++;
+        }
+        slot_at[pc] = i;
+        pc += 1 + static_cast<uint32_t>(op_operand_bytes(op));
+    }
+    slots[count] = ThreadedSlot{&t_off_end, size, 0, 0, 0, 0, 0};
+    slot_at[size] = count;
+
+    for (uint32_t k = 0; k < count; k++) {
+        ThreadedSlot& s = slots[k];
+        if (!is_jump(static_cast<Op>(s.op))) continue;
+        uint64_t target = s.imm;
+        if (target > size || slot_at[target] == kNoSlot) return;
+        s.imm = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(&slots[slot_at[target]]));
+    }
+
+    out.slots = std::move(slots);
+    out.slot_at = std::move(slot_at);
+    out.exit_code = std::move(exit_code);
+    out.slot_count = count;
+    out.decoded_ops = decoded;
+}
+
+}
+
+bool threaded_enabled() {
+    return g_threaded_on;
+}
+
+Value threaded_exit(Frame& f, uint32_t pc, Value acc) {
+    f.pc = pc;
+    return acc;
+}
+
+void threaded_attach(Frame& f) {
+    if (!g_threaded_on || f.baseline) return;
+    const BytecodeChunk& chunk = f.chunk;
+    if (!chunk.threaded) {
+        auto tc = std::make_unique<ThreadedCode>();
+        if (chunk.code.size() != 0) build(chunk, *tc);
+        // Set on a const chunk the way chunk.baseline is: once, the first
+        // time it is needed. A chunk that would not decode keeps its empty
+        // ThreadedCode, so it is not tried again on every call.
+        const_cast<BytecodeChunk&>(chunk).threaded = std::move(tc);
+    }
+    ThreadedCode* tc = chunk.threaded.get();
+    if (tc->slot_count == 0) return;
+    f.threaded = tc;
+    f.code = tc->exit_code.get();
+}
+
+Value threaded_enter(Frame& f, uint32_t pc, Value acc) {
+    const ThreadedCode& tc = *f.threaded;
+    const ThreadedSlot* s = &tc.slots[tc.slot_at[pc]];
+    return s->fn(f, s, acc);
+}
+
+}
+}
@@ -0,0 +1,172 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+// Shared between the interpreter, the threaded stream and the baseline
+// compiler, which both call the interpreter's handlers and so have to agree
+// with it on the frame they are handed. Nothing outside src/core/vm includes this.
+
+#pragma once
+#include <array>
+#include <cstdint>
+#include <span>
+#include "quanta/core/vm/BaselineJit.h"
+#include "quanta/core/vm/Bytecode.h"
+#include "quanta/core/vm/ThreadedCode.h"
+
+namespace Quanta {
+
+class Context;
+class Function;
+class Environment;
+
+namespace VM {
+
+// Everything the dispatch loop reads or writes, so the loop can live in a
+// function of its own with no exception-handling region in it. run() keeps
+// the try/catch, the register bank and the env side-stack; this only hands
+// the loop pointers to them.
+struct Frame {
+    const BytecodeChunk& chunk;
+    Context& ctx;
+    std::span<const Value> args;
+    Function* owner;
+    // Whether this frame's inline caches may hold cells: true when a function
+    // owns the chunk and traces it, and true for the top-level script, whose
+    // chunk run_script roots for the duration. Separate from `owner`, which
+    // also decides ROUTING -- a chunk shared across instances needs each
+    // instance's own lookup/private caches, and only a function has those.
+    bool feedback_rooted;
+    Value* regs;
+    Environment** env_saves;
+    // A reference resolved before the right side of an assignment runs, parked
+    // until the store. Only a body with a direct eval needs it: eval is the one
+    // thing that can add a nearer binding between the two.
+    Environment** resolved_envs;
+    BytecodeChunk::LookupCacheEntry* lookup_cache_data;
+    PrivateFeedback* private_feedback_data;
+    const uint8_t* code;
+    const Value* constants;
+    Environment* entry_env;
+    // Written by the loop and read by run() after an exception unwinds out of
+    // it, so these cannot be locals of the dispatch function.
+    Value this_value;
+    Value acc;
+    uint32_t pc;
+    uint32_t instr_pc;
+    uint8_t env_save_top;
+    bool this_resolved;
+    // Set once this frame has moved onto the chunk's native code; `code` then
+    // points at its exit copy. See BaselineJit.h.
+    BaselineCode* baseline = nullptr;
+    // Set while this frame runs off the chunk's pre-decoded stream; `code`
+    // then points at that stream's exit copy. See ThreadedCode.h.
+    ThreadedCode* threaded = nullptr;
+};
+
+// Arithmetic on the int32 form, for the fast paths that have two of them:
+// the int32 result while there is one, the double once it overflows. A
+// product of zero with a negative operand is -0, which only the double form
+// can hold.
+inline Value int32_add(int32_t a, int32_t b) {
+    int32_t r;
+    if (__builtin_add_overflow(a, b, &r)) return Value(static_cast<double>(a) + b);
+    return Value::from_int32(r);
+}
+
+inline Value int32_sub(int32_t a, int32_t b) {
+    int32_t r;
+    if (__builtin_sub_overflow(a, b, &r)) return Value(static_cast<double>(a) - b);
+    return Value::from_int32(r);
+}
+
+inline Value int32_mul(int32_t a, int32_t b) {
+    int32_t r;
+    if (__builtin_mul_overflow(a, b, &r) || (r == 0 && (a | b) < 0)) {
+        return Value(static_cast<double>(a) * b);
+    }
+    return Value::from_int32(r);
+}
+
+// >>>'s result, which is a uint32 and so only sometimes fits.
+inline Value uint32_value(uint32_t u) {
+    if (u <= static_cast<uint32_t>(INT32_MAX)) return Value::from_int32(static_cast<int32_t>(u));
+    return Value(static_cast<double>(u));
+}
+
+// Tail-call threaded dispatch.
+//
+// This started as a single switch over every opcode, which kept the
+// interpreter's state on the stack: run's frame had 133 distinct slots and
+// even `code`, a pointer that never changes, was reloaded per opcode -- 48
+// instructions and ~15 loads for an opcode like Ldar that needs about four. A
+// handler per opcode carries the hot state in argument registers instead, and
+// musttail makes each one reuse the same machine frame rather than growing
+// the stack.
+//
+// `pc` names the opcode byte itself, never its operands, so a handler that
+// only covers the common shape can hand that same pc to a slower one.
+using Handler = Value (*)(Frame&, uint32_t, Value);
+
+extern const std::array<Handler, 256> kHandlers;
+
+
+// Where a back-edge goes when its safepoint reports the heap over its limit
+// (see Collector::safepoint): raises the RangeError on the frame's context and
+// carries on at the handler covering f.instr_pc, or returns with the
+// exception pending when nothing in this frame catches it. A table handler,
+// so the threaded stream reaches it the way it reaches any other.
+Value heap_limit_exit(Frame& f, uint32_t pc, Value acc);
+
+// kBaselineExitByte's table slot: the first translated instruction after a
+// run of called-out ones. Hands the accumulator back to the native code,
+// which picks up at f.pc.
+Value baseline_exit(Frame& f, uint32_t pc, Value acc);
+
+// Runs the frame's native code from `pc`. Also what the interpreter
+// tail-calls into when a back-edge finishes a chunk's budget mid-loop.
+Value baseline_enter(Frame& f, uint32_t pc, Value acc);
+
+// Charges one call or back-edge to the chunk, compiling it when that spends
+// the budget. True when the chunk has native code to move onto.
+inline bool baseline_charge(const BytecodeChunk& chunk) {
+    if (chunk.baseline_budget != 0 && --chunk.baseline_budget == 0) baseline_compile(chunk);
+    return chunk.baseline != nullptr;
+}
+
+inline void baseline_attach(Frame& f) {
+    f.threaded = nullptr;
+    f.baseline = f.chunk.baseline.get();
+    f.code = f.baseline->exit_code.get();
+}
+
+// baseline_charge for a frame running off the handler table. True when the
+// frame has just moved onto native code, in which case the caller must
+// continue through baseline_enter rather than the handler table. A frame on
+// the threaded stream charges its own back-edges (see Threaded.cpp): the
+// handlers it bridges to must come back to it, not leave for native code.
+inline bool baseline_tick(Frame& f) {
+    if (f.baseline || f.threaded) return false;
+    if (!baseline_charge(f.chunk)) return false;
+    baseline_attach(f);
+    return true;
+}
+
+// kThreadedExitByte's table slot: a bridged handler chain has reached a
+// decoded instruction. Hands the accumulator back to the bridge, which picks
+// up at f.pc.
+Value threaded_exit(Frame& f, uint32_t pc, Value acc);
+
+// Moves a frame that has not started onto the chunk's threaded stream,
+// decoding the chunk first if this is its first execution. Leaves the frame
+// on the handler table when the stream is off or the chunk would not decode.
+void threaded_attach(Frame& f);
+
+// Runs the frame's threaded stream from the instruction at `pc`.
+Value threaded_enter(Frame& f, uint32_t pc, Value acc);
+
+}
+
+}
@@ -84,7 +84,7 @@ ASTNode* FunctionExecutable::ensure_body() const {
     if (!body_is_deferred() || !unit_) return nullptr;
     // Deliberately not adopt_body: that clears unit_, and the unit still backs
     // the source text this executable reports. The tree is owned outright from
-    // here on -- the token range has done its job.
+    // here on; the token index stays, as the body's code cache key.
     auto parsed = unit_->parse_body_at(body_tok_first_, deferred_strict_,
                                        deferred_generator_, deferred_async_);
     if (!parsed) {
@@ -101,7 +101,6 @@ ASTNode* FunctionExecutable::ensure_body() const {
     body_ = owned_body_.get();
     if (body_) body_start_ = body_->get_start();
     body_deferred_ = false;
-    body_tok_first_ = 0;
     return body_;
 }
 
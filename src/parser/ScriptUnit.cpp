@@ -2,6 +2,7 @@
 #include "quanta/parser/Parser.h"
 
 #include "quanta/parser/AST.h"
+#include "quanta/core/vm/CodeCache.h"
 
 namespace Quanta {
 
@@ -20,6 +21,10 @@ void ScriptUnit::set_root(std::unique_ptr<ASTNode> root) {
     root_ = std::move(root);
 }
 
+void ScriptUnit::set_code_cache(std::unique_ptr<VM::CodeCacheFile> cache) {
+    code_cache_ = std::move(cache);
+}
+
 std::unique_ptr<ASTNode> ScriptUnit::parse_body_at(uint32_t tok_first, bool strict,
                                                    bool is_generator, bool is_async) {
     // Parser takes its TokenSequence by value, so one per body would copy the
@@ -29,7 +34,11 @@ std::unique_ptr<ASTNode> ScriptUnit::parse_body_at(uint32_t tok_first, bool stri
     // than every body it would let us drop. The unit reads the stream back
     // through the parser from here on, which is why can_reparse_bodies() also
     // accepts a parser that already holds it.
-    if (!body_parser_) body_parser_ = std::make_unique<Parser>(std::move(tokens_));
+    if (!body_parser_) {
+        Parser::ParseOptions options;
+        options.source_type_module = module_goal_;
+        body_parser_ = std::make_unique<Parser>(std::move(tokens_), options);
+    }
     // Stamped with this unit, exactly as the original parse was.
     BuildScope scope(this);
     return body_parser_->parse_body_at(tok_first, strict, is_generator, is_async);
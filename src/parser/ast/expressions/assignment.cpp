@@ -1430,7 +1430,10 @@ void AssignmentExpression::destructuring_assign(Context& ctx, ASTNode* pattern,
                                     // Rest: collect all remaining into temp array
                                     if (!iter_done) {
                                         for (;;) {
-                                            Collector::safepoint();
+                                            if (Collector::safepoint()) {
+                                                Collector::raise_heap_limit_error(ctx);
+                                                return;
+                                            }
                                             // Per spec, if next() throws, do NOT close the iterator
                                             // (no IteratorClose on abrupt next).
                                             Value res = call_next();
@@ -94,7 +94,10 @@ void append_spread_values(Context& ctx, const Value& spread_value, std::vector<V
                     return;
                 }
                 for (;;) {
-                    Collector::safepoint();
+                    if (Collector::safepoint()) {
+                        Collector::raise_heap_limit_error(ctx);
+                        return;
+                    }
                     Value res = next_fn.as_function()->call(ctx, {}, iter_obj);
                     if (ctx.has_exception()) return;
                     if (!res.is_object()) {
@@ -778,6 +778,63 @@ static bool field_init_cannot_observe_cfi(const ASTNode* n) {
     }
 }
 
+// ClassDefinitionEvaluation's checks on an evaluated ClassHeritage (step 8):
+// `super_constructor` has to be null or a constructor whose .prototype is an
+// object or null. That .prototype is fetched exactly once, here, and left in
+// `super_proto`. False on a throw. They come before any element of the body
+// is evaluated, so both define_class and Op::CreateClass make them as soon as
+// the heritage has a value.
+static bool check_class_heritage(Context& ctx, const Value& super_constructor, Value& super_proto) {
+    if (super_constructor.is_null()) return true;
+    if (!super_constructor.is_object_like()) {
+        // extends non-object (number, string, boolean, etc.) -> TypeError
+        ctx.throw_type_error("Class extends value " + super_constructor.to_string() + " is not a constructor or null");
+        return false;
+    }
+    Object* super_obj = super_constructor.as_object();
+    // Must be a constructor
+    if (!super_obj || !super_obj->is_function() || !static_cast<Function*>(super_obj)->is_constructor()) {
+        ctx.throw_type_error("Class extends value is not a constructor or null");
+        return false;
+    }
+    // super.prototype must be null or an object -- spec: Get(superclass, "prototype")
+    // result must be Object or Null; undefined (e.g. a getter-less accessor) also throws.
+    super_proto = super_obj->get_property("prototype");
+    if (ctx.has_exception()) return false;
+    if (!super_proto.is_null() && !super_proto.is_object() && !super_proto.is_function()) {
+        ctx.throw_type_error("Class extends value has invalid prototype property");
+        return false;
+    }
+    return true;
+}
+
+// The rest of the heritage steps, for a heritage check_class_heritage passed:
+// the class's constructor and prototype are linked to it. Returns the
+// function super() and super.x resolve against, or nullptr for `extends
+// null`. Shared by define_class and Op::CreateClass.
+static Function* link_class_heritage(const Value& super_constructor, const Value& super_proto,
+                                     Function* constructor_fn, Object* proto_ptr) {
+    if (super_constructor.is_null()) {
+        if (proto_ptr) {
+            proto_ptr->set_prototype(nullptr);
+        }
+        // Mark constructor so super() throws TypeError (spec: superclass null -> FunctionPrototype, not a constructor)
+        constructor_fn->set_super_is_null();
+        return nullptr;
+    }
+    Function* super_fn = static_cast<Function*>(super_constructor.as_object());
+    if (!constructor_fn) return nullptr;
+    constructor_fn->set_prototype(super_fn);
+    constructor_fn->set_super_constructor(super_fn);
+    if (proto_ptr) {
+        Object* super_proto_obj = nullptr;
+        if (super_proto.is_object()) super_proto_obj = super_proto.as_object();
+        else if (super_proto.is_function()) super_proto_obj = super_proto.as_function();
+        if (super_proto_obj) proto_ptr->set_prototype(super_proto_obj);
+    }
+    return super_fn;
+}
+
 Value ClassDeclaration::evaluate(Context& ctx) { return define_class(ctx); }
 
 Value ClassDeclaration::define_class(Context& ctx) {
@@ -801,6 +858,24 @@ Value ClassDeclaration::define_class(Context& ctx) {
         }
     }
 
+    // ClassHeritage is evaluated and checked before any element of the body
+    // (spec step 8), so a computed key never runs ahead of it -- the order
+    // Op::CreateClass keeps too. Linked to the constructor once that exists,
+    // below.
+    std::vector<Value> heritage_root_vec;
+    ValueVectorRoot heritage_root(&heritage_root_vec);
+    if (has_superclass()) {
+        // ClassHeritage is class code: always strict (functions defined in it
+        // must come out strict even when the class appears in sloppy code).
+        bool saved_strict = ctx.is_strict_mode();
+        ctx.set_strict_mode(true);
+        heritage_root_vec.push_back(superclass_->evaluate(ctx));
+        ctx.set_strict_mode(saved_strict);
+        if (ctx.has_exception()) return Value();
+        heritage_root_vec.emplace_back();
+        if (!check_class_heritage(ctx, heritage_root_vec[0], heritage_root_vec[1])) return Value();
+    }
+
     CallStack& outer_cs_ = CallStack::instance();
     Object* outer_brands_ptr = nullptr;
     if (!outer_cs_.is_empty() && outer_cs_.top().function_ptr) {
@@ -826,6 +901,10 @@ Value ClassDeclaration::define_class(Context& ctx) {
     // Resolved computed keys of INSTANCE fields, in declaration order. The
     // constructor reads them back by index (EngineHelper::ClassFieldKey).
     std::vector<std::string> computed_instance_keys;
+    // Resolved computed keys of static methods, in declaration order, for the
+    // pass that builds them once the constructor exists.
+    std::vector<std::string> static_computed_keys;
+    size_t next_static_computed_key = 0;
     std::vector<std::unique_ptr<ASTNode>> field_initializers;
     std::vector<std::unique_ptr<ASTNode>> static_field_initializers;
     bool has_explicit_constructor = false;
@@ -907,14 +986,21 @@ Value ClassDeclaration::define_class(Context& ctx) {
             if (stmt->get_type() == Type::METHOD_DEFINITION) {
                 MethodDefinition* method = static_cast<MethodDefinition*>(stmt.get());
                 std::string method_name;
-                // Static methods get rebuilt (and their computed key re-evaluated) in the pass below --
-                // skip here so a `yield`/`await` key expression doesn't run twice.
-                if (method->is_computed() && method->is_static()) {
-                } else if (method->is_computed()) {
+                // Every computed key is evaluated here, in source order; static
+                // methods are built in the pass below, from the key saved for them.
+                if (method->is_computed()) {
                     Value key_val = method->get_key()->evaluate(ctx);
                     if (ctx.has_exception()) return Value();
                     method_name = computed_key_to_property_key(ctx, key_val);
                     if (ctx.has_exception()) return Value();
+                    if (method->is_static()) {
+                        // Computed static method named 'prototype' is a runtime TypeError
+                        if (method_name == "prototype") {
+                            ctx.throw_type_error("Class may not have a static property named 'prototype'");
+                            return Value();
+                        }
+                        static_computed_keys.push_back(method_name);
+                    }
                 } else if (Identifier* id = dynamic_cast<Identifier*>(method->get_key())) {
                     method_name = id->get_name();
                 } else if (StringLiteral* str = dynamic_cast<StringLiteral*>(method->get_key())) {
@@ -931,7 +1017,7 @@ Value ClassDeclaration::define_class(Context& ctx) {
                         ctor_func_expr = static_cast<FunctionExpression*>(method->get_value());
                     }
                 } else if (method->is_static()) {
-                    if (!method_name.empty() && method_name[0] == '#')
+                    if (!method->is_computed() && !method_name.empty() && method_name[0] == '#')
                         private_static_names.push_back(method_name);
                 } else {
                     if (!method_name.empty() && method_name[0] == '#') {
@@ -1361,15 +1447,7 @@ Value ClassDeclaration::define_class(Context& ctx) {
                 if (method->is_static()) {
                     std::string method_name;
                     if (method->is_computed()) {
-                        Value key_val = method->get_key()->evaluate(ctx);
-                        if (ctx.has_exception()) return Value();
-                        method_name = computed_key_to_property_key(ctx, key_val);
-                        if (ctx.has_exception()) return Value();
-                        // Computed static method named 'prototype' is a runtime TypeError
-                        if (method_name == "prototype") {
-                            ctx.throw_type_error("Class may not have a static property named 'prototype'");
-                            return Value();
-                        }
+                        method_name = static_computed_keys[next_static_computed_key++];
                     } else if (Identifier* id = dynamic_cast<Identifier*>(method->get_key())) {
                         method_name = id->get_name();
                     } else if (StringLiteral* str = dynamic_cast<StringLiteral*>(method->get_key())) {
@@ -1475,105 +1553,45 @@ Value ClassDeclaration::define_class(Context& ctx) {
     }
 
     if (has_superclass()) {
-        // ClassHeritage is class code: always strict (functions defined in it
-        // must come out strict even when the class appears in sloppy code).
-        bool saved_strict = ctx.is_strict_mode();
-        ctx.set_strict_mode(true);
-        Value super_constructor = superclass_->evaluate(ctx);
-        ctx.set_strict_mode(saved_strict);
+        Function* super_fn = link_class_heritage(heritage_root_vec[0], heritage_root_vec[1], constructor_fn.get(), proto_ptr);
         if (ctx.has_exception()) return Value();
-
-        if (super_constructor.is_null()) {
+        if (super_fn) {
             if (proto_ptr) {
-                proto_ptr->set_prototype(nullptr);
-            }
-            // Mark constructor so super() throws TypeError (spec: superclass null -> FunctionPrototype, not a constructor)
-            constructor_fn->set_super_is_null();
-        } else if (!super_constructor.is_object_like()) {
-            // extends non-object (number, string, boolean, etc.) -> TypeError
-            ctx.throw_type_error("Class extends value " + super_constructor.to_string() + " is not a constructor or null");
-            return Value();
-        } else if (super_constructor.is_object_like() && super_constructor.as_object()) {
-            Object* super_obj = super_constructor.as_object();
-            // Must be a constructor
-            if (!super_obj->is_function()) {
-                ctx.throw_type_error("Class extends value is not a constructor or null");
-                return Value();
-            }
-            Function* super_fn_check = static_cast<Function*>(super_obj);
-            if (!super_fn_check->is_constructor()) {
-                ctx.throw_type_error("Class extends value is not a constructor or null");
-                return Value();
-            }
-            // super.prototype must be null or an object -- spec: Get(superclass, "prototype")
-            // result must be Object or Null; undefined (e.g. a getter-less accessor) also throws.
-            Value super_proto_check = super_obj->get_property("prototype");
-            if (!super_proto_check.is_null() &&
-                !super_proto_check.is_object() && !super_proto_check.is_function()) {
-                ctx.throw_type_error("Class extends value has invalid prototype property");
-                return Value();
-            }
-            Function* super_fn = nullptr;
-            if (super_obj->is_function()) {
-                super_fn = static_cast<Function*>(super_obj);
-            } else if (super_obj->get_type() == Object::ObjectType::Proxy) {
-                Proxy* proxy_super = static_cast<Proxy*>(super_obj);
-                Object* target = proxy_super->get_proxy_target();
-                if (target && target->is_function()) {
-                    super_fn = static_cast<Function*>(target);
-                }
-            }
-            if (super_fn && constructor_fn.get()) {
-                constructor_fn->set_prototype(super_fn);
-                constructor_fn->set_super_constructor(super_fn);
-
-                if (proto_ptr) {
-                    auto method_keys = proto_ptr->get_own_property_keys_unfiltered();
-                    for (const auto& mkey : method_keys) {
-                        if (mkey == "constructor") continue;
-                        // get_property/get_own_property invoke the getter for accessor properties, which would spuriously execute "get m() { return super.x(); }" right now and throw.
-                        PropertyDescriptor mdesc = proto_ptr->get_property_descriptor(mkey);
-                        if (mdesc.is_accessor_descriptor()) {
-                            if (mdesc.has_getter() && mdesc.get_getter()) {
-                                static_cast<Function*>(mdesc.get_getter())->set_super_constructor(super_fn);
-                            }
-                            if (mdesc.has_setter() && mdesc.get_setter()) {
-                                static_cast<Function*>(mdesc.get_setter())->set_super_constructor(super_fn);
-                            }
-                        } else if (mdesc.has_value() && mdesc.get_value().is_function()) {
-                            mdesc.get_value().as_function()->set_super_constructor(super_fn);
+                auto method_keys = proto_ptr->get_own_property_keys_unfiltered();
+                for (const auto& mkey : method_keys) {
+                    if (mkey == "constructor") continue;
+                    // get_property/get_own_property invoke the getter for accessor properties, which would spuriously execute "get m() { return super.x(); }" right now and throw.
+                    PropertyDescriptor mdesc = proto_ptr->get_property_descriptor(mkey);
+                    if (mdesc.is_accessor_descriptor()) {
+                        if (mdesc.has_getter() && mdesc.get_getter()) {
+                            static_cast<Function*>(mdesc.get_getter())->set_super_constructor(super_fn);
+                        }
+                        if (mdesc.has_setter() && mdesc.get_setter()) {
+                            static_cast<Function*>(mdesc.get_setter())->set_super_constructor(super_fn);
                         }
+                    } else if (mdesc.has_value() && mdesc.get_value().is_function()) {
+                        mdesc.get_value().as_function()->set_super_constructor(super_fn);
                     }
                 }
+            }
 
-                // Static methods/getters/setters need the super constructor too, or "static get foo() { return super.bar(); }" falls back to this's [[Prototype]] instead of the real binding.
-                {
-                    auto static_method_keys = constructor_fn->get_own_property_keys_unfiltered();
-                    for (const auto& skey : static_method_keys) {
-                        if (skey == "prototype" || skey == "name" || skey == "length") continue;
-                        PropertyDescriptor sdesc = constructor_fn->get_property_descriptor(skey);
-                        if (sdesc.is_accessor_descriptor()) {
-                            if (sdesc.has_getter() && sdesc.get_getter()) {
-                                static_cast<Function*>(sdesc.get_getter())->set_super_constructor(super_fn);
-                            }
-                            if (sdesc.has_setter() && sdesc.get_setter()) {
-                                static_cast<Function*>(sdesc.get_setter())->set_super_constructor(super_fn);
-                            }
-                        } else if (sdesc.has_value() && sdesc.get_value().is_function()) {
-                            sdesc.get_value().as_function()->set_super_constructor(super_fn);
+            // Static methods/getters/setters need the super constructor too, or "static get foo() { return super.bar(); }" falls back to this's [[Prototype]] instead of the real binding.
+            {
+                auto static_method_keys = constructor_fn->get_own_property_keys_unfiltered();
+                for (const auto& skey : static_method_keys) {
+                    if (skey == "prototype" || skey == "name" || skey == "length") continue;
+                    PropertyDescriptor sdesc = constructor_fn->get_property_descriptor(skey);
+                    if (sdesc.is_accessor_descriptor()) {
+                        if (sdesc.has_getter() && sdesc.get_getter()) {
+                            static_cast<Function*>(sdesc.get_getter())->set_super_constructor(super_fn);
                         }
+                        if (sdesc.has_setter() && sdesc.get_setter()) {
+                            static_cast<Function*>(sdesc.get_setter())->set_super_constructor(super_fn);
+                        }
+                    } else if (sdesc.has_value() && sdesc.get_value().is_function()) {
+                        sdesc.get_value().as_function()->set_super_constructor(super_fn);
                     }
                 }
-
-                // Reuse the value already fetched above (super_proto_check) -- Get(superclass,
-                // "prototype") must run exactly once per ClassDefinitionEvaluation, not twice.
-                Value super_proto_val = super_proto_check;
-                if (proto_ptr) {
-                    Object* super_proto_obj = nullptr;
-                    if (super_proto_val.is_object()) super_proto_obj = super_proto_val.as_object();
-                    else if (super_proto_val.is_function()) super_proto_obj = super_proto_val.as_function();
-                    if (super_proto_obj) proto_ptr->set_prototype(super_proto_obj);
-                }
             }
         }
     }
@@ -1810,6 +1828,247 @@ Value ClassDeclaration::define_class(Context& ctx) {
     return Value(constructor_ptr);
 }
 
+// The executable every evaluation of one method literal shares, cached on the
+// literal as define_class caches it -- so a class site that moves between
+// define_class and Op::CreateClass still builds each method body once.
+static ExecutableRef<FunctionExecutable> class_method_executable(FunctionExpression* func_expr) {
+    ExecutableRef<FunctionExecutable> exe = func_expr->get_cached_executable();
+    if (exe) return exe;
+    exe = make_executable_ref();
+    install_literal_body(exe.get(), func_expr);
+    for (const auto& param : func_expr->get_params()) {
+        exe->parameter_objects.push_back(
+            std::unique_ptr<Parameter>(static_cast<Parameter*>(param->clone().release())));
+        exe->parameters.push_back(exe->parameter_objects.back()->get_name()->get_name());
+    }
+    func_expr->set_cached_executable(exe);
+    return exe;
+}
+
+static uint32_t class_method_length(const FunctionExecutable& exe) {
+    uint32_t length = 0;
+    for (const auto& p : exe.parameter_objects) {
+        if (p->is_rest() || p->has_default()) break;
+        length++;
+    }
+    return length;
+}
+
+// define_class's mark_class_name_closure test, asked once per class site: a
+// body it cannot see is taken to read the name.
+static bool class_method_reads_name(const FunctionExecutable& exe, const std::string& class_name) {
+    if (class_name.empty()) return false;
+    if (!exe.body()) return true;
+    if (BytecodeCompiler::references_identifier(exe.body(), class_name)) return true;
+    for (const auto& p : exe.parameter_objects) {
+        if (p->has_default() && BytecodeCompiler::references_identifier(p->get_default_value(), class_name)) return true;
+        if (p->has_destructuring() && BytecodeCompiler::references_identifier(p->get_destructuring_pattern(), class_name)) return true;
+    }
+    return false;
+}
+
+bool class_template_for(const ClassDeclaration* node, ClassTemplate& tpl) {
+    tpl.class_name = node->get_id() ? node->get_id()->get_name() : "";
+    tpl.constructor_name = (tpl.class_name.empty() && !node->get_inferred_name().empty())
+        ? node->get_inferred_name() : tpl.class_name;
+    tpl.has_heritage = node->has_superclass();
+    // Without the class scope define_class pushes, nothing outside a method
+    // body may see the inner binding: a heritage or computed key that names
+    // the class has to find it in its TDZ.
+    if (tpl.has_heritage && !tpl.class_name.empty() &&
+        BytecodeCompiler::references_identifier(node->get_superclass(), tpl.class_name)) {
+        return false;
+    }
+
+    FunctionExpression* ctor_func_expr = nullptr;
+    if (BlockStatement* body = node->get_body()) {
+        for (const auto& stmt : body->get_statements()) {
+            if (stmt->get_type() != ASTNode::Type::METHOD_DEFINITION) return false;
+            auto* method = static_cast<MethodDefinition*>(stmt.get());
+            FunctionExpression* func_expr = method->get_value();
+            if (!func_expr) return false;
+            if (method->is_constructor()) {
+                ctor_func_expr = func_expr;
+                continue;
+            }
+            ClassTemplate::Member m;
+            if (method->is_computed()) {
+                if (!tpl.class_name.empty() &&
+                    BytecodeCompiler::references_identifier(method->get_key(), tpl.class_name)) {
+                    return false;
+                }
+                m.is_computed = true;
+            } else if (auto* id = dynamic_cast<Identifier*>(method->get_key())) {
+                m.key = id->get_name();
+                if (!m.key.empty() && m.key[0] == '#') return false;
+            } else if (auto* str = dynamic_cast<StringLiteral*>(method->get_key())) {
+                m.key = str->get_value();
+            } else if (auto* num = dynamic_cast<NumberLiteral*>(method->get_key())) {
+                m.key = Value(num->get_value()).to_property_key();
+            } else {
+                return false;
+            }
+            m.kind = method->get_kind() == MethodDefinition::GETTER ? ClassTemplate::Member::Kind::Getter
+                   : method->get_kind() == MethodDefinition::SETTER ? ClassTemplate::Member::Kind::Setter
+                   : ClassTemplate::Member::Kind::Method;
+            m.is_static = method->is_static();
+            m.is_generator = func_expr->is_generator();
+            m.is_async = func_expr->is_async();
+            m.executable = class_method_executable(func_expr);
+            m.declared_length = class_method_length(*m.executable);
+            m.reads_class_name = class_method_reads_name(*m.executable, tpl.class_name);
+            m.source_text = method->get_source_text();
+            tpl.members.push_back(std::move(m));
+        }
+    }
+    if (tpl.members.size() > 0xFF + 1) return false;
+
+    tpl.explicit_constructor = ctor_func_expr != nullptr;
+    if (ctor_func_expr) {
+        tpl.constructor = class_method_executable(ctor_func_expr);
+    } else {
+        tpl.constructor = node->get_cached_ctor_exe();
+        if (!tpl.constructor) {
+            tpl.constructor = make_executable_ref();
+            std::vector<std::unique_ptr<ASTNode>> empty_statements;
+            tpl.constructor->adopt_body(std::make_unique<BlockStatement>(
+                std::move(empty_statements), Position{0, 0}, Position{0, 0}));
+            node->set_cached_ctor_exe(tpl.constructor);
+        }
+    }
+    tpl.declared_length = class_method_length(*tpl.constructor);
+    tpl.constructor_reads_class_name = class_method_reads_name(*tpl.constructor, tpl.class_name);
+    if (node->has_source_range()) tpl.source_text = node->get_source_text();
+    return true;
+}
+
+// Op::CreateClass: what define_class builds before its first method, for a
+// class whose template says it has nothing else -- the constructor, the
+// prototype, the link between them and the heritage.
+Value create_class(Context& ctx, const ClassTemplate& tpl, const Value& heritage) {
+    CallStack& outer_cs = CallStack::instance();
+    Object* outer_brands = nullptr;
+    if (!outer_cs.is_empty() && outer_cs.top().function_ptr) {
+        outer_brands = outer_cs.top().function_ptr->private_brands();
+    }
+
+    auto prototype = ObjectFactory::create_object();
+    auto constructor_fn = std::make_unique<Function>(tpl.constructor_name, tpl.constructor, &ctx,
+                                                     /*create_prototype=*/true);
+    constructor_fn->mark_closure_environment_escaped();
+    if (Object* func_proto = ObjectFactory::get_function_prototype()) {
+        constructor_fn->set_prototype(func_proto);
+    }
+    constructor_fn->set_declared_length(tpl.declared_length);
+
+    Object* proto_ptr = prototype.get();
+    PropertyDescriptor proto_desc(Value(proto_ptr), static_cast<PropertyAttributes>(0));
+    constructor_fn->set_property_descriptor("prototype", proto_desc);
+    PropertyDescriptor ctor_desc(Value(constructor_fn.get()),
+        static_cast<PropertyAttributes>(PropertyAttributes::Writable | PropertyAttributes::Configurable));
+    proto_ptr->set_property_descriptor("constructor", ctor_desc);
+    constructor_fn->set_is_class_constructor(true);
+    constructor_fn->set_is_strict(true);
+    constructor_fn->set_construct_slot_hint(0);
+    constructor_fn->set_internal_slot("__private_class_brand__", Value(proto_ptr));
+    // No private names of its own, but a class nested in one that has them
+    // still reaches the outer ones through its methods.
+    auto brands = ObjectFactory::create_object();
+    if (outer_brands) {
+        for (const auto& k : outer_brands->get_own_property_keys())
+            brands->set_property(k, outer_brands->get_property(k));
+    }
+    constructor_fn->set_private_brands(brands.release());
+    if (!tpl.explicit_constructor) constructor_fn->set_default_ctor();
+    if (!tpl.source_text.empty()) constructor_fn->set_source_text(tpl.source_text);
+    prototype.release();
+
+    if (tpl.has_heritage) {
+        Value super_proto;
+        if (!check_class_heritage(ctx, heritage, super_proto)) return Value();
+        link_class_heritage(heritage, super_proto, constructor_fn.get(), proto_ptr);
+    }
+    if (tpl.constructor_reads_class_name) {
+        constructor_fn->set_property("__closure_" + tpl.class_name, Value(constructor_fn.get()));
+        constructor_fn->set_property("__closure_const_" + tpl.class_name, Value(true));
+    }
+    constructor_fn->set_home_object(proto_ptr);
+    return Value(constructor_fn.release());
+}
+
+// Op::DefineClassMember: one method, getter or setter, built and stamped the
+// way define_class does it for the same member, and installed where it goes.
+void define_class_member(Context& ctx, Function* constructor_fn, const ClassTemplate& tpl,
+                         uint8_t index, const Value& computed_key) {
+    const ClassTemplate::Member& m = tpl.members[index];
+    std::string method_name = m.key;
+    if (m.is_computed) {
+        method_name = computed_key_to_property_key(ctx, computed_key);
+        if (ctx.has_exception()) return;
+        // Computed static method named 'prototype' is a runtime TypeError
+        if (m.is_static && method_name == "prototype") {
+            ctx.throw_type_error("Class may not have a static property named 'prototype'");
+            return;
+        }
+    }
+    Object* home = constructor_fn;
+    if (!m.is_static) {
+        Value proto_val = constructor_fn->get_property_descriptor("prototype").get_value();
+        home = proto_val.is_object() ? proto_val.as_object() : nullptr;
+        if (!home) return;
+    }
+
+    std::unique_ptr<Function> method;
+    if (m.is_generator && m.is_async) {
+        method = std::make_unique<AsyncGeneratorFunction>(method_name, m.executable, &ctx);
+    } else if (m.is_generator) {
+        method = std::make_unique<GeneratorFunction>(method_name, m.executable, &ctx);
+    } else if (m.is_async) {
+        method = std::make_unique<AsyncFunction>(method_name, m.executable, &ctx);
+    } else {
+        // Class methods are non-constructors and have no prototype.
+        method = std::make_unique<Function>(method_name, m.executable, &ctx, /*create_prototype=*/false);
+        method->mark_closure_environment_escaped();
+        if (Object* func_proto = ObjectFactory::get_function_prototype()) {
+            method->set_prototype(func_proto);
+        }
+    }
+    method->set_declared_length(m.declared_length);
+    if (!m.source_text.empty()) method->set_source_text(m.source_text);
+    method->set_is_strict(true);
+    method->set_internal_slot("__private_class_brand__", Value(home));
+    if (Object* brands = constructor_fn->private_brands()) method->set_private_brands(brands);
+    if (m.is_static) method->set_static_method();
+    if (Function* super_fn = constructor_fn->super_constructor()) method->set_super_constructor(super_fn);
+    if (m.reads_class_name) {
+        method->set_property("__closure_" + tpl.class_name, Value(constructor_fn));
+        method->set_property("__closure_const_" + tpl.class_name, Value(true));
+    }
+    method->set_home_object(home);
+
+    if (m.kind != ClassTemplate::Member::Kind::Method) {
+        const bool is_getter = m.kind == ClassTemplate::Member::Kind::Getter;
+        method->set_name(accessor_function_name(method_name, is_getter ? "get " : "set "));
+        PropertyDescriptor existing = home->get_property_descriptor(method_name);
+        PropertyDescriptor desc;
+        if (existing.is_accessor_descriptor() || existing.has_getter() || existing.has_setter()) {
+            desc = existing;
+        }
+        if (is_getter) desc.set_getter(method.release());
+        else desc.set_setter(method.release());
+        desc.set_enumerable(false);
+        desc.set_configurable(true);
+        home->set_property_descriptor(method_name, desc);
+    } else {
+        if (method_name.find("@@sym:") == 0 || method_name.find("Symbol.") == 0) {
+            method->set_name(accessor_function_name(method_name, ""));
+        }
+        PropertyDescriptor method_desc(Value(method.release()),
+            static_cast<PropertyAttributes>(PropertyAttributes::Writable | PropertyAttributes::Configurable));
+        home->set_property_descriptor(method_name, method_desc);
+    }
+}
+
 std::string ClassDeclaration::to_string() const {
     std::ostringstream oss;
     oss << "class " << id_->get_name();
@@ -192,7 +192,10 @@ Value Program::evaluate(Context& ctx) {
 
     for (const auto& statement : statements_) {
         if (statement->get_type() != ASTNode::Type::FUNCTION_DECLARATION) {
-            Collector::safepoint();
+            if (Collector::safepoint()) {
+                Collector::raise_heap_limit_error(ctx);
+                return Value();
+            }
             g_empty_completion = false;
             Value result = statement->evaluate(ctx);
             if (!g_empty_completion) last_value = result;
@@ -929,7 +932,12 @@ Value ForStatement::evaluate(Context& ctx) {
                         if (init_) init_->evaluate(ctx);
 
                         while (true) {
-                            Collector::safepoint();
+                            if (Collector::safepoint()) {
+                                Collector::raise_heap_limit_error(ctx);
+                                ctx.pop_block_scope();
+                                decrement_loop_depth();
+                                return Value();
+                            }
                             Value test_val = test_->evaluate(ctx);
                             if (!test_val.to_boolean()) break;
 
@@ -1019,7 +1027,12 @@ Value ForStatement::evaluate(Context& ctx) {
     if (has_per_iteration_scope) create_per_iter_env();
 
     while (true) {
-        Collector::safepoint();
+        if (Collector::safepoint()) {
+            Collector::raise_heap_limit_error(ctx);
+            if (has_per_iteration_scope) ctx.pop_block_scope();
+            FOR_CLEANUP();
+            return Value();
+        }
 
         if (test_) {
             Value test_value = test_->evaluate(ctx);
@@ -1292,7 +1305,11 @@ Value ForInStatement::evaluate(Context& ctx) {
         Value V; // completion value (spec ForIn/OfBodyEvaluation V)
 
         for (const auto& key : keys) {
-            Collector::safepoint();
+            if (Collector::safepoint()) {
+                Collector::raise_heap_limit_error(ctx);
+                ctx.set_current_loop_label(prev_loop_label);
+                return Value();
+            }
 
             // Skip properties deleted during enumeration (spec allows this).
             {
@@ -1889,7 +1906,11 @@ Value ForOfStatement::evaluate(Context& ctx) {
         };
 
         for (;;) {
-            Collector::safepoint();
+            if (Collector::safepoint()) {
+                Collector::raise_heap_limit_error(ctx);
+                close_on_throw();
+                return Value();
+            }
             Value value;
             if (async_iterator_step(ctx, iterator, next_fn, from_sync, value)) {
                 if (ctx.has_exception()) return Value();
@@ -2089,7 +2110,11 @@ Value ForOfStatement::evaluate(Context& ctx) {
                         Value V_iter;
 
                         while (true) {
-                            Collector::safepoint();
+                            if (Collector::safepoint()) {
+                                Collector::raise_heap_limit_error(ctx);
+                                close_iterator();
+                                return Value();
+                            }
                             Value result = next_fn->call(ctx, {}, iterator_obj);
 
                             // Per spec: if next() throws abruptly, do NOT close the iterator.
@@ -2370,7 +2395,11 @@ Value WhileStatement::evaluate(Context& ctx) {
 
     try {
         while (true) {
-            Collector::safepoint();
+            if (Collector::safepoint()) {
+                Collector::raise_heap_limit_error(ctx);
+                ctx.set_current_loop_label(prev_loop_label);
+                return Value();
+            }
 
             Value test_value;
             try {
@@ -2467,7 +2496,11 @@ Value DoWhileStatement::evaluate(Context& ctx) {
 
     try {
         do {
-            Collector::safepoint();
+            if (Collector::safepoint()) {
+                Collector::raise_heap_limit_error(ctx);
+                ctx.set_current_loop_label(prev_loop_label);
+                return Value();
+            }
 
             try {
                 Value body_result = body_->evaluate(ctx);
@@ -0,0 +1,592 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Collector tests that need a running engine (make collector-test): object
+ * graphs are built by script, so what is checked is what the collector and
+ * its tools see of real cells.
+ */
+
+#include "quanta/core/engine/Engine.h"
+#include "quanta/core/gc/Collector.h"
+#include "quanta/core/gc/HeapSnapshot.h"
+#include "quanta/core/gc/ParallelMarker.h"
+#include "quanta/core/runtime/MapSet.h"
+#include "quanta/core/runtime/String.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+using namespace Quanta;
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        std::printf("FAIL %s:%d  %s\n", __FILE__, __LINE__, #cond); \
+        failures++; \
+    } \
+} while (0)
+
+static Engine* engine = nullptr;
+
+static bool run(const char* source) {
+    Engine::Result r = engine->execute(source, "<collector-test>");
+    if (!r.success) std::printf("script failed: %s\n", r.error_message.c_str());
+    return r.success;
+}
+
+// Overwrites the stack below the caller with zeros. The cells a script just
+// let go of can still be named by words its frames left behind, and the
+// conservative scan would keep them; a test that needs them gone (or needs
+// them held only by the graph it built) clears those words first.
+__attribute__((noinline)) static void clear_stale_stack() {
+    volatile char pad[256 * 1024];
+    std::memset(const_cast<char*>(pad), 0, sizeof(pad));
+}
+
+// Just enough of a reader for the snapshot's own JSON: the number arrays and
+// the string table, located by key.
+static std::vector<uint64_t> json_numbers(const std::string& json, const char* key) {
+    std::vector<uint64_t> out;
+    size_t at = json.find(std::string("\"") + key + "\":[");
+    if (at == std::string::npos) return out;
+    const char* p = json.c_str() + json.find('[', at) + 1;
+    while (*p && *p != ']') {
+        if (*p >= '0' && *p <= '9') out.push_back(std::strtoull(p, const_cast<char**>(&p), 10));
+        else p++;
+    }
+    return out;
+}
+
+static uint64_t json_count(const std::string& json, const char* key) {
+    size_t at = json.find(std::string("\"") + key + "\":");
+    if (at == std::string::npos) return UINT64_MAX;
+    return std::strtoull(json.c_str() + at + std::strlen(key) + 3, nullptr, 10);
+}
+
+static std::vector<std::string> json_strings(const std::string& json) {
+    std::vector<std::string> out;
+    size_t i = json.find("\"strings\":[");
+    if (i == std::string::npos) return out;
+    i += 11;
+    while (i < json.size() && json[i] != ']') {
+        if (json[i] != '"') { i++; continue; }
+        std::string s;
+        for (i++; i < json.size() && json[i] != '"'; i++) {
+            if (json[i] != '\\') { s.push_back(json[i]); continue; }
+            const char e = json[++i];
+            if (e == 'u') {
+                s.push_back(static_cast<char>(std::strtoul(json.substr(i + 1, 4).c_str(), nullptr, 16)));
+                i += 4;
+            } else {
+                s.push_back(e);
+            }
+        }
+        i++;
+        out.push_back(std::move(s));
+    }
+    return out;
+}
+
+// The snapshot's graph, from its JSON, with the node type and edge type
+// numbering HeapSnapshot declares in its header.
+struct SnapshotGraph {
+    static constexpr size_t kNodeFields = 7;
+    static constexpr uint64_t kObjectType = 3;
+    static constexpr uint64_t kWeakEdge = 6;
+
+    std::vector<uint64_t> nodes;
+    std::vector<uint64_t> edges;
+    std::vector<std::string> strings;
+
+    size_t node_count() const { return nodes.size() / kNodeFields; }
+    uint64_t type(size_t n) const { return nodes[n * kNodeFields]; }
+    const std::string& name(size_t n) const { return strings[nodes[n * kNodeFields + 1]]; }
+    uint64_t self_size(size_t n) const { return nodes[n * kNodeFields + 3]; }
+
+    // The object node named `name`; node_count() when there is not exactly
+    // one.
+    size_t object(const std::string& want) const {
+        size_t found = node_count();
+        for (size_t n = 0; n < node_count(); n++) {
+            if (type(n) != kObjectType || name(n) != want) continue;
+            if (found != node_count()) return node_count();
+            found = n;
+        }
+        return found;
+    }
+
+    // Calls f(type, to) for each edge of node n.
+    template <typename F> void for_each_edge(size_t n, F f) const {
+        size_t e = 0;
+        for (size_t i = 0; i < n; i++) e += nodes[i * kNodeFields + 4];
+        for (uint64_t k = 0; k < nodes[n * kNodeFields + 4]; k++, e++)
+            f(edges[e * 3], edges[e * 3 + 2] / kNodeFields);
+    }
+};
+
+// A node's retained size out of the Summary, found by name and self size;
+// SIZE_MAX when no entry matches.
+static size_t retained(const HeapSnapshot::Summary& s, const std::string& name, size_t self) {
+    size_t best = SIZE_MAX;
+    for (const HeapSnapshot::Node& n : s.top_retainers) {
+        if (n.name != name || n.self_size != self) continue;
+        if (best == SIZE_MAX || n.retained_size > best) best = n.retained_size;
+    }
+    return best;
+}
+
+static void test_heap_snapshot() {
+    // Built inside a function, so no binding but the global ones below holds
+    // any node: each graph hangs from the global object by one property.
+    CHECK(run(R"JS(
+        class Chain1 {} class Chain2 {} class Chain3 {}
+        class Top {} class Left {} class Right {} class Bottom {}
+        class WeakOwner {} class WeakTarget {}
+        (function () {
+            const c3 = new Chain3(), c2 = new Chain2(), c1 = new Chain1();
+            c2.next = c3;
+            c1.next = c2;
+            globalThis.chain = c1;
+
+            const top = new Top(), left = new Left(), right = new Right(), bottom = new Bottom();
+            left.down = bottom;
+            right.down = bottom;
+            top.left = left;
+            top.right = right;
+            globalThis.diamond = top;
+
+            const owner = new WeakOwner(), target = new WeakTarget();
+            owner.target = target;
+            globalThis.owner = owner;
+            globalThis.weak = new WeakRef(target);
+
+            globalThis.escaped = 'q"uo\\te\n\x01';
+        })();
+        0;
+    )JS"));
+    clear_stale_stack();
+
+    std::ostringstream out;
+    HeapSnapshot::Summary summary;
+    CHECK(HeapSnapshot::write(out, &summary, SIZE_MAX));
+    const std::string json = out.str();
+
+    SnapshotGraph g;
+    g.nodes = json_numbers(json, "nodes");
+    g.edges = json_numbers(json, "edges");
+    g.strings = json_strings(json);
+
+    // The counts agree: the header's, the Summary's, and the arrays'.
+    CHECK(json_count(json, "node_count") == summary.node_count);
+    CHECK(json_count(json, "edge_count") == summary.edge_count);
+    CHECK(g.nodes.size() == summary.node_count * SnapshotGraph::kNodeFields);
+    CHECK(g.edges.size() == summary.edge_count * 3);
+    uint64_t listed = 0;
+    for (size_t n = 0; n < g.node_count(); n++) {
+        listed += g.nodes[n * SnapshotGraph::kNodeFields + 4];
+        CHECK(g.nodes[n * SnapshotGraph::kNodeFields + 1] < g.strings.size());
+    }
+    CHECK(listed == summary.edge_count);
+    // to_node is a node's offset into the nodes array, not its index.
+    bool to_nodes_ok = true;
+    for (size_t e = 0; e < g.edges.size() / 3; e++) {
+        const uint64_t to = g.edges[e * 3 + 2];
+        if (to % SnapshotGraph::kNodeFields != 0 || to >= g.nodes.size()) to_nodes_ok = false;
+    }
+    CHECK(to_nodes_ok);
+
+    // A quote, a backslash and two control characters, escaped as JSON has
+    // them and read back whole.
+    CHECK(json.find(R"("q\"uo\\te\u000a\u0001")") != std::string::npos);
+    bool found_escaped = false;
+    for (const std::string& s : g.strings) found_escaped |= s == "q\"uo\\te\n\x01";
+    CHECK(found_escaped);
+
+    const size_t c1 = g.object("Chain1"), c2 = g.object("Chain2"), c3 = g.object("Chain3");
+    const size_t top = g.object("Top"), left = g.object("Left"), right = g.object("Right");
+    const size_t bottom = g.object("Bottom");
+    const size_t owner = g.object("WeakOwner"), target = g.object("WeakTarget");
+    const size_t none = g.node_count();
+    CHECK(c1 != none && c2 != none && c3 != none);
+    CHECK(top != none && left != none && right != none && bottom != none);
+    CHECK(owner != none && target != none);
+    if (failures) return;
+
+    auto self = [&](size_t n) { return static_cast<size_t>(g.self_size(n)); };
+    auto kept = [&](size_t n) { return retained(summary, g.name(n), self(n)); };
+
+    // A chain: each link retains itself and everything after it.
+    CHECK(kept(c3) == self(c3));
+    CHECK(kept(c2) == self(c2) + self(c3));
+    CHECK(kept(c1) == self(c1) + self(c2) + self(c3));
+
+    // A diamond: the shared bottom is retained by the top alone, not by
+    // either side.
+    CHECK(kept(left) == self(left));
+    CHECK(kept(right) == self(right));
+    CHECK(kept(bottom) == self(bottom));
+    CHECK(kept(top) == self(top) + self(left) + self(right) + self(bottom));
+
+    // A weak edge: the WeakRef names its target, but only as a weak edge, so
+    // the target is still the owner's alone.
+    bool weak_edge = false;
+    for (size_t n = 0; n < g.node_count(); n++) {
+        if (g.type(n) != SnapshotGraph::kObjectType || g.name(n) != "WeakRef") continue;
+        g.for_each_edge(n, [&](uint64_t type, uint64_t to) {
+            if (to == target) weak_edge |= type == SnapshotGraph::kWeakEdge;
+        });
+        CHECK(retained(summary, "WeakRef", self(n)) == self(n));
+    }
+    CHECK(weak_edge);
+    CHECK(kept(owner) == self(owner) + self(target));
+    CHECK(kept(target) == self(target));
+}
+
+// Whether `expression` evaluates to true, read back through a global.
+static bool holds(const char* expression) {
+    if (!run(("globalThis.holds = (" + std::string(expression) + ") === true; 0;").c_str())) return false;
+    const Value v = engine->get_global_property("holds");
+    return v.is_boolean() && v.as_boolean();
+}
+
+static void test_ephemeron_chain() {
+    // maps[i] maps keys[i] to a value holding an inner WeakMap, which nothing
+    // else holds, and the probe key it is keyed by; the inner map's value is
+    // what reaches keys[i + 1]. So each link of the chain is only known live
+    // once the one before it is, through two maps, one of them itself found
+    // only inside an ephemeron value. The maps are built last link first, the
+    // order that makes a pass-until-nothing-changes loop take a pass a link.
+    CHECK(run(R"JS(
+        (function () {
+            const N = 16;
+            const keys = [];
+            for (let i = 0; i <= N; i++) keys.push({ key: i });
+            globalThis.head = keys[0];
+            globalThis.maps = [];
+            globalThis.refs = [];
+            for (let i = N - 1; i >= 0; i--) {
+                const inner = new WeakMap();
+                const probe = { probe: i };
+                inner.set(probe, { next: keys[i + 1] });
+                const outer = new WeakMap();
+                outer.set(keys[i], { inner: inner, probe: probe });
+                maps[i] = outer;
+                refs.push(new WeakRef(keys[i + 1]), new WeakRef(inner), new WeakRef(probe));
+            }
+        })();
+        globalThis.walk = function () {
+            let key = head, links = 0;
+            for (let i = 0; i < maps.length; i++) {
+                const value = maps[i].get(key);
+                if (value === undefined) break;
+                const next = value.inner.get(value.probe);
+                if (next === undefined) break;
+                key = next.next;
+                links++;
+            }
+            return links;
+        };
+        0;
+    )JS"));
+
+    // Rooted at its head, every link survives a minor -- the chain is all
+    // young -- and then a major.
+    clear_stale_stack();
+    Collector::collect_minor();
+    CHECK(holds("walk() === 16"));
+    clear_stale_stack();
+    Collector::collect();
+    CHECK(holds("walk() === 16"));
+    CHECK(holds("refs.every(r => r.deref() !== undefined)"));
+
+    // Dropped at its head, none of it does, though every outer map is still
+    // rooted.
+    CHECK(run("head = null; 0;"));
+    clear_stale_stack();
+    Collector::collect();
+    CHECK(holds("refs.length === 48 && refs.every(r => r.deref() === undefined)"));
+}
+
+static void test_idle_near_heap_limit() {
+    Heap* heap = engine->get_heap();
+    clear_stale_stack();
+    Collector::collect();
+
+    // Within a quarter of the limit and nothing grown since the last major:
+    // a safepoint would take this request as a major, so idle time must too.
+    const size_t footprint = heap->footprint();
+    heap->set_heap_limit(footprint + footprint / 8);
+    CHECK(Heap::near_heap_limit());
+    Heap::request_gc();
+    engine->idle_notification(std::chrono::steady_clock::now() + std::chrono::seconds(5));
+    CHECK(!Collector::last_cycle().minor);
+    CHECK(!Collector::major_in_progress());
+    heap->set_heap_limit(SIZE_MAX);
+}
+
+static void test_deque() {
+    // Alone, the owner's end is a stack and the thieves' a queue, and both
+    // see every entry through a growth past the first array.
+    WorkStealingDeque dq;
+    uintptr_t w = 0;
+    CHECK(dq.looks_empty());
+    CHECK(!dq.pop(w));
+    CHECK(!dq.steal(w));
+    const uintptr_t n = 3000;
+    for (uintptr_t i = 1; i <= n; i++) dq.push(i << 4);
+    CHECK(!dq.looks_empty());
+    CHECK(dq.steal(w) && w == (1u << 4));
+    CHECK(dq.steal(w) && w == (2u << 4));
+    CHECK(dq.pop(w) && w == (n << 4));
+    CHECK(dq.pop(w) && w == ((n - 1) << 4));
+    size_t left = 0;
+    uintptr_t expect = n - 2;
+    bool ordered = true;
+    while (dq.pop(w)) {
+        ordered &= w == (expect-- << 4);
+        left++;
+    }
+    CHECK(ordered);
+    CHECK(left == n - 4);
+    CHECK(dq.looks_empty());
+    dq.release_outgrown();
+    dq.push(7u << 4);
+    CHECK(dq.pop(w) && w == (7u << 4));
+
+    // With thieves racing the owner, every entry is taken exactly once --
+    // including the last ones, where pop and steal meet on the same slot.
+    WorkStealingDeque shared;
+    const size_t items = 200000;
+    std::vector<std::atomic<uint32_t>> taken(items + 1);
+    std::atomic<bool> done{false};
+    std::vector<std::thread> thieves;
+    for (int t = 0; t < 3; t++) {
+        thieves.emplace_back([&] {
+            uintptr_t x;
+            for (;;) {
+                if (shared.steal(x)) taken[x >> 4].fetch_add(1, std::memory_order_relaxed);
+                else if (done.load(std::memory_order_acquire) && shared.looks_empty()) return;
+            }
+        });
+    }
+    for (size_t i = 1; i <= items; i++) {
+        shared.push(i << 4);
+        if (i % 3 == 0 && shared.pop(w)) taken[w >> 4].fetch_add(1, std::memory_order_relaxed);
+    }
+    while (shared.pop(w)) taken[w >> 4].fetch_add(1, std::memory_order_relaxed);
+    done.store(true, std::memory_order_release);
+    for (auto& t : thieves) t.join();
+    size_t once = 0;
+    for (size_t i = 1; i <= items; i++) once += taken[i].load() == 1;
+    CHECK(once == items);
+}
+
+// Edges of one cell as a trace reports them, for walking a graph the way a
+// marker would without marking anything.
+class EdgeCollector final : public Visitor {
+public:
+    std::vector<Heap::ProbeResult> cells;
+
+    void visit_object(Object* o) override { add(o); }
+    void visit_string(String* s) override { add(s); }
+    void visit_symbol(Symbol* s) override { add(s); }
+    void visit_bigint(BigInt* b) override { add(b); }
+    void visit_context(Context*) override {}
+    void visit_environment(Environment*) override {}
+
+private:
+    void add(const void* p) {
+        if (!p) return;
+        Heap::ProbeResult r = Heap::exact_cell(p);
+        if (r.cell) cells.push_back(r);
+    }
+};
+
+static void test_parallel_marking() {
+    CHECK(run(R"JS(
+        globalThis.pm = (function () {
+            const captured = { captured: true };
+            const key = { key: 1 };
+            const wm = new WeakMap();
+            wm.set(key, { value: "held through the map" });
+            const root = {
+                list: [],
+                fn: function () { return captured; },
+                wm: wm,
+                key: key,
+                ref: new WeakRef(captured),
+                ws: new WeakSet([key]),
+                text: "left" + String(Math.random()).slice(0, 1) + "right",
+            };
+            for (let i = 0; i < 500; i++) {
+                root.list.push({ i: i, s: "cell " + i, next: i ? root.list[i - 1] : null });
+            }
+            return root;
+        })();
+        0;
+    )JS"));
+    Object* root = engine->get_global_property("pm").as_object();
+    Object* wm = root->get_property("wm").as_object();
+    Object* ref = root->get_property("ref").as_object();
+    Object* ws = root->get_property("ws").as_object();
+
+    // A pool of two run straight over unmarked cells: whatever a trace edge
+    // reaches from the root is marked, and what a marker may not mark itself
+    // is left for the collecting thread to take back.
+    clear_stale_stack();
+    Collector::collect();
+    Heap::finish_background_sweep();
+    Heap::finish_lazy_sweep();
+    Heap::clear_all_marks();
+    {
+        MarkerPool pool(2);
+        std::vector<Heap::ProbeResult> seed{Heap::mark_exact_atomic(root, CellKind::Object)};
+        CHECK(seed[0].cell == root);
+        pool.run(seed);
+        CHECK(seed.empty());
+        CHECK(pool.phases() == 1);
+
+        std::unordered_set<void*> seen{root};
+        std::vector<Heap::ProbeResult> stack{Heap::exact_cell(root)};
+        size_t reached = 0, unmarked = 0;
+        while (!stack.empty()) {
+            Heap::ProbeResult p = stack.back();
+            stack.pop_back();
+            reached++;
+            if (!Heap::test_mark(p)) unmarked++;
+            EdgeCollector edges;
+            if (p.kind == CellKind::Object) static_cast<Object*>(p.cell)->trace(edges);
+            else if (p.kind == CellKind::String) static_cast<String*>(p.cell)->gc_trace(edges);
+            for (const Heap::ProbeResult& e : edges.cells) {
+                if (seen.insert(e.cell).second) stack.push_back(e);
+            }
+        }
+        CHECK(reached > 1000);
+        CHECK(unmarked == 0);
+
+        size_t marked = 0, envs = 0;
+        bool has_wm = false, has_ref = false, has_ws = false;
+        for (unsigned i = 0; i < pool.size(); i++) {
+            ParallelMarker& m = pool.marker(i);
+            CHECK(m.deque.looks_empty());
+            marked += m.stats.marked;
+            envs += m.contexts.size() + m.environments.size();
+            for (WeakMap* w : m.weak_maps) has_wm |= static_cast<Object*>(w) == wm;
+            for (WeakRef* r : m.weak_refs) has_ref |= static_cast<Object*>(r) == ref;
+            for (WeakSet* w : m.weak_sets) has_ws |= static_cast<Object*>(w) == ws;
+        }
+        CHECK(marked + 1 >= reached);
+        CHECK(envs > 0);
+        CHECK(has_wm && has_ref && has_ws);
+    }
+    // The marks above are not a collection's; the next major starts over.
+    Collector::collect();
+
+    // The same through the collector: a full collection whose drains run on
+    // two markers keeps what only the merged-back work reaches -- the
+    // closure's captured object, the map's value -- and still clears a
+    // WeakRef whose target is gone.
+    Collector::set_mark_threads(2);
+    CHECK(run(R"JS(
+        globalThis.dead = new WeakRef((function () { return { dead: true }; })());
+        0;
+    )JS"));
+    clear_stale_stack();
+    Collector::collect();
+    CHECK(marker_pool() && marker_pool()->phases() > 0);
+    CHECK(holds("pm.fn().captured === true && pm.ref.deref() === pm.fn()"));
+    CHECK(holds("pm.wm.get(pm.key).value === 'held through the map'"));
+    CHECK(holds("pm.ws.has(pm.key)"));
+    CHECK(holds("pm.list[499].next.next.s === 'cell 497'"));
+    CHECK(holds("dead.deref() === undefined"));
+    Collector::set_mark_threads(1);
+    CHECK(marker_pool() == nullptr);
+    CHECK(run("pm = null; dead = null; 0;"));
+}
+
+static void test_telemetry() {
+    clear_stale_stack();
+    const Collector::Telemetry before = Collector::telemetry();
+
+    // More collections than the ring holds, in a pattern a misplaced oldest
+    // record would show: a major every seventh, minors between.
+    const size_t total = Collector::kTelemetryCycles + 44;
+    std::vector<bool> minor(total);
+    for (size_t i = 0; i < total; i++) {
+        minor[i] = i % 7 != 3;
+        if (minor[i]) Collector::collect_minor();
+        else Collector::collect();
+    }
+    const Collector::Telemetry t = Collector::telemetry();
+    const size_t minors = static_cast<size_t>(std::count(minor.begin(), minor.end(), true));
+    CHECK(t.minor_count == before.minor_count + minors);
+    CHECK(t.major_count == before.major_count + (total - minors));
+
+    // Oldest first, and the oldest is the one after the last overwritten.
+    CHECK(t.cycles.size() == Collector::kTelemetryCycles);
+    bool pattern = true, ordered = true, slices = true;
+    for (size_t i = 0; i < t.cycles.size(); i++) {
+        const Collector::CycleRecord& r = t.cycles[i];
+        pattern &= r.minor == minor[total - t.cycles.size() + i];
+        if (i) ordered &= r.start_us >= t.cycles[i - 1].start_us;
+        slices &= r.minor ? r.slices <= 1 : r.slices >= 1 && r.longest_slice_us <= r.pause_us;
+    }
+    CHECK(pattern);
+    CHECK(ordered);
+    CHECK(slices);
+
+    // Each distribution covers the last kTelemetryPauses pauses of its kind:
+    // a minor is one pause, a major at least one slice. The ring's records
+    // are among those pauses, so none of them is past the maximum.
+    const Collector::PauseDistribution& mp = t.minor_pauses;
+    const Collector::PauseDistribution& sp = t.major_slice_pauses;
+    CHECK(mp.count == std::min(t.minor_count, Collector::kTelemetryPauses));
+    CHECK(sp.count >= std::min(t.major_count, Collector::kTelemetryPauses));
+    CHECK(sp.count <= Collector::kTelemetryPauses);
+    CHECK(mp.p50_us <= mp.p99_us && mp.p99_us <= mp.max_us);
+    CHECK(sp.p50_us <= sp.p99_us && sp.p99_us <= sp.max_us);
+    CHECK(std::max(mp.max_us, sp.max_us) <= t.max_pause_us);
+    bool bounded = true;
+    uint64_t paused = 0;
+    for (const Collector::CycleRecord& r : t.cycles) {
+        bounded &= r.minor ? r.pause_us <= mp.max_us : r.longest_slice_us <= sp.max_us;
+        paused += r.pause_us;
+    }
+    CHECK(bounded);
+    CHECK(t.total_pause_us >= before.total_pause_us + paused);
+}
+
+int main() {
+    // Immortal, as every engine is.
+    engine = new Engine();
+    if (!engine->initialize()) {
+        std::printf("collector-test: engine failed to initialize\n");
+        return 1;
+    }
+
+    test_heap_snapshot();
+    test_ephemeron_chain();
+    test_idle_near_heap_limit();
+    test_deque();
+    test_parallel_marking();
+    test_telemetry();
+
+    if (failures == 0) {
+        std::printf("collector-test: ALL PASS\n");
+        return 0;
+    }
+    std::printf("collector-test: %d FAILURE(S)\n", failures);
+    return 1;
+}
@@ -6,11 +6,16 @@
  * Standalone unit tests for the GC heap (make heap-test).
  */
 
+#include "quanta/core/gc/BlockAllocator.h"
+#include "quanta/core/gc/CardTable.h"
 #include "quanta/core/gc/Heap.h"
+#include <atomic>
+#include <chrono>
 #include <cstdint>
 #include <cstdio>
 #include <cstring>
 #include <set>
+#include <thread>
 #include <vector>
 
 using namespace Quanta;
@@ -55,17 +60,36 @@ static void test_size_class_boundaries() {
     CHECK(!heap.contains(d));
 }
 
-static void test_bump_freelist_and_reuse() {
+static void test_bump_runs_and_reuse() {
     Heap heap;
     void* p1 = heap.allocate(64, CellKind::Object);
     void* p2 = heap.allocate(64, CellKind::Object);
     CHECK(p1 != p2);
+    CHECK(static_cast<char*>(p2) == static_cast<char*>(p1) + 64);  // bumped
     Heap::cell_free(p1);
     CHECK(!heap.contains(p1));
     void* p3 = heap.allocate(64, CellKind::Object);
-    CHECK(p3 == p1);  // LIFO free-list reuse
+    CHECK(p3 == p1);
     CHECK(heap.contains(p3));
     CHECK(heap.contains(p2));
+
+    // Holes are handed out lowest address first, whatever order they were
+    // freed in, and a run of them back to back.
+    std::vector<void*> cells;
+    for (int i = 0; i < 8; i++) cells.push_back(heap.allocate(64, CellKind::Object));
+    Heap::cell_free(cells[6]);
+    Heap::cell_free(cells[2]);
+    Heap::cell_free(cells[3]);
+    CHECK(heap.allocate(64, CellKind::Object) == cells[2]);
+    CHECK(heap.allocate(64, CellKind::Object) == cells[3]);
+    CHECK(heap.allocate(64, CellKind::Object) == cells[6]);
+
+    // A retired slot is never handed out again.
+    HeapBlock* b = HeapBlock::from_cell(cells[0]);
+    b->retire_cell(cells[1]);
+    Heap::cell_free(cells[4]);
+    CHECK(heap.allocate(64, CellKind::Object) == cells[4]);
+    CHECK(heap.allocate(64, CellKind::Object) != cells[1]);
 }
 
 static void test_block_overflow_multi_block() {
@@ -188,10 +212,434 @@ static void test_churn() {
     CHECK(s.live_cells == live.size());
 }
 
+static size_t g_samples = 0;
+static size_t g_large_samples = 0;
+static void* g_last_sample = nullptr;
+static void* g_last_freed = nullptr;
+
+static void test_allocation_sampling() {
+    Heap heap;
+    // Off: nothing is ever handed over.
+    Heap::set_allocation_sampling(0, [](void*, size_t, CellKind) { g_samples++; }, nullptr);
+    for (int i = 0; i < 10000; i++) heap.allocate(64, CellKind::Object);
+    CHECK(g_samples == 0);
+
+    // Mean 4KB over 64MB of 64B cells: ~16384 samples, and a Poisson
+    // process's count is within a few percent of that.
+    Heap::set_allocation_sampling(4096,
+        [](void* cell, size_t size, CellKind) {
+            g_samples++;
+            if (size > 4096) g_large_samples++;
+            g_last_sample = cell;
+        },
+        [](void* cell) { g_last_freed = cell; });
+    const size_t total = 64 * 1024 * 1024;
+    std::vector<void*> cells;
+    bool sampled_the_cell_returned = true;
+    for (size_t n = 0; n < total; n += 64) {
+        const size_t before = g_samples;
+        void* p = heap.allocate(64, CellKind::Object);
+        if (g_samples != before && g_last_sample != p) sampled_the_cell_returned = false;
+        cells.push_back(p);
+        if (cells.size() == 4096) {
+            for (void* c : cells) Heap::cell_free(c);
+            cells.clear();
+        }
+    }
+    CHECK(g_samples > 15500 && g_samples < 17300);
+    CHECK(sampled_the_cell_returned);
+
+    // A cell sixteen times the interval is sampled nearly every time, and
+    // once, however many sampling points it spans.
+    for (int i = 0; i < 100; i++) Heap::cell_free(heap.allocate(64 * 1024, CellKind::String));
+    CHECK(g_large_samples >= 95 && g_large_samples <= 100);
+
+    // Deletes are reported while sampling is on, and not once it is off.
+    void* p = heap.allocate(64, CellKind::Object);
+    Heap::cell_free(p);
+    CHECK(g_last_freed == p);
+    Heap::set_allocation_sampling(0, nullptr, nullptr);
+    g_last_freed = nullptr;
+    for (void* c : cells) Heap::cell_free(c);
+    CHECK(g_last_freed == nullptr);
+}
+
+static void test_decommit_idle_regions() {
+    // Free regions go back to the OS one by one, not only as whole chunks,
+    // and come back ahead of a fresh chunk.
+    BlockAllocator alloc;
+    std::vector<void*> regions;
+    for (size_t i = 0; i < BlockAllocator::kCommittedReserve + 8; i++) {
+        void* r = alloc.allocate_block_region();
+        std::memset(r, 0xAB, HeapBlock::kBlockSize);
+        regions.push_back(r);
+    }
+    const size_t chunks = alloc.chunk_count();
+    const size_t free_regions = alloc.block_capacity();
+    for (void* r : regions) alloc.release_block_region(r);
+    alloc.decommit_idle_regions();
+    CHECK(alloc.decommitted_count() == free_regions - BlockAllocator::kCommittedReserve);
+    alloc.decommit_idle_regions();  // nothing left above the reserve
+    CHECK(alloc.decommitted_count() == free_regions - BlockAllocator::kCommittedReserve);
+    for (size_t i = 0; i < free_regions; i++) {
+        void* r = alloc.allocate_block_region();
+        std::memset(r, 0xCD, HeapBlock::kBlockSize);
+    }
+    CHECK(alloc.chunk_count() == chunks);
+    CHECK(alloc.decommitted_count() == 0);
+}
+
+static void test_heap_limit() {
+    // Crossing the limit is noticed where the heap grows, never refused: the
+    // flag and the collection request are for the next safepoint.
+    Heap heap;
+    heap.set_heap_limit(4 * HeapBlock::kBlockSize);
+    Heap::clear_heap_limit_reached();
+    Heap::clear_gc_request();
+    std::vector<void*> cells;
+    while (heap.footprint() <= heap.heap_limit()) {
+        CHECK(!Heap::heap_limit_reached());
+        cells.push_back(heap.allocate(4096, CellKind::Object));
+    }
+    CHECK(Heap::heap_limit_reached());
+    CHECK(Heap::gc_requested());
+    Heap::clear_heap_limit_reached();
+    Heap::clear_gc_request();
+
+    // Large cells count at their size, and stop counting once freed.
+    const size_t before = heap.footprint();
+    void* big = heap.allocate(100000, CellKind::Object);
+    CHECK(heap.footprint() == before + 100000);
+    CHECK(Heap::heap_limit_reached());
+    Heap::cell_free(big);
+    CHECK(heap.footprint() == before);
+    Heap::clear_heap_limit_reached();
+    Heap::clear_gc_request();
+
+    // No callback, or one that does not raise the limit, declines.
+    CHECK(!heap.raise_limit_for_footprint());
+    size_t seen_initial = 0;
+    heap.set_near_heap_limit_callback([&](size_t current, size_t initial) {
+        seen_initial = initial;
+        return current * 2;
+    });
+    CHECK(heap.raise_limit_for_footprint());
+    CHECK(heap.heap_limit() == 8 * HeapBlock::kBlockSize);
+    CHECK(seen_initial == 4 * HeapBlock::kBlockSize);
+    heap.set_near_heap_limit_callback([](size_t current, size_t) { return current; });
+    CHECK(!heap.raise_limit_for_footprint());
+    CHECK(heap.heap_limit() == 8 * HeapBlock::kBlockSize);
+    for (void* c : cells) Heap::cell_free(c);
+}
+
+static void test_heap_limit_refusal() {
+    // A declined limit is reported until someone raises it, not once: the
+    // refusal and the collection request both outlive a safepoint that drops
+    // the answer, and the heap still over its limit notices again as it grows.
+    Heap heap;
+    heap.set_heap_limit(2 * HeapBlock::kBlockSize);
+    heap.set_near_heap_limit_callback([](size_t current, size_t) { return current; });
+    Heap::clear_heap_limit_reached();
+    Heap::clear_gc_request();
+    std::vector<void*> cells;
+    while (!Heap::heap_limit_reached()) cells.push_back(heap.allocate(4096, CellKind::Object));
+    CHECK(Heap::over_limit_heap() == &heap);
+    CHECK(!heap.raise_limit_for_footprint());
+
+    // What the safepoint does with the refusal.
+    Heap::clear_heap_limit_reached();
+    Heap::refuse_heap_limit();
+    CHECK(Heap::heap_limit_refused());
+    CHECK(Heap::gc_requested());
+    // A collection in between clears its request; the refusal keeps it armed.
+    Heap::clear_gc_request();
+    CHECK(Heap::gc_requested());
+    CHECK(Heap::heap_limit_refused());
+
+    // Raised: the script has been told, and the request can go.
+    Heap::clear_heap_limit_refused();
+    Heap::clear_gc_request();
+    CHECK(!Heap::gc_requested());
+    // Still over the limit, so the next block asks again.
+    const size_t blocks = heap.footprint();
+    while (heap.footprint() == blocks) cells.push_back(heap.allocate(4096, CellKind::Object));
+    CHECK(Heap::heap_limit_reached());
+    CHECK(Heap::gc_requested());
+    Heap::clear_heap_limit_reached();
+    Heap::clear_gc_request();
+    for (void* c : cells) Heap::cell_free(c);
+}
+
+static void test_reserve() {
+    // Reserved chunks are mapped but hold no blocks: the footprint is what
+    // the heap uses, not what it has room for.
+    Heap heap;
+    heap.reserve(3 * BlockAllocator::kChunkSize);
+    CHECK(heap.stats().chunk_count == 3);
+    CHECK(heap.footprint() == 0);
+    heap.reserve(BlockAllocator::kChunkSize);
+    CHECK(heap.stats().chunk_count == 3);
+    for (size_t i = 0; i < 3 * BlockAllocator::kBlocksPerChunk; i++) heap.allocate(4096, CellKind::Object);
+    CHECK(heap.stats().chunk_count == 3);
+}
+
+static void test_card_table() {
+    CardTable t;
+    t.mark(5);
+    t.mark_range(CardTable::kCardSize * 3 - 1, 2);  // straddles cards 2 and 3
+    t.mark(CardTable::kCardSize * 9);                 // past the length below
+    std::vector<std::pair<uint32_t, uint32_t>> runs;
+    size_t dirty = t.take_dirty(CardTable::kCardSize * 3 + 10, [&](uint32_t b, uint32_t e) { runs.push_back({b, e}); });
+    CHECK(dirty == 4);
+    CHECK(runs.size() == 3);
+    CHECK(runs[0] == std::make_pair(0u, CardTable::kCardSize));
+    CHECK(runs[1] == std::make_pair(CardTable::kCardSize * 2, CardTable::kCardSize * 3));
+    CHECK(runs[2] == std::make_pair(CardTable::kCardSize * 3, CardTable::kCardSize * 3 + 10));
+    // Taken means clean.
+    CHECK(t.take_dirty(~0u, [](uint32_t, uint32_t) {}) == 0);
+    t.mark_range(0, 1);
+    t.listed = true;
+    t.clear();
+    CHECK(!t.listed);
+    CHECK(t.take_dirty(~0u, [](uint32_t, uint32_t) {}) == 0);
+}
+
+static size_t lazy_finalized = 0;
+static bool lazy_finalizes_anywhere(void* cell, CellKind) { return *static_cast<uint32_t*>(cell) != 0xDEAD; }
+static void lazy_finalize(void*, CellKind) { lazy_finalized++; }
+
+static void test_lazy_sweep() {
+    // On a thread of its own: collect_dead_cells walks every heap the calling
+    // thread owns, and the other tests' heaps are gone by now.
+    std::thread([] {
+        Heap* heap = new Heap;  // immortal, like an engine's
+        HeapScope scope(heap);
+        std::vector<void*> cells;
+        for (int i = 0; i < 3000; i++) {
+            void* p = heap->allocate(64, CellKind::Object);
+            std::memset(p, 0, 64);
+            cells.push_back(p);
+        }
+        for (size_t i = 0; i < cells.size(); i += 2) HeapBlock::from_cell(cells[i])->set_mark(cells[i]);
+        // A dead cell only a safepoint may finalize: allocation must turn its
+        // block down.
+        *static_cast<uint32_t*>(cells[1]) = 0xDEAD;
+        HeapBlock* refused = HeapBlock::from_cell(cells[1]);
+        const size_t refused_dead = refused->dead_count();
+
+        std::vector<Heap::DeadCell> dead;
+        const Heap::LazySweep lazy{lazy_finalizes_anywhere, lazy_finalize};
+        const size_t deferred = Heap::collect_dead_cells(dead, false, nullptr, &lazy);
+        CHECK(deferred + dead.size() == 1500);  // the active block is swept now
+        for (const Heap::DeadCell& d : dead) Heap::cell_free(d.cell);
+        Heap::reset_dirty_blocks();
+        Heap::rebuild_allocation_candidates();
+
+        Heap::Stats s = heap->stats();
+        CHECK(s.live_cells == 1500);
+        CHECK(s.unswept_bytes == deferred * 64);
+        CHECK(s.unswept_blocks > 0);
+        CHECK(heap->find_cell(cells[1]) == nullptr);  // dead, though not yet swept
+        CHECK(heap->find_cell(cells[2]) == cells[2]);
+        CHECK(lazy_finalized == 0);
+
+        // Allocation sweeps a lazy block before it takes a fresh one.
+        for (int i = 0; i < 1500; i++) heap->allocate(64, CellKind::Object);
+        CHECK(lazy_finalized == deferred - refused_dead);
+        CHECK(refused->awaiting_lazy_sweep());
+        Heap::sweep_refused_blocks();
+        CHECK(lazy_finalized == deferred);
+        s = heap->stats();
+        CHECK(s.unswept_blocks == 0);
+        CHECK(s.unswept_bytes == 0);
+        CHECK(s.live_cells == 3000);
+    }).join();
+}
+
+static void test_sweep_lazy_until() {
+    std::thread([] {
+        Heap* heap = new Heap;
+        HeapScope scope(heap);
+        std::vector<void*> cells;
+        for (int i = 0; i < 3000; i++) {
+            void* p = heap->allocate(64, CellKind::Object);
+            std::memset(p, 0, 64);
+            cells.push_back(p);
+        }
+        for (size_t i = 0; i < cells.size(); i += 2) HeapBlock::from_cell(cells[i])->set_mark(cells[i]);
+        *static_cast<uint32_t*>(cells[1]) = 0xDEAD;
+        HeapBlock* refused = HeapBlock::from_cell(cells[1]);
+        const size_t refused_dead = refused->dead_count();
+        std::vector<Heap::DeadCell> dead;
+        const Heap::LazySweep lazy{lazy_finalizes_anywhere, lazy_finalize};
+        const size_t deferred = Heap::collect_dead_cells(dead, false, nullptr, &lazy);
+        for (const Heap::DeadCell& d : dead) Heap::cell_free(d.cell);
+        Heap::reset_dirty_blocks();
+        Heap::rebuild_allocation_candidates();
+        CHECK(deferred > 0);
+        CHECK(Heap::lazy_sweep_pending());
+
+        // A deadline already past sweeps nothing.
+        const size_t finalized_before = lazy_finalized;
+        CHECK(Heap::sweep_lazy_until(std::chrono::steady_clock::now()) == 0);
+        CHECK(Heap::lazy_sweep_pending());
+        CHECK(lazy_finalized == finalized_before);
+
+        // Nor does it sweep a block allocation turned down: the refused list
+        // waits on the deadline like the lazy one.
+        size_t allocated = 0;
+        while (lazy_finalized < finalized_before + deferred - refused_dead && allocated < 3000) {
+            heap->allocate(64, CellKind::Object);
+            allocated++;
+        }
+        CHECK(refused->awaiting_lazy_sweep());
+        CHECK(Heap::sweep_lazy_until(std::chrono::steady_clock::now()) == 0);
+        CHECK(refused->awaiting_lazy_sweep());
+        CHECK(Heap::lazy_sweep_pending());
+
+        CHECK(Heap::sweep_lazy_until(std::chrono::steady_clock::now() + std::chrono::hours(1)) > 0);
+        CHECK(!Heap::lazy_sweep_pending());
+        CHECK(!refused->awaiting_lazy_sweep());
+        CHECK(lazy_finalized == finalized_before + deferred);
+        Heap::Stats s = heap->stats();
+        CHECK(s.unswept_blocks == 0);
+        CHECK(s.live_cells == 1500 + allocated);
+    }).join();
+}
+
+// Garbage the sweeper gets: String, Symbol and BigInt blocks, every third
+// cell marked live, with an Object block beside them that stays in the pause.
+static std::vector<void*> build_sweep_garbage(Heap* heap) {
+    std::vector<void*> cells;
+    const size_t per_block = HeapBlock::kPayloadSize / 64;
+    for (CellKind kind : {CellKind::String, CellKind::Symbol, CellKind::BigInt, CellKind::Object}) {
+        for (size_t i = 0; i < per_block * 3; i++) {
+            void* p = heap->allocate(64, kind);
+            std::memset(p, 0, 64);
+            if (i % 3 == 0) HeapBlock::from_cell(p)->set_mark(p);
+            cells.push_back(p);
+        }
+    }
+    return cells;
+}
+
+static std::atomic<size_t> sweep_finalized{0};
+static std::atomic<bool> sweep_gate_open{true};
+static void count_finalize(void*, CellKind) { sweep_finalized++; }
+static void gated_finalize(void*, CellKind) {
+    while (!sweep_gate_open.load()) std::this_thread::yield();
+    sweep_finalized++;
+}
+
+struct SweepOutcome {
+    Heap::Stats stats;
+    size_t finalized = 0;
+};
+
+// The serial sweep: every dead cell listed and freed in the pause.
+static SweepOutcome sweep_serially() {
+    SweepOutcome out;
+    std::thread([&] {
+        Heap* heap = new Heap;  // immortal, like an engine's
+        HeapScope scope(heap);
+        build_sweep_garbage(heap);
+        sweep_finalized = 0;
+        std::vector<Heap::DeadCell> dead;
+        CHECK(Heap::collect_dead_cells(dead, false) == 0);
+        for (const Heap::DeadCell& d : dead) {
+            count_finalize(d.cell, d.kind);
+            Heap::cell_free(d.cell);
+        }
+        Heap::reset_dirty_blocks();
+        Heap::rebuild_allocation_candidates();
+        out.stats = heap->stats();
+        out.finalized = sweep_finalized;
+    }).join();
+    return out;
+}
+
+// The same garbage with the non-Object blocks handed to the sweeper, which is
+// held at its first dead cell while the mutator asks for `free_first` (an
+// explicit free into a block it still has) or stats(); either has to wait it
+// out and take the blocks back.
+static SweepOutcome sweep_in_background(bool free_first) {
+    SweepOutcome out;
+    std::thread([&] {
+        Heap* heap = new Heap;
+        HeapScope scope(heap);
+        std::vector<void*> cells = build_sweep_garbage(heap);
+        sweep_finalized = 0;
+        std::vector<Heap::DeadCell> dead;
+        std::vector<HeapBlock*> background;
+        const size_t deferred = Heap::collect_dead_cells(dead, false, &background);
+        CHECK(deferred > 0);
+        CHECK(!background.empty());
+        for (HeapBlock* b : background) CHECK(b->in_background_sweep() && b->cell_kind() != CellKind::Object);
+        for (const Heap::DeadCell& d : dead) {
+            count_finalize(d.cell, d.kind);
+            Heap::cell_free(d.cell);
+        }
+        // A live cell in a block the sweeper is about to own.
+        HeapBlock* flagged = background.front();
+        void* victim = nullptr;
+        for (void* p : cells) {
+            if (HeapBlock::from_cell(p) == flagged && flagged->test_mark(p)) { victim = p; break; }
+        }
+        CHECK(victim != nullptr);
+
+        sweep_gate_open = false;
+        Heap::sweep_in_background(background, gated_finalize);
+        Heap::reset_dirty_blocks();
+        Heap::rebuild_allocation_candidates();
+        CHECK(flagged->in_background_sweep());
+        CHECK(sweep_finalized < dead.size() + deferred);
+        std::thread opener([] {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            sweep_gate_open = true;
+        });
+        if (free_first) {
+            Heap::cell_free(victim);
+            CHECK(!flagged->in_background_sweep());
+            CHECK(sweep_finalized == dead.size() + deferred);
+            CHECK(!heap->contains(victim));
+        }
+        out.stats = heap->stats();
+        out.finalized = sweep_finalized;
+        CHECK(!flagged->in_background_sweep());
+        opener.join();
+    }).join();
+    return out;
+}
+
+static void test_background_sweep() {
+    const SweepOutcome serial = sweep_serially();
+    CHECK(serial.finalized > 0);
+
+    const SweepOutcome by_stats = sweep_in_background(false);
+    CHECK(by_stats.finalized == serial.finalized);
+    CHECK(by_stats.stats.live_cells == serial.stats.live_cells);
+    CHECK(by_stats.stats.live_bytes == serial.stats.live_bytes);
+    for (size_t k = 0; k < kNumCellKinds; k++) {
+        CHECK(by_stats.stats.live_cells_by_kind[k] == serial.stats.live_cells_by_kind[k]);
+    }
+    CHECK(by_stats.stats.unswept_blocks == 0);
+
+    // One cell fewer, freed by hand, and nothing else different.
+    const SweepOutcome by_free = sweep_in_background(true);
+    CHECK(by_free.finalized == serial.finalized);
+    CHECK(by_free.stats.live_cells == serial.stats.live_cells - 1);
+    CHECK(by_free.stats.live_bytes == serial.stats.live_bytes - 64);
+    size_t differing = 0;
+    for (size_t k = 0; k < kNumCellKinds; k++) {
+        if (by_free.stats.live_cells_by_kind[k] != serial.stats.live_cells_by_kind[k]) differing++;
+    }
+    CHECK(differing == 1);
+}
+
 int main() {
     test_alignment_and_block_mapping();
     test_size_class_boundaries();
-    test_bump_freelist_and_reuse();
+    test_bump_runs_and_reuse();
     test_block_overflow_multi_block();
     test_interior_pointers();
     test_kind_segregation();
@@ -200,6 +648,15 @@ int main() {
     test_stats();
     test_mark_bitmap_reserved();
     test_churn();
+    test_lazy_sweep();
+    test_decommit_idle_regions();
+    test_allocation_sampling();
+    test_heap_limit();
+    test_heap_limit_refusal();
+    test_reserve();
+    test_card_table();
+    test_sweep_lazy_until();
+    test_background_sweep();
 
     if (failures == 0) {
         std::printf("heap-test: ALL PASS\n");
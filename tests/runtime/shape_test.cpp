@@ -97,6 +97,71 @@ static void test_independent_branches_do_not_interfere() {
     CHECK(right->slot_count() == 2);
 }
 
+static void test_prune_keeps_reached_and_ancestors() {
+    Shape* root = Shape::root();
+    Shape* kept_parent = root->transition("__prune_keep__");
+    Shape* kept = kept_parent->transition("a");
+    Shape* sibling = root->transition("__prune_keep__")->transition("b");
+    Shape* pinned = root->transition("__prune_pin__");
+    root->transition("__prune_drop__")->transition("x")->transition("y");
+    Shape::pin(pinned);
+    (void)sibling;
+
+    // Nothing an object uses but `kept`: its parent stays with it, the
+    // pinned shape stays on its own, and everything else goes -- the
+    // earlier tests' shapes included.
+    const size_t before = Shape::count();
+    Shape::begin_reachability();
+    kept->note_reached();
+    Shape::settle_reachability();
+    CHECK(kept->reached() && kept_parent->reached());
+    CHECK(!sibling->reached());
+    const size_t freed = Shape::prune_unreached();
+    CHECK(freed > 0);
+    CHECK(Shape::count() == before - freed);
+    CHECK(Shape::count() == 4); // root, kept and its parent, pinned
+
+    // What stayed is found again rather than rebuilt.
+    CHECK(root->transition("__prune_keep__")->transition("a") == kept);
+    CHECK(root->transition("__prune_pin__") == pinned);
+    CHECK(kept->find_slot("__prune_keep__") == 0 && kept->find_slot("a") == 1);
+    // A pruned branch grows back as a fresh shape.
+    Shape* regrown = root->transition("__prune_drop__")->transition("x");
+    CHECK(regrown->slot_count() == 2);
+    CHECK(Shape::count() == 6);
+}
+
+static void test_sweep_drops_unheld_keys() {
+    Shape* held_by_shape = Shape::root()->transition("__key_in_shape__");
+    const std::string* held = Shape::intern("__key_held__");
+    const std::string* pinned = Shape::intern_pinned("__key_pinned__");
+    Shape::intern("__key_dropped__");
+
+    // A shape's key is held by the shape; the rest only by whoever marks
+    // them, and the pinned one by nobody at all.
+    Shape::begin_reachability();
+    Shape::begin_key_reachability();
+    held_by_shape->note_reached();
+    Shape::settle_reachability();
+    Shape::prune_unreached();
+    Shape::note_key_reached(held);
+    const size_t before = Shape::key_count();
+    const size_t freed = Shape::sweep_unreached_keys();
+    CHECK(freed > 0);
+    CHECK(Shape::key_count() == before - freed);
+    CHECK(Shape::intern_existing("__key_dropped__") == nullptr);
+    CHECK(Shape::intern_existing("__key_held__") == held);
+    CHECK(Shape::intern_existing("__key_pinned__") == pinned);
+    CHECK(held_by_shape->find_slot("__key_in_shape__") == 0);
+    CHECK(Shape::root()->transition("__key_in_shape__") == held_by_shape);
+
+    // A key handed out again while a cycle is open counts as held.
+    Shape::begin_key_reachability();
+    CHECK(Shape::intern("__key_held__") == held);
+    Shape::sweep_unreached_keys();
+    CHECK(Shape::intern_existing("__key_held__") == held);
+}
+
 int main() {
     test_root_is_empty();
     test_linear_transition_assigns_slots_in_order();
@@ -105,6 +170,8 @@ int main() {
     test_transition_cap_forces_dictionary_fallback();
     test_slot_depth_cap_forces_dictionary_fallback();
     test_independent_branches_do_not_interfere();
+    test_prune_keeps_reached_and_ancestors();
+    test_sweep_drops_unheld_keys();
 
     if (failures == 0) {
         std::printf("shape-test: ALL PASS\n");
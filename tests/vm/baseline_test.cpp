@@ -0,0 +1,209 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Baseline tier differential tests (make baseline-test). Each case is a
+ * script whose functions run hot enough to be compiled; the test runs them
+ * here, with the tier on, then runs itself again with QUANTA_JIT=0 and
+ * requires the interpreter to print the same result for every case. The
+ * cases lean on what the native code does for itself -- int32 and double
+ * arithmetic, overflow out of int32, guards that fail after compilation,
+ * exceptions thrown under a call-out -- since that is where the two tiers
+ * could disagree.
+ */
+
+#include "quanta/core/engine/Engine.h"
+#include "quanta/core/runtime/Object.h"
+#include "quanta/core/vm/BaselineJit.h"
+#include "quanta/core/vm/Bytecode.h"
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace Quanta;
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        std::printf("FAIL %s:%d  %s\n", __FILE__, __LINE__, #cond); \
+        failures++; \
+    } \
+} while (0)
+
+struct Case {
+    const char* name;
+    // Global functions that run past kBaselineBudget.
+    std::vector<const char*> hot;
+    // Leaves the case's result, as a string, in globalThis.out.
+    const char* source;
+};
+
+static const Case kCases[] = {
+    {"int32 loop", {"mix"}, R"JS(
+        function mix(n) {
+            let s = 0;
+            for (let i = 0; i < n; i++) {
+                s = (s + i * 3) | 0;
+                s ^= i << 2;
+                if (s < 0) s = -s;
+            }
+            return s;
+        }
+        globalThis.out = String(mix(200000));
+    )JS"},
+    {"int32 overflow", {"add_up", "mul_up"}, R"JS(
+        function add_up(n) {
+            let x = 2147483000;
+            for (let i = 0; i < n; i++) x = x + 1;
+            return x;
+        }
+        function mul_up(n) {
+            let p = 1, wraps = 0;
+            for (let i = 0; i < n; i++) {
+                p = p * 7;
+                if (p > 1e300) { p = 1; wraps++; }
+            }
+            return p + "/" + wraps;
+        }
+        globalThis.out = add_up(5000) + " " + mul_up(5000) + " " + (add_up(647) === 2147483647);
+    )JS"},
+    {"deopt", {"plus", "getx", "run"}, R"JS(
+        function plus(a, b) { return a + b; }
+        function getx(o) { return o.x; }
+        function run(n) {
+            const parts = [];
+            let s = 0;
+            for (let i = 0; i < n; i++) s = plus(s, i);
+            parts.push(s);
+            // Past compilation, the operands stop being numbers...
+            parts.push(plus("a", 1), plus(1.5, 2.25), plus(2147483647, 1), plus({}, []));
+            // ...and the monomorphic GetNamed sees other shapes.
+            let t = 0;
+            for (let i = 0; i < n; i++) t += getx({ x: i });
+            parts.push(t, getx({ y: 1, x: "late" }), getx({}), getx([1]));
+            return parts.join(",");
+        }
+        globalThis.out = run(5000);
+    )JS"},
+    {"exception unwind", {"thrower", "unwind", "escape"}, R"JS(
+        function thrower(i) {
+            if (i % 997 === 996) throw new Error("e" + i);
+            if (i % 1999 === 1998) null.x;
+            return i;
+        }
+        function unwind(n) {
+            let s = 0, caught = 0, kinds = "";
+            for (let i = 0; i < n; i++) {
+                try {
+                    s = (s + thrower(i)) | 0;
+                } catch (e) {
+                    caught++;
+                    kinds += e instanceof TypeError ? "T" : "E";
+                } finally {
+                    s ^= 1;
+                }
+            }
+            return s + ":" + caught + ":" + kinds;
+        }
+        // Thrown from a compiled frame with nothing in it to catch.
+        function escape(n) {
+            let i = 0;
+            for (; i < n; i++) if (i === n - 1) throw new RangeError("at " + i);
+            return i;
+        }
+        let escaped;
+        try { escape(5000); } catch (e) { escaped = e.name + " " + e.message; }
+        globalThis.out = unwind(20000) + " " + escaped;
+    )JS"},
+};
+
+struct Outcome {
+    std::string result;
+    bool compiled = true;   // every hot function
+    bool any_compiled = false;
+};
+
+static Engine* engine = nullptr;
+
+static Outcome run_case(const Case& c) {
+    Outcome o;
+    Engine::Result r = engine->execute(c.source, "<baseline-test>");
+    if (!r.success) {
+        o.result = "script failed: " + r.error_message;
+        return o;
+    }
+    o.result = engine->get_global_property("out").to_string();
+    for (const char* name : c.hot) {
+        const Value v = engine->get_global_property(name);
+        const BytecodeChunk* chunk = nullptr;
+        if (v.is_function()) {
+            const auto& exec = v.as_function()->get_executable();
+            if (exec) chunk = exec->bytecode_chunk.get();
+        }
+        const bool native = chunk && chunk->baseline;
+        o.compiled &= native;
+        o.any_compiled |= native;
+    }
+    return o;
+}
+
+int main(int argc, char** argv) {
+    // Immortal, as every engine is.
+    engine = new Engine();
+    if (!engine->initialize()) {
+        std::printf("baseline-test: engine failed to initialize\n");
+        return 1;
+    }
+
+    // The second run: one line per case, nothing compiled.
+    if (argc > 1 && std::strcmp(argv[1], "--interpreted") == 0) {
+        for (const Case& c : kCases) {
+            Outcome o = run_case(c);
+            std::printf("%s%s\n", o.any_compiled ? "COMPILED " : "", o.result.c_str());
+        }
+        return 0;
+    }
+
+    if (!VM::baseline_enabled()) {
+        std::printf("baseline-test: no baseline tier here (QUANTA_JIT=0 or no backend), nothing to test\n");
+        return 0;
+    }
+
+    std::vector<Outcome> native;
+    for (const Case& c : kCases) {
+        native.push_back(run_case(c));
+        if (!native.back().compiled) std::printf("  %s: not every hot function was compiled\n", c.name);
+        CHECK(native.back().compiled);
+    }
+
+    const std::string command = "QUANTA_JIT=0 '" + std::string(argv[0]) + "' --interpreted";
+    FILE* child = popen(command.c_str(), "r");
+    CHECK(child != nullptr);
+    if (!child) return 1;
+    std::vector<std::string> interpreted;
+    std::string line;
+    for (int ch; (ch = std::fgetc(child)) != EOF;) {
+        if (ch != '\n') { line += static_cast<char>(ch); continue; }
+        interpreted.push_back(line);
+        line.clear();
+    }
+    CHECK(pclose(child) == 0);
+
+    CHECK(interpreted.size() == native.size());
+    for (size_t i = 0; i < native.size() && i < interpreted.size(); i++) {
+        if (native[i].result == interpreted[i]) continue;
+        std::printf("  %s:\n    baseline:    %s\n    interpreter: %s\n", kCases[i].name,
+                    native[i].result.c_str(), interpreted[i].c_str());
+        failures++;
+    }
+
+    if (failures == 0) {
+        std::printf("baseline-test: ALL PASS\n");
+        return 0;
+    }
+    std::printf("baseline-test: %d FAILURE(S)\n", failures);
+    return 1;
+}
@@ -0,0 +1,229 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Code cache tests (make code-cache-test). QUANTA_CODE_CACHE is read once,
+ * at startup, so every run of the script is a run of this binary with it
+ * set: the parent writes the script into a scratch directory, runs it cold,
+ * warm, and against a cache file it has tampered with, and reads back from
+ * each run which functions took their chunk from the file.
+ */
+
+#include "quanta/core/engine/Engine.h"
+#include "quanta/core/runtime/Object.h"
+#include "quanta/core/vm/Bytecode.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+using namespace Quanta;
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        std::printf("FAIL %s:%d  %s\n", __FILE__, __LINE__, #cond); \
+        failures++; \
+    } \
+} while (0)
+
+// Leaf functions, so each body is deferred and cached on its own.
+static const char* kScript = R"JS(
+function add(a, b) { return a + b; }
+function pick(o) { return o.x * 2 + o.y; }
+function sum(n) { let s = 0; for (let i = 0; i < n; i++) s += i; return s; }
+function label(x) { return x > 1 ? "many" : "one"; }
+globalThis.out = [add(2, 3), pick({ x: 4, y: 1 }), sum(10), label(1), label(5)].join(",");
+)JS";
+
+static const char* const kFunctions[] = {"add", "pick", "sum", "label"};
+constexpr size_t kFunctionCount = sizeof(kFunctions) / sizeof(kFunctions[0]);
+
+// The child: runs the script and prints its result, then one letter per
+// function -- C when its chunk came from the cache and no tree was ever
+// built for it, T when the body was parsed and compiled.
+static int run_script(const char* path) {
+    // Immortal, as every engine is.
+    Engine* engine = new Engine();
+    if (!engine->initialize()) return 1;
+    Engine::Result r = engine->execute_file(path);
+    if (!r.success) {
+        std::printf("script failed: %s\n", r.error_message.c_str());
+        return 1;
+    }
+    std::string taken;
+    for (const char* name : kFunctions) {
+        const Value v = engine->get_global_property(name);
+        const FunctionExecutable* exe = v.is_function() ? v.as_function()->get_executable().get() : nullptr;
+        taken += exe && exe->bytecode_chunk && exe->body_is_deferred() ? 'C' : 'T';
+    }
+    std::printf("%s\n%s\n", engine->get_global_property("out").to_string().c_str(), taken.c_str());
+    return 0;
+}
+
+struct Run {
+    std::string out;
+    std::string taken;
+};
+
+static Run run_child(const std::string& self, const std::filesystem::path& dir) {
+    const std::string command = "QUANTA_CODE_CACHE='" + (dir / "cache").string() + "' '" + self +
+                                "' --run '" + (dir / "script.js").string() + "'";
+    Run run;
+    FILE* child = popen(command.c_str(), "r");
+    if (!child) return run;
+    std::vector<std::string> lines(1);
+    for (int ch; (ch = std::fgetc(child)) != EOF;) {
+        if (ch == '\n') lines.emplace_back();
+        else lines.back() += static_cast<char>(ch);
+    }
+    CHECK(pclose(child) == 0);
+    if (lines.size() >= 2) {
+        run.out = lines[0];
+        run.taken = lines[1];
+    }
+    return run;
+}
+
+static std::filesystem::path cache_file(const std::filesystem::path& dir) {
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(dir / "cache", ec)) {
+        if (entry.path().extension() == ".qcc") return entry.path();
+    }
+    return {};
+}
+
+static std::string read_file(const std::filesystem::path& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+}
+
+static void write_file(const std::filesystem::path& path, const std::string& bytes) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+}
+
+// The file's layout, as CodeCache.cpp writes it: a 36-byte header whose last
+// field is the entry count; entries of body token, size and body; an FNV-1a
+// checksum of everything before it. An entry's body opens with the body's
+// offset, line and column, then register count (u16), parameter count and
+// flags (u8 each), and the code, counted (u32).
+constexpr size_t kHeaderSize = 36;
+
+static uint64_t fnv1a(const std::string& bytes, size_t size) {
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < size; i++) {
+        h ^= static_cast<uint8_t>(bytes[i]);
+        h *= 0x100000001b3ull;
+    }
+    return h;
+}
+
+template <typename T> static T read_at(const std::string& bytes, size_t at) {
+    T v{};
+    std::memcpy(&v, bytes.data() + at, sizeof v);
+    return v;
+}
+
+// Points the first register operand of the first entry past the entry's
+// register bank and re-signs the file, so the file and the entry both pass
+// every check but the operand ones. Returns false if there was nothing to
+// change.
+static bool corrupt_first_entry(std::string& bytes) {
+    const size_t entry = kHeaderSize + 8;
+    if (bytes.size() < entry + 20) return false;
+    const size_t registers_at = entry + 12;
+    const uint16_t registers = read_at<uint16_t>(bytes, registers_at);
+    const uint32_t code_size = read_at<uint32_t>(bytes, registers_at + 4);
+    const size_t code_at = registers_at + 8;
+    if (registers >= 0xFF || code_at + code_size > bytes.size()) return false;
+    for (uint32_t pc = 0; pc < code_size;) {
+        const Op op = static_cast<Op>(static_cast<uint8_t>(bytes[code_at + pc]));
+        const RegisterOperands regs = register_operands(op);
+        if (regs.count > 0) {
+            bytes[code_at + pc + 1 + regs.at[0]] = static_cast<char>(0xFF);
+            const size_t body = bytes.size() - 8;
+            const uint64_t sum = fnv1a(bytes, body);
+            std::memcpy(bytes.data() + body, &sum, sizeof sum);
+            return true;
+        }
+        pc += 1 + static_cast<uint32_t>(op_operand_bytes(op));
+    }
+    return false;
+}
+
+static void test_code_cache(const std::string& self) {
+    char scratch[] = "/tmp/quanta-code-cache-XXXXXX";
+    CHECK(mkdtemp(scratch) != nullptr);
+    const std::filesystem::path dir(scratch);
+    write_file(dir / "script.js", kScript);
+    const std::string expected = "5,9,45,one,many";
+    const std::string all_cached(kFunctionCount, 'C');
+    const std::string all_compiled(kFunctionCount, 'T');
+
+    // Cold: nothing to take, everything written.
+    Run cold = run_child(self, dir);
+    CHECK(cold.out == expected);
+    CHECK(cold.taken == all_compiled);
+    const std::filesystem::path file = cache_file(dir);
+    CHECK(!file.empty());
+    if (file.empty()) {
+        std::filesystem::remove_all(dir);
+        return;
+    }
+    const std::string written = read_file(file);
+
+    // Warm: every body from the file, none rebuilt, the file left as it was.
+    Run warm = run_child(self, dir);
+    CHECK(warm.out == expected);
+    CHECK(warm.taken == all_cached);
+    CHECK(read_file(file) == written);
+
+    // One entry naming a register its chunk does not have, in a file whose
+    // checksum still holds: that entry is refused and its function compiled
+    // from source, with the right answer; the others still hit.
+    std::string tampered = written;
+    CHECK(corrupt_first_entry(tampered));
+    write_file(file, tampered);
+    Run stale = run_child(self, dir);
+    CHECK(stale.out == expected);
+    CHECK(std::count(stale.taken.begin(), stale.taken.end(), 'T') == 1);
+    CHECK(std::count(stale.taken.begin(), stale.taken.end(), 'C') == kFunctionCount - 1);
+
+    // The refused entry was replaced by the chunk compiled in its place, so
+    // the next run hits throughout again.
+    Run healed = run_child(self, dir);
+    CHECK(healed.out == expected);
+    CHECK(healed.taken == all_cached);
+
+    // A file that fails its checksum is no file at all.
+    std::string damaged = read_file(file);
+    damaged[kHeaderSize + 8 + 20] ^= 0x40;
+    write_file(file, damaged);
+    Run unsigned_run = run_child(self, dir);
+    CHECK(unsigned_run.out == expected);
+    CHECK(unsigned_run.taken == all_compiled);
+
+    std::filesystem::remove_all(dir);
+}
+
+int main(int argc, char** argv) {
+    if (argc > 2 && std::strcmp(argv[1], "--run") == 0) return run_script(argv[2]);
+
+    test_code_cache(std::filesystem::absolute(argv[0]).string());
+
+    if (failures == 0) {
+        std::printf("code-cache-test: ALL PASS\n");
+        return 0;
+    }
+    std::printf("code-cache-test: %d FAILURE(S)\n", failures);
+    return 1;
+}
@@ -0,0 +1,372 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Unit tests for the bytecode pass pipeline (make passes-test). Every body
+ * here is built by hand and run through VM::optimize_bytecode the way
+ * BytecodeCompiler runs it, so each case pins down one rewrite -- and the
+ * offsets and handler ranges it had to move -- byte for byte.
+ */
+
+#include "quanta/core/vm/Bytecode.h"
+#include "quanta/core/vm/BytecodePasses.h"
+#include <cstdint>
+#include <cstdio>
+#include <initializer_list>
+#include <vector>
+
+using namespace Quanta;
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        std::printf("FAIL %s:%d  %s\n", __FILE__, __LINE__, #cond); \
+        failures++; \
+    } \
+} while (0)
+
+static uint8_t b(Op op) { return static_cast<uint8_t>(op); }
+
+// Appends one instruction; returns the pc it starts at.
+static uint32_t emit(std::vector<uint8_t>& code, Op op, std::initializer_list<uint8_t> operands = {}) {
+    const uint32_t pc = static_cast<uint32_t>(code.size());
+    code.push_back(static_cast<uint8_t>(op));
+    code.insert(code.end(), operands);
+    CHECK(operands.size() == static_cast<size_t>(op_operand_bytes(op)));
+    return pc;
+}
+
+// Points the plain jump at `pc` to `target`.
+static void aim(std::vector<uint8_t>& code, uint32_t pc, uint32_t target) {
+    const auto off = static_cast<uint16_t>(static_cast<int16_t>(target - (pc + 3)));
+    code[pc + 1] = static_cast<uint8_t>(off & 0xFF);
+    code[pc + 2] = static_cast<uint8_t>(off >> 8);
+}
+
+struct Run {
+    std::vector<uint8_t> code;
+    std::vector<Value> constants;
+    BytecodeChunk chunk;
+    VM::PassStats stats;
+};
+
+static void optimize(Run& r, uint16_t registers, uint8_t params) {
+    r.chunk.register_count = registers;
+    r.chunk.parameter_count = params;
+    r.stats = VM::optimize_bytecode(r.code, r.constants, r.chunk);
+}
+
+static void test_fold_arithmetic() {
+    Run r;
+    emit(r.code, Op::LdaSmi, {2});
+    emit(r.code, Op::Star, {1});
+    emit(r.code, Op::LdaSmi, {3});
+    emit(r.code, Op::Add, {1});
+    emit(r.code, Op::Return);
+    optimize(r, 2, 0);
+
+    // 2 + 3 is loaded as 5, and the operands go with the store that held one.
+    CHECK(r.stats.folded >= 1);
+    CHECK(r.stats.dead_stores >= 3);
+    CHECK((r.code == std::vector<uint8_t>{b(Op::LdaSmi), 5, b(Op::Return)}));
+    CHECK(r.chunk.register_count == 0);
+    CHECK(r.stats.bytes_before == 9 && r.stats.bytes_after == 3);
+}
+
+static void test_fold_wide_result() {
+    Run r;
+    r.constants.push_back(Value(1.5));
+    emit(r.code, Op::LdaSmi, {100});
+    emit(r.code, Op::Star, {0});
+    emit(r.code, Op::LdaSmi, {100});
+    emit(r.code, Op::Mul, {0});
+    emit(r.code, Op::Return);
+    optimize(r, 1, 0);
+
+    // Too wide for LdaSmi: the result goes to the pool, after what was there.
+    CHECK(r.constants.size() == 2 && r.constants[1].is_number() && r.constants[1].as_number() == 10000);
+    CHECK((r.code == std::vector<uint8_t>{b(Op::LdaConst), 1, 0, b(Op::Return)}));
+}
+
+static void test_fold_known_branch() {
+    Run r;
+    emit(r.code, Op::LdaTrue);
+    const uint32_t branch = emit(r.code, Op::JumpIfFalse, {0, 0});
+    emit(r.code, Op::LdaSmi, {1});
+    emit(r.code, Op::Return);
+    const uint32_t other = emit(r.code, Op::LdaSmi, {2});
+    emit(r.code, Op::Return);
+    aim(r.code, branch, other);
+    optimize(r, 0, 0);
+
+    // Never taken: the branch goes, and then the arm only it reached.
+    CHECK(r.stats.folded >= 1);
+    CHECK(r.stats.threaded >= 2);
+    CHECK((r.code == std::vector<uint8_t>{b(Op::LdaSmi), 1, b(Op::Return)}));
+}
+
+static void test_copyprop() {
+    Run r;
+    // r2 = r0; return r2 + r1
+    emit(r.code, Op::Mov, {0, 2});
+    emit(r.code, Op::Ldar, {2});
+    emit(r.code, Op::Add, {1});
+    emit(r.code, Op::Return);
+    optimize(r, 3, 2);
+
+    // The copy is read as its source, which leaves it unread and r2 unnamed.
+    CHECK(r.stats.propagated >= 1);
+    CHECK(r.stats.registers_dropped == 1);
+    CHECK((r.code == std::vector<uint8_t>{b(Op::Ldar), 0, b(Op::Add), 1, b(Op::Return)}));
+    CHECK(r.chunk.register_count == 2);
+
+    // Loading what the accumulator already holds is no load at all.
+    Run s;
+    emit(s.code, Op::Ldar, {0});
+    emit(s.code, Op::Star, {1});
+    emit(s.code, Op::Ldar, {1});
+    emit(s.code, Op::Return);
+    optimize(s, 2, 1);
+    CHECK((s.code == std::vector<uint8_t>{b(Op::Ldar), 0, b(Op::Return)}));
+}
+
+static void test_jump_to_jump() {
+    Run r;
+    emit(r.code, Op::Ldar, {0});
+    const uint32_t branch = emit(r.code, Op::JumpIfTrue, {0, 0});
+    emit(r.code, Op::LdaSmi, {1});
+    emit(r.code, Op::Return);
+    const uint32_t hop = emit(r.code, Op::Jump, {0, 0});
+    emit(r.code, Op::LdaSmi, {9});
+    emit(r.code, Op::Return);
+    const uint32_t target = emit(r.code, Op::LdaSmi, {2});
+    emit(r.code, Op::Return);
+    aim(r.code, branch, hop);
+    aim(r.code, hop, target);
+    optimize(r, 1, 1);
+
+    // The branch goes straight to the final target; the Jump, and the code
+    // only it skipped, go. The offset is re-measured over what is left.
+    CHECK(r.stats.threaded >= 1);
+    const std::vector<uint8_t> want{
+        b(Op::Ldar), 0,
+        b(Op::JumpIfTrue), 3, 0,
+        b(Op::LdaSmi), 1, b(Op::Return),
+        b(Op::LdaSmi), 2, b(Op::Return),
+    };
+    CHECK(r.code == want);
+}
+
+static void test_branch_over_jump() {
+    Run r;
+    // if (r0) goto then; goto else; then: return 1; else: return 2
+    emit(r.code, Op::Ldar, {0});
+    const uint32_t branch = emit(r.code, Op::JumpIfTrue, {0, 0});
+    const uint32_t over = emit(r.code, Op::Jump, {0, 0});
+    const uint32_t then_pc = emit(r.code, Op::LdaSmi, {1});
+    emit(r.code, Op::Return);
+    const uint32_t else_pc = emit(r.code, Op::LdaSmi, {2});
+    emit(r.code, Op::Return);
+    aim(r.code, branch, then_pc);
+    aim(r.code, over, else_pc);
+    optimize(r, 1, 1);
+
+    CHECK(r.stats.threaded >= 1);
+    const std::vector<uint8_t> want{
+        b(Op::Ldar), 0,
+        b(Op::JumpIfFalse), 3, 0,
+        b(Op::LdaSmi), 1, b(Op::Return),
+        b(Op::LdaSmi), 2, b(Op::Return),
+    };
+    CHECK(r.code == want);
+}
+
+static void test_backward_jump_retargeted() {
+    Run r;
+    // A loop whose body shrinks: the back edge has to be re-measured.
+    emit(r.code, Op::LdaZero);
+    emit(r.code, Op::Star, {1});
+    const uint32_t head = emit(r.code, Op::Ldar, {1});
+    emit(r.code, Op::TestLt, {0});
+    const uint32_t exit = emit(r.code, Op::JumpIfFalse, {0, 0});
+    emit(r.code, Op::LdaSmi, {7});     // dead: overwritten below
+    emit(r.code, Op::Ldar, {1});
+    emit(r.code, Op::Inc);
+    emit(r.code, Op::Star, {1});
+    const uint32_t back = emit(r.code, Op::Jump, {0, 0});
+    const uint32_t done = emit(r.code, Op::Ldar, {1});
+    emit(r.code, Op::Return);
+    aim(r.code, exit, done);
+    aim(r.code, back, head);
+    optimize(r, 2, 1);
+
+    CHECK(r.stats.dead_stores >= 1);
+    const std::vector<uint8_t> want{
+        b(Op::LdaZero), b(Op::Star), 1,
+        b(Op::Ldar), 1, b(Op::TestLt), 0,
+        b(Op::JumpIfFalse), 8, 0,
+        b(Op::Ldar), 1, b(Op::Inc), b(Op::Star), 1,
+        b(Op::Jump), 0xF1, 0xFF,
+        b(Op::Ldar), 1, b(Op::Return),
+    };
+    CHECK(r.code == want);
+}
+
+static void test_handlers_follow_code() {
+    Run r;
+    emit(r.code, Op::LdaSmi, {2});
+    emit(r.code, Op::Star, {1});
+    emit(r.code, Op::LdaSmi, {3});
+    emit(r.code, Op::Add, {1});
+    emit(r.code, Op::Star, {2});
+    const uint32_t try_start = emit(r.code, Op::Ldar, {0});
+    emit(r.code, Op::Throw);
+    const uint32_t handler = emit(r.code, Op::Ldar, {2});
+    emit(r.code, Op::Return);
+    const uint32_t pad = emit(r.code, Op::LdaUndefined);
+    emit(r.code, Op::Return);
+    r.chunk.ensure_handlers().push_back(HandlerEntry{try_start, handler, handler, static_cast<int32_t>(pad)});
+    optimize(r, 3, 1);
+
+    // Only the handler reads r2, so its store stays, renumbered to r1; every
+    // pc the region names moves down with the code in front of it.
+    const std::vector<uint8_t> want{
+        b(Op::LdaSmi), 5, b(Op::Star), 1,
+        b(Op::Ldar), 0, b(Op::Throw),
+        b(Op::Ldar), 1, b(Op::Return),
+        b(Op::LdaUndefined), b(Op::Return),
+    };
+    CHECK(r.code == want);
+    CHECK(r.chunk.register_count == 2);
+    const HandlerEntry& h = (*r.chunk.handlers)[0];
+    CHECK(h.start_pc == 4);
+    CHECK(h.end_pc == 7);
+    CHECK(h.handler_pc == 7);
+    CHECK(h.genreturn_pc == 10);
+}
+
+static void test_dse_keeps_arguments() {
+    Run r;
+    emit(r.code, Op::LdaSmi, {1});
+    emit(r.code, Op::Star, {0});
+    emit(r.code, Op::LdaSmi, {1});
+    emit(r.code, Op::Star, {1});
+    emit(r.code, Op::LdaSmi, {2});
+    emit(r.code, Op::Return);
+    r.chunk.needs_arguments = true;
+    optimize(r, 2, 1);
+
+    // The store to r1 is dead. The one to the parameter is not: the
+    // arguments object reads it without the code ever naming it.
+    const std::vector<uint8_t> want{
+        b(Op::LdaSmi), 1, b(Op::Star), 0,
+        b(Op::LdaSmi), 2, b(Op::Return),
+    };
+    CHECK(r.code == want);
+    CHECK(r.chunk.register_count == 1);
+}
+
+static void test_renumber_keeps_runs() {
+    Run r;
+    emit(r.code, Op::LdaUndefined);
+    emit(r.code, Op::Star, {6});
+    emit(r.code, Op::LdaSmi, {1});
+    emit(r.code, Op::Star, {4});
+    emit(r.code, Op::LdaSmi, {2});
+    emit(r.code, Op::Star, {5});
+    emit(r.code, Op::Call, {6, 4, 2, 0, 0, 0, 0});
+    emit(r.code, Op::Return);
+    optimize(r, 8, 0);
+
+    // r4..r6 close up to r0..r2, and the argument run stays a run.
+    CHECK(r.stats.registers_dropped == 5);
+    CHECK(r.chunk.register_count == 3);
+    const std::vector<uint8_t> want{
+        b(Op::LdaUndefined), b(Op::Star), 2,
+        b(Op::LdaSmi), 1, b(Op::Star), 0,
+        b(Op::LdaSmi), 2, b(Op::Star), 1,
+        b(Op::Call), 2, 0, 2, 0, 0, 0, 0,
+        b(Op::Return),
+    };
+    CHECK(r.code == want);
+}
+
+static void test_unchanged() {
+    // Nothing to do: every instruction is needed as it stands.
+    Run r;
+    emit(r.code, Op::Ldar, {0});
+    emit(r.code, Op::Add, {1});
+    emit(r.code, Op::Return);
+    const std::vector<uint8_t> before = r.code;
+    optimize(r, 2, 2);
+    CHECK(r.code == before);
+    CHECK(r.chunk.register_count == 2);
+    CHECK(r.stats.folded == 0 && r.stats.propagated == 0 && r.stats.threaded == 0);
+    CHECK(r.stats.dead_stores == 0 && r.stats.registers_dropped == 0);
+
+    // An opcode the passes do not model reads everything and leaves nothing
+    // known, so the store in front of it and the load after it both stay.
+    Run s;
+    emit(s.code, Op::LdaSmi, {4});
+    emit(s.code, Op::Star, {1});
+    emit(s.code, Op::SaveEnv);
+    emit(s.code, Op::Ldar, {1});
+    emit(s.code, Op::Return);
+    const std::vector<uint8_t> opaque = s.code;
+    optimize(s, 2, 1);
+    CHECK(s.code == opaque);
+    CHECK(s.chunk.register_count == 2);
+}
+
+static void test_unencodable_left_alone() {
+    // Two nested regions that differ only by code the passes drop would tie
+    // afterwards, and the interpreter would pick the outer one: the whole
+    // body is left exactly as it came, constants included.
+    Run r;
+    r.constants.push_back(Value(2.5));
+    const uint32_t start = emit(r.code, Op::Ldar, {0});
+    emit(r.code, Op::Throw);
+    const uint32_t inner_end = emit(r.code, Op::LdaSmi, {1});  // unreachable
+    emit(r.code, Op::Return);
+    const uint32_t handler = emit(r.code, Op::Return);
+    r.chunk.ensure_handlers().push_back(HandlerEntry{start, handler, handler});
+    r.chunk.ensure_handlers().push_back(HandlerEntry{start, inner_end, handler});
+    const std::vector<uint8_t> before = r.code;
+    optimize(r, 1, 1);
+
+    CHECK(r.code == before);
+    CHECK(r.constants.size() == 1);
+    CHECK(r.stats.bytes_before == r.stats.bytes_after);
+    CHECK(r.stats.threaded == 0 && r.stats.dead_stores == 0);
+    CHECK((*r.chunk.handlers)[0].end_pc == handler);
+    CHECK((*r.chunk.handlers)[1].end_pc == inner_end);
+}
+
+int main() {
+    if (!VM::passes_enabled()) {
+        std::printf("passes-test: QUANTA_VM_PASSES=0, nothing to test\n");
+        return 0;
+    }
+
+    test_fold_arithmetic();
+    test_fold_wide_result();
+    test_fold_known_branch();
+    test_copyprop();
+    test_jump_to_jump();
+    test_branch_over_jump();
+    test_backward_jump_retargeted();
+    test_handlers_follow_code();
+    test_dse_keeps_arguments();
+    test_renumber_keeps_runs();
+    test_unchanged();
+    test_unencodable_left_alone();
+
+    if (failures == 0) {
+        std::printf("passes-test: ALL PASS\n");
+        return 0;
+    }
+    std::printf("passes-test: %d FAILURE(S)\n", failures);
+    return 1;
+}
@@ -0,0 +1,327 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Threaded stream tests (make threaded-test). The functions here are run a
+ * few times each -- well short of kBaselineBudget, so they stay on the
+ * stream -- and then the decoded chunk is checked against its compact
+ * encoding, every case's result against a QUANTA_VM_THREADED=0 run of the
+ * same binary, and each binary-op site's feedback and handler against the
+ * operands it has been given.
+ */
+
+#include "quanta/core/engine/Engine.h"
+#include "quanta/core/runtime/Object.h"
+#include "quanta/core/vm/Bytecode.h"
+#include "quanta/core/vm/ThreadedCode.h"
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace Quanta;
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        std::printf("FAIL %s:%d  %s\n", __FILE__, __LINE__, #cond); \
+        failures++; \
+    } \
+} while (0)
+
+static Engine* engine = nullptr;
+
+static bool run(const char* source) {
+    Engine::Result r = engine->execute(source, "<threaded-test>");
+    if (!r.success) std::printf("script failed: %s\n", r.error_message.c_str());
+    return r.success;
+}
+
+// Whether `expression` evaluates to true, read back through a global.
+static bool holds(const char* expression) {
+    if (!run(("globalThis.holds = (" + std::string(expression) + ") === true; 0;").c_str())) return false;
+    const Value v = engine->get_global_property("holds");
+    return v.is_boolean() && v.as_boolean();
+}
+
+// The chunk a global function runs from -- a generator's is the suspendable
+// one; null when it has none yet.
+static const BytecodeChunk* chunk_of(const char* name) {
+    const Value v = engine->get_global_property(name);
+    if (!v.is_function()) return nullptr;
+    const auto& exec = v.as_function()->get_executable();
+    if (!exec) return nullptr;
+    return exec->bytecode_chunk ? exec->bytecode_chunk.get() : exec->suspendable_chunk.get();
+}
+
+// Each leaves its result, as a string, in globalThis.out; `fn` is the global
+// function whose chunk test_layout checks.
+struct Case {
+    const char* name;
+    const char* fn;
+    const char* source;
+};
+
+static const Case kCases[] = {
+    {"arithmetic", "arith", R"JS(
+        function arith(n) {
+            let i = 0, s = 0, d = 0.5, bits = 0;
+            while (i < n) {
+                s = s + i * 3 - 1;
+                d = d * 1.5 - i / 4;
+                bits = (bits ^ (i << 3)) | (i >>> 1);
+                i = i + 1;
+            }
+            return [s, d, bits, 2147483647 + n, -0 * n, n % 7].join(",");
+        }
+        globalThis.out = arith(60) + " " + arith(0);
+    )JS"},
+    {"compare", "cmp", R"JS(
+        function cmp(a, b) {
+            return [a < b, a > b, a <= b, a >= b, a == b, a != b, a === b, a !== b].join("");
+        }
+        globalThis.out = [cmp(1, 2), cmp(2.5, 2.5), cmp(NaN, 1), cmp(-0, 0), cmp(Infinity, 1),
+                          cmp("a", "b"), cmp("10", 9), cmp(null, undefined),
+                          // Numbers again, on sites the strings have moved to
+                          // the generic handlers.
+                          cmp(3, 3), cmp(4, 3.5), cmp(NaN, NaN)].join(" ");
+    )JS"},
+    {"branches", "classify", R"JS(
+        function classify(x) {
+            if (x === undefined) return "u";
+            if (!x) return "falsy";
+            let kind = "";
+            for (let i = 0; i < 3; i++) {
+                if (i === 1) continue;
+                kind += typeof x === "number" ? (x > 10 ? "big" : "small") : "other";
+            }
+            return kind;
+        }
+        globalThis.out = [classify(), classify(0), classify(""), classify(5), classify(50),
+                          classify("s"), classify({})].join(",");
+    )JS"},
+    {"caught exception", "guarded", R"JS(
+        function guarded(n) {
+            let log = "";
+            for (let i = 0; i < n; i++) {
+                try {
+                    if (i % 3 === 2) throw i;
+                    log += i;
+                } catch (e) {
+                    log += "!" + e;
+                } finally {
+                    log += ".";
+                }
+            }
+            return log;
+        }
+        globalThis.out = guarded(10);
+    )JS"},
+    {"generator", "gen", R"JS(
+        function* gen(n) {
+            let total = 0;
+            for (let i = 0; i < n; i++) total += yield i * 2;
+            return total;
+        }
+        const it = gen(5);
+        const seen = [it.next().value];
+        for (let k = 1; k < 10; k++) {
+            const r = it.next(k);
+            seen.push(r.done ? "done:" + r.value : r.value);
+            if (r.done) break;
+        }
+        globalThis.out = seen.join(",");
+    )JS"},
+};
+
+static std::string run_case(const Case& c) {
+    if (!run(c.source)) return "script failed";
+    return engine->get_global_property("out").to_string();
+}
+
+// The stream against the encoding it was decoded from: a slot per
+// instruction in pc order, slot_at mapping each instruction start back to
+// its slot, and an exit copy that differs from the code exactly at the
+// decoded instructions' opcode bytes.
+static void test_layout(const Case& c) {
+    const BytecodeChunk* chunk = chunk_of(c.fn);
+    CHECK(chunk != nullptr);
+    if (!chunk) return;
+    CHECK(chunk->baseline == nullptr);
+    CHECK(chunk->threaded != nullptr);
+    if (!chunk->threaded) return;
+    const VM::ThreadedCode& tc = *chunk->threaded;
+    CHECK(tc.slot_count > 0);
+    if (tc.slot_count == 0) return;
+
+    const auto& code = chunk->code;
+    uint32_t pc = 0, slot = 0, exits = 0;
+    bool in_order = true, mapped = true, copied = true;
+    while (pc < code.size() && slot < tc.slot_count) {
+        const Op op = static_cast<Op>(code[pc]);
+        in_order &= tc.slots[slot].pc == pc && tc.slots[slot].op == code[pc];
+        mapped &= tc.slot_at[pc] == slot;
+        if (tc.exit_code[pc] == VM::kThreadedExitByte) exits++;
+        else copied &= tc.exit_code[pc] == code[pc];
+        for (int k = 1; k <= op_operand_bytes(op); k++) copied &= tc.exit_code[pc + k] == code[pc + k];
+        pc += 1 + static_cast<uint32_t>(op_operand_bytes(op));
+        slot++;
+    }
+    if (!in_order || !mapped || !copied) std::printf("  %s: stream does not match the encoding\n", c.name);
+    CHECK(in_order && mapped && copied);
+    CHECK(pc == code.size());
+    CHECK(exits == tc.decoded_ops);
+    CHECK(tc.decoded_ops > 0);
+}
+
+// The slot of the first `op` in a global function's chunk.
+static const VM::ThreadedSlot* slot_of(const char* fn, Op op) {
+    const BytecodeChunk* chunk = chunk_of(fn);
+    if (!chunk || !chunk->threaded || chunk->threaded->slot_count == 0) return nullptr;
+    const VM::ThreadedCode& tc = *chunk->threaded;
+    for (uint32_t i = 0; i < tc.slot_count; i++) {
+        if (tc.slots[i].op == static_cast<uint8_t>(op)) return &tc.slots[i];
+    }
+    return nullptr;
+}
+
+// A binary-op site is quickened by its first execution to the form its
+// operands call for, keeps that form for anything the form itself handles,
+// and is moved to the generic handler for good -- with the new kind added
+// to its feedback -- the first time it sees something else.
+static void test_quickening() {
+    CHECK(run(R"JS(
+        function add(a, b) { return a + b; }
+        function cat(a, b) { return a + b; }
+        function mixed(a, b) { return a + b; }
+        function scale(a, b) { return a * b; }
+        function lt(a, b) { return a < b; }
+        function diff(a, b) { return a - b; }
+        0;
+    )JS"));
+
+    // Int32 operands: the number form, which also takes doubles, NaN and the
+    // infinities without leaving it.
+    CHECK(holds("add(1, 2) === 3"));
+    const VM::ThreadedSlot* add = slot_of("add", Op::Add);
+    CHECK(add != nullptr);
+    if (!add) return;
+    CHECK(add->feedback == VM::kBinaryInt);
+    const VM::ThreadedHandler add_number = add->fn;
+    CHECK(holds("add(0.5, 2) === 2.5 && Number.isNaN(add(NaN, 1)) && add(1, Infinity) === Infinity"));
+    CHECK(holds("add(2147483647, 1) === 2147483648"));
+    CHECK(add->fn == add_number);
+    CHECK(add->feedback == VM::kBinaryInt);
+
+    // Two strings: the concatenation form.
+    CHECK(holds("cat('x', 'y') === 'xy'"));
+    const VM::ThreadedSlot* cat = slot_of("cat", Op::Add);
+    CHECK(cat != nullptr);
+    if (!cat) return;
+    CHECK(cat->feedback == VM::kBinaryString);
+    const VM::ThreadedHandler add_string = cat->fn;
+    CHECK(add_string != add_number);
+
+    // One of each from the start: the generic handler, straight away.
+    CHECK(holds("mixed(1, 'a') === '1a'"));
+    const VM::ThreadedSlot* mixed = slot_of("mixed", Op::Add);
+    CHECK(mixed != nullptr);
+    if (!mixed) return;
+    CHECK(mixed->feedback == VM::kBinaryOther);
+    const VM::ThreadedHandler add_generic = mixed->fn;
+    CHECK(add_generic != add_number && add_generic != add_string);
+
+    // A guard miss deopts, with the right answer, and for good.
+    CHECK(holds("add('a', 'b') === 'ab'"));
+    CHECK(add->fn == add_generic);
+    CHECK(add->feedback == (VM::kBinaryInt | VM::kBinaryString));
+    CHECK(holds("add(2, 3) === 5 && add(0.25, 0.25) === 0.5"));
+    CHECK(add->fn == add_generic);
+    CHECK(holds("cat(1, 2) === 3 && cat('p', 'q') === 'pq'"));
+    CHECK(cat->fn == add_generic);
+    CHECK(cat->feedback == (VM::kBinaryString | VM::kBinaryInt));
+
+    // A double first records double, not int.
+    CHECK(holds("scale(0.5, 3) === 1.5 && scale(-0, 5) === 0 && 1 / scale(-0, 5) === -Infinity"));
+    const VM::ThreadedSlot* scale = slot_of("scale", Op::Mul);
+    CHECK(scale != nullptr);
+    if (scale) CHECK(scale->feedback == VM::kBinaryDouble);
+
+    // Comparisons quicken the same way, NaN included in the number form.
+    CHECK(holds("lt(1, 2) === true && lt(NaN, 1) === false && lt(1, NaN) === false"));
+    const VM::ThreadedSlot* lt = slot_of("lt", Op::TestLt);
+    CHECK(lt != nullptr);
+    if (!lt) return;
+    const VM::ThreadedHandler lt_number = lt->fn;
+    CHECK(lt->feedback == VM::kBinaryInt);
+    CHECK(holds("lt('a', 'b') === true && lt('b', 'a') === false"));
+    CHECK(lt->fn != lt_number);
+    CHECK(lt->feedback == (VM::kBinaryInt | VM::kBinaryString));
+    CHECK(holds("lt(2, 1) === false && lt(1.5, 2) === true"));
+
+    // No string form for Sub: two strings go to the generic handler, which
+    // still converts them.
+    CHECK(holds("diff('5', '2') === 3"));
+    const VM::ThreadedSlot* diff = slot_of("diff", Op::Sub);
+    CHECK(diff != nullptr);
+    if (diff) CHECK(diff->feedback == VM::kBinaryString);
+    CHECK(holds("diff(5, 2) === 3"));
+    if (diff) CHECK(diff->feedback == VM::kBinaryString);
+}
+
+int main(int argc, char** argv) {
+    // Immortal, as every engine is.
+    engine = new Engine();
+    if (!engine->initialize()) {
+        std::printf("threaded-test: engine failed to initialize\n");
+        return 1;
+    }
+
+    // The second run: one line per case, off the handler table.
+    if (argc > 1 && std::strcmp(argv[1], "--table") == 0) {
+        for (const Case& c : kCases) std::printf("%s\n", run_case(c).c_str());
+        return 0;
+    }
+
+    if (!VM::threaded_enabled()) {
+        std::printf("threaded-test: QUANTA_VM_THREADED=0, nothing to test\n");
+        return 0;
+    }
+
+    std::vector<std::string> threaded;
+    for (const Case& c : kCases) {
+        threaded.push_back(run_case(c));
+        test_layout(c);
+    }
+    test_quickening();
+
+    const std::string command = "QUANTA_VM_THREADED=0 '" + std::string(argv[0]) + "' --table";
+    FILE* child = popen(command.c_str(), "r");
+    CHECK(child != nullptr);
+    if (!child) return 1;
+    std::vector<std::string> table;
+    std::string line;
+    for (int ch; (ch = std::fgetc(child)) != EOF;) {
+        if (ch != '\n') { line += static_cast<char>(ch); continue; }
+        table.push_back(line);
+        line.clear();
+    }
+    CHECK(pclose(child) == 0);
+
+    CHECK(table.size() == threaded.size());
+    for (size_t i = 0; i < threaded.size() && i < table.size(); i++) {
+        if (threaded[i] == table[i]) continue;
+        std::printf("  %s:\n    threaded: %s\n    table:    %s\n", kCases[i].name,
+                    threaded[i].c_str(), table[i].c_str());
+        failures++;
+    }
+
+    if (failures == 0) {
+        std::printf("threaded-test: ALL PASS\n");
+        return 0;
+    }
+    std::printf("threaded-test: %d FAILURE(S)\n", failures);
+    return 1;
+}
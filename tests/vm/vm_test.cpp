@@ -0,0 +1,354 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * Interpreter behaviour tests (make vm-test). Functions are defined and
+ * called by script, and what is checked is both what the script sees and
+ * what the chunks they compiled to recorded along the way. The class cases
+ * are run a second time by this binary with QUANTA_VM_CLASSES=0, and the
+ * tree-walker has to print what the compiled classes did.
+ */
+
+#include "quanta/core/engine/Engine.h"
+#include "quanta/core/runtime/Object.h"
+#include "quanta/core/vm/Bytecode.h"
+#include "quanta/core/vm/Inliner.h"
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace Quanta;
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        std::printf("FAIL %s:%d  %s\n", __FILE__, __LINE__, #cond); \
+        failures++; \
+    } \
+} while (0)
+
+static Engine* engine = nullptr;
+
+static bool run(const char* source) {
+    Engine::Result r = engine->execute(source, "<vm-test>");
+    if (!r.success) std::printf("script failed: %s\n", r.error_message.c_str());
+    return r.success;
+}
+
+// Whether `expression` evaluates to true, read back through a global.
+static bool holds(const char* expression) {
+    if (!run(("globalThis.holds = (" + std::string(expression) + ") === true; 0;").c_str())) return false;
+    const Value v = engine->get_global_property("holds");
+    return v.is_boolean() && v.as_boolean();
+}
+
+static Function* function_named(const char* name) {
+    const Value v = engine->get_global_property(name);
+    return v.is_function() ? v.as_function() : nullptr;
+}
+
+// The chunk a global function runs from; null when it has none yet.
+static const BytecodeChunk* chunk_of(const char* name) {
+    Function* fn = function_named(name);
+    if (!fn || !fn->get_executable()) return nullptr;
+    return fn->get_executable()->bytecode_chunk.get();
+}
+
+// The feedback of the only call site in a global function.
+static const CallFeedback* call_site_of(const char* name) {
+    const BytecodeChunk* chunk = chunk_of(name);
+    if (!chunk || chunk->call_feedback.size() != 1) return nullptr;
+    return &chunk->call_feedback[0];
+}
+
+static void test_call_feedback() {
+    CHECK(run(R"JS(
+        function helper(x) { return x + 1; }
+        function other(x) { return x * 10; }
+        function make() { return function (x) { return x - 1; }; }
+        function through(f, x) { return f(x); }
+        function closures(f, x) { return f(x); }
+        function named(x) { return helper(x); }
+        function native(x) { return Math.abs(x); }
+        function bound(f, x) { return f(x); }
+        0;
+    )JS"));
+    using Kind = CallFeedback::Kind;
+
+    // One target: the site learns its executable.
+    CHECK(holds("through(helper, 1) === 2"));
+    const CallFeedback* cf = call_site_of("through");
+    CHECK(cf != nullptr);
+    if (!cf) return;
+    CHECK(cf->kind == Kind::Bytecode);
+    CHECK(cf->function == function_named("helper"));
+    CHECK(cf->executable == function_named("helper")->get_executable().get());
+    CHECK(holds("through(helper, 41) === 42"));
+    CHECK(cf->kind == Kind::Bytecode);
+
+    // A second target: megamorphic for good, its cells dropped, and every
+    // call still right.
+    CHECK(holds("through(other, 2) === 20"));
+    CHECK(cf->kind == Kind::Mega);
+    CHECK(cf->function == nullptr && cf->executable == nullptr);
+    CHECK(holds("through(helper, 3) === 4 && through(other, 3) === 30"));
+    CHECK(cf->kind == Kind::Mega);
+
+    // Keyed on the executable: every closure of one declaration hits.
+    CHECK(holds("(() => { const a = make(), b = make(); return closures(a, 5) === 4 && closures(b, 7) === 6; })()"));
+    const CallFeedback* by_decl = call_site_of("closures");
+    CHECK(by_decl != nullptr);
+    if (by_decl) CHECK(by_decl->kind == Kind::Bytecode);
+
+    // A callee looked up by name and then redefined: the site's executable
+    // no longer matches, so it lets go of the old function and the new one
+    // is what runs.
+    CHECK(holds("named(1) === 2"));
+    const CallFeedback* by_name = call_site_of("named");
+    CHECK(by_name != nullptr);
+    if (!by_name) return;
+    CHECK(by_name->kind == Kind::Bytecode);
+    CHECK(run("helper = function (x) { return x + 100; }; 0;"));
+    CHECK(holds("named(1) === 101"));
+    CHECK(by_name->kind == Kind::Mega);
+    CHECK(by_name->function == nullptr);
+    CHECK(holds("named(2) === 102"));
+
+    // Natives are keyed on the function, bind() results on the wrapper.
+    CHECK(holds("native(-3) === 3 && native(4) === 4"));
+    const CallFeedback* to_native = call_site_of("native");
+    CHECK(to_native != nullptr);
+    if (to_native) CHECK(to_native->kind == Kind::Native);
+    CHECK(holds("(() => { const b = other.bind(null); return bound(b, 3) === 30 && bound(b, 4) === 40; })()"));
+    const CallFeedback* to_bound = call_site_of("bound");
+    CHECK(to_bound != nullptr);
+    if (to_bound) {
+        CHECK(to_bound->kind == Kind::Bound);
+        CHECK(to_bound->target == function_named("other"));
+    }
+}
+
+// Whether a chunk holds `op` anywhere.
+static bool contains_op(const BytecodeChunk& chunk, Op op) {
+    for (uint32_t pc = 0; pc < chunk.code.size();) {
+        const Op at = static_cast<Op>(chunk.code[pc]);
+        if (at == op) return true;
+        pc += 1 + static_cast<uint32_t>(op_operand_bytes(at));
+    }
+    return false;
+}
+
+static void test_inline_guard() {
+    if (!VM::inlining_enabled()) return;
+    // Enough back-edges to spend the caller's budget, so the call after it
+    // builds the variant with square inlined.
+    CHECK(run(R"JS(
+        function square(x) { return x * x; }
+        function sum_squares(n) { let s = 0; for (let i = 0; i < n; i++) s += square(i); return s; }
+        globalThis.warm = sum_squares(3000);
+        0;
+    )JS"));
+    CHECK(holds("sum_squares(10) === 285"));
+    const BytecodeChunk* chunk = chunk_of("sum_squares");
+    CHECK(chunk && chunk->inlined && chunk->inlined->variant);
+    if (!chunk || !chunk->inlined || !chunk->inlined->variant) return;
+    const BytecodeChunk& variant = *chunk->inlined->variant;
+    CHECK(chunk->inlined->sites == 1);
+    CHECK(contains_op(variant, Op::InlineGuard));
+    CHECK(variant.inlined && variant.inlined->targets.size() == 1 &&
+          variant.inlined->targets[0].executable == function_named("square")->get_executable().get());
+    // The guard passed, so the call behind it -- with the feedback the
+    // variant was built from -- has not run.
+    CHECK(variant.call_feedback.size() == 1 && variant.call_feedback[0].kind == CallFeedback::Kind::Bytecode);
+    CHECK(holds("sum_squares(4) === 14"));
+
+    // Another body under the same name: the guard fails, the original call
+    // runs (and finds its own feedback stale), and the answer is the new
+    // body's -- every time after, too.
+    CHECK(run("square = function (x) { return -x; }; 0;"));
+    CHECK(holds("sum_squares(10) === -45"));
+    CHECK(variant.call_feedback[0].kind == CallFeedback::Kind::Mega);
+    CHECK(holds("sum_squares(4) === -6"));
+
+    // And back to a square that is not the inlined one: still the call.
+    CHECK(run("square = function (x) { return x * x; }; 0;"));
+    CHECK(holds("sum_squares(10) === 285"));
+}
+
+struct ClassCase {
+    const char* name;
+    // Defines and runs a global function `define`, which builds its classes
+    // and returns what they did, as a string.
+    const char* source;
+};
+
+// Every key expression and heritage logs itself, so a case's result carries
+// the order they ran in as well as the classes they built.
+static const ClassCase kClassCases[] = {
+    {"computed keys", R"JS(
+        function define() {
+            const log = [];
+            const k = (n) => { log.push("key " + n); return n; };
+            class C {
+                [k("a")]() { return "a"; }
+                static [k("s1")]() { return "s1"; }
+                plain() { return "p"; }
+                get [k("g")]() { return "g"; }
+                static [k("s2")]() { return "s2"; }
+                set [k("g")](v) { log.push("set " + v); }
+                [k(2)]() { return 2; }
+                static get [k("sg")]() { return "sg"; }
+                1() { return 1; }
+                [{ toString() { log.push("toString"); return "obj"; } }]() { return "o"; }
+                [Symbol.iterator]() { return [][Symbol.iterator](); }
+            }
+            const c = new C();
+            c.g = 5;
+            return [log.join(","), Object.getOwnPropertyNames(C.prototype).join(","),
+                    Object.getOwnPropertyNames(C).join(","), c.a() + c.plain() + c.g + c[2]() + c[1]() + c.obj(),
+                    C.s1() + C.s2() + C.sg, [...c].length].join(" | ");
+        }
+    )JS"},
+    {"heritage", R"JS(
+        function define() {
+            const log = [];
+            const k = (n) => { log.push("key " + n); return n; };
+            function base() {
+                log.push("heritage");
+                return class B {
+                    constructor(x) { this.x = x; }
+                    who() { return "B" + this.x; }
+                    static kind() { return "base"; }
+                };
+            }
+            class D extends base() {
+                constructor() { super(7); this.y = 1; }
+                [k("who")]() { return "D:" + super.who(); }
+                static [k("kind")]() { return "derived of " + super.kind(); }
+            }
+            class N extends null { [k("n")]() { return "n"; } }
+            const d = new D();
+            return [log.join(","), d.who(), D.kind(), d.x + d.y, Object.getPrototypeOf(D.prototype).constructor.name,
+                    Object.getPrototypeOf(N.prototype), Object.getPrototypeOf(N) === Function.prototype,
+                    d instanceof D, Object.getOwnPropertyNames(D.prototype).join(",")].join(" | ");
+        }
+    )JS"},
+    {"abrupt", R"JS(
+        function define() {
+            const log = [];
+            const k = (n) => { log.push("key " + n); return n; };
+            const out = [];
+            const arrow = () => {};
+            const unlinked = function () {}.bind();
+            const thrower = () => { throw new RangeError("key"); };
+            function own() { log.push("own heritage"); return Object; }
+            try { class A extends 5 { [k("not after a number")]() {} } out.push("A"); } catch (e) { out.push(e.constructor.name); }
+            try { class A extends arrow { [k("not after an arrow")]() {} } out.push("A"); } catch (e) { out.push(e.constructor.name); }
+            try { class A extends unlinked { [k("not after no prototype")]() {} } out.push("A"); } catch (e) { out.push(e.constructor.name); }
+            try {
+                class A { [k("first")]() {} [thrower()]() {} [k("never")]() {} }
+                out.push("A");
+            } catch (e) { out.push(e.constructor.name); }
+            try {
+                class A { [k("before")]() {} static [k("prototype")]() {} [k("after")]() {} }
+                out.push("A");
+            } catch (e) { out.push(e.constructor.name); }
+            class O extends own() { static [k("ok")]() { return 1; } }
+            out.push(O.ok());
+            return out.join(",") + " | " + log.join(",");
+        }
+    )JS"},
+    {"every evaluation", R"JS(
+        function define() {
+            const made = [];
+            for (let i = 0; i < 3; i++) {
+                class C { ["m" + i]() { return i; } static ["s" + i]() { return -i; } }
+                made.push(Object.getOwnPropertyNames(C.prototype).join(",") + "/" + C["s" + i]() + "/" + new C()["m" + i]());
+            }
+            return made.join(" ");
+        }
+    )JS"},
+};
+
+// What `define` returned, or why it did not.
+static std::string run_class_case(const ClassCase& c) {
+    Engine::Result r = engine->execute(c.source, "<vm-test>");
+    if (r.success) r = engine->execute("globalThis.out = String(define()); 0;", "<vm-test>");
+    if (!r.success) return "script failed: " + r.error_message;
+    return engine->get_global_property("out").to_string();
+}
+
+static void test_class_definition(const char* self) {
+    std::vector<std::string> compiled;
+    for (const ClassCase& c : kClassCases) {
+        compiled.push_back(run_class_case(c));
+        // Built by CreateClass here, with nothing left for DefineClass.
+        const BytecodeChunk* chunk = chunk_of("define");
+        CHECK(chunk != nullptr);
+        if (!chunk) continue;
+        CHECK(contains_op(*chunk, Op::CreateClass));
+        CHECK(!contains_op(*chunk, Op::DefineClass));
+    }
+    // The heritage first, then every key in source order, static or not.
+    CHECK(compiled[0].rfind("key a,key s1,key g,key s2,key g,key 2,key sg,toString,set 5 | ", 0) == 0);
+    CHECK(compiled[1].rfind("heritage,key who,key kind,key n | ", 0) == 0);
+    // A heritage that is no constructor throws before any key runs; a key
+    // that throws stops the ones after it.
+    CHECK(compiled[2] == "TypeError,TypeError,TypeError,RangeError,TypeError,1 | "
+                         "key first,key before,key prototype,own heritage,key ok");
+
+    const std::string command = "QUANTA_VM_CLASSES=0 '" + std::string(self) + "' --tree-walker";
+    FILE* child = popen(command.c_str(), "r");
+    CHECK(child != nullptr);
+    if (!child) return;
+    std::vector<std::string> walked;
+    std::string line;
+    for (int ch; (ch = std::fgetc(child)) != EOF;) {
+        if (ch != '\n') { line += static_cast<char>(ch); continue; }
+        walked.push_back(line);
+        line.clear();
+    }
+    CHECK(pclose(child) == 0);
+
+    CHECK(walked.size() == compiled.size());
+    for (size_t i = 0; i < compiled.size() && i < walked.size(); i++) {
+        if (compiled[i] == walked[i]) continue;
+        std::printf("  %s:\n    compiled:    %s\n    tree-walker: %s\n", kClassCases[i].name,
+                    compiled[i].c_str(), walked[i].c_str());
+        failures++;
+    }
+}
+
+int main(int argc, char** argv) {
+    // Immortal, as every engine is.
+    engine = new Engine();
+    if (!engine->initialize()) {
+        std::printf("vm-test: engine failed to initialize\n");
+        return 1;
+    }
+
+    // The second run: one line per class case, every class left to
+    // DefineClass.
+    if (argc > 1 && std::strcmp(argv[1], "--tree-walker") == 0) {
+        for (const ClassCase& c : kClassCases) {
+            const std::string result = run_class_case(c);
+            const BytecodeChunk* chunk = chunk_of("define");
+            std::printf("%s%s\n", chunk && contains_op(*chunk, Op::CreateClass) ? "COMPILED " : "", result.c_str());
+        }
+        return 0;
+    }
+
+    test_call_feedback();
+    test_inline_guard();
+    test_class_definition(argv[0]);
+
+    if (failures == 0) {
+        std::printf("vm-test: ALL PASS\n");
+        return 0;
+    }
+    std::printf("vm-test: %d FAILURE(S)\n", failures);
+    return 1;
+}
@@ -0,0 +1,65 @@
+// Interpreter dispatch microbenchmark: loops made of the instructions the
+// pre-decoded stream runs itself (register moves, constants, jumps, numeric
+// and bitwise ops), plus one that mostly bridges to the handler table
+// (property reads and calls), so a change to either path shows up.
+//
+// Compare the threaded stream against the compact-encoding dispatch with the
+// baseline compiler out of the way:
+//
+//   QUANTA_JIT=0 QUANTA_VM_THREADED=1 ./build/bin/quanta tools/bench_dispatch.js
+//   QUANTA_JIT=0 QUANTA_VM_THREADED=0 ./build/bin/quanta tools/bench_dispatch.js
+//
+// Each case runs a few times and reports its best, in milliseconds.
+
+function sumLoop(n) {
+    let s = 0;
+    for (let i = 0; i < n; i++) s = s + i;
+    return s;
+}
+
+function bitMix(n) {
+    let h = 0x811c9dc5 | 0;
+    for (let i = 0; i < n; i++) {
+        h = h ^ (i & 0xff);
+        h = (h << 5) - h;
+        h = h | 0;
+    }
+    return h;
+}
+
+function nestedCompare(n) {
+    let hits = 0;
+    for (let i = 0; i < n; i++) {
+        let a = i % 7;
+        if (a < 3) hits++;
+        else if (a >= 5) hits--;
+    }
+    return hits;
+}
+
+function bridged(n) {
+    const p = { x: 1, y: 2 };
+    function inc(v) { return v + 1; }
+    let s = 0;
+    for (let i = 0; i < n; i++) s = inc(s + p.x + p.y);
+    return s;
+}
+
+const cases = [
+    ["sum_loop", sumLoop, 5000000],
+    ["bit_mix", bitMix, 5000000],
+    ["nested_compare", nestedCompare, 5000000],
+    ["bridged", bridged, 1000000],
+];
+
+for (const [name, fn, n] of cases) {
+    let best = Infinity;
+    let result;
+    for (let round = 0; round < 5; round++) {
+        const start = Date.now();
+        result = fn(n);
+        const elapsed = Date.now() - start;
+        if (elapsed < best) best = elapsed;
+    }
+    console.log(name + ": " + best + " ms (" + result + ")");
+}
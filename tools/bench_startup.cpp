@@ -0,0 +1,96 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+// Engine startup benchmark: builds engines back to back on one thread, the
+// way an embedder that creates one per request does, and reports what each
+// costs to bring up.
+//
+// The first engine on a thread is the cold start: besides its own realm it
+// pays for what every later one shares -- the root of the shape tree and the
+// transitions the builtins grow off it, the well-known symbols, the interned
+// property names. Every later engine restores onto that and only builds its
+// realm. Both are reported, and the later ones are split into the first and
+// last quarter of the run so that a per-engine cost that grows with the
+// number of engines already built shows up as a gap between the two.
+//
+//   make bench-startup
+//   ./build/bin/bench-startup [engines]      (default 500)
+//
+// Memory is resident-set growth over the run divided by the engine count, so
+// it includes whatever each engine leaves behind when it is shut down.
+
+#include "quanta/core/engine/Engine.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using namespace Quanta;
+
+namespace {
+
+long resident_kb() {
+#if defined(__linux__)
+    long pages = 0, resident = 0;
+    if (FILE* f = std::fopen("/proc/self/statm", "r")) {
+        if (std::fscanf(f, "%ld %ld", &pages, &resident) != 2) resident = 0;
+        std::fclose(f);
+    }
+    return resident * 4;
+#else
+    return 0;
+#endif
+}
+
+double start_one_us() {
+    auto t0 = std::chrono::steady_clock::now();
+    auto* engine = new Engine();
+    bool ok = engine->initialize();
+    auto t1 = std::chrono::steady_clock::now();
+    if (!ok) {
+        std::fprintf(stderr, "engine failed to initialize\n");
+        std::exit(1);
+    }
+    engine->shutdown();
+    delete engine;
+    return std::chrono::duration<double, std::micro>(t1 - t0).count();
+}
+
+double mean(const std::vector<double>& v, size_t from, size_t to) {
+    double sum = 0;
+    for (size_t i = from; i < to; i++) sum += v[i];
+    return to > from ? sum / (to - from) : 0;
+}
+
+}
+
+int main(int argc, char** argv) {
+    int engines = argc > 1 ? std::atoi(argv[1]) : 500;
+    if (engines < 8) engines = 8;
+
+    long rss_before = resident_kb();
+    double cold = start_one_us();
+    long rss_cold = resident_kb();
+
+    std::vector<double> warm;
+    warm.reserve(engines - 1);
+    for (int i = 1; i < engines; i++) warm.push_back(start_one_us());
+    long rss_after = resident_kb();
+
+    size_t quarter = warm.size() / 4;
+    std::printf("engines:            %d\n", engines);
+    std::printf("cold start:         %8.1f us\n", cold);
+    std::printf("warm start (mean):  %8.1f us\n", mean(warm, 0, warm.size()));
+    std::printf("  first quarter:    %8.1f us\n", mean(warm, 0, quarter));
+    std::printf("  last quarter:     %8.1f us\n", mean(warm, warm.size() - quarter, warm.size()));
+    if (rss_before > 0) {
+        std::printf("rss, first engine:  %8ld KB\n", rss_cold - rss_before);
+        std::printf("rss, per engine:    %8.1f KB\n",
+                    double(rss_after - rss_cold) / double(engines - 1));
+    }
+    return 0;
+}